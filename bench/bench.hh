@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+/* Timing and reporting shared by the benchmarks. Results print as text,
+ * or with BENCH_JSON set in the environment as one JSON object per line,
+ * so that runs can be compared between releases. */
+
+static const char *bench_suite = "";
+static char        bench_engine[64];
+static const char *bench_prefix = "";
+
+static inline double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static inline bool
+bench_json()
+{
+  const char *env = getenv("BENCH_JSON");
+  return env && *env && strcmp(env, "0");
+}
+
+/* Names the results which follow: the program, and what it runs on. The
+ * engine name is copied, since the engine may be unloaded before the end. */
+static inline void
+bench_begin(const char *program, const char *engine)
+{
+  const char *base = strrchr(program, '/');
+  bench_suite = base ? base + 1 : program;
+  snprintf(bench_engine, sizeof(bench_engine), "%s", engine);
+  bench_prefix = "";
+  if (!bench_json())
+    printf("%s:\n", engine);
+}
+
+/* Starts a group of results within the current engine */
+static inline void
+bench_group(const char *group)
+{
+  bench_prefix = group;
+  if (!bench_json())
+    printf(" %s:\n", group);
+}
+
+static inline void
+report(const char *name, size_t ops, double start)
+{
+  double ns = (now() - start) / ops;
+  if (bench_json())
+    printf("{\"suite\": \"%s\", \"engine\": \"%s\", \"name\": \"%s%s%s\", \"ops\": %lu, \"ns_per_op\": %.1f}\n",
+           bench_suite, bench_engine, bench_prefix, *bench_prefix ? "/" : "", name,
+           (unsigned long) ops, ns);
+  else
+    printf("  %-16s %10lu ops %8.1f ns/op\n", name, (unsigned long) ops, ns);
+}
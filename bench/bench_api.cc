@@ -0,0 +1,219 @@
+#include <string>
+#include <unistd.h>
+
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus.h>
+#include <natus-require.h>
+
+#include "../tests/test.h"
+#include "bench.hh"
+
+#define ROUNDS  100000
+#define GLOBALS 50
+#define GRAPH   10000
+
+/* The hot paths of the C API, one at a time */
+
+static natusValue *
+identity(natusValue *fnc, natusValue *ths, natusValue *arg)
+{
+  return natus_get_index(arg, 0);
+}
+
+static void
+bench_new(natusValue *global)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_new_number(global, i));
+  report("new number", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_new_string_utf8(global, "natus"));
+  report("new string", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_new_object(global, NULL));
+  report("new object", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_new_array(global, NULL));
+  report("new array", ROUNDS, start);
+}
+
+static void
+bench_property(natusValue *global)
+{
+  natusValue *obj = natus_new_object(global, NULL);
+  natusValue *arr = natus_new_array(global, NULL);
+  natusValue *key = natus_new_string_utf8(global, "x");
+  natusValue *val = natus_new_number(global, 1);
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_set_utf8(obj, "x", val, natusPropAttrNone));
+  report("set utf8", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_get_utf8(obj, "x"));
+  report("get utf8", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_set(obj, key, val, natusPropAttrNone));
+  report("set value", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_get(obj, key));
+  report("get value", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_set_index(arr, i % 1000, val));
+  report("set index", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_get_index(arr, i % 1000));
+  report("get index", ROUNDS, start);
+
+  natus_decref(val);
+  natus_decref(key);
+  natus_decref(arr);
+  natus_decref(obj);
+}
+
+static void
+bench_call(natusValue *global)
+{
+  natusValue *native = natus_new_function(global, identity, "identity");
+  natusValue *script = natus_evaluate_utf8(global, "(function(x) { return x; })", NULL, 0);
+  natusValue *one = natus_new_number(global, 1);
+  natusValue *args = natus_new_array(global, one, NULL);
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_call_array(native, global, args));
+  report("call native", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    natus_decref(natus_call_array(script, global, args));
+  report("call script", ROUNDS, start);
+
+  natus_decref(args);
+  natus_decref(one);
+  natus_decref(script);
+  natus_decref(native);
+}
+
+static void
+bench_evaluate(natusValue *global)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS / 10; i++)
+    natus_decref(natus_evaluate_utf8(global, "1 + 1", NULL, 0));
+  report("evaluate", ROUNDS / 10, start);
+}
+
+static void
+bench_exception(natusValue *global)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS / 10; i++)
+    natus_decref(natus_throw_exception(global, NULL, "TypeError", "bench %lu", (unsigned long) i));
+  report("exception", ROUNDS / 10, start);
+}
+
+/* Cold is the first require() in a new global, warm is every one after */
+static void
+bench_require(const char *engine, const char *dir)
+{
+  std::string config = std::string("{\"natus\": {\"require\": {\"path\": [\"") + dir + "\"]}}}";
+  natusValue *globals[GLOBALS];
+
+  for (size_t i=0; i < GLOBALS; i++) {
+    globals[i] = natus_new_global(engine);
+    natus_require_init_utf8(globals[i], config.c_str());
+  }
+
+  double start = now();
+  for (size_t i=0; i < GLOBALS; i++)
+    natus_decref(natus_require_utf8(globals[i], "benchmod"));
+  report("require cold", GLOBALS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS / 10; i++)
+    natus_decref(natus_require_utf8(globals[0], "benchmod"));
+  report("require warm", ROUNDS / 10, start);
+
+  for (size_t i=0; i < GLOBALS; i++)
+    natus_decref(globals[i]);
+}
+
+/* Releasing a global which still has many values alive */
+static void
+bench_teardown(const char *engine)
+{
+  natusValue **values = (natusValue **) malloc(sizeof(natusValue*) * GRAPH);
+  double total = 0;
+
+  for (size_t round=0; round < 10; round++) {
+    natusValue *global = natus_new_global(engine);
+    natusValue *root = natus_new_object(global, NULL);
+    for (size_t i=0; i < GRAPH; i++) {
+      values[i] = natus_new_object(global, NULL);
+      natus_decref(natus_set_index(root, i, values[i]));
+      natus_decref(natus_set_utf8(values[i], "parent", root, natusPropAttrNone));
+    }
+
+    double start = now();
+    for (size_t i=0; i < GRAPH; i++)
+      natus_decref(values[i]);
+    natus_decref(root);
+    natus_decref(global);
+    total += now() - start;
+  }
+
+  free(values);
+  report("teardown", 10 * GRAPH, now() - total);
+}
+
+int
+onEngine(const char *eng, int argc, const char **argv)
+{
+  natusValue *global = natus_new_global(eng);
+  if (!global || natus_is_exception(global)) {
+    fprintf(stderr, "Unable to init engine! %s\n", eng);
+    return 1;
+  }
+  bench_begin(argv[0], natus_get_engine_name(global));
+
+  bench_new(global);
+  bench_property(global);
+  bench_call(global);
+  bench_evaluate(global);
+  bench_exception(global);
+  natus_decref(global);
+
+  char dir[] = "/tmp/natus-bench-XXXXXX";
+  if (!mkdtemp(dir))
+    return 1;
+  std::string mod = std::string(dir) + "/benchmod.js";
+  FILE *f = fopen(mod.c_str(), "w");
+  if (f) {
+    fputs("exports.value = 42;\n", f);
+    fclose(f);
+    bench_require(eng, dir);
+  }
+  unlink(mod.c_str());
+  rmdir(dir);
+
+  bench_teardown(eng);
+  return 0;
+}
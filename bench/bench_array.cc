@@ -0,0 +1,85 @@
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus.h>
+#include <natus.hh>
+using namespace natus;
+
+#include "../tests/test.h"
+#include "bench.hh"
+
+#define ROUNDS 100
+#define LENGTH 10000
+
+/* Fill an array one element at a time */
+static void
+bench_set(Value& array)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    for (size_t j=0; j < LENGTH; j++)
+      array.set(j, (long) j);
+  report("index set", ROUNDS * LENGTH, start);
+}
+
+/* Walk it the way a serializer would */
+static void
+bench_get(Value& array)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    for (size_t j=0; j < LENGTH; j++)
+      array.get(j);
+  report("index get", ROUNDS * LENGTH, start);
+}
+
+/* Build a result array the old way, one push at a time */
+static void
+bench_push(Value& global)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++) {
+    Value array = global.newArray();
+    for (size_t j=0; j < LENGTH; j++)
+      array.push((double) j);
+  }
+  report("push", ROUNDS * LENGTH, start);
+}
+
+/* And in one call */
+static void
+bench_bulk(Value& global)
+{
+  double *nums = new double[LENGTH];
+  for (size_t j=0; j < LENGTH; j++)
+    nums[j] = j;
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    global.newArray(nums, LENGTH);
+  report("bulk new", ROUNDS * LENGTH, start);
+
+  Value array = global.newArray(nums, LENGTH);
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    free(natus_array_to_doubles(array.borrowCValue(), NULL));
+  report("bulk read", ROUNDS * LENGTH, start);
+
+  delete[] nums;
+}
+
+int
+onEngine(const char *eng, int argc, const char **argv)
+{
+  Value global = Value::newGlobal(eng);
+  if (global.isException()) {
+    fprintf(stderr, "Unable to init engine! %s\n", eng);
+    return 1;
+  }
+  bench_begin(argv[0], global.getEngineName());
+
+  Value array = global.newArray();
+  bench_set(array);
+  bench_get(array);
+  bench_push(global);
+  bench_bulk(global);
+  return 0;
+}
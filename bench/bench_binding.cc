@@ -0,0 +1,126 @@
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus.hh>
+using namespace natus;
+
+#include "../tests/test.h"
+#include "bench.hh"
+
+#define ROUNDS 100000
+
+/* The cost of crossing the binding layer. Run against the Reference
+ * engine, whose own work per crossing is a few pointer operations, this
+ * is the overhead of natus itself: wrapping values, libmem, private
+ * lookups and argument marshaling. Other engines add their own cost. */
+
+static Value
+identity(Value& fnc, Value& ths, Value& args)
+{
+  return args[0];
+}
+
+static void
+bench_new(Value& global)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    global.newNumber(i);
+  report("new number", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    global.newString("binding");
+  report("new string", ROUNDS, start);
+}
+
+static void
+bench_property(Value& global)
+{
+  Value obj = global.newObject();
+  Value val = global.newNumber(1);
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    obj.set("x", val);
+  report("set", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    obj.get("x");
+  report("get", ROUNDS, start);
+}
+
+/* Native to native, through the engine */
+static void
+bench_call(Value& global)
+{
+  Value fnc = global.newFunction(identity, "identity");
+  Value arg = global.newNumber(1);
+  Value args = global.newArray().push(arg);
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    fnc.call(global, args);
+  report("call native", ROUNDS, start);
+}
+
+/* Script to native: the loop itself is measured separately and removed */
+static void
+bench_callback(Value& global)
+{
+  global.set("identity", global.newFunction(identity, "identity"));
+  Value loop = global.compile("for (var i = 0; i < 10000; i++) ;", "loop.js");
+  Value calls = global.compile("for (var i = 0; i < 10000; i++) identity(i);", "calls.js");
+
+  double start = now();
+  global.run(loop);
+  double empty = now() - start;
+
+  start = now();
+  global.run(calls);
+  report("call from script", 10000, start + empty);
+}
+
+/* Script to native by argument count: the engine lends its arguments to
+ * natus, so this is how the per argument cost of each engine grows */
+static void
+bench_argc(Value& global)
+{
+  static const char *calls[] = {
+    "for (var i = 0; i < 10000; i++) identity();",
+    "for (var i = 0; i < 10000; i++) identity(i);",
+    "for (var i = 0; i < 10000; i++) identity(i, i, i, i);",
+    "for (var i = 0; i < 10000; i++) identity(i, i, i, i, i, i, i, i);",
+  };
+  static const char *names[] = { "argc 0", "argc 1", "argc 4", "argc 8" };
+
+  global.set("identity", global.newFunction(identity, "identity"));
+  Value loop = global.compile("for (var i = 0; i < 10000; i++) ;", "loop.js");
+  double start = now();
+  global.run(loop);
+  double empty = now() - start;
+
+  for (size_t i=0; i < sizeof(calls) / sizeof(*calls); i++) {
+    Value script = global.compile(calls[i], "argc.js");
+    start = now();
+    global.run(script);
+    report(names[i], 10000, start + empty);
+  }
+}
+
+int
+onEngine(const char *eng, int argc, const char **argv)
+{
+  Value global = Value::newGlobal(eng);
+  if (global.isException()) {
+    fprintf(stderr, "Unable to init engine! %s\n", eng);
+    return 1;
+  }
+  bench_begin(argv[0], global.getEngineName());
+
+  bench_new(global);
+  bench_property(global);
+  bench_call(global);
+  bench_callback(global);
+  bench_argc(global);
+  return 0;
+}
@@ -0,0 +1,74 @@
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus.hh>
+using namespace natus;
+
+#include "../tests/test.h"
+#include "bench.hh"
+
+#define ROUNDS 100000
+
+class Getter : public Class {
+  virtual Value
+  get(Value& obj, Value& idx)
+  {
+    return obj.newNumber(1);
+  }
+
+  virtual Class::Hooks
+  getHooks()
+  {
+    return Class::HookGet;
+  }
+};
+
+class Callable : public Class {
+  virtual Value
+  call(Value& obj, Value& ths, Value& arg)
+  {
+    return obj.newUndefined();
+  }
+
+  virtual Class::Hooks
+  getHooks()
+  {
+    return Class::HookCall;
+  }
+};
+
+/* Construct many objects of one class, the case the engine-side class
+ * cache is for */
+template <class T>
+static void
+bench_new(Value& global, const char *name)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    global.newObject(new T());
+  report(name, ROUNDS, start);
+}
+
+/* Plain objects, as a baseline */
+static void
+bench_plain(Value& global)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    global.newObject();
+  report("new/plain", ROUNDS, start);
+}
+
+int
+onEngine(const char *eng, int argc, const char **argv)
+{
+  Value global = Value::newGlobal(eng);
+  if (global.isException()) {
+    fprintf(stderr, "Unable to init engine! %s\n", eng);
+    return 1;
+  }
+  bench_begin(argv[0], global.getEngineName());
+
+  bench_plain(global);
+  bench_new<Getter>(global, "new/get");
+  bench_new<Callable>(global, "new/call");
+  return 0;
+}
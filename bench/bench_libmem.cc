@@ -0,0 +1,123 @@
+#include <libmem.h>
+
+#include "bench.hh"
+
+#define ROUNDS 2000000
+#define BATCH  64
+
+/* Allocate and release a lone chunk, the simplest libmem round trip */
+static void
+bench_churn()
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    mem_free(mem_new_size_zero(NULL, 24));
+  report("churn", ROUNDS, start);
+}
+
+/* What mkval() does: a value chunk which holds a reference on its context */
+static void
+bench_value(void *ctx)
+{
+  void *vals[BATCH];
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS / BATCH; i++) {
+    for (size_t j=0; j < BATCH; j++) {
+      vals[j] = mem_new_size_zero(NULL, 24);
+      mem_incref(vals[j], ctx);
+    }
+    for (size_t j=BATCH; j > 0; j--)
+      mem_decref(NULL, vals[j-1]);
+  }
+  report("value", ROUNDS / BATCH * BATCH, start);
+}
+
+/* Build a parent with many owned children of mixed sizes and drop it */
+static void
+bench_tree()
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS / BATCH; i++) {
+    void *root = mem_new_size(NULL, 64);
+    for (size_t j=0; j < BATCH; j++)
+      mem_new_size(root, 8 + (j % 8) * 40);
+    mem_free(root);
+  }
+  report("tree", ROUNDS / BATCH * (BATCH + 1), start);
+}
+
+/* Grow a child of a live parent one item at a time */
+static void
+bench_resize()
+{
+  void *root = mem_new_size(NULL, 0);
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS / BATCH; i++) {
+    int *arr = mem_new_array(root, int, 1);
+    for (size_t j=2; j <= BATCH; j++)
+      mem_resize_array_size((void**) &arr, sizeof(int), j);
+    mem_decref(root, arr);
+  }
+  report("resize", ROUNDS / BATCH * BATCH, start);
+
+  mem_free(root);
+}
+
+/* Hold N values on one context, then release them oldest first and in
+ * random order: the cost per value should not grow with N */
+static void
+bench_scale(void *ctx)
+{
+  for (size_t n=1000; n <= 1000000; n *= 10) {
+    void **vals = (void**) malloc(n * sizeof(void*));
+    char name[32];
+
+    double start = now();
+    for (size_t i=0; i < n; i++) {
+      vals[i] = mem_new_size_zero(NULL, 24);
+      mem_incref(vals[i], ctx);
+    }
+    for (size_t i=0; i < n; i++)
+      mem_decref(NULL, vals[i]);
+    snprintf(name, sizeof(name), "fifo/%lu", (unsigned long) n);
+    report(name, n, start);
+
+    start = now();
+    for (size_t i=0; i < n; i++) {
+      vals[i] = mem_new_size_zero(NULL, 24);
+      mem_incref(vals[i], ctx);
+    }
+    for (size_t i=n, r=n; i > 0; i--) {
+      r = r * 1103515245 + 12345;
+      size_t j = r % i;
+      mem_decref(NULL, vals[j]);
+      vals[j] = vals[i-1];
+    }
+    snprintf(name, sizeof(name), "random/%lu", (unsigned long) n);
+    report(name, n, start);
+
+    free(vals);
+  }
+}
+
+int
+main(int argc, const char **argv)
+{
+#ifdef LIBMEM_SLAB
+  bench_begin(argv[0], "slab");
+#else
+  bench_begin(argv[0], "malloc");
+#endif
+  void *ctx = mem_new_size_zero(NULL, 24);
+
+  bench_churn();
+  bench_value(ctx);
+  bench_tree();
+  bench_resize();
+  bench_scale(ctx);
+
+  mem_free(ctx);
+  return 0;
+}
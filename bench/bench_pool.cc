@@ -0,0 +1,72 @@
+#include <unistd.h>
+
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus.h>
+
+#include "../tests/test.h"
+#include "bench.hh"
+
+#define JOBS 20000
+
+/* Job throughput of natus_pool as workers are added, clones included */
+
+static const char *script =
+  "(function(n) { var s = 0; for (var i=0; i < n; i++) s += i; return { sum: s }; })";
+
+static void
+drop(natusClone *result, void *misc)
+{
+  natus_clone_free(result);
+}
+
+static bool
+bench_workers(const char *eng, natusValue *args, size_t workers)
+{
+  natusPool *pool = natus_pool_new(eng, workers, NULL, NULL);
+  if (!pool)
+    return false;
+
+  // Let every worker compile the script first
+  for (size_t i=0; i < workers * 4; i++)
+    natus_pool_submit(pool, script, natus_clone(args), drop, NULL);
+  natus_pool_wait(pool);
+
+  double start = now();
+  for (size_t i=0; i < JOBS; i++)
+    natus_pool_submit(pool, script, natus_clone(args), drop, NULL);
+  natus_pool_wait(pool);
+
+  char name[32];
+  snprintf(name, sizeof(name), "%lu worker%s", (unsigned long) workers, workers > 1 ? "s" : "");
+  report(name, JOBS, start);
+
+  natus_pool_free(pool);
+  return true;
+}
+
+int
+onEngine(const char *eng, int argc, const char **argv)
+{
+  natusValue *global = natus_new_global(eng);
+  if (!global || natus_is_exception(global)) {
+    fprintf(stderr, "Unable to init engine! %s\n", eng);
+    return 1;
+  }
+  bench_begin(argv[0], natus_get_engine_name(global));
+
+  natusValue *n = natus_new_number(global, 100);
+  natusValue *args = natus_new_array(global, n, NULL);
+  natus_decref(n);
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (size_t workers=1; workers <= (size_t) (cpus > 1 ? cpus : 1); workers *= 2) {
+    if (!bench_workers(eng, args, workers)) {
+      fprintf(stderr, "Unable to start %lu workers on %s\n", (unsigned long) workers, eng);
+      break;
+    }
+  }
+
+  natus_decref(args);
+  natus_decref(global);
+  return 0;
+}
@@ -0,0 +1,90 @@
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus.hh>
+using namespace natus;
+
+#include "../tests/test.h"
+#include "bench.hh"
+
+#define ROUNDS 200000
+
+/* Keeps its state in a user private key, next to the built-in ones */
+class Counter : public Class {
+  virtual Value
+  get(Value& obj, Value& idx)
+  {
+    return obj.newNumber(obj.getPrivateName<long>("count"));
+  }
+
+  virtual Value
+  set(Value& obj, Value& idx, Value& val)
+  {
+    obj.setPrivateName("count", val.to<long>());
+    return obj.newBoolean(true);
+  }
+
+  virtual Class::Hooks
+  getHooks()
+  {
+    return (Class::Hooks) (Class::HookGet | Class::HookSet);
+  }
+};
+
+/* Property access from native code: every call goes through the class hooks */
+static void
+bench_native(Value& obj)
+{
+  double start = now();
+  for (long i=0; i < ROUNDS; i++) {
+    obj.set("count", i);
+    obj.get("count");
+  }
+  report("native get+set", ROUNDS, start);
+}
+
+/* The same, driven from script */
+static void
+bench_script(Value& global)
+{
+  char js[128];
+  snprintf(js, sizeof(js), "for (var i=0; i < %d; i++) x.count = x.count + 1;", ROUNDS);
+
+  double start = now();
+  global.evaluate(js);
+  report("script get+set", ROUNDS, start);
+}
+
+/* Lookup of user keys on an object with many of them */
+static void
+bench_keys(Value& obj)
+{
+  char keys[64][16];
+  for (int i=0; i < 64; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+    obj.setPrivateName(keys[i], (void*) (long) i);
+  }
+
+  double start = now();
+  for (long i=0; i < ROUNDS; i++)
+    obj.getPrivateName<long>(keys[i % 64]);
+  report("private/64 keys", ROUNDS, start);
+}
+
+int
+onEngine(const char *eng, int argc, const char **argv)
+{
+  Value global = Value::newGlobal(eng);
+  if (global.isException()) {
+    fprintf(stderr, "Unable to init engine! %s\n", eng);
+    return 1;
+  }
+  bench_begin(argv[0], global.getEngineName());
+
+  Value x = global.newObject(new Counter());
+  if (global.set("x", x).isException())
+    return 1;
+
+  bench_native(x);
+  bench_script(global);
+  bench_keys(x);
+  return 0;
+}
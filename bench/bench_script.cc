@@ -0,0 +1,57 @@
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus.hh>
+using namespace natus;
+
+#include "../tests/test.h"
+#include "bench.hh"
+
+#define ROUNDS 2000
+
+/* A typical request handler: some setup, a loop and a result */
+static const char *handler =
+  "var req = { path: '/a/b/c', query: { id: 42 } };\n"
+  "var parts = req.path.split('/');\n"
+  "var out = [];\n"
+  "for (var i = 0; i < parts.length; i++)\n"
+  "  if (parts[i]) out.push(parts[i].toUpperCase());\n"
+  "out.join('.') + ':' + req.query.id;\n";
+
+/* Parse on every request */
+static void
+bench_evaluate(Value& global)
+{
+  Value src = global.newString(handler);
+  Value file = global.newString("handler.js");
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    global.evaluate(src, file);
+  report("evaluate", ROUNDS, start);
+}
+
+/* Parse once */
+static void
+bench_run(Value& global)
+{
+  Value script = global.compile(handler, "handler.js");
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    global.run(script);
+  report("run", ROUNDS, start);
+}
+
+int
+onEngine(const char *eng, int argc, const char **argv)
+{
+  Value global = Value::newGlobal(eng);
+  if (global.isException()) {
+    fprintf(stderr, "Unable to init engine! %s\n", eng);
+    return 1;
+  }
+  bench_begin(argv[0], global.getEngineName());
+
+  bench_evaluate(global);
+  bench_run(global);
+  return 0;
+}
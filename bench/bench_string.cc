@@ -0,0 +1,81 @@
+#include <cstring>
+
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus.h>
+#include <natus.hh>
+using namespace natus;
+
+#include "../tests/test.h"
+#include "bench.hh"
+
+#define ROUNDS 100000
+#define LENGTH 64
+
+/* Read a string the way a logger would, into a fresh allocation */
+static void
+bench_copy(Value& str)
+{
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    free(natus_to_string_utf8(str.borrowCValue(), NULL));
+  report("utf8 copy", ROUNDS, start);
+
+  start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    free(natus_to_string_utf16(str.borrowCValue(), NULL));
+  report("utf16 copy", ROUNDS, start);
+}
+
+/* Into a buffer on the stack */
+static void
+bench_buffer(Value& str)
+{
+  char buf[LENGTH * 3 + 1];
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++)
+    str.toUTF8(buf, sizeof(buf));
+  report("utf8 buffer", ROUNDS, start);
+}
+
+/* Or not at all */
+static void
+bench_view(Value& str)
+{
+  const natusChar *chars;
+  natusStringView view;
+  size_t len;
+
+  double start = now();
+  for (size_t i=0; i < ROUNDS; i++) {
+    natus_string_view_utf16(str.borrowCValue(), &chars, &len, &view);
+    natus_string_view_release(&view);
+  }
+  report("utf16 view", ROUNDS, start);
+}
+
+int
+onEngine(const char *eng, int argc, const char **argv)
+{
+  Value global = Value::newGlobal(eng);
+  if (global.isException()) {
+    fprintf(stderr, "Unable to init engine! %s\n", eng);
+    return 1;
+  }
+  bench_begin(argv[0], global.getEngineName());
+
+  static natusChar chars[LENGTH + 1];
+  for (size_t j=0; j < LENGTH; j++)
+    chars[j] = 'a' + j % 26;
+
+  Value str = global.newString(UTF16(chars, LENGTH));
+  bench_copy(str);
+  bench_buffer(str);
+  bench_view(str);
+
+  bench_group("external");
+  str = global.newStringExternal(chars, LENGTH, NULL);
+  bench_copy(str);
+  bench_buffer(str);
+  bench_view(str);
+  return 0;
+}
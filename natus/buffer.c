@@ -0,0 +1,219 @@
+#include <natus-internal.h>
+
+#include <string.h>
+
+#include <libmem.h>
+
+/* Buffers are objects whose indexes are the bytes of some native memory.
+ * The buffer class below serves them wherever the engine has no external
+ * array of its own; engines which have one only use it for native callers. */
+
+typedef struct {
+  void             *data;
+  size_t            len;
+  natusFreeFunction free;
+} buffer;
+
+typedef enum {
+  bufferPropOther,
+  bufferPropIndex,
+  bufferPropLength
+} bufferProp;
+
+static void
+buffer_free(buffer *buf)
+{
+  if (buf->free)
+    buf->free(buf->data);
+  free(buf);
+}
+
+static buffer *
+buffer_of(const natusValue *obj)
+{
+  return private_get_slot(private_of(obj), privateSlotBuffer);
+}
+
+static bufferProp
+buffer_prop(const natusValue *prop, size_t *idx)
+{
+  if (natus_is_number(prop)) {
+    // Range checked first: casting NaN or a huge double is undefined
+    double d = natus_to_double(prop);
+    if (!(d >= 0 && d < UINT32_MAX) || d != (uint32_t) d)
+      return bufferPropOther;
+    *idx = (size_t) d;
+    return bufferPropIndex;
+  }
+
+  char *name = natus_to_string_utf8(prop, NULL);
+  if (!name)
+    return bufferPropOther;
+
+  // Only canonical indexes, "012" is just a name
+  bufferProp type = bufferPropOther;
+  if (!strcmp(name, "length"))
+    type = bufferPropLength;
+  else if (name[0] >= '0' && name[0] <= '9' && (name[0] != '0' || !name[1])) {
+    char *end = NULL;
+    *idx = strtoul(name, &end, 10);
+    if (end && !*end && *idx < UINT32_MAX)
+      type = bufferPropIndex;
+  }
+
+  free(name);
+  return type;
+}
+
+/* Let the engine handle anything which isn't ours */
+static natusValue *
+buffer_pass(natusValue *obj)
+{
+  return natus_to_exception(natus_new_undefined(obj));
+}
+
+static natusValue *
+buffer_del(natusClass *cls, natusValue *obj, const natusValue *prop)
+{
+  size_t idx;
+  if (buffer_prop(prop, &idx) == bufferPropOther)
+    return buffer_pass(obj);
+  return natus_new_boolean(obj, false);
+}
+
+static natusValue *
+buffer_get(natusClass *cls, natusValue *obj, const natusValue *prop)
+{
+  buffer *buf = buffer_of(obj);
+  size_t idx;
+
+  switch (buf ? buffer_prop(prop, &idx) : bufferPropOther) {
+  case bufferPropIndex:
+    if (idx >= buf->len)
+      return natus_new_undefined(obj);
+    return natus_new_number(obj, ((uint8_t*) buf->data)[idx]);
+  case bufferPropLength:
+    return natus_new_number(obj, buf->len);
+  default:
+    return buffer_pass(obj);
+  }
+}
+
+static natusValue *
+buffer_set(natusClass *cls, natusValue *obj, const natusValue *prop, const natusValue *value)
+{
+  buffer *buf = buffer_of(obj);
+  size_t idx;
+
+  switch (buf ? buffer_prop(prop, &idx) : bufferPropOther) {
+  case bufferPropIndex:
+    // Stored like a Uint8Array would: truncated, modulo 256
+    if (idx < buf->len) {
+      double d = natus_to_double(value);
+      ((uint8_t*) buf->data)[idx] = d > -9e18 && d < 9e18 ? (uint8_t) (long long) d : 0;
+    }
+    return natus_new_boolean(obj, true);
+  case bufferPropLength:
+    return natus_new_boolean(obj, true);
+  default:
+    return buffer_pass(obj);
+  }
+}
+
+static natusValue *
+buffer_enumerate(natusClass *cls, natusValue *obj)
+{
+  buffer *buf = buffer_of(obj);
+  if (!buf)
+    return buffer_pass(obj);
+
+  double *idx = malloc(sizeof(double) * (buf->len > 0 ? buf->len : 1));
+  if (!idx)
+    return NULL;
+  for (size_t i=0; i < buf->len; i++)
+    idx[i] = i;
+
+  natusValue *ret = natus_new_array_doubles(obj, idx, buf->len);
+  free(idx);
+  return ret;
+}
+
+static natusClass bufferClass = {
+  buffer_del,
+  buffer_get,
+  buffer_set,
+  buffer_enumerate,
+  NULL,
+  NULL
+};
+
+static bool
+ctx_get_dll(void *parent, void **child, void ***data)
+{
+  *data = child;
+  return false;
+}
+
+natusValue *
+natus_new_buffer_external(const natusValue *ctx, void *data, size_t len, natusFreeFunction freefnc)
+{
+  void **dll = NULL;
+
+  // Past this, indexes are only names in JavaScript
+  if (!ctx || (!data && len > 0) || len >= UINT32_MAX)
+    goto error;
+
+  mem_children_foreach(ctx->ctx, "dll", ctx_get_dll, &dll);
+  if (!dll)
+    goto error;
+
+  buffer *buf = malloc(sizeof(buffer));
+  if (!buf)
+    goto error;
+  buf->data = data;
+  buf->len = len;
+  buf->free = freefnc;
+
+  natusPrivate *priv = private_new(dll);
+  if (!priv) {
+    free(buf);
+    goto error;
+  }
+
+  // From here on, freeing priv frees the data
+  if (!private_set_slot(priv, privateSlotBuffer, buf, (natusFreeFunction) buffer_free)) {
+    free(buf);
+    mem_decref(dll, priv);
+    goto error;
+  }
+
+  if (!private_set_slot(priv, privateSlotGlobal, natus_get_global(ctx), NULL)
+      || !private_set_slot(priv, privateSlotClass, &bufferClass, NULL)) {
+    mem_decref(dll, priv);
+    return NULL;
+  }
+
+  callandreturn(natusValueTypeBuffer, ctx, new_buffer, ctx->ctx->ctx, &bufferClass, priv, data, len);
+
+error:
+  if (freefnc && data)
+    freefnc(data);
+  return NULL;
+}
+
+bool
+natus_borrow_buffer(const natusValue *val, void **data, size_t *len)
+{
+  if (!natus_is_buffer(val))
+    return false;
+
+  buffer *buf = buffer_of(val);
+  if (!buf)
+    return false;
+
+  if (data)
+    *data = buf->data;
+  if (len)
+    *len = buf->len;
+  return true;
+}
@@ -1,6 +1,31 @@
 #include <natus-internal.h>
 
 #include <assert.h>
+#include <stdlib.h>
+
+#define ARGV_STACK 16
+
+/* Gathers the NULL terminated arguments in ap, into stack if they fit */
+static natusValue **
+collect_varg(va_list ap, natusValue **stack, size_t *argc)
+{
+  va_list apc;
+
+  va_copy(apc, ap);
+  for (*argc = 0; va_arg(apc, natusValue*); (*argc)++)
+    ;
+  va_end(apc);
+
+  natusValue **argv = stack;
+  if (*argc > ARGV_STACK && !(argv = malloc(sizeof(natusValue*) * *argc)))
+    return NULL;
+
+  va_copy(apc, ap);
+  for (size_t i=0; i < *argc; i++)
+    argv[i] = va_arg(apc, natusValue*);
+  va_end(apc);
+  return argv;
+}
 
 natusValue *
 natus_call(natusValue *func, natusValue *ths, ...)
@@ -15,12 +40,45 @@ natus_call(natusValue *func, natusValue *ths, ...)
 natusValue *
 natus_call_varg(natusValue *func, natusValue *ths, va_list ap)
 {
-  natusValue *array = natus_new_array_varg(func, ap);
-  if (natus_is_exception(array))
-    return array;
+  natusValue *stack[ARGV_STACK];
+  size_t argc = 0;
+
+  natusValue **argv = collect_varg(ap, stack, &argc);
+  if (!argv)
+    return NULL;
 
-  natusValue *ret = natus_call_array(func, ths, array);
-  natus_decref(array);
+  natusValue *ret = natus_call_argv(func, ths, argc, argv);
+  if (argv != stack)
+    free(argv);
+  return ret;
+}
+
+natusValue *
+natus_call_argv(natusValue *func, natusValue *ths, size_t argc, natusValue **argv)
+{
+  natusEngVal stack[ARGV_STACK];
+  natusEngVal *vals = stack;
+  natusValue *ret = NULL;
+
+  if (!func)
+    return NULL;
+  if (argc > ARGV_STACK && !(vals = malloc(sizeof(natusEngVal) * argc)))
+    return NULL;
+
+  for (size_t i=0; i < argc; i++) {
+    if (!argv[i] || !(vals[i] = engval(argv[i])))
+      goto out;
+  }
+
+  natusValue *args = argv_view(func, argc, argc > 0 ? vals : NULL);
+  if (args) {
+    ret = natus_call_array(func, ths, args);
+    argv_release(args);
+  }
+
+out:
+  if (vals != stack)
+    free(vals);
   return ret;
 }
 
@@ -29,7 +87,9 @@ natus_call_array(natusValue *func, natusValue *ths, natusValue *args)
 {
   natusValue *newargs = NULL;
   if (!args)
-    args = newargs = natus_new_array(func, NULL);
+    args = newargs = argv_view(func, 0, NULL);
+  if (!args)
+    return NULL;
   if (ths)
     natus_incref(ths);
   else
@@ -37,8 +97,9 @@ natus_call_array(natusValue *func, natusValue *ths, natusValue *args)
 
   // If the function is native, skip argument conversion and js overhead;
   //    call directly for increased speed
-  natusNativeFunction fnc = natus_get_private_name(func, NATUS_PRIV_FUNCTION);
-  natusClass *cls = natus_get_private_name(func, NATUS_PRIV_CLASS);
+  natusPrivate *prv = private_of(func);
+  natusNativeFunction fnc = private_get_slot(prv, privateSlotFunction);
+  natusClass *cls = private_get_slot(prv, privateSlotClass);
   natusValue *res = NULL;
   if (fnc || (cls && cls->call)) {
     if (fnc)
@@ -46,11 +107,24 @@ natus_call_array(natusValue *func, natusValue *ths, natusValue *args)
     else
       res = cls->call(cls, func, ths, args);
   } else if (natus_is_function(func)) {
-    callandmkval(res, natusValueTypeUnknown, func, call, func->ctx->ctx, func->val, ths->val, args->val);
+    char buf[TRACE_NAME];
+    const char *name = trace_enter(func, natusTraceCall, NULL, func, "(anonymous)", buf);
+    func->ctx->stats.calls++;
+
+    if (args->argv) {
+      // Hand the arguments over as they are, no array needed
+      callandmkval(res, natusValueTypeUnknown, func, call_argv, func->ctx->ctx,
+                   engval(func), engval(ths), args->argc, args->argv);
+    } else {
+      callandmkval(res, natusValueTypeUnknown, func, call, func->ctx->ctx,
+                   engval(func), engval(ths), engval(args));
+    }
+
+    trace_leave(func, natusTraceCall, name);
   }
 
   natus_decref(ths);
-  natus_decref(newargs);
+  argv_release(newargs);
   return res;
 }
 
@@ -67,12 +141,12 @@ natus_call_utf8(natusValue *ths, const char *name, ...)
 natusValue *
 natus_call_utf8_varg(natusValue *ths, const char *name, va_list ap)
 {
-  natusValue *array = natus_new_array_varg(ths, ap);
-  if (natus_is_exception(array))
-    return array;
+  natusValue *func = natus_get_utf8(ths, name);
+  if (!func)
+    return NULL;
 
-  natusValue *ret = natus_call_utf8_array(ths, name, array);
-  natus_decref(array);
+  natusValue *ret = natus_call_varg(func, ths, ap);
+  natus_decref(func);
   return ret;
 }
 
@@ -101,13 +175,7 @@ natus_call_new(natusValue *func, ...)
 natusValue *
 natus_call_new_varg(natusValue *func, va_list ap)
 {
-  natusValue *array = natus_new_array_varg(func, ap);
-  if (natus_is_exception(array))
-    return array;
-
-  natusValue *ret = natus_call_new_array(func, array);
-  natus_decref(array);
-  return ret;
+  return natus_call_varg(func, NULL, ap);
 }
 
 natusValue *
@@ -135,12 +203,12 @@ natus_call_new_utf8(natusValue *obj, const char *name, ...)
 natusValue *
 natus_call_new_utf8_varg(natusValue *obj, const char *name, va_list ap)
 {
-  natusValue *array = natus_new_array_varg(obj, ap);
-  if (natus_is_exception(array))
-    return array;
+  natusValue *func = natus_get_utf8(obj, name);
+  if (!func)
+    return NULL;
 
-  natusValue *ret = natus_call_new_utf8_array(obj, name, array);
-  natus_decref(array);
+  natusValue *ret = natus_call_varg(func, NULL, ap);
+  natus_decref(func);
   return ret;
 }
 
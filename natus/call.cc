@@ -1,5 +1,17 @@
 #include <natus-internal.hh>
 
+#include <vector>
+
+/* Calls func with the NULL terminated Value pointers, without an array */
+static Value
+call_argv(natusValue *func, natusValue *ths, const Value *arg0, va_list ap)
+{
+  std::vector<natusValue*> argv;
+  for (const Value *arg = arg0; arg; arg = va_arg(ap, const Value*))
+    argv.push_back(arg->borrowCValue());
+  return natus_call_argv(func, ths, argv.size(), argv.empty() ? NULL : &argv[0]);
+}
+
 Value
 Value::call(Value ths, va_list ap)
 {
@@ -20,7 +32,7 @@ Value::call(Value ths, const Value *arg0, ...)
 {
   va_list ap;
   va_start(ap, arg0);
-  Value ret = call(ths, new_array(*this, arg0, ap));
+  Value ret = call_argv(internal, ths.internal, arg0, ap);
   va_end(ap);
   return ret;
 }
@@ -46,7 +58,8 @@ Value::call(UTF8 name, const Value *arg0, ...)
 {
   va_list ap;
   va_start(ap, arg0);
-  Value ret = call(name, new_array(*this, arg0, ap));
+  Value func = get(name);
+  Value ret = call_argv(func.internal, internal, arg0, ap);
   va_end(ap);
   return ret;
 }
@@ -72,7 +85,8 @@ Value::call(UTF16 name, const Value *arg0, ...)
 {
   va_list ap;
   va_start(ap, arg0);
-  Value ret = call(name, new_array(*this, arg0, ap));
+  Value func = get(name);
+  Value ret = call_argv(func.internal, internal, arg0, ap);
   va_end(ap);
   return ret;
 }
@@ -97,7 +111,7 @@ Value::callNew(const Value* arg0, ...)
 {
   va_list ap;
   va_start(ap, arg0);
-  Value ret = callNew(new_array(*this, arg0, ap));
+  Value ret = call_argv(internal, NULL, arg0, ap);
   va_end(ap);
   return ret;
 }
@@ -123,7 +137,8 @@ Value::callNew(UTF8 name, const Value *arg0, ...)
 {
   va_list ap;
   va_start(ap, arg0);
-  Value ret = callNew(name, new_array(*this, arg0, ap));
+  Value func = get(name);
+  Value ret = call_argv(func.internal, NULL, arg0, ap);
   va_end(ap);
   return ret;
 }
@@ -149,7 +164,8 @@ Value::callNew(UTF16 name, const Value *arg0, ...)
 {
   va_list ap;
   va_start(ap, arg0);
-  Value ret = callNew(name, new_array(*this, arg0, ap));
+  Value func = get(name);
+  Value ret = call_argv(func.internal, NULL, arg0, ap);
   va_end(ap);
   return ret;
 }
@@ -0,0 +1,386 @@
+#include <natus-internal.h>
+
+#include <string.h>
+
+/* Clones hold no natusValue and nothing from libmem, only malloc()ed
+ * memory, so they may be made in one context and thread and turned back
+ * into values in another. */
+
+/* Arrays and objects are cloned recursively, so how deeply they nest is
+ * bounded, though not how many there are */
+#define CLONE_DEPTH 1024
+
+typedef struct cloneNode cloneNode;
+struct cloneNode {
+  natusValueType type;
+  bool           boolean;
+  double         number;
+  void          *data;    /* String characters or buffer bytes */
+  size_t         len;
+  cloneNode    **keys;    /* Property names of objects */
+  uint32_t      *indexes; /* Indexes of arrays, without the holes */
+  cloneNode    **items;
+  size_t         count;
+  size_t         id;      /* Arrays and objects, numbered as they are met */
+  bool           done;    /* All the items are cloned */
+};
+
+struct natusClone {
+  bool        exception;
+  cloneNode  *root;
+  cloneNode **nodes;   /* Every node once, however many refer to it */
+  size_t      count;
+  size_t      size;
+  size_t      objects;
+};
+
+/* Each array and object met so far, to keep shared ones shared and to find
+ * cycles. Looked up by the engine's identity for it, then confirmed. */
+typedef struct {
+  natusValue *val;
+  cloneNode  *node;
+  uintptr_t   identity;
+} cloneSeen;
+
+typedef struct {
+  natusClone *clone;
+  cloneSeen  *seen;    /* Open addressed, never more than half full */
+  size_t      size;
+  size_t      depth;
+} cloneState;
+
+static size_t
+seen_slot(const cloneState *state, uintptr_t identity)
+{
+  // Fibonacci hashing, handles are often aligned pointers
+  uint64_t hash = (uint64_t) identity * 11400714819323198485ULL;
+  return (size_t) (hash ^ hash >> 32) & (state->size - 1);
+}
+
+static cloneSeen *
+seen_find(const cloneState *state, const natusValue *val, uintptr_t identity)
+{
+  if (!state->seen)
+    return NULL;
+
+  for (size_t i = seen_slot(state, identity); state->seen[i].val; i = (i + 1) & (state->size - 1)) {
+    if (state->seen[i].identity == identity && natus_equals_strict(state->seen[i].val, val))
+      return &state->seen[i];
+  }
+  return NULL;
+}
+
+static bool
+seen_add(cloneState *state, natusValue *val, uintptr_t identity, cloneNode *node)
+{
+  if ((state->clone->objects + 1) * 2 > state->size) {
+    cloneState grown = *state;
+    grown.size = state->size ? state->size * 2 : 64;
+    grown.seen = calloc(grown.size, sizeof(cloneSeen));
+    if (!grown.seen)
+      return false;
+
+    for (size_t i = 0; i < state->size; i++) {
+      if (!state->seen[i].val)
+        continue;
+      size_t j = seen_slot(&grown, state->seen[i].identity);
+      while (grown.seen[j].val)
+        j = (j + 1) & (grown.size - 1);
+      grown.seen[j] = state->seen[i];
+    }
+    free(state->seen);
+    *state = grown;
+  }
+
+  size_t i = seen_slot(state, identity);
+  while (state->seen[i].val)
+    i = (i + 1) & (state->size - 1);
+  state->seen[i].val = natus_incref(val);
+  state->seen[i].node = node;
+  state->seen[i].identity = identity;
+  return true;
+}
+
+static void
+node_free(cloneNode *node)
+{
+  free(node->keys);
+  free(node->indexes);
+  free(node->items);
+  free(node->data);
+  free(node);
+}
+
+static cloneNode *
+node_new(natusClone *clone, natusValueType type)
+{
+  if (clone->count == clone->size) {
+    size_t size = clone->size ? clone->size * 2 : 16;
+    cloneNode **tmp = realloc(clone->nodes, sizeof(cloneNode*) * size);
+    if (!tmp)
+      return NULL;
+    clone->nodes = tmp;
+    clone->size = size;
+  }
+
+  cloneNode *node = calloc(1, sizeof(cloneNode));
+  if (!node)
+    return NULL;
+  node->type = type;
+  clone->nodes[clone->count++] = node;
+  return node;
+}
+
+static cloneNode *
+clone_node(cloneState *state, const natusValue *val);
+
+static bool
+clone_children(cloneState *state, cloneNode *node, natusValue *val)
+{
+  // Enumerating arrays too only visits the elements which are there
+  natusValue *keys = natus_enumerate(val);
+  if (!natus_is_array(keys))
+    goto error;
+  natusValue *length = natus_get_utf8(keys, "length");
+  size_t count = natus_is_number(length) ? (size_t) natus_to_double(length) : 0;
+  natus_decref(length);
+
+  node->items = calloc(count > 0 ? count : 1, sizeof(cloneNode*));
+  if (node->type == natusValueTypeArray)
+    node->indexes = calloc(count > 0 ? count : 1, sizeof(uint32_t));
+  else
+    node->keys = calloc(count > 0 ? count : 1, sizeof(cloneNode*));
+  if (!node->items || (!node->indexes && !node->keys))
+    goto error;
+
+  for (size_t i=0; i < count; i++) {
+    natusValue *key = natus_get_index(keys, i);
+    natusValue *item = NULL;
+    if (node->indexes) {
+      // Other properties of arrays are left behind
+      double idx = natus_to_double(key);
+      if (idx >= 0 && idx < UINT32_MAX && idx == (uint32_t) idx) {
+        node->indexes[node->count] = (uint32_t) idx;
+        item = natus_get_index(val, (uint32_t) idx);
+      }
+      natus_decref(key);
+      if (!item)
+        continue;
+    } else {
+      node->keys[node->count] = clone_node(state, key);
+      item = natus_get(val, key);
+      natus_decref(key);
+      if (!node->keys[node->count] || node->keys[node->count]->type != natusValueTypeString) {
+        natus_decref(item);
+        goto error;
+      }
+    }
+
+    node->items[node->count] = natus_is_exception(item) ? NULL : clone_node(state, item);
+    natus_decref(item);
+    if (!node->items[node->count++])
+      goto error;
+  }
+
+  natus_decref(keys);
+  return true;
+
+error:
+  natus_decref(keys);
+  return false;
+}
+
+static cloneNode *
+clone_node(cloneState *state, const natusValue *val)
+{
+  natusClone *clone = state->clone;
+
+  if (!val)
+    return NULL;
+
+  natusValueType type = natus_get_type(val);
+  uintptr_t identity = 0;
+  if (type == natusValueTypeArray || type == natusValueTypeObject) {
+    // Met before: the same node, unless we are still inside it
+    identity = val->ctx->spec->identity(val->ctx->ctx, engval(val));
+    cloneSeen *seen = seen_find(state, val, identity);
+    if (seen)
+      return seen->node->done ? seen->node : NULL;
+
+    // Only plain objects, native classes keep their state out of reach
+    if (type == natusValueTypeObject && private_get_slot(private_of(val), privateSlotClass))
+      return NULL;
+
+    if (state->depth >= CLONE_DEPTH)
+      return NULL;
+  }
+
+  cloneNode *node = node_new(clone, type);
+  if (!node)
+    return NULL;
+
+  // On failure, the node goes with the rest of the clone
+  switch (type) {
+  case natusValueTypeUndefined:
+  case natusValueTypeNull:
+    break;
+  case natusValueTypeBoolean:
+    node->boolean = natus_to_bool(val);
+    break;
+  case natusValueTypeNumber:
+    node->number = natus_to_double(val);
+    break;
+  case natusValueTypeString:
+    node->data = natus_to_string_utf16(val, &node->len);
+    if (!node->data)
+      return NULL;
+    break;
+  case natusValueTypeBuffer: {
+    void *data;
+    if (!natus_borrow_buffer(val, &data, &node->len))
+      return NULL;
+    node->data = malloc(node->len > 0 ? node->len : 1);
+    if (!node->data)
+      return NULL;
+    memcpy(node->data, data, node->len);
+    break;
+  }
+  case natusValueTypeArray:
+  case natusValueTypeObject:
+    if (!seen_add(state, (natusValue*) val, identity, node))
+      return NULL;
+    node->id = clone->objects++;
+    state->depth++;
+    if (!clone_children(state, node, (natusValue*) val))
+      return NULL;
+    state->depth--;
+    node->done = true;
+    break;
+  default:
+    return NULL;
+  }
+
+  return node;
+}
+
+natusClone *
+natus_clone(const natusValue *val)
+{
+  natusClone *clone = calloc(1, sizeof(natusClone));
+  if (!clone)
+    return NULL;
+
+  cloneState state = { clone, NULL, 0, 0 };
+  clone->root = clone_node(&state, val);
+  for (size_t i=0; i < state.size; i++)
+    natus_decref(state.seen[i].val);
+  free(state.seen);
+
+  if (!clone->root) {
+    natus_clone_free(clone);
+    return NULL;
+  }
+  clone->exception = natus_is_exception(val);
+  return clone;
+}
+
+/* made holds the arrays and objects built so far, by id */
+static natusValue *
+clone_value(const natusValue *ctx, const cloneNode *node, natusValue **made)
+{
+  natusValue *val = NULL;
+
+  switch (node->type) {
+  case natusValueTypeUndefined:
+    return natus_new_undefined(ctx);
+  case natusValueTypeNull:
+    return natus_new_null(ctx);
+  case natusValueTypeBoolean:
+    return natus_new_boolean(ctx, node->boolean);
+  case natusValueTypeNumber:
+    return natus_new_number(ctx, node->number);
+  case natusValueTypeString:
+    return natus_new_string_utf16_length(ctx, node->data, node->len);
+  case natusValueTypeBuffer: {
+    void *data = malloc(node->len > 0 ? node->len : 1);
+    if (!data)
+      return NULL;
+    memcpy(data, node->data, node->len);
+    return natus_new_buffer_external(ctx, data, node->len, free);
+  }
+  case natusValueTypeArray:
+    if (made[node->id])
+      return natus_incref(made[node->id]);
+    val = natus_new_array(ctx, NULL);
+    break;
+  default:
+    if (made[node->id])
+      return natus_incref(made[node->id]);
+    val = natus_new_object(ctx, NULL);
+    break;
+  }
+
+  if (!val || natus_is_exception(val))
+    return val;
+  made[node->id] = natus_incref(val);
+
+  for (size_t i=0; i < node->count; i++) {
+    natusValue *item = clone_value(ctx, node->items[i], made);
+    natusValue *name = node->keys ? clone_value(ctx, node->keys[i], made) : NULL;
+    natusValue *rslt = NULL;
+    if (!item || natus_is_exception(item) || (node->keys && !name))
+      rslt = item ? natus_incref(item) : NULL;
+    else if (name)
+      rslt = natus_set(val, name, item, natusPropAttrNone);
+    else
+      rslt = natus_set_index(val, node->indexes[i], item);
+    natus_decref(name);
+    natus_decref(item);
+
+    if (!rslt || natus_is_exception(rslt)) {
+      natus_decref(val);
+      return rslt;
+    }
+    natus_decref(rslt);
+  }
+
+  return val;
+}
+
+natusValue *
+natus_clone_value(const natusValue *ctx, const natusClone *clone)
+{
+  if (!ctx || !clone)
+    return NULL;
+
+  natusValue **made = calloc(clone->objects > 0 ? clone->objects : 1, sizeof(natusValue*));
+  if (!made)
+    return NULL;
+
+  natusValue *val = clone_value(ctx, clone->root, made);
+  for (size_t i=0; i < clone->objects; i++)
+    natus_decref(made[i]);
+  free(made);
+
+  if (val && clone->exception)
+    natus_to_exception(val);
+  return val;
+}
+
+bool
+natus_clone_is_exception(const natusClone *clone)
+{
+  return clone && clone->exception;
+}
+
+void
+natus_clone_free(natusClone *clone)
+{
+  if (!clone)
+    return;
+
+  for (size_t i=0; i < clone->count; i++)
+    node_free(clone->nodes[i]);
+  free(clone->nodes);
+  free(clone);
+}
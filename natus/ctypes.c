@@ -8,7 +8,7 @@ natus_to_bool(const natusValue *val)
   if (natus_is_exception(val))
     return false;
 
-  return val->ctx->spec->to_bool(val->ctx->ctx, val->val);
+  return val->ctx->spec->to_bool(val->ctx->ctx, engval(val));
 }
 
 double
@@ -16,7 +16,7 @@ natus_to_double(const natusValue *val)
 {
   if (!val)
     return 0;
-  return val->ctx->spec->to_double(val->ctx->ctx, val->val);
+  return val->ctx->spec->to_double(val->ctx->ctx, engval(val));
 }
 
 int
@@ -47,14 +47,14 @@ natus_to_string_utf8(const natusValue *val, size_t *len)
   if (!natus_is_string(val)) {
     natusValue *str = natus_call_utf8_array((natusValue*) val, "toString", NULL);
     if (natus_is_string(str)) {
-      char *tmp = val->ctx->spec->to_string_utf8(str->ctx->ctx, str->val, len);
+      char *tmp = val->ctx->spec->to_string_utf8(str->ctx->ctx, engval(str), len);
       natus_decref(str);
       return tmp;
     }
     natus_decref(str);
   }
 
-  return val->ctx->spec->to_string_utf8(val->ctx->ctx, val->val, len);
+  return val->ctx->spec->to_string_utf8(val->ctx->ctx, engval(val), len);
 }
 
 natusChar *
@@ -69,14 +69,123 @@ natus_to_string_utf16(const natusValue *val, size_t *len)
   if (!natus_is_string(val)) {
     natusValue *str = natus_call_utf8_array((natusValue*) val, "toString", NULL);
     if (natus_is_string(str)) {
-      natusChar *tmp = val->ctx->spec->to_string_utf16(str->ctx->ctx, str->val, len);
+      natusChar *tmp = val->ctx->spec->to_string_utf16(str->ctx->ctx, engval(str), len);
       natus_decref(str);
       return tmp;
     }
     natus_decref(str);
   }
 
-  return val->ctx->spec->to_string_utf16(val->ctx->ctx, val->val, len);
+  return val->ctx->spec->to_string_utf16(val->ctx->ctx, engval(val), len);
+}
+
+size_t
+natus_to_string_utf8_buffer(const natusValue *val, char *buf, size_t size)
+{
+  if (!val || (!buf && size > 0))
+    return (size_t) -1;
+
+  if (!natus_is_string(val)) {
+    natusValue *str = natus_call_utf8_array((natusValue*) val, "toString", NULL);
+    if (natus_is_string(str)) {
+      size_t len = val->ctx->spec->to_string_utf8_buffer(str->ctx->ctx, engval(str), buf, size);
+      natus_decref(str);
+      return len;
+    }
+    natus_decref(str);
+  }
+
+  return val->ctx->spec->to_string_utf8_buffer(val->ctx->ctx, engval(val), buf, size);
+}
+
+size_t
+natus_to_string_utf16_range(const natusValue *val, size_t offset, natusChar *buf, size_t size)
+{
+  if (!val || (!buf && size > 0))
+    return (size_t) -1;
+
+  if (!natus_is_string(val)) {
+    natusValue *str = natus_call_utf8_array((natusValue*) val, "toString", NULL);
+    if (natus_is_string(str)) {
+      size_t len = val->ctx->spec->to_string_utf16_range(str->ctx->ctx, engval(str), offset, buf, size);
+      natus_decref(str);
+      return len;
+    }
+    natus_decref(str);
+  }
+
+  return val->ctx->spec->to_string_utf16_range(val->ctx->ctx, engval(val), offset, buf, size);
+}
+
+bool
+natus_string_view_utf16(const natusValue *val, const natusChar **chars, size_t *len, natusStringView *view)
+{
+  if (!val || !chars || !view)
+    return false;
+  size_t intlen = 0;
+  if (!len)
+    len = &intlen;
+
+  view->val = val;
+  view->token = NULL;
+  view->copy = NULL;
+
+  // Only the engine's own strings can be lent
+  if (natus_is_string(val)) {
+    *chars = val->ctx->spec->string_view(val->ctx->ctx, engval(val), len, &view->token);
+    if (*chars)
+      return true;
+  }
+
+  view->copy = natus_to_string_utf16(val, len);
+  *chars = view->copy;
+  return view->copy != NULL;
+}
+
+void
+natus_string_view_release(natusStringView *view)
+{
+  if (!view || !view->val)
+    return;
+  if (view->token)
+    view->val->ctx->spec->string_release(view->val->ctx->ctx, view->token);
+  free(view->copy);
+  view->val = NULL;
+  view->token = NULL;
+  view->copy = NULL;
+}
+
+double *
+natus_array_to_doubles(const natusValue *val, size_t *len)
+{
+  if (!natus_is_array(val))
+    return NULL;
+  size_t intlen = 0;
+  if (!len)
+    len = &intlen;
+
+  if (val->argv)
+    *len = val->argc;
+  else {
+    natusValue *length = natus_get_utf8((natusValue*) val, "length");
+    *len = natus_is_number(length) ? (size_t) natus_to_double(length) : 0;
+    natus_decref(length);
+  }
+
+  double *array = malloc(sizeof(double) * (*len > 0 ? *len : 1));
+  if (!array)
+    return NULL;
+
+  // Arguments views are read without making them into an array
+  if (val->argv) {
+    for (size_t i = 0; i < *len; i++)
+      array[i] = val->ctx->spec->to_double(val->ctx->ctx, val->argv[i]);
+  } else if (!val->ctx->spec->to_doubles(val->ctx->ctx, engval(val), array, *len)) {
+    free(array);
+    return NULL;
+  }
+
+  return array;
 }
 
 bool
@@ -53,3 +53,21 @@ template<>
     free(tmp);
     return rslt;
   }
+
+bool
+Value::borrowBuffer(void **data, size_t *len) const
+{
+  return natus_borrow_buffer(internal, data, len);
+}
+
+size_t
+Value::toUTF8(char* buf, size_t size) const
+{
+  return natus_to_string_utf8_buffer(internal, buf, size);
+}
+
+size_t
+Value::toUTF16(Char* buf, size_t offset, size_t size) const
+{
+  return natus_to_string_utf16_range(internal, offset, (natusChar*) buf, size);
+}
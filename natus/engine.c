@@ -21,8 +21,8 @@ return_ownership(natusValue *val, natusEngValFlags *flags)
   *flags = val->flag;
 
   /* If this value will not free here, retain ownership */
-  ret = val->val;
-  if (mem_parents_count(val, NULL) > 1)
+  ret = engval(val);
+  if (val->scope ? val->refs > 1 : mem_parents_count(val, NULL) > 1)
     *flags &= ~(natusEngValFlagUnlock | natusEngValFlagFree);
   else
     val->flag &= ~(natusEngValFlagUnlock | natusEngValFlagFree);
@@ -31,23 +31,42 @@ return_ownership(natusValue *val, natusEngValFlags *flags)
   return ret;
 }
 
+static const char *
+action_name(natusPropertyAction act)
+{
+  switch (act) {
+  case natusPropertyActionDelete:
+    return "delete";
+  case natusPropertyActionGet:
+    return "get";
+  case natusPropertyActionSet:
+    return "set";
+  default:
+    return "enumerate";
+  }
+}
+
 natusEngVal
 natus_handle_property(const natusPropertyAction act, natusEngVal obj, const natusPrivate *priv, natusEngVal idx, natusEngVal val, natusEngValFlags *flags)
 {
-  natusValue *glbl = private_get(priv, NATUS_PRIV_GLOBAL);
+  natusValue *glbl = private_get_slot(priv, privateSlotGlobal);
   assert(glbl);
+  glbl->ctx->stats.properties++;
 
   /* Convert the arguments */
   natusValue *vobj = hmkval(glbl, obj);
   natusValue *vidx = hmkval(glbl, act & natusPropertyActionEnumerate ? NULL : idx);
   natusValue *vval = hmkval(glbl, act & natusPropertyActionSet ? val : NULL);
   natusValue *rslt = NULL;
+  const char *name = NULL;
+  char buf[TRACE_NAME];
 
   /* Do the call */
-  natusClass *clss = private_get(priv, NATUS_PRIV_CLASS);
+  natusClass *clss = private_get_slot(priv, privateSlotClass);
   if (clss && vobj &&
       (vidx || (act & natusPropertyActionEnumerate)) &&
       (vval || (act & ~natusPropertyActionSet))) {
+    name = trace_enter(glbl, natusTraceProperty, action_name(act), vidx, NULL, buf);
     switch (act) {
     case natusPropertyActionDelete:
       rslt = clss->del(clss, vobj, vidx);
@@ -64,6 +83,7 @@ natus_handle_property(const natusPropertyAction act, natusEngVal obj, const natu
     default:
       assert(false);
     }
+    trace_leave(glbl, natusTraceProperty, name);
   }
   natus_decref(vobj);
   natus_decref(vidx);
@@ -72,34 +92,72 @@ natus_handle_property(const natusPropertyAction act, natusEngVal obj, const natu
   return return_ownership(rslt, flags);
 }
 
-natusEngVal
-natus_handle_call(natusEngVal obj, const natusPrivate *priv, natusEngVal ths, natusEngVal arg, natusEngValFlags *flags)
+static natusEngVal
+handle_call(natusValue *glbl, natusEngVal obj, const natusPrivate *priv, natusEngVal ths, natusValue *varg, natusEngValFlags *flags)
 {
-  natusValue *glbl = private_get(priv, NATUS_PRIV_GLOBAL);
-  assert(glbl);
+  glbl->ctx->stats.callbacks++;
 
   /* Convert the arguments */
   natusValue *vobj = hmkval(glbl, obj);
   natusValue *vths = ths ? hmkval(glbl, ths) : natus_new_undefined(glbl);
-  natusValue *varg = hmkval(glbl, arg);
   natusValue *rslt = NULL;
   if (vobj && vths && varg) {
-    natusClass *clss = private_get(priv, NATUS_PRIV_CLASS);
-    natusNativeFunction func = private_get(priv, NATUS_PRIV_FUNCTION);
+    natusClass *clss = private_get_slot(priv, privateSlotClass);
+    natusNativeFunction func = private_get_slot(priv, privateSlotFunction);
+    char buf[TRACE_NAME];
+    const char *name = trace_enter(glbl, natusTraceCallback, NULL, vobj, "(anonymous)", buf);
     if (clss)
       rslt = clss->call(clss, vobj, vths, varg);
     else if (func)
       rslt = func(vobj, vths, varg);
+    trace_leave(glbl, natusTraceCallback, name);
   }
 
   /* Free the arguments */
   natus_decref(vobj);
   natus_decref(vths);
-  natus_decref(varg);
+  argv_release(varg);
 
   return return_ownership(rslt, flags);
 }
 
+natusEngVal
+natus_handle_call(natusEngVal obj, const natusPrivate *priv, natusEngVal ths, natusEngVal arg, natusEngValFlags *flags)
+{
+  natusValue *glbl = private_get_slot(priv, privateSlotGlobal);
+  assert(glbl);
+
+  return handle_call(glbl, obj, priv, ths, hmkval(glbl, arg), flags);
+}
+
+natusEngVal
+natus_handle_call_argv(natusEngVal obj, const natusPrivate *priv, natusEngVal ths, size_t argc, const natusEngVal *argv, natusEngValFlags *flags)
+{
+  natusValue *glbl = private_get_slot(priv, privateSlotGlobal);
+  assert(glbl);
+
+  return handle_call(glbl, obj, priv, ths, argv_view(glbl, argc, argv), flags);
+}
+
+natusClassHooks
+natus_class_hooks(const natusClass *cls)
+{
+  natusClassHooks hooks = natusClassHookNone;
+  if (!cls)
+    return hooks;
+  if (cls->del)
+    hooks |= natusClassHookDel;
+  if (cls->get)
+    hooks |= natusClassHookGet;
+  if (cls->set)
+    hooks |= natusClassHookSet;
+  if (cls->enumerate)
+    hooks |= natusClassHookEnumerate;
+  if (cls->call)
+    hooks |= natusClassHookCall;
+  return hooks;
+}
+
 void
 natus_private_free(natusPrivate *priv)
 {
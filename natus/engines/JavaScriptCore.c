@@ -41,7 +41,6 @@ typedef JSValueRef natusEngVal;
 #define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
 #include <natus-engine.h>
 
-#define NATUS_PRIV_JSC_CLASS "natus.JavaScriptCore.JSClass"
 
 #define checkerror() \
   if (exc) { \
@@ -54,11 +53,6 @@ typedef JSValueRef natusEngVal;
   if (!val) \
     return NULL
 
-typedef struct {
-  JSClassDefinition def;
-  JSClassRef ref;
-} JavaScriptCoreClass;
-
 static natusEngVal
 mkval(const JSContextRef ctx, JSValueRef val, natusEngValFlags *flags)
 {
@@ -67,39 +61,24 @@ mkval(const JSContextRef ctx, JSValueRef val, natusEngValFlags *flags)
   return val;
 }
 
-static void
-class_free(JavaScriptCoreClass *jscc)
-{
-  if (!jscc)
-    return;
-  if (jscc->ref)
-    JSClassRelease(jscc->ref);
-  free(jscc);
-}
-
-static size_t
-pows(size_t base, size_t pow)
-{
-  if (pow == 0)
-    return 1;
-  return base * pows(base, pow - 1);
-}
-
 static natusEngVal
 property_to_value(natusEngCtx ctx, JSStringRef propertyName)
 {
-  size_t i = 0, idx = 0, len = JSStringGetLength(propertyName);
+  size_t i, len = JSStringGetLength(propertyName);
   const JSChar *jschars = JSStringGetCharactersPtr(propertyName);
   if (!jschars)
     return NULL;
 
-  for (; jschars && len-- > 0; i++) {
-    if (jschars[len] < '0' || jschars[len] > '9')
+  // Only canonical array indexes ("0", "12", not "012") become numbers
+  uint64_t idx = 0;
+  if (len == 0 || len > 10 || (len > 1 && jschars[0] == '0'))
+    goto str;
+  for (i = 0; i < len; i++) {
+    if (jschars[i] < '0' || jschars[i] > '9')
       goto str;
-
-    idx += (jschars[len] - '0') * pows(10, i);
+    idx = idx * 10 + (jschars[i] - '0');
   }
-  if (i > 0)
+  if (idx < UINT32_MAX)
     return JSValueMakeNumber(ctx, idx);
 
 str:
@@ -223,12 +202,12 @@ static JSValueRef
 obj_call(JSContextRef ctx, JSObjectRef object, JSObjectRef thisObject, size_t argc, const JSValueRef args[], JSValueRef* exc)
 {
   natusEngValFlags flags = natusEngValFlagNone;
-  JSValueRef arg = JSObjectMakeArray(ctx, argc, args, exc);
   JSValueProtect(ctx, object);
   if (thisObject)
     JSValueProtect(ctx, thisObject);
-  JSValueProtect(ctx, arg);
-  JSValueRef ret = natus_handle_call(object, JSObjectGetPrivate(object), thisObject, arg, &flags);
+
+  // The arguments are lent as they are, they live on the caller's stack
+  JSValueRef ret = natus_handle_call_argv(object, JSObjectGetPrivate(object), thisObject, argc, args, &flags);
   if (!ret) {
     *exc = JSValueMakeUndefined(ctx);
     return NULL;
@@ -254,6 +233,9 @@ obj_new(JSContextRef ctx, JSObjectRef object, size_t argc, const JSValueRef args
 static JSClassRef glbcls;
 static JSClassRef objcls;
 static JSClassRef fnccls;
+static JSClassRef bufcls;
+static JSClassRef scrcls;
+static JSClassRef hookcls[natusClassHookAll + 1]; /* Shared by natusClasses with these hooks */
 static JSClassDefinition glbclassdef = {
     .className = "GlobalObject",
     .finalize = obj_finalize,
@@ -268,6 +250,38 @@ static JSClassDefinition fncclassdef = {
     .callAsFunction = obj_call,
     .callAsConstructor = obj_new,
 };
+static JSClassDefinition bufclassdef = {
+    .className = "Buffer",
+    .finalize = obj_finalize,
+    .getProperty = obj_get,
+    .setProperty = obj_set,
+    .deleteProperty = obj_del,
+    .getPropertyNames = obj_enum,
+};
+
+/* JavaScriptCore can't keep compiled code, so scripts keep their source */
+typedef struct {
+  JSStringRef  source;
+  JSStringRef  filename;
+  unsigned int lineno;
+} jscScript;
+
+static void
+scr_finalize(JSObjectRef object)
+{
+  jscScript *scr = JSObjectGetPrivate(object);
+  if (!scr)
+    return;
+  JSStringRelease(scr->source);
+  if (scr->filename)
+    JSStringRelease(scr->filename);
+  free(scr);
+}
+
+static JSClassDefinition scrclassdef = {
+    .className = "Script",
+    .finalize = scr_finalize,
+};
 
 __attribute__((constructor))
 static void
@@ -285,6 +299,27 @@ _init()
     assert(objcls = JSClassCreate(&objclassdef));
   if (!fnccls)
     assert(fnccls = JSClassCreate(&fncclassdef));
+  if (!bufcls)
+    assert(bufcls = JSClassCreate(&bufclassdef));
+  if (!scrcls)
+    assert(scrcls = JSClassCreate(&scrclassdef));
+
+  // Every set of hooks up front: created lazily, contexts on different
+  // threads would race to fill the same slot
+  for (size_t hooks = 0; hooks <= natusClassHookAll; hooks++) {
+    JSClassDefinition def = kJSClassDefinitionEmpty;
+    def.finalize = obj_finalize;
+    def.className = hooks & natusClassHookCall ? "NativeFunction" : "NativeObject";
+    def.getProperty = hooks & natusClassHookGet ? obj_get : NULL;
+    def.setProperty = hooks & natusClassHookSet ? obj_set : NULL;
+    def.deleteProperty = hooks & natusClassHookDel ? obj_del : NULL;
+    def.getPropertyNames = hooks & natusClassHookEnumerate ? obj_enum : NULL;
+    def.callAsFunction = hooks & natusClassHookCall ? obj_call : NULL;
+    def.callAsConstructor = hooks & natusClassHookCall ? obj_new : NULL;
+    if (!hookcls[hooks])
+      hookcls[hooks] = JSClassCreate(&def);
+    assert(hookcls[hooks]);
+  }
 }
 
 __attribute__((destructor))
@@ -303,6 +338,20 @@ _fini()
     JSClassRelease(fnccls);
     fnccls = NULL;
   }
+  if (bufcls) {
+    JSClassRelease(bufcls);
+    bufcls = NULL;
+  }
+  if (scrcls) {
+    JSClassRelease(scrcls);
+    scrcls = NULL;
+  }
+  for (size_t i = 0; i <= natusClassHookAll; i++) {
+    if (hookcls[i]) {
+      JSClassRelease(hookcls[i]);
+      hookcls[i] = NULL;
+    }
+  }
 }
 
 static void
@@ -393,6 +442,25 @@ jsc_new_string_utf16(const natusEngCtx ctx, const natusChar *str, size_t len, na
   return mkval(ctx, val, flags);
 }
 
+// JavaScriptCore has no external strings in its C API, so these copy
+static natusEngVal
+jsc_new_string_external_utf8(const natusEngCtx ctx, const char *str, size_t len, natusFreeFunction freefnc, natusEngValFlags *flags)
+{
+  natusEngVal ret = jsc_new_string_utf8(ctx, str, len, flags);
+  if (freefnc)
+    freefnc((void *) str);
+  return ret;
+}
+
+static natusEngVal
+jsc_new_string_external_utf16(const natusEngCtx ctx, const natusChar *str, size_t len, natusFreeFunction freefnc, natusEngValFlags *flags)
+{
+  natusEngVal ret = jsc_new_string_utf16(ctx, str, len, flags);
+  if (freefnc)
+    freefnc((void *) str);
+  return ret;
+}
+
 static natusEngVal
 jsc_new_array(const natusEngCtx ctx, const natusEngVal *array, size_t len, natusEngValFlags *flags)
 {
@@ -402,6 +470,21 @@ jsc_new_array(const natusEngCtx ctx, const natusEngVal *array, size_t len, natus
   return mkval(ctx, ret, flags);
 }
 
+static natusEngVal
+jsc_new_array_doubles(const natusEngCtx ctx, const double *array, size_t len, natusEngValFlags *flags)
+{
+  JSValueRef exc = NULL;
+  JSObjectRef ret = JSObjectMakeArray(ctx, 0, NULL, &exc);
+  checkerrorval(ret);
+
+  // Filled in place: a heap vector of numbers would not be seen by the GC
+  for (size_t i = 0; i < len && !exc; i++)
+    JSObjectSetPropertyAtIndex(ctx, ret, i, JSValueMakeNumber(ctx, array[i]), &exc);
+  checkerror();
+
+  return mkval(ctx, ret, flags);
+}
+
 static natusEngVal
 jsc_new_function(const natusEngCtx ctx, const char *name, natusPrivate *priv, natusEngValFlags *flags)
 {
@@ -477,30 +560,7 @@ jsc_new_function(const natusEngCtx ctx, const char *name, natusPrivate *priv, na
 static natusEngVal
 jsc_new_object(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, natusEngValFlags *flags)
 {
-  // Fill in our functions
-  JSClassRef jscls = objcls;
-  if (cls) {
-    JavaScriptCoreClass *jscc = malloc(sizeof(JavaScriptCoreClass));
-    if (!jscc)
-      return NULL;
-
-    memset(jscc, 0, sizeof(JavaScriptCoreClass));
-    jscc->def.finalize = obj_finalize;
-    jscc->def.className = cls->call ? "NativeFunction" : "NativeObject";
-    jscc->def.getProperty = cls->get ? obj_get : NULL;
-    jscc->def.setProperty = cls->set ? obj_set : NULL;
-    jscc->def.deleteProperty = cls->del ? obj_del : NULL;
-    jscc->def.getPropertyNames = cls->enumerate ? obj_enum : NULL;
-    jscc->def.callAsFunction = cls->call ? obj_call : NULL;
-    jscc->def.callAsConstructor = cls->call ? obj_new : NULL;
-
-    if (!natus_private_push(priv, jscc, (natusFreeFunction) class_free))
-      return NULL;
-
-    jscc->ref = jscls = JSClassCreate(&jscc->def);
-    if (!jscls)
-      return NULL;
-  }
+  JSClassRef jscls = cls ? hookcls[natus_class_hooks(cls)] : objcls;
 
   // Build the object
   JSObjectRef obj = JSObjectMake(ctx, jscls, priv);
@@ -511,6 +571,17 @@ jsc_new_object(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, natus
   return mkval(ctx, obj, flags);
 }
 
+static natusEngVal
+jsc_new_buffer(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, void *data, size_t len, natusEngValFlags *flags)
+{
+  // The bytes are served by the buffer class hooks
+  JSObjectRef obj = JSObjectMake(ctx, bufcls, priv);
+  if (!obj)
+    return NULL;
+
+  return mkval(ctx, obj, flags);
+}
+
 static natusEngVal
 jsc_new_null(const natusEngCtx ctx, natusEngValFlags *flags)
 {
@@ -535,6 +606,23 @@ jsc_to_double(const natusEngCtx ctx, const natusEngVal val)
   return JSValueToNumber(ctx, val, NULL);
 }
 
+static bool
+jsc_to_doubles(const natusEngCtx ctx, const natusEngVal val, double *array, size_t len)
+{
+  JSValueRef exc = NULL;
+
+  JSObjectRef obj = JSValueToObject(ctx, val, &exc);
+  if (!obj || exc)
+    return false;
+
+  for (size_t i = 0; i < len && !exc; i++) {
+    JSValueRef item = JSObjectGetPropertyAtIndex(ctx, obj, i, &exc);
+    if (item && !exc)
+      array[i] = JSValueToNumber(ctx, item, &exc);
+  }
+  return !exc;
+}
+
 static char *
 jsc_to_string_utf8(const natusEngCtx ctx, const natusEngVal val, size_t *len)
 {
@@ -576,6 +664,76 @@ jsc_to_string_utf16(const natusEngCtx ctx, const natusEngVal val, size_t *len)
   return buff;
 }
 
+static size_t
+jsc_to_string_utf8_buffer(const natusEngCtx ctx, const natusEngVal val, char *buf, size_t size)
+{
+  JSStringRef str = JSValueToStringCopy(ctx, val, NULL);
+  if (!str)
+    return (size_t) -1;
+
+  // JavaScriptCore has no exact UTF-8 length, so count it
+  const JSChar *chars = JSStringGetCharactersPtr(str);
+  size_t clen = JSStringGetLength(str);
+  size_t len = 0;
+  for (size_t i=0; i < clen; i++) {
+    if (chars[i] < 0x80)
+      len += 1;
+    else if (chars[i] < 0x800)
+      len += 2;
+    else if (chars[i] >= 0xD800 && chars[i] <= 0xDBFF && i + 1 < clen
+             && chars[i + 1] >= 0xDC00 && chars[i + 1] <= 0xDFFF) {
+      len += 4;
+      i++;
+    } else
+      len += 3;
+  }
+
+  if (size > 0 && JSStringGetUTF8CString(str, buf, size) == 0)
+    buf[0] = '\0';
+  JSStringRelease(str);
+  return len;
+}
+
+static size_t
+jsc_to_string_utf16_range(const natusEngCtx ctx, const natusEngVal val, size_t offset, natusChar *buf, size_t size)
+{
+  JSStringRef str = JSValueToStringCopy(ctx, val, NULL);
+  if (!str)
+    return (size_t) -1;
+
+  size_t len = JSStringGetLength(str);
+  if (offset >= len)
+    size = 0;
+  else if (size > len - offset)
+    size = len - offset;
+  if (size > 0)
+    memcpy(buf, JSStringGetCharactersPtr(str) + offset, sizeof(natusChar) * size);
+  JSStringRelease(str);
+  return size;
+}
+
+static const natusChar *
+jsc_string_view(const natusEngCtx ctx, const natusEngVal val, size_t *len, void **token)
+{
+  if (!JSValueIsString(ctx, val))
+    return NULL;
+
+  // For strings this takes a reference rather than a copy
+  JSStringRef str = JSValueToStringCopy(ctx, val, NULL);
+  if (!str)
+    return NULL;
+
+  *token = (void *) str;
+  *len = JSStringGetLength(str);
+  return JSStringGetCharactersPtr(str);
+}
+
+static void
+jsc_string_release(const natusEngCtx ctx, void *token)
+{
+  JSStringRelease((JSStringRef) token);
+}
+
 static natusEngVal
 jsc_del(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, natusEngValFlags *flags)
 {
@@ -643,6 +801,34 @@ jsc_set(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, const natu
   return mkval(ctx, JSValueMakeBoolean(ctx, true), flags);
 }
 
+static natusEngVal
+jsc_get_index(const natusEngCtx ctx, natusEngVal val, uint32_t idx, natusEngValFlags *flags)
+{
+  JSValueRef exc = NULL;
+
+  JSObjectRef obj = JSValueToObject(ctx, val, &exc);
+  checkerrorval(obj);
+
+  JSValueRef rslt = JSObjectGetPropertyAtIndex(ctx, obj, idx, &exc);
+  checkerrorval(rslt);
+
+  return mkval(ctx, rslt, flags);
+}
+
+static natusEngVal
+jsc_set_index(const natusEngCtx ctx, natusEngVal val, uint32_t idx, const natusEngVal value, natusEngValFlags *flags)
+{
+  JSValueRef exc = NULL;
+
+  JSObjectRef obj = JSValueToObject(ctx, val, &exc);
+  checkerrorval(obj);
+
+  JSObjectSetPropertyAtIndex(ctx, obj, idx, value, &exc);
+  checkerror();
+
+  return mkval(ctx, JSValueMakeBoolean(ctx, true), flags);
+}
+
 static natusEngVal
 jsc_enumerate(const natusEngCtx ctx, natusEngVal val, natusEngValFlags *flags)
 {
@@ -684,13 +870,31 @@ jsc_enumerate(const natusEngCtx ctx, natusEngVal val, natusEngValFlags *flags)
 }
 
 static natusEngVal
-jsc_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal args, natusEngValFlags *flags)
+do_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, size_t argc, const JSValueRef *argv, natusEngValFlags *flags)
 {
   JSValueRef exc = NULL;
 
   JSObjectRef funcobj = JSValueToObject(ctx, func, &exc);
   checkerrorval(funcobj);
 
+  JSValueRef rval;
+  if (JSValueIsUndefined(ctx, ths))
+    rval = JSObjectCallAsConstructor(ctx, funcobj, argc, argv, &exc);
+  else {
+    JSObjectRef thsobj = JSValueToObject(ctx, ths, &exc);
+    checkerrorval(thsobj);
+    rval = JSObjectCallAsFunction(ctx, funcobj, thsobj, argc, argv, &exc);
+  }
+  checkerror();
+
+  return mkval(ctx, rval, flags);
+}
+
+static natusEngVal
+jsc_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal args, natusEngValFlags *flags)
+{
+  JSValueRef exc = NULL;
+
   JSObjectRef argsobj = JSValueToObject(ctx, args, &exc);
   checkerrorval(argsobj);
 
@@ -715,18 +919,15 @@ jsc_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal a
   }
 
   // Call the function
-  JSValueRef rval;
-  if (JSValueIsUndefined(ctx, ths))
-    rval = JSObjectCallAsConstructor(ctx, funcobj, i, argv, &exc);
-  else {
-    JSObjectRef thsobj = JSValueToObject(ctx, ths, &exc);
-    checkerrorval(thsobj);
-    rval = JSObjectCallAsFunction(ctx, funcobj, thsobj, i, argv, &exc);
-  }
+  natusEngVal rslt = do_call(ctx, func, ths, i, argv, flags);
   free(argv);
-  checkerror();
+  return rslt;
+}
 
-  return mkval(ctx, rval, flags);
+static natusEngVal
+jsc_call_argv(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, size_t argc, const natusEngVal *argv, natusEngValFlags *flags)
+{
+  return do_call(ctx, func, ths, argc, argv, flags);
 }
 
 static natusEngVal
@@ -753,6 +954,86 @@ jsc_evaluate(const natusEngCtx ctx, natusEngVal ths, const natusEngVal jscript,
   return mkval(ctx, rval, flags);
 }
 
+static natusEngVal
+jsc_compile(const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno, natusEngValFlags *flags)
+{
+  JSValueRef exc = NULL;
+
+  jscScript *scr = calloc(1, sizeof(jscScript));
+  if (!scr)
+    return NULL;
+  scr->lineno = lineno;
+
+  scr->source = JSValueToStringCopy(ctx, jscript, &exc);
+  if (scr->source && !exc && filename)
+    scr->filename = JSValueToStringCopy(ctx, filename, &exc);
+
+  // Still report syntax errors now, as the other engines do
+  if (scr->source && !exc)
+    JSCheckScriptSyntax(ctx, scr->source, scr->filename, lineno, &exc);
+
+  JSObjectRef obj = NULL;
+  if (scr->source && !exc)
+    obj = JSObjectMake(ctx, scrcls, scr);
+  if (!obj) {
+    if (scr->source)
+      JSStringRelease(scr->source);
+    if (scr->filename)
+      JSStringRelease(scr->filename);
+    free(scr);
+  }
+
+  checkerrorval(obj);
+  return mkval(ctx, obj, flags);
+}
+
+static natusEngVal
+jsc_run(const natusEngCtx ctx, natusEngVal ths, const natusEngVal script, natusEngValFlags *flags)
+{
+  JSValueRef exc = NULL;
+
+  JSObjectRef thsobj = JSValueToObject(ctx, ths, &exc);
+  checkerrorval(thsobj);
+
+  if (!JSValueIsObjectOfClass(ctx, script, scrcls)) {
+    // Thrown as a TypeError, like the errors natus throws itself
+    JSStringRef name = JSStringCreateWithUTF8CString("TypeError");
+    JSStringRef msg = JSStringCreateWithUTF8CString("Not a compiled script");
+    JSValueRef arg = JSValueMakeString(ctx, msg);
+    JSValueRef ctor = JSObjectGetProperty(ctx, JSContextGetGlobalObject(ctx), name, &exc);
+    JSObjectRef err = NULL;
+    if (!exc && ctor && JSValueIsObject(ctx, ctor))
+      err = JSObjectCallAsConstructor(ctx, (JSObjectRef) ctor, 1, &arg, &exc);
+    if (err)
+      exc = err;
+    else if (!exc)
+      exc = arg;
+    JSStringRelease(name);
+    JSStringRelease(msg);
+    checkerror();
+  }
+
+  jscScript *scr = JSObjectGetPrivate((JSObjectRef) script);
+  JSValueRef rval = JSEvaluateScript(ctx, scr->source, thsobj, scr->filename, scr->lineno, &exc);
+  checkerror();
+
+  return mkval(ctx, rval, flags);
+}
+
+// Scripts here are only source, so there is nothing worth saving
+static void *
+jsc_serialize(const natusEngCtx ctx, const natusEngVal script, size_t *len)
+{
+  return NULL;
+}
+
+static natusEngVal
+jsc_deserialize(const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno,
+                const void *data, size_t len, natusEngValFlags *flags)
+{
+  return NULL;
+}
+
 static natusPrivate *
 jsc_get_private(const natusEngCtx ctx, const natusEngVal val)
 {
@@ -802,7 +1083,7 @@ jsc_get_type(const natusEngCtx ctx, const natusEngVal val)
   //  call the natus defined property handler, which may call
   //  get_type(), etc)
   if (JSObjectGetPrivate(obj))
-    return natusValueTypeObject;
+    return JSValueIsObjectOfClass(ctx, val, bufcls) ? natusValueTypeBuffer : natusValueTypeObject;
 
   // ARRAY
   /* Yes, this is really ugly. But unfortunately JavaScriptCore is missing JSValueIsArray().
@@ -852,4 +1133,10 @@ jsc_equal(const natusEngCtx ctx, const natusEngVal val1, const natusEngVal val2,
   return JSValueIsEqual(ctx, val1, val2, NULL);
 }
 
-NATUS_ENGINE("JavaScriptCore", "JSObjectMakeFunctionWithCallback", jsc);
+static uintptr_t
+jsc_identity(const natusEngCtx ctx, const natusEngVal val)
+{
+  return (uintptr_t) val;
+}
+
+NATUS_ENGINE("JavaScriptCore", "JSObjectMakeFunctionWithCallback", natusEngineFlagThreadSafe, jsc);
@@ -0,0 +1,2193 @@
+/*
+ * Copyright (c) 2010 Nathaniel McCallum <nathaniel@natemccallum.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * The Reference engine implements the full natusEngineSpec without any
+ * external dependencies.  It is there for two things:
+ *
+ *   1. running the test suite on machines without a real engine installed
+ *   2. measuring the overhead of the natus binding layer itself, since the
+ *      engine's own cost for a crossing is a handful of pointer operations
+ *
+ * This half is what the binding layer talks to: values, objects, property
+ * access and the engine interface.  Scripts are parsed and run by
+ * ReferenceScript.c.
+ *
+ * Every value is a reference counted cell.  Cycles among objects are found
+ * by a collector, which runs only while no script or native hook is active.
+ */
+
+#include "Reference.h"
+
+static void
+object_clear(refRuntime *rt, refObject *obj);
+
+/*
+ * Cells
+ */
+
+static void
+cell_free(refRuntime *rt, refValue *val)
+{
+  if (val->prev)
+    val->prev->next = val->next;
+  else
+    rt->cells = val->next;
+  if (val->next)
+    val->next->prev = val->prev;
+
+  if (val->kind == refKindString)
+    free(val->u.string.chars);
+  else if (val->kind == refKindObject)
+    rt->objects--;
+  free(val);
+}
+
+void
+decref(refRuntime *rt, refValue *val)
+{
+  if (!val || rt->dying)
+    return;
+
+  assert(val->refs > 0);
+  if (--val->refs > 0)
+    return;
+
+  if (val->kind == refKindObject) {
+    refObject *obj = OBJ(val);
+
+    /* Keep the object alive while the finalizer runs */
+    val->refs++;
+    if (obj->priv) {
+      natusPrivate *priv = obj->priv;
+      obj->priv = NULL;
+      rt->callouts++;
+      natus_private_free(priv);
+      rt->callouts--;
+    }
+    object_clear(rt, obj);
+    if (--val->refs > 0)
+      return;
+  }
+
+  cell_free(rt, val);
+}
+
+static refValue *
+cell_new(refRuntime *rt, refKind kind, size_t size)
+{
+  refValue *val = calloc(1, size);
+  if (!val)
+    return NULL;
+
+  val->refs = 1;
+  val->kind = kind;
+  val->next = rt->cells;
+  if (rt->cells)
+    rt->cells->prev = val;
+  rt->cells = val;
+  return val;
+}
+
+/*
+ * Primitives
+ */
+
+refValue *
+mknumber(refRuntime *rt, double n)
+{
+  refValue *val = cell_new(rt, refKindNumber, sizeof(refValue));
+  if (val)
+    val->u.number = n;
+  return val;
+}
+
+uint32_t
+chars_hash(const natusChar *chars, size_t len)
+{
+  uint32_t hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    hash ^= chars[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+/* Takes ownership of chars */
+refValue *
+mkstring_take(refRuntime *rt, natusChar *chars, size_t len)
+{
+  refValue *val = cell_new(rt, refKindString, sizeof(refValue));
+  if (!val) {
+    free(chars);
+    return NULL;
+  }
+
+  val->u.string.chars = chars;
+  val->u.string.len = len;
+  val->u.string.hash = chars_hash(chars, len);
+  return val;
+}
+
+refValue *
+mkstring_utf16(refRuntime *rt, const natusChar *str, size_t len)
+{
+  natusChar *chars = malloc(sizeof(natusChar) * (len + 1));
+  if (!chars)
+    return NULL;
+  if (len > 0)
+    memcpy(chars, str, sizeof(natusChar) * len);
+  chars[len] = 0;
+  return mkstring_take(rt, chars, len);
+}
+
+static natusChar *
+utf8_to_utf16(const char *str, size_t len, size_t *outlen)
+{
+  natusChar *out = malloc(sizeof(natusChar) * (len + 1));
+  size_t i = 0, o = 0;
+  if (!out)
+    return NULL;
+
+  while (i < len) {
+    unsigned char c = str[i];
+    uint32_t cp;
+    size_t n;
+
+    if (c < 0x80) {
+      cp = c;
+      n = 1;
+    } else if ((c & 0xE0) == 0xC0) {
+      cp = c & 0x1F;
+      n = 2;
+    } else if ((c & 0xF0) == 0xE0) {
+      cp = c & 0x0F;
+      n = 3;
+    } else if ((c & 0xF8) == 0xF0) {
+      cp = c & 0x07;
+      n = 4;
+    } else {
+      cp = 0xFFFD;
+      n = 1;
+    }
+
+    if (n > 1) {
+      size_t j;
+      if (i + n > len) {
+        cp = 0xFFFD;
+        n = len - i;
+      } else {
+        for (j = 1; j < n; j++) {
+          if ((str[i + j] & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            n = j;
+            break;
+          }
+          cp = (cp << 6) | (str[i + j] & 0x3F);
+        }
+      }
+    }
+    i += n;
+
+    if (cp >= 0x10000) {
+      cp -= 0x10000;
+      out[o++] = 0xD800 | (cp >> 10);
+      out[o++] = 0xDC00 | (cp & 0x3FF);
+    } else
+      out[o++] = cp;
+  }
+
+  out[o] = 0;
+  *outlen = o;
+  return out;
+}
+
+/* Encodes what fits of str into size bytes of out, whole characters only.
+ * Returns the full length, with the bytes written in *written. */
+static size_t
+utf16_write_utf8(const natusChar *str, size_t len, char *out, size_t size, size_t *written)
+{
+  size_t i, o = 0;
+  bool full = false;
+
+  *written = 0;
+  for (i = 0; i < len; i++) {
+    uint32_t cp = str[i];
+    char seq[4];
+    size_t n;
+
+    if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < len
+        && str[i + 1] >= 0xDC00 && str[i + 1] <= 0xDFFF) {
+      cp = 0x10000 + ((cp - 0xD800) << 10) + (str[++i] - 0xDC00);
+      seq[0] = 0xF0 | (cp >> 18);
+      seq[1] = 0x80 | ((cp >> 12) & 0x3F);
+      seq[2] = 0x80 | ((cp >> 6) & 0x3F);
+      seq[3] = 0x80 | (cp & 0x3F);
+      n = 4;
+    } else if (cp >= 0x800) {
+      seq[0] = 0xE0 | (cp >> 12);
+      seq[1] = 0x80 | ((cp >> 6) & 0x3F);
+      seq[2] = 0x80 | (cp & 0x3F);
+      n = 3;
+    } else if (cp >= 0x80) {
+      seq[0] = 0xC0 | (cp >> 6);
+      seq[1] = 0x80 | (cp & 0x3F);
+      n = 2;
+    } else {
+      seq[0] = cp;
+      n = 1;
+    }
+
+    if (!full && o + n <= size) {
+      memcpy(out + o, seq, n);
+      *written = o + n;
+    } else
+      full = true;
+    o += n;
+  }
+
+  return o;
+}
+
+static char *
+utf16_to_utf8(const natusChar *str, size_t len, size_t *outlen)
+{
+  char *out = malloc(len * 3 + 1);
+  size_t o;
+  if (!out)
+    return NULL;
+
+  utf16_write_utf8(str, len, out, len * 3, &o);
+  out[o] = '\0';
+  *outlen = o;
+  return out;
+}
+
+refValue *
+mkstring_utf8(refRuntime *rt, const char *str, size_t len)
+{
+  size_t outlen;
+  natusChar *chars = utf8_to_utf16(str, len, &outlen);
+  if (!chars)
+    return NULL;
+  return mkstring_take(rt, chars, outlen);
+}
+
+static inline bool
+string_equal(const refValue *a, const refValue *b)
+{
+  if (a == b)
+    return true;
+  if (a->u.string.hash != b->u.string.hash || a->u.string.len != b->u.string.len)
+    return false;
+  return !memcmp(a->u.string.chars, b->u.string.chars, sizeof(natusChar) * a->u.string.len);
+}
+
+refValue *
+string_concat(refRuntime *rt, const refValue *a, const refValue *b)
+{
+  size_t len = a->u.string.len + b->u.string.len;
+  natusChar *chars = malloc(sizeof(natusChar) * (len + 1));
+  if (!chars)
+    return NULL;
+  memcpy(chars, a->u.string.chars, sizeof(natusChar) * a->u.string.len);
+  memcpy(chars + a->u.string.len, b->u.string.chars, sizeof(natusChar) * b->u.string.len);
+  chars[len] = 0;
+  return mkstring_take(rt, chars, len);
+}
+
+int
+string_compare(const refValue *a, const refValue *b)
+{
+  size_t i, len = a->u.string.len < b->u.string.len ? a->u.string.len : b->u.string.len;
+  for (i = 0; i < len; i++)
+    if (a->u.string.chars[i] != b->u.string.chars[i])
+      return a->u.string.chars[i] < b->u.string.chars[i] ? -1 : 1;
+  if (a->u.string.len == b->u.string.len)
+    return 0;
+  return a->u.string.len < b->u.string.len ? -1 : 1;
+}
+
+/* Formats a number the way ECMAScript's ToString does */
+static size_t
+number_format(double d, char *buf)
+{
+  char tmp[40], digits[20];
+  int exp, k = 0, n, i;
+  char *s = buf;
+
+  if (isnan(d))
+    return sprintf(buf, "NaN");
+  if (d == 0)
+    return sprintf(buf, "0");
+  if (isinf(d))
+    return sprintf(buf, d < 0 ? "-Infinity" : "Infinity");
+  if (d < 0) {
+    *s++ = '-';
+    d = -d;
+  }
+
+  /* Find the shortest representation which round-trips */
+  for (i = 1; i <= 17; i++) {
+    snprintf(tmp, sizeof(tmp), "%.*e", i - 1, d);
+    if (strtod(tmp, NULL) == d)
+      break;
+  }
+
+  for (i = 0; tmp[i] && tmp[i] != 'e'; i++)
+    if (isdigit((unsigned char) tmp[i]))
+      digits[k++] = tmp[i];
+  while (k > 1 && digits[k - 1] == '0')
+    k--;
+  digits[k] = '\0';
+  exp = atoi(tmp + i + 1);
+  n = exp + 1;
+
+  if (k <= n && n <= 21) {
+    s += sprintf(s, "%s", digits);
+    for (i = 0; i < n - k; i++)
+      *s++ = '0';
+  } else if (0 < n && n <= 21) {
+    memcpy(s, digits, n);
+    s += n;
+    *s++ = '.';
+    s += sprintf(s, "%s", digits + n);
+  } else if (-6 < n && n <= 0) {
+    *s++ = '0';
+    *s++ = '.';
+    for (i = 0; i < -n; i++)
+      *s++ = '0';
+    s += sprintf(s, "%s", digits);
+  } else {
+    *s++ = digits[0];
+    if (k > 1) {
+      *s++ = '.';
+      s += sprintf(s, "%s", digits + 1);
+    }
+    s += sprintf(s, "e%c%d", n - 1 < 0 ? '-' : '+', abs(n - 1));
+  }
+
+  *s = '\0';
+  return s - buf;
+}
+
+refValue *
+number_to_string(refRuntime *rt, double d)
+{
+  char buf[64];
+  size_t len = number_format(d, buf);
+  return mkstring_utf8(rt, buf, len);
+}
+
+bool
+is_space(natusChar c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v'
+      || c == '\f' || c == 0xA0 || c == 0xFEFF || c == 0x2028 || c == 0x2029;
+}
+
+static double
+string_to_number(const refValue *str)
+{
+  const natusChar *c = str->u.string.chars;
+  size_t len = str->u.string.len, i;
+  char *buf, *end;
+  double d;
+
+  while (len > 0 && is_space(*c)) {
+    c++;
+    len--;
+  }
+  while (len > 0 && is_space(c[len - 1]))
+    len--;
+  if (len == 0)
+    return 0;
+
+  buf = malloc(len + 1);
+  if (!buf)
+    return NAN;
+  for (i = 0; i < len; i++) {
+    if (c[i] > 127) {
+      free(buf);
+      return NAN;
+    }
+    buf[i] = c[i];
+  }
+  buf[len] = '\0';
+
+  if (len > 2 && buf[0] == '0' && (buf[1] == 'x' || buf[1] == 'X'))
+    d = (double) strtoull(buf + 2, &end, 16);
+  else if (!strcmp(buf, "Infinity") || !strcmp(buf, "+Infinity"))
+    d = INFINITY, end = buf + len;
+  else if (!strcmp(buf, "-Infinity"))
+    d = -INFINITY, end = buf + len;
+  else if (isalpha((unsigned char) buf[len - 1]) || strchr(buf, 'x') || strchr(buf, 'X'))
+    d = NAN, end = buf + len; /* Reject strtod's inf/nan/hex extensions */
+  else
+    d = strtod(buf, &end);
+
+  if (*end != '\0')
+    d = NAN;
+  free(buf);
+  return d;
+}
+
+/* Returns true if the string is a canonical array index */
+bool
+string_to_index(const refValue *str, uint32_t *index)
+{
+  const natusChar *c = str->u.string.chars;
+  size_t len = str->u.string.len, i;
+  uint64_t n = 0;
+
+  if (len == 0 || len > 10 || (len > 1 && c[0] == '0'))
+    return false;
+  for (i = 0; i < len; i++) {
+    if (c[i] < '0' || c[i] > '9')
+      return false;
+    n = n * 10 + (c[i] - '0');
+  }
+  if (n >= UINT32_MAX)
+    return false;
+
+  *index = (uint32_t) n;
+  return true;
+}
+
+static inline bool
+number_to_index(double d, uint32_t *index)
+{
+  if (!(d >= 0 && d < UINT32_MAX) || d != floor(d))
+    return false;
+  *index = (uint32_t) d;
+  return true;
+}
+
+static refValue *
+index_to_string(refRuntime *rt, uint32_t index)
+{
+  char buf[16];
+  return mkstring_utf8(rt, buf, sprintf(buf, "%u", index));
+}
+
+/*
+ * Objects
+ */
+
+refValue *
+object_new(refRuntime *rt, refClass cls, refValue *proto)
+{
+  refValue *val = cell_new(rt, refKindObject, sizeof(refObject));
+  if (!val)
+    return NULL;
+
+  OBJ(val)->cls = cls;
+  OBJ(val)->proto = incref(proto);
+  OBJ(val)->global = incref(rt->global);
+  rt->objects++;
+  return val;
+}
+
+static void
+object_clear(refRuntime *rt, refObject *obj)
+{
+  size_t i;
+
+  refValue *proto = obj->proto, *global = obj->global, *scope = obj->scope;
+  refProperty *props = obj->props;
+  refValue **items = obj->items;
+  size_t nprops = obj->nprops, nitems = obj->nitems;
+
+  /* Detach everything before releasing it, since releasing may recurse */
+  obj->proto = obj->global = obj->scope = NULL;
+  obj->props = NULL;
+  obj->items = NULL;
+  obj->nprops = obj->aprops = obj->nitems = obj->aitems = 0;
+  free(obj->index);
+  obj->index = NULL;
+  obj->nindex = 0;
+  if (obj->program) {
+    program_decref(obj->program);
+    obj->program = NULL;
+    obj->func = NULL;
+  }
+
+  decref(rt, proto);
+  if (global != &obj->base)
+    decref(rt, global);
+  decref(rt, scope);
+  for (i = 0; i < nprops; i++) {
+    decref(rt, props[i].key);
+    decref(rt, props[i].value);
+  }
+  for (i = 0; i < nitems; i++)
+    decref(rt, items[i]);
+  free(props);
+  free(items);
+}
+
+static void
+index_insert(refObject *obj, size_t prop)
+{
+  size_t mask = obj->nindex - 1;
+  size_t i = obj->props[prop].key->u.string.hash & mask;
+  while (obj->index[i])
+    i = (i + 1) & mask;
+  obj->index[i] = prop + 1;
+}
+
+static void
+index_rebuild(refObject *obj)
+{
+  size_t i, size = 16;
+
+  free(obj->index);
+  obj->index = NULL;
+  obj->nindex = 0;
+  if (obj->nprops <= REF_HASH_MINIMUM)
+    return;
+
+  while (size < obj->nprops * 2)
+    size *= 2;
+  obj->index = calloc(size, sizeof(size_t));
+  if (!obj->index)
+    return;
+  obj->nindex = size;
+
+  for (i = 0; i < obj->nprops; i++)
+    index_insert(obj, i);
+}
+
+size_t
+prop_find(const refObject *obj, const refValue *key)
+{
+  size_t i;
+
+  if (obj->index) {
+    size_t mask = obj->nindex - 1;
+    for (i = key->u.string.hash & mask; obj->index[i]; i = (i + 1) & mask)
+      if (string_equal(obj->props[obj->index[i] - 1].key, key))
+        return obj->index[i] - 1;
+    return SIZE_MAX;
+  }
+
+  for (i = 0; i < obj->nprops; i++)
+    if (string_equal(obj->props[i].key, key))
+      return i;
+  return SIZE_MAX;
+}
+
+/* Defines or overwrites an own property; key and value are borrowed */
+bool
+prop_put(refRuntime *rt, refObject *obj, refValue *key, refValue *value, unsigned attrs)
+{
+  size_t i = prop_find(obj, key);
+  if (i != SIZE_MAX) {
+    refValue *old = obj->props[i].value;
+    obj->props[i].value = incref(value);
+    obj->props[i].attrs = attrs;
+    decref(rt, old);
+    return true;
+  }
+
+  if (obj->nprops == obj->aprops) {
+    size_t size = obj->aprops ? obj->aprops * 2 : 4;
+    refProperty *tmp = realloc(obj->props, sizeof(refProperty) * size);
+    if (!tmp)
+      return false;
+    obj->props = tmp;
+    obj->aprops = size;
+  }
+
+  i = obj->nprops++;
+  obj->props[i].key = incref(key);
+  obj->props[i].value = incref(value);
+  obj->props[i].attrs = attrs;
+
+  if (obj->nprops > REF_HASH_MINIMUM) {
+    if (!obj->index || obj->nprops * 2 > obj->nindex)
+      index_rebuild(obj);
+    else
+      index_insert(obj, i);
+  }
+  return true;
+}
+
+static void
+prop_remove(refRuntime *rt, refObject *obj, size_t i)
+{
+  refValue *key = obj->props[i].key;
+  refValue *value = obj->props[i].value;
+
+  memmove(obj->props + i, obj->props + i + 1, sizeof(refProperty) * (obj->nprops - i - 1));
+  obj->nprops--;
+  if (obj->index)
+    index_rebuild(obj);
+
+  decref(rt, key);
+  decref(rt, value);
+}
+
+bool
+prop_put_ascii(refRuntime *rt, refValue *obj, const char *name, refValue *value, unsigned attrs)
+{
+  refValue *key = mkstring(rt, name);
+  if (!key)
+    return false;
+  bool res = prop_put(rt, OBJ(obj), key, value, attrs);
+  decref(rt, key);
+  return res;
+}
+
+static bool
+array_set(refRuntime *rt, refObject *obj, uint32_t index, refValue *value)
+{
+  if (index >= obj->aitems) {
+    size_t size = obj->aitems ? obj->aitems : 4;
+    while (size <= index)
+      size *= 2;
+    refValue **tmp = realloc(obj->items, sizeof(refValue*) * size);
+    if (!tmp)
+      return false;
+    memset(tmp + obj->aitems, 0, sizeof(refValue*) * (size - obj->aitems));
+    obj->items = tmp;
+    obj->aitems = size;
+  }
+
+  refValue *old = obj->items[index];
+  obj->items[index] = incref(value);
+  if (index >= obj->nitems)
+    obj->nitems = index + 1;
+  decref(rt, old);
+  return true;
+}
+
+bool
+array_push(refRuntime *rt, refObject *obj, refValue *value)
+{
+  return array_set(rt, obj, obj->nitems, value);
+}
+
+static void
+array_truncate(refRuntime *rt, refObject *obj, size_t len)
+{
+  while (obj->nitems > len) {
+    refValue *old = obj->items[--obj->nitems];
+    obj->items[obj->nitems] = NULL;
+    decref(rt, old);
+  }
+}
+
+refValue *
+array_new(refRuntime *rt, size_t len, refValue **items)
+{
+  size_t i;
+
+  refValue *arr = object_new(rt, refClassArray, rt->protos[refProtoArray]);
+  if (!arr)
+    return NULL;
+
+  if (len > 0) {
+    OBJ(arr)->items = calloc(len, sizeof(refValue*));
+    if (!OBJ(arr)->items) {
+      decref(rt, arr);
+      return NULL;
+    }
+    OBJ(arr)->aitems = OBJ(arr)->nitems = len;
+    for (i = 0; items && i < len; i++)
+      OBJ(arr)->items[i] = incref(items[i]);
+  }
+
+  return arr;
+}
+
+/*
+ * Property keys
+ */
+
+bool
+key_init(refRuntime *rt, refKey *key, refValue *val)
+{
+  memset(key, 0, sizeof(refKey));
+  key->orig = val;
+
+  if (IS_NUMBER(val)) {
+    if (number_to_index(val->u.number, &key->index))
+      key->isindex = true;
+    else if (!(key->string = number_to_string(rt, val->u.number)))
+      return false;
+    return true;
+  }
+
+  key->string = IS_STRING(val) ? incref(val) : to_string(rt, val);
+  if (!key->string)
+    return false;
+  key->isindex = string_to_index(key->string, &key->index);
+  return true;
+}
+
+static refValue *
+key_string(refRuntime *rt, refKey *key)
+{
+  if (!key->string)
+    key->string = index_to_string(rt, key->index);
+  return key->string;
+}
+
+static void
+key_init_index(refKey *key, uint32_t index)
+{
+  memset(key, 0, sizeof(refKey));
+  key->index = index;
+  key->isindex = true;
+}
+
+static refValue *
+key_orig(refRuntime *rt, refKey *key)
+{
+  if (!key->orig)
+    key->orig = key->number = mknumber(rt, key->index);
+  return key->orig;
+}
+
+void
+key_free(refRuntime *rt, refKey *key)
+{
+  decref(rt, key->string);
+  decref(rt, key->number);
+}
+
+/*
+ * Native class hooks
+ */
+
+typedef enum {
+  refHookBypass,
+  refHookIntercept,
+  refHookException
+} refHookResult;
+
+static refHookResult
+hook_property(refRuntime *rt, refValue *obj, natusPropertyAction act,
+              refValue *key, refValue *val, refValue **out)
+{
+  natusEngValFlags flags = natusEngValFlagNone;
+  rt->callouts++;
+  refValue *res = natus_handle_property(act, incref(obj), OBJ(obj)->priv,
+                                        act & natusPropertyActionEnumerate ? NULL : incref(key),
+                                        act & natusPropertyActionSet ? incref(val) : NULL,
+                                        &flags);
+  rt->callouts--;
+
+  if (flags & natusEngValFlagException) {
+    if (!res || res->kind == refKindUndefined) {
+      if (res && (flags & natusEngValFlagUnlock))
+        decref(rt, res);
+      return refHookBypass;
+    }
+
+    decref(rt, rt->exception);
+    rt->exception = incref(res);
+    if (flags & natusEngValFlagUnlock)
+      decref(rt, res);
+    return refHookException;
+  }
+
+  if (out)
+    *out = incref(res);
+  if (flags & natusEngValFlagUnlock)
+    decref(rt, res);
+  return refHookIntercept;
+}
+
+/*
+ * Property access
+ */
+
+/* Looks up an own property without consulting hooks; returns a borrowed
+ * value or NULL if it doesn't exist */
+refValue *
+own_lookup(refRuntime *rt, refValue *obj, refKey *key)
+{
+  refObject *o = OBJ(obj);
+
+  if (o->cls == refClassArray) {
+    if (key->isindex)
+      return key->index < o->nitems ? o->items[key->index] : NULL;
+    if (key->string && string_equal(key->string, rt->s_length))
+      return NULL;
+  }
+
+  size_t i = prop_find(o, key_string(rt, key));
+  return i == SIZE_MAX ? NULL : o->props[i].value;
+}
+
+static refValue *
+get_key(refRuntime *rt, refValue *val, refKey *key)
+{
+  refValue *obj = val;
+
+  switch (val->kind) {
+  case refKindUndefined:
+  case refKindNull:
+    key_string(rt, key);
+    return throw_error(rt, refProtoTypeError, "Cannot read property '%S' of %s",
+                       key->string, val->kind == refKindNull ? "null" : "undefined");
+
+  case refKindString:
+    if (key->isindex) {
+      if (key->index < val->u.string.len)
+        return mkstring_utf16(rt, val->u.string.chars + key->index, 1);
+      return incref(rt->undefined);
+    }
+    if (string_equal(key->string, rt->s_length))
+      return mknumber(rt, val->u.string.len);
+    obj = rt->protos[refProtoString];
+    break;
+
+  case refKindNumber:
+  case refKindBoolean:
+    obj = rt->protos[refProtoObject];
+    break;
+
+  case refKindObject:
+    if (HAS_HOOK(val, get)) {
+      refValue *res = NULL;
+      switch (hook_property(rt, val, natusPropertyActionGet, key_orig(rt, key), NULL, &res)) {
+      case refHookIntercept:
+        return res;
+      case refHookException:
+        return NULL;
+      default:
+        break;
+      }
+    }
+
+    if (OBJ(val)->cls == refClassArray && !key->isindex
+        && string_equal(key_string(rt, key), rt->s_length))
+      return mknumber(rt, OBJ(val)->nitems);
+    break;
+  }
+
+  for (; obj; obj = OBJ(obj)->proto) {
+    refValue *res = own_lookup(rt, obj, key);
+    if (res)
+      return incref(res);
+  }
+
+  return incref(rt->undefined);
+}
+
+refValue *
+get_property(refRuntime *rt, refValue *val, refValue *id)
+{
+  refKey key;
+  if (!key_init(rt, &key, id))
+    return NULL;
+  refValue *res = get_key(rt, val, &key);
+  key_free(rt, &key);
+  return res;
+}
+
+refValue *
+get_named(refRuntime *rt, refValue *val, refValue *name)
+{
+  return get_property(rt, val, name);
+}
+
+/* Returns false if an exception is pending */
+static bool
+put_key(refRuntime *rt, refValue *val, refKey *key, refValue *value, unsigned attrs, bool define)
+{
+  if (!IS_OBJECT(val)) {
+    if (val->kind == refKindUndefined || val->kind == refKindNull) {
+      key_string(rt, key);
+      throw_error(rt, refProtoTypeError, "Cannot set property '%S' of %s",
+                  key->string, val->kind == refKindNull ? "null" : "undefined");
+      return false;
+    }
+    return true; /* Silently ignored, like a non-strict engine */
+  }
+
+  refObject *obj = OBJ(val);
+  if (HAS_HOOK(val, set)) {
+    switch (hook_property(rt, val, natusPropertyActionSet, key_orig(rt, key), value, NULL)) {
+    case refHookIntercept:
+      return true;
+    case refHookException:
+      return false;
+    default:
+      break;
+    }
+  }
+
+  if (obj->cls == refClassArray) {
+    if (key->isindex) {
+      if (array_set(rt, obj, key->index, value))
+        return true;
+      throw_error(rt, refProtoRangeError, "Out of memory");
+      return false;
+    }
+
+    if (string_equal(key_string(rt, key), rt->s_length)) {
+      double d = value->kind == refKindNumber ? value->u.number : NAN;
+      uint32_t len;
+      if (!number_to_index(d, &len)) {
+        throw_error(rt, refProtoRangeError, "Invalid array length");
+        return false;
+      }
+      if (len < obj->nitems)
+        array_truncate(rt, obj, len);
+      else if (len > obj->nitems) {
+        if (!array_set(rt, obj, len - 1, rt->undefined))
+          return false;
+        decref(rt, obj->items[len - 1]);
+        obj->items[len - 1] = NULL;
+      }
+      return true;
+    }
+  }
+
+  size_t i = prop_find(obj, key_string(rt, key));
+  if (i != SIZE_MAX && !define) {
+    if (obj->props[i].attrs & natusPropAttrReadOnly)
+      return true;
+    attrs = obj->props[i].attrs;
+  }
+
+  if (!prop_put(rt, obj, key->string, value, attrs)) {
+    throw_error(rt, refProtoRangeError, "Out of memory");
+    return false;
+  }
+  return true;
+}
+
+bool
+put_property(refRuntime *rt, refValue *val, refValue *id, refValue *value)
+{
+  refKey key;
+  if (!key_init(rt, &key, id))
+    return false;
+  bool res = put_key(rt, val, &key, value, natusPropAttrNone, false);
+  key_free(rt, &key);
+  return res;
+}
+
+/* Returns NULL if an exception is pending, otherwise true or false */
+refValue *
+del_key(refRuntime *rt, refValue *val, refKey *key)
+{
+  if (!IS_OBJECT(val))
+    return mkbool(rt, true);
+
+  refObject *obj = OBJ(val);
+  if (HAS_HOOK(val, del)) {
+    refValue *res = NULL;
+    switch (hook_property(rt, val, natusPropertyActionDelete, key_orig(rt, key), NULL, &res)) {
+    case refHookIntercept:
+      decref(rt, res);
+      return mkbool(rt, true);
+    case refHookException:
+      return NULL;
+    default:
+      break;
+    }
+  }
+
+  if (obj->cls == refClassArray && key->isindex) {
+    if (key->index < obj->nitems) {
+      refValue *old = obj->items[key->index];
+      obj->items[key->index] = NULL;
+      decref(rt, old);
+    }
+    return mkbool(rt, true);
+  }
+
+  size_t i = prop_find(obj, key_string(rt, key));
+  if (i == SIZE_MAX)
+    return mkbool(rt, true);
+  if (obj->props[i].attrs & natusPropAttrDontDelete)
+    return mkbool(rt, false);
+
+  prop_remove(rt, obj, i);
+  return mkbool(rt, true);
+}
+
+/* Returns an array of the enumerable own property names */
+refValue *
+own_keys(refRuntime *rt, refValue *val, bool hooks)
+{
+  size_t i;
+
+  if (hooks && HAS_HOOK(val, enumerate)) {
+    refValue *res = NULL;
+    switch (hook_property(rt, val, natusPropertyActionEnumerate, NULL, NULL, &res)) {
+    case refHookIntercept:
+      if (IS_OBJECT(res) && OBJ(res)->cls == refClassArray)
+        return res;
+      decref(rt, res);
+      return throw_error(rt, refProtoTypeError, "Enumeration did not return an array");
+    case refHookException:
+      return NULL;
+    default:
+      break;
+    }
+  }
+
+  refValue *arr = array_new(rt, 0, NULL);
+  if (!arr)
+    return NULL;
+
+  refObject *obj = OBJ(val);
+  if (obj->cls == refClassArray) {
+    for (i = 0; i < obj->nitems; i++) {
+      if (!obj->items[i])
+        continue;
+      refValue *k = index_to_string(rt, i);
+      if (!k || !array_push(rt, OBJ(arr), k)) {
+        decref(rt, k);
+        decref(rt, arr);
+        return NULL;
+      }
+      decref(rt, k);
+    }
+  }
+
+  for (i = 0; i < obj->nprops; i++)
+    if (!(obj->props[i].attrs & natusPropAttrDontEnum))
+      if (!array_push(rt, OBJ(arr), obj->props[i].key)) {
+        decref(rt, arr);
+        return NULL;
+      }
+
+  return arr;
+}
+
+/*
+ * Conversions
+ */
+
+bool
+to_boolean(const refValue *val)
+{
+  switch (val->kind) {
+  case refKindUndefined:
+  case refKindNull:
+    return false;
+  case refKindBoolean:
+    return val->u.boolean;
+  case refKindNumber:
+    return !(val->u.number == 0 || isnan(val->u.number));
+  case refKindString:
+    return val->u.string.len > 0;
+  default:
+    return true;
+  }
+}
+
+refValue *
+to_primitive(refRuntime *rt, refValue *val, bool string)
+{
+  refValue *names[2];
+  int i;
+
+  if (!IS_OBJECT(val))
+    return incref(val);
+
+  names[0] = string ? rt->s_toString : rt->s_valueOf;
+  names[1] = string ? rt->s_valueOf : rt->s_toString;
+  for (i = 0; i < 2; i++) {
+    refValue *fnc = get_named(rt, val, names[i]);
+    if (!fnc)
+      return NULL;
+    if (is_callable(fnc)) {
+      refValue *res = call_function(rt, fnc, val, 0, NULL);
+      decref(rt, fnc);
+      if (!res)
+        return NULL;
+      if (!IS_OBJECT(res))
+        return res;
+      decref(rt, res);
+    } else
+      decref(rt, fnc);
+  }
+
+  return throw_error(rt, refProtoTypeError, "Cannot convert object to primitive value");
+}
+
+refValue *
+to_string(refRuntime *rt, refValue *val)
+{
+  switch (val->kind) {
+  case refKindUndefined:
+    return mkstring(rt, "undefined");
+  case refKindNull:
+    return mkstring(rt, "null");
+  case refKindBoolean:
+    return mkstring(rt, val->u.boolean ? "true" : "false");
+  case refKindNumber:
+    return number_to_string(rt, val->u.number);
+  case refKindString:
+    return incref(val);
+  default: {
+    refValue *prim = to_primitive(rt, val, true);
+    if (!prim)
+      return NULL;
+    refValue *res = to_string(rt, prim);
+    decref(rt, prim);
+    return res;
+  }
+  }
+}
+
+/* Returns false if an exception is pending */
+bool
+to_number(refRuntime *rt, refValue *val, double *d)
+{
+  switch (val->kind) {
+  case refKindUndefined:
+    *d = NAN;
+    return true;
+  case refKindNull:
+    *d = 0;
+    return true;
+  case refKindBoolean:
+    *d = val->u.boolean ? 1 : 0;
+    return true;
+  case refKindNumber:
+    *d = val->u.number;
+    return true;
+  case refKindString:
+    *d = string_to_number(val);
+    return true;
+  default: {
+    refValue *prim = to_primitive(rt, val, false);
+    if (!prim)
+      return false;
+    bool res = to_number(rt, prim, d);
+    decref(rt, prim);
+    return res;
+  }
+  }
+}
+
+bool
+strict_equal(const refValue *a, const refValue *b)
+{
+  if (a->kind != b->kind)
+    return false;
+
+  switch (a->kind) {
+  case refKindUndefined:
+  case refKindNull:
+    return true;
+  case refKindBoolean:
+    return a->u.boolean == b->u.boolean;
+  case refKindNumber:
+    return a->u.number == b->u.number;
+  case refKindString:
+    return string_equal(a, b);
+  default:
+    return a == b;
+  }
+}
+
+/* Returns -1 if an exception is pending */
+int
+loose_equal(refRuntime *rt, refValue *a, refValue *b)
+{
+  double x, y;
+
+  if (a->kind == b->kind)
+    return strict_equal(a, b);
+  if ((a->kind == refKindUndefined || a->kind == refKindNull)
+      && (b->kind == refKindUndefined || b->kind == refKindNull))
+    return true;
+  if (a->kind == refKindUndefined || a->kind == refKindNull
+      || b->kind == refKindUndefined || b->kind == refKindNull)
+    return false;
+
+  if (IS_OBJECT(a) || IS_OBJECT(b)) {
+    refValue *pa = to_primitive(rt, a, false);
+    if (!pa)
+      return -1;
+    refValue *pb = to_primitive(rt, b, false);
+    if (!pb) {
+      decref(rt, pa);
+      return -1;
+    }
+    int res = loose_equal(rt, pa, pb);
+    decref(rt, pa);
+    decref(rt, pb);
+    return res;
+  }
+
+  to_number(rt, a, &x);
+  to_number(rt, b, &y);
+  return x == y;
+}
+
+const char *
+type_of(const refValue *val)
+{
+  switch (val->kind) {
+  case refKindUndefined:
+    return "undefined";
+  case refKindNull:
+    return "object";
+  case refKindBoolean:
+    return "boolean";
+  case refKindNumber:
+    return "number";
+  case refKindString:
+    return "string";
+  default:
+    return is_callable(val) ? "function" : "object";
+  }
+}
+
+/*
+ * Errors
+ */
+
+/* Supports %s (C string), %d and %S (string cell) */
+refValue *
+throw_error(refRuntime *rt, refProto type, const char *fmt, ...)
+{
+  char buf[512], *out = buf;
+  va_list ap;
+
+  va_start(ap, fmt);
+  for (; *fmt && out < buf + sizeof(buf) - 64; fmt++) {
+    if (*fmt != '%') {
+      *out++ = *fmt;
+      continue;
+    }
+
+    switch (*++fmt) {
+    case 's':
+      out += snprintf(out, buf + sizeof(buf) - 64 - out, "%s", va_arg(ap, const char *));
+      break;
+    case 'd':
+      out += sprintf(out, "%d", va_arg(ap, int));
+      break;
+    case 'S': {
+      refValue *str = va_arg(ap, refValue *);
+      size_t len;
+      char *tmp = str ? utf16_to_utf8(str->u.string.chars, str->u.string.len, &len) : NULL;
+      out += snprintf(out, buf + sizeof(buf) - 64 - out, "%s", tmp ? tmp : "");
+      free(tmp);
+      break;
+    }
+    default:
+      *out++ = *fmt;
+      break;
+    }
+    if (out > buf + sizeof(buf) - 64)
+      out = buf + sizeof(buf) - 64;
+  }
+  *out = '\0';
+  va_end(ap);
+
+  refValue *msg = mkstring(rt, buf);
+  refValue *exc = NULL;
+  if (msg) {
+    exc = construct(rt, rt->ctors[type], 1, &msg);
+    decref(rt, msg);
+  }
+
+  if (exc) {
+    decref(rt, rt->exception);
+    rt->exception = exc;
+  } else if (!rt->exception)
+    rt->exception = incref(rt->undefined);
+
+  return NULL;
+}
+
+/*
+ * Collector
+ *
+ * Reference counts free everything but cycles.  To find those, every
+ * reference one object holds on another is taken off the target's count:
+ * objects with some left are held from outside the graph, by natus, the
+ * runtime or a C frame.  Whatever can't be reached from those is garbage.
+ * Only run while no script or native hook is active, when every C frame
+ * holding an object is outside the engine.
+ */
+
+typedef struct {
+  refValue **items;
+  size_t     count;
+  size_t     size;
+  bool       failed;
+} refStack;
+
+static void
+stack_push(refStack *stack, refValue *val)
+{
+  if (stack->count == stack->size) {
+    size_t size = stack->size ? stack->size * 2 : 256;
+    refValue **tmp = realloc(stack->items, sizeof(refValue*) * size);
+    if (!tmp) {
+      stack->failed = true;
+      return;
+    }
+    stack->items = tmp;
+    stack->size = size;
+  }
+  stack->items[stack->count++] = val;
+}
+
+typedef void
+(*refVisit)(refValue *child, refStack *stack);
+
+static void
+object_visit(refObject *obj, refVisit visit, refStack *stack)
+{
+  size_t i;
+
+  visit(obj->proto, stack);
+  if (obj->global != &obj->base)
+    visit(obj->global, stack);
+  visit(obj->scope, stack);
+  for (i = 0; i < obj->nprops; i++)
+    visit(obj->props[i].value, stack);
+  for (i = 0; i < obj->nitems; i++)
+    visit(obj->items[i], stack);
+}
+
+static void
+visit_unref(refValue *child, refStack *stack)
+{
+  if (child && IS_OBJECT(child))
+    OBJ(child)->gcrefs--;
+}
+
+static void
+visit_reach(refValue *child, refStack *stack)
+{
+  if (child && IS_OBJECT(child) && !OBJ(child)->gcreached) {
+    OBJ(child)->gcreached = true;
+    stack_push(stack, child);
+  }
+}
+
+static void
+collect(refRuntime *rt)
+{
+  refStack stack = { NULL, 0, 0, false };
+  refValue *val;
+  size_t i;
+
+  rt->collecting = true;
+  for (val = rt->cells; val; val = val->next) {
+    if (IS_OBJECT(val)) {
+      OBJ(val)->gcrefs = val->refs;
+      OBJ(val)->gcreached = false;
+    }
+  }
+  for (val = rt->cells; val; val = val->next)
+    if (IS_OBJECT(val))
+      object_visit(OBJ(val), visit_unref, &stack);
+
+  /* Mark from the objects held from outside; out of memory, we can't
+   * tell what is garbage and try again later */
+  for (val = rt->cells; val; val = val->next)
+    if (IS_OBJECT(val) && OBJ(val)->gcrefs > 0)
+      visit_reach(val, &stack);
+  while (stack.count > 0 && !stack.failed)
+    object_visit(OBJ(stack.items[--stack.count]), visit_reach, &stack);
+
+  /* The rest is garbage: hold it while it is taken apart */
+  if (!stack.failed) {
+    for (val = rt->cells; val && !stack.failed; val = val->next)
+      if (IS_OBJECT(val) && !OBJ(val)->gcreached)
+        stack_push(&stack, incref(val));
+  }
+  if (stack.failed) {
+    for (i = 0; i < stack.count; i++)
+      stack.items[i]->refs--;
+    stack.count = 0;
+  }
+
+  for (i = 0; i < stack.count; i++) {
+    refObject *obj = OBJ(stack.items[i]);
+    if (obj->priv) {
+      natusPrivate *priv = obj->priv;
+      obj->priv = NULL;
+      rt->callouts++;
+      natus_private_free(priv);
+      rt->callouts--;
+    }
+  }
+  for (i = 0; i < stack.count; i++)
+    object_clear(rt, OBJ(stack.items[i]));
+  for (i = 0; i < stack.count; i++)
+    decref(rt, stack.items[i]);
+
+  free(stack.items);
+  rt->gcnext = rt->objects * 2 > REF_GC_MINIMUM ? rt->objects * 2 : REF_GC_MINIMUM;
+  rt->collecting = false;
+}
+
+/* Called as natus enters the engine, so no C frame inside it is active */
+static void
+maybe_collect(refRuntime *rt)
+{
+  if (rt->objects >= rt->gcnext && !rt->depth && !rt->callouts && !rt->collecting)
+    collect(rt);
+}
+
+/*
+ * Runtime
+ */
+
+static void
+ref_ctx_free(natusEngCtx ctx);
+
+static refRuntime *
+runtime_new(void)
+{
+  refRuntime *rt = calloc(1, sizeof(refRuntime));
+  if (!rt)
+    return NULL;
+  rt->gcnext = REF_GC_MINIMUM;
+
+  if (!(rt->undefined = cell_new(rt, refKindUndefined, sizeof(refValue)))
+      || !(rt->null = cell_new(rt, refKindNull, sizeof(refValue)))
+      || !(rt->yes = cell_new(rt, refKindBoolean, sizeof(refValue)))
+      || !(rt->no = cell_new(rt, refKindBoolean, sizeof(refValue))))
+    goto error;
+  rt->yes->u.boolean = true;
+
+  if (!(rt->s_length = mkstring(rt, "length"))
+      || !(rt->s_prototype = mkstring(rt, "prototype"))
+      || !(rt->s_constructor = mkstring(rt, "constructor"))
+      || !(rt->s_message = mkstring(rt, "message"))
+      || !(rt->s_name = mkstring(rt, "name"))
+      || !(rt->s_toString = mkstring(rt, "toString"))
+      || !(rt->s_valueOf = mkstring(rt, "valueOf"))
+      || !(rt->s_arguments = mkstring(rt, "arguments")))
+    goto error;
+
+  if (!realm_init(rt))
+    goto error;
+  return rt;
+
+error:
+  ref_ctx_free(rt);
+  return NULL;
+}
+
+/* Hands a result (or the pending exception) back to natus */
+static refValue *
+retval(refRuntime *rt, refValue *val, natusEngValFlags *flags)
+{
+  *flags = natusEngValFlagUnlock;
+  if (val)
+    return val;
+
+  *flags |= natusEngValFlagException;
+  val = rt->exception;
+  rt->exception = NULL;
+  return val;
+}
+
+/*
+ * Engine interface
+ */
+
+static void
+ref_ctx_free(natusEngCtx ctx)
+{
+  refValue *val, *next;
+
+  if (!ctx)
+    return;
+
+  /* Run every finalizer while the heap is still intact, then tear the
+   * whole thing down without bothering with reference counts. */
+  ctx->dying = true;
+  for (val = ctx->cells; val; val = val->next) {
+    if (val->kind == refKindObject && OBJ(val)->priv) {
+      natusPrivate *priv = OBJ(val)->priv;
+      OBJ(val)->priv = NULL;
+      natus_private_free(priv);
+    }
+  }
+  for (val = ctx->cells; val; val = val->next)
+    if (val->kind == refKindObject)
+      object_clear(ctx, OBJ(val));
+  for (val = ctx->cells; val; val = next) {
+    next = val->next;
+    if (val->kind == refKindString)
+      free(val->u.string.chars);
+    free(val);
+  }
+
+  free(ctx);
+}
+
+static void
+ref_val_unlock(natusEngCtx ctx, natusEngVal val)
+{
+  decref(ctx, val);
+}
+
+static natusEngVal
+ref_val_duplicate(natusEngCtx ctx, natusEngVal val)
+{
+  return incref(val);
+}
+
+static void
+ref_val_free(natusEngVal val)
+{
+
+}
+
+static natusEngVal
+ref_new_global(natusEngCtx ctx, natusEngVal val, natusPrivate *priv, natusEngCtx *newctx, natusEngValFlags *flags)
+{
+  refRuntime *rt = ctx ? ctx : runtime_new();
+  *newctx = rt;
+  *flags = natusEngValFlagNone;
+  if (!rt) {
+    natus_private_free(priv);
+    return NULL;
+  }
+
+  /* Globals refer to themselves without holding a reference */
+  refValue *saved = rt->global;
+  rt->global = NULL;
+  refValue *glb = object_new(rt, refClassGlobal, rt->protos[refProtoObject]);
+  if (!glb) {
+    rt->global = saved;
+    goto error;
+  }
+  OBJ(glb)->global = glb;
+  OBJ(glb)->priv = priv;
+
+  rt->global = glb;
+  bool ok = global_init(rt, glb);
+  rt->global = saved;
+  if (!ok) {
+    decref(rt, glb);
+    if (!ctx)
+      ref_ctx_free(rt);
+    *newctx = NULL;
+    return NULL;
+  }
+
+  /* The first global is the fallback for code running without one */
+  if (!rt->global)
+    rt->global = incref(glb);
+
+  *flags = natusEngValFlagUnlock;
+  return glb;
+
+error:
+  natus_private_free(priv);
+  if (!ctx) {
+    ref_ctx_free(rt);
+    *newctx = NULL;
+  }
+  return NULL;
+}
+
+static natusEngVal
+ref_new_bool(const natusEngCtx ctx, bool b, natusEngValFlags *flags)
+{
+  return retval(ctx, mkbool(ctx, b), flags);
+}
+
+static natusEngVal
+ref_new_number(const natusEngCtx ctx, double n, natusEngValFlags *flags)
+{
+  return retval(ctx, mknumber(ctx, n), flags);
+}
+
+static natusEngVal
+ref_new_string_utf8(const natusEngCtx ctx, const char *str, size_t len, natusEngValFlags *flags)
+{
+  return retval(ctx, mkstring_utf8(ctx, str, len), flags);
+}
+
+static natusEngVal
+ref_new_string_utf16(const natusEngCtx ctx, const natusChar *str, size_t len, natusEngValFlags *flags)
+{
+  return retval(ctx, mkstring_utf16(ctx, str, len), flags);
+}
+
+// Strings here own their characters, so these copy
+static natusEngVal
+ref_new_string_external_utf8(const natusEngCtx ctx, const char *str, size_t len, natusFreeFunction freefnc, natusEngValFlags *flags)
+{
+  natusEngVal ret = ref_new_string_utf8(ctx, str, len, flags);
+  if (freefnc)
+    freefnc((void *) str);
+  return ret;
+}
+
+static natusEngVal
+ref_new_string_external_utf16(const natusEngCtx ctx, const natusChar *str, size_t len, natusFreeFunction freefnc, natusEngValFlags *flags)
+{
+  natusEngVal ret = ref_new_string_utf16(ctx, str, len, flags);
+  if (freefnc)
+    freefnc((void *) str);
+  return ret;
+}
+
+static natusEngVal
+ref_new_array(const natusEngCtx ctx, const natusEngVal *array, size_t len, natusEngValFlags *flags)
+{
+  maybe_collect(ctx);
+  return retval(ctx, array_new(ctx, len, (refValue**) array), flags);
+}
+
+static natusEngVal
+ref_new_array_doubles(const natusEngCtx ctx, const double *array, size_t len, natusEngValFlags *flags)
+{
+  maybe_collect(ctx);
+  refValue *arr = array_new(ctx, len, NULL);
+  for (size_t i = 0; arr && i < len; i++) {
+    if (!(OBJ(arr)->items[i] = mknumber(ctx, array[i]))) {
+      decref(ctx, arr);
+      arr = NULL;
+    }
+  }
+  return retval(ctx, arr, flags);
+}
+
+static natusEngVal
+ref_new_function(const natusEngCtx ctx, const char *name, natusPrivate *priv, natusEngValFlags *flags)
+{
+  maybe_collect(ctx);
+  refValue *fnc = object_new(ctx, refClassFunction, ctx->protos[refProtoFunction]);
+  if (!fnc) {
+    natus_private_free(priv);
+    return retval(ctx, NULL, flags);
+  }
+  OBJ(fnc)->priv = priv;
+
+  refValue *nm = mkstring(ctx, name ? name : "");
+  refValue *proto = object_new_plain(ctx);
+  if (!nm || !proto
+      || !prop_put(ctx, OBJ(fnc), ctx->s_name, nm, natusPropAttrProtected)
+      || !prop_put(ctx, OBJ(fnc), ctx->s_prototype, proto, natusPropAttrDontEnum | natusPropAttrDontDelete)
+      || !prop_put(ctx, OBJ(proto), ctx->s_constructor, fnc, natusPropAttrDontEnum)) {
+    decref(ctx, nm);
+    decref(ctx, proto);
+    decref(ctx, fnc);
+    return retval(ctx, NULL, flags);
+  }
+  decref(ctx, nm);
+  decref(ctx, proto);
+
+  return retval(ctx, fnc, flags);
+}
+
+static natusEngVal
+ref_new_object(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, natusEngValFlags *flags)
+{
+  maybe_collect(ctx);
+  refValue *obj = object_new_plain(ctx);
+  if (!obj) {
+    natus_private_free(priv);
+    return retval(ctx, NULL, flags);
+  }
+
+  OBJ(obj)->priv = priv;
+  OBJ(obj)->hooks = cls;
+  return retval(ctx, obj, flags);
+}
+
+/* The bytes are served by the buffer class hooks */
+static natusEngVal
+ref_new_buffer(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, void *data, size_t len, natusEngValFlags *flags)
+{
+  maybe_collect(ctx);
+  refValue *obj = object_new(ctx, refClassBuffer, ctx->protos[refProtoObject]);
+  if (!obj) {
+    natus_private_free(priv);
+    return retval(ctx, NULL, flags);
+  }
+
+  OBJ(obj)->priv = priv;
+  OBJ(obj)->hooks = cls;
+  return retval(ctx, obj, flags);
+}
+
+static natusEngVal
+ref_new_null(const natusEngCtx ctx, natusEngValFlags *flags)
+{
+  return retval(ctx, incref(ctx->null), flags);
+}
+
+static natusEngVal
+ref_new_undefined(const natusEngCtx ctx, natusEngValFlags *flags)
+{
+  return retval(ctx, incref(ctx->undefined), flags);
+}
+
+static bool
+ref_to_bool(const natusEngCtx ctx, const natusEngVal val)
+{
+  return to_boolean(val);
+}
+
+static double
+ref_to_double(const natusEngCtx ctx, const natusEngVal val)
+{
+  double d;
+  if (to_number(ctx, val, &d))
+    return d;
+
+  decref(ctx, ctx->exception);
+  ctx->exception = NULL;
+  return NAN;
+}
+
+static bool
+ref_to_doubles(const natusEngCtx ctx, const natusEngVal val, double *array, size_t len)
+{
+  refObject *o = IS_OBJECT(val) ? OBJ(val) : NULL;
+
+  for (size_t i = 0; i < len; i++) {
+    /* Dense items are read in place, holes and the rest take a lookup */
+    if (o && o->cls == refClassArray && !o->priv && i < o->nitems && o->items[i]) {
+      if (to_number(ctx, o->items[i], &array[i]))
+        continue;
+    } else {
+      refKey key;
+      key_init_index(&key, i);
+      refValue *item = get_key(ctx, val, &key);
+      key_free(ctx, &key);
+
+      bool ok = item && to_number(ctx, item, &array[i]);
+      decref(ctx, item);
+      if (ok)
+        continue;
+    }
+
+    decref(ctx, ctx->exception);
+    ctx->exception = NULL;
+    return false;
+  }
+  return true;
+}
+
+static char *
+ref_to_string_utf8(const natusEngCtx ctx, const natusEngVal val, size_t *len)
+{
+  refValue *str = to_string(ctx, val);
+  if (!str) {
+    decref(ctx, ctx->exception);
+    ctx->exception = NULL;
+    return NULL;
+  }
+
+  char *res = utf16_to_utf8(str->u.string.chars, str->u.string.len, len);
+  decref(ctx, str);
+  return res;
+}
+
+static natusChar *
+ref_to_string_utf16(const natusEngCtx ctx, const natusEngVal val, size_t *len)
+{
+  refValue *str = to_string(ctx, val);
+  if (!str) {
+    decref(ctx, ctx->exception);
+    ctx->exception = NULL;
+    return NULL;
+  }
+
+  natusChar *res = malloc(sizeof(natusChar) * (str->u.string.len + 1));
+  if (res) {
+    memcpy(res, str->u.string.chars, sizeof(natusChar) * str->u.string.len);
+    res[str->u.string.len] = 0;
+    *len = str->u.string.len;
+  }
+  decref(ctx, str);
+  return res;
+}
+
+static size_t
+ref_to_string_utf8_buffer(const natusEngCtx ctx, const natusEngVal val, char *buf, size_t size)
+{
+  refValue *str = to_string(ctx, val);
+  if (!str) {
+    decref(ctx, ctx->exception);
+    ctx->exception = NULL;
+    return (size_t) -1;
+  }
+
+  size_t written;
+  size_t len = utf16_write_utf8(str->u.string.chars, str->u.string.len,
+                                buf, size > 0 ? size - 1 : 0, &written);
+  if (size > 0)
+    buf[written] = '\0';
+  decref(ctx, str);
+  return len;
+}
+
+static size_t
+ref_to_string_utf16_range(const natusEngCtx ctx, const natusEngVal val, size_t offset, natusChar *buf, size_t size)
+{
+  refValue *str = to_string(ctx, val);
+  if (!str) {
+    decref(ctx, ctx->exception);
+    ctx->exception = NULL;
+    return (size_t) -1;
+  }
+
+  size_t len = str->u.string.len;
+  if (offset >= len)
+    size = 0;
+  else if (size > len - offset)
+    size = len - offset;
+  if (size > 0)
+    memcpy(buf, str->u.string.chars + offset, sizeof(natusChar) * size);
+  decref(ctx, str);
+  return size;
+}
+
+static const natusChar *
+ref_string_view(const natusEngCtx ctx, const natusEngVal val, size_t *len, void **token)
+{
+  refValue *str = to_string(ctx, val);
+  if (!str) {
+    decref(ctx, ctx->exception);
+    ctx->exception = NULL;
+    return NULL;
+  }
+
+  // The token holds the string until it is released
+  *token = str;
+  *len = str->u.string.len;
+  return str->u.string.chars;
+}
+
+static void
+ref_string_release(const natusEngCtx ctx, void *token)
+{
+  decref(ctx, token);
+}
+
+static natusEngVal
+ref_del(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, natusEngValFlags *flags)
+{
+  refValue *res = NULL;
+  refKey key;
+
+  if (key_init(ctx, &key, id)) {
+    res = del_key(ctx, val, &key);
+    key_free(ctx, &key);
+  }
+  return retval(ctx, res, flags);
+}
+
+static natusEngVal
+ref_get(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, natusEngValFlags *flags)
+{
+  refValue *res = NULL;
+  refKey key;
+
+  if (key_init(ctx, &key, id)) {
+    res = get_key(ctx, val, &key);
+    key_free(ctx, &key);
+  }
+  return retval(ctx, res, flags);
+}
+
+static natusEngVal
+ref_set(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, const natusEngVal value, natusPropAttr attrs, natusEngValFlags *flags)
+{
+  refValue *res = NULL;
+  refKey key;
+
+  if (key_init(ctx, &key, id)) {
+    if (put_key(ctx, val, &key, value, attrs, true))
+      res = mkbool(ctx, true);
+    key_free(ctx, &key);
+  }
+  return retval(ctx, res, flags);
+}
+
+static natusEngVal
+ref_get_index(const natusEngCtx ctx, natusEngVal val, uint32_t idx, natusEngValFlags *flags)
+{
+  refKey key;
+  key_init_index(&key, idx);
+  refValue *res = get_key(ctx, val, &key);
+  key_free(ctx, &key);
+  return retval(ctx, res, flags);
+}
+
+static natusEngVal
+ref_set_index(const natusEngCtx ctx, natusEngVal val, uint32_t idx, const natusEngVal value, natusEngValFlags *flags)
+{
+  refValue *res = NULL;
+  refKey key;
+
+  key_init_index(&key, idx);
+  if (put_key(ctx, val, &key, value, natusPropAttrNone, true))
+    res = mkbool(ctx, true);
+  key_free(ctx, &key);
+  return retval(ctx, res, flags);
+}
+
+static natusEngVal
+ref_enumerate(const natusEngCtx ctx, natusEngVal val, natusEngValFlags *flags)
+{
+  if (!IS_OBJECT(val))
+    return retval(ctx, array_new(ctx, 0, NULL), flags);
+  return retval(ctx, own_keys(ctx, val, true), flags);
+}
+
+static natusEngVal
+ref_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal args, natusEngValFlags *flags)
+{
+  refValue **argv = NULL;
+  size_t argc = 0, i;
+
+  maybe_collect(ctx);
+
+  if (!IS_OBJECT(args) || OBJ(args)->cls != refClassArray)
+    return retval(ctx, throw_error(ctx, refProtoTypeError, "Arguments must be an array"), flags);
+
+  /* Holes become undefined */
+  argc = OBJ(args)->nitems;
+  if (argc > 0 && !(argv = malloc(sizeof(refValue*) * argc)))
+    return retval(ctx, throw_error(ctx, refProtoRangeError, "Out of memory"), flags);
+  for (i = 0; i < argc; i++)
+    argv[i] = incref(OBJ(args)->items[i] ? OBJ(args)->items[i] : ctx->undefined);
+
+  refValue *res;
+  if (ths->kind == refKindUndefined)
+    res = construct(ctx, func, argc, argv);
+  else
+    res = call_function(ctx, func, ths, argc, argv);
+
+  for (i = 0; i < argc; i++)
+    decref(ctx, argv[i]);
+  free(argv);
+  return retval(ctx, res, flags);
+}
+
+static natusEngVal
+ref_call_argv(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, size_t argc, const natusEngVal *argv, natusEngValFlags *flags)
+{
+  maybe_collect(ctx);
+  refValue *res;
+  if (ths->kind == refKindUndefined)
+    res = construct(ctx, func, argc, (refValue**) argv);
+  else
+    res = call_function(ctx, func, ths, argc, (refValue**) argv);
+  return retval(ctx, res, flags);
+}
+
+static natusEngVal
+ref_evaluate(const natusEngCtx ctx, natusEngVal ths, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno, natusEngValFlags *flags)
+{
+  maybe_collect(ctx);
+  refValue *src = to_string(ctx, jscript);
+  if (!src)
+    return retval(ctx, NULL, flags);
+
+  refProgram *prg = program_parse(ctx, src->u.string.chars, src->u.string.len, lineno);
+  decref(ctx, src);
+  if (!prg)
+    return retval(ctx, NULL, flags);
+
+  refValue *glb = IS_OBJECT(ths) && OBJ(ths)->global ? OBJ(ths)->global : ctx->global;
+  refValue *res = program_run(ctx, prg, glb, ths);
+  program_decref(prg);
+  return retval(ctx, res, flags);
+}
+
+/* A compiled script is an object holding the parsed program */
+static natusEngVal
+ref_compile(const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno, natusEngValFlags *flags)
+{
+  refValue *src = to_string(ctx, jscript);
+  if (!src)
+    return retval(ctx, NULL, flags);
+
+  refProgram *prg = program_parse(ctx, src->u.string.chars, src->u.string.len, lineno);
+  decref(ctx, src);
+  if (!prg)
+    return retval(ctx, NULL, flags);
+
+  refValue *obj = object_new(ctx, refClassScript, ctx->protos[refProtoObject]);
+  if (!obj) {
+    program_decref(prg);
+    return retval(ctx, NULL, flags);
+  }
+
+  OBJ(obj)->program = prg;
+  return retval(ctx, obj, flags);
+}
+
+static natusEngVal
+ref_run(const natusEngCtx ctx, natusEngVal ths, const natusEngVal script, natusEngValFlags *flags)
+{
+  maybe_collect(ctx);
+  if (!IS_OBJECT(script) || OBJ(script)->cls != refClassScript || !OBJ(script)->program)
+    return retval(ctx, throw_error(ctx, refProtoTypeError, "Not a compiled script"), flags);
+
+  refValue *glb = IS_OBJECT(ths) && OBJ(ths)->global ? OBJ(ths)->global : ctx->global;
+  return retval(ctx, program_run(ctx, OBJ(script)->program, glb, ths), flags);
+}
+
+/* Programs are only kept as their source, which is what gets saved; this
+ * is no faster than compiling, but takes callers down the same paths */
+#define REF_SAVED_MAGIC "natusRF" /* 8 bytes, keeping the source aligned */
+
+static void *
+ref_serialize(const natusEngCtx ctx, const natusEngVal script, size_t *len)
+{
+  if (!IS_OBJECT(script) || OBJ(script)->cls != refClassScript || !OBJ(script)->program)
+    return NULL;
+
+  refProgram *prg = OBJ(script)->program;
+  size_t size = sizeof(REF_SAVED_MAGIC) + sizeof(natusChar) * prg->length;
+  char *data = malloc(size);
+  if (!data)
+    return NULL;
+
+  memcpy(data, REF_SAVED_MAGIC, sizeof(REF_SAVED_MAGIC));
+  memcpy(data + sizeof(REF_SAVED_MAGIC), prg->source, sizeof(natusChar) * prg->length);
+  *len = size;
+  return data;
+}
+
+static natusEngVal
+ref_deserialize(const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno,
+                const void *data, size_t len, natusEngValFlags *flags)
+{
+  if (len < sizeof(REF_SAVED_MAGIC) || memcmp(data, REF_SAVED_MAGIC, sizeof(REF_SAVED_MAGIC))
+      || (len - sizeof(REF_SAVED_MAGIC)) % sizeof(natusChar))
+    return NULL;
+
+  const natusChar *src = (const natusChar *) ((const char *) data + sizeof(REF_SAVED_MAGIC));
+  refProgram *prg = program_parse(ctx, src, (len - sizeof(REF_SAVED_MAGIC)) / sizeof(natusChar), lineno);
+  if (!prg) {
+    decref(ctx, ctx->exception);
+    ctx->exception = NULL;
+    return NULL;
+  }
+
+  refValue *obj = object_new(ctx, refClassScript, ctx->protos[refProtoObject]);
+  if (!obj) {
+    program_decref(prg);
+    return retval(ctx, NULL, flags);
+  }
+
+  OBJ(obj)->program = prg;
+  return retval(ctx, obj, flags);
+}
+
+static natusPrivate *
+ref_get_private(const natusEngCtx ctx, const natusEngVal val)
+{
+  if (!IS_OBJECT(val))
+    return NULL;
+  return OBJ(val)->priv;
+}
+
+static natusEngVal
+ref_get_global(const natusEngCtx ctx, const natusEngVal val, natusEngValFlags *flags)
+{
+  *flags &= ~(natusEngValFlagFree | natusEngValFlagUnlock);
+  if (IS_OBJECT(val) && OBJ(val)->global)
+    return OBJ(val)->global;
+  return ctx->global;
+}
+
+static natusValueType
+ref_get_type(const natusEngCtx ctx, const natusEngVal val)
+{
+  switch (val->kind) {
+  case refKindBoolean:
+    return natusValueTypeBoolean;
+  case refKindNull:
+    return natusValueTypeNull;
+  case refKindNumber:
+    return natusValueTypeNumber;
+  case refKindString:
+    return natusValueTypeString;
+  case refKindObject:
+    break;
+  default:
+    return natusValueTypeUndefined;
+  }
+
+  if (OBJ(val)->cls == refClassBuffer)
+    return natusValueTypeBuffer;
+
+  /* Classes may be callable, but they are still objects */
+  if (OBJ(val)->hooks)
+    return natusValueTypeObject;
+  if (OBJ(val)->cls == refClassArray)
+    return natusValueTypeArray;
+  if (is_callable(val))
+    return natusValueTypeFunction;
+  return natusValueTypeObject;
+}
+
+static bool
+ref_borrow_context(natusEngCtx ctx, natusEngVal val, void **context, void **value)
+{
+  *context = (void*) ctx;
+  *value = (void*) val;
+  return true;
+}
+
+static bool
+ref_equal(const natusEngCtx ctx, const natusEngVal val1, const natusEngVal val2, bool strict)
+{
+  if (strict)
+    return strict_equal(val1, val2);
+
+  bool res = loose_equal(ctx, val1, val2);
+  if (ctx->exception) {
+    decref(ctx, ctx->exception);
+    ctx->exception = NULL;
+  }
+  return res;
+}
+
+/* The symbol is never defined anywhere, so this engine is only picked when
+ * nothing else is available (or when it is requested by name). */
+static uintptr_t
+ref_identity(const natusEngCtx ctx, const natusEngVal val)
+{
+  return (uintptr_t) val;
+}
+
+NATUS_ENGINE("Reference", "natus_reference_engine", natusEngineFlagThreadSafe, ref);
@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2010 Nathaniel McCallum <nathaniel@natemccallum.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* Shared by the two halves of the Reference engine: Reference.c, the
+ * values, objects and the engine interface, and ReferenceScript.c, which
+ * parses and runs scripts. Only the engine spec is exported. */
+
+#ifndef REFERENCE_H_
+#define REFERENCE_H_
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct refRuntime refRuntime;
+typedef struct refValue refValue;
+typedef refRuntime* natusEngCtx;
+typedef refValue* natusEngVal;
+#define NATUS_ENGINE_TYPES_DEFINED
+#define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
+#include <natus-engine.h>
+
+#define REF_HASH_MINIMUM 8
+#define REF_MAX_DEPTH    512
+#define REF_GC_MINIMUM   4096
+
+typedef enum {
+  refKindUndefined,
+  refKindNull,
+  refKindBoolean,
+  refKindNumber,
+  refKindString,
+  refKindObject
+} refKind;
+
+typedef enum {
+  refClassObject,
+  refClassArray,
+  refClassFunction,
+  refClassError,
+  refClassGlobal,
+  refClassScope,
+  refClassBuffer,
+  refClassScript
+} refClass;
+
+typedef enum {
+  refProtoObject,
+  refProtoFunction,
+  refProtoArray,
+  refProtoString,
+  refProtoError,
+  refProtoRangeError,
+  refProtoReferenceError,
+  refProtoSyntaxError,
+  refProtoTypeError,
+  refProtoCount
+} refProto;
+
+typedef struct refNode refNode;
+typedef struct refProgram refProgram;
+
+typedef refValue *
+(*refBuiltin)(refRuntime *rt, refValue *fnc, refValue *ths,
+              size_t argc, refValue **argv, bool construct);
+
+struct refValue {
+  refValue *prev;
+  refValue *next;
+  size_t    refs;
+  refKind   kind;
+  union {
+    bool    boolean;
+    double  number;
+    struct {
+      natusChar *chars;
+      size_t     len;
+      uint32_t   hash;
+    } string;
+  } u;
+};
+
+typedef struct {
+  refValue *key;
+  refValue *value;
+  unsigned  attrs;
+} refProperty;
+
+typedef struct {
+  refValue      base;
+  refClass      cls;
+  refValue     *proto;
+  refValue     *global;
+  refProperty  *props;
+  size_t        nprops;
+  size_t        aprops;
+  size_t       *index;
+  size_t        nindex;
+  refValue    **items;
+  size_t        nitems;
+  size_t        aitems;
+  natusPrivate *priv;
+  natusClass   *hooks;
+  refBuiltin    builtin;
+  refNode      *func;
+  refProgram   *program;
+  refValue     *scope;
+  size_t        gcrefs;    /* References from outside the object graph */
+  bool          gcreached;
+} refObject;
+
+struct refRuntime {
+  refValue     *cells;
+  bool          dying;
+  unsigned      depth;
+  unsigned      callouts;   /* Native hooks and functions running */
+  bool          collecting;
+  size_t        objects;
+  size_t        gcnext;     /* Collect once there are this many objects */
+
+  refValue     *undefined;
+  refValue     *null;
+  refValue     *yes;
+  refValue     *no;
+  refValue     *exception;
+  refValue     *global;
+
+  refValue     *protos[refProtoCount];
+  refValue     *ctors[refProtoCount];
+  refValue     *json;
+
+  refValue     *s_length;
+  refValue     *s_prototype;
+  refValue     *s_constructor;
+  refValue     *s_message;
+  refValue     *s_name;
+  refValue     *s_toString;
+  refValue     *s_valueOf;
+  refValue     *s_arguments;
+};
+
+#define OBJ(v)       ((refObject*) (v))
+#define IS_OBJECT(v) ((v)->kind == refKindObject)
+#define IS_STRING(v) ((v)->kind == refKindString)
+#define IS_NUMBER(v) ((v)->kind == refKindNumber)
+
+typedef struct refArena refArena;
+
+struct refProgram {
+  size_t      refs;
+  refRuntime *rt;
+  refArena   *arena;
+  natusChar  *source;
+  size_t      length;
+  refValue  **cells;
+  size_t      ncells;
+  size_t      acells;
+  refNode    *root;
+};
+
+typedef struct {
+  refValue *orig;    /* The key as it was given, NULL for bare indexes */
+  refValue *string;  /* The key as a string, if already known */
+  refValue *number;  /* Made for native hooks from a bare index */
+  uint32_t  index;
+  bool      isindex;
+} refKey;
+
+void
+decref(refRuntime *rt, refValue *val);
+
+refValue *
+mknumber(refRuntime *rt, double n);
+
+uint32_t
+chars_hash(const natusChar *chars, size_t len);
+
+refValue *
+mkstring_take(refRuntime *rt, natusChar *chars, size_t len);
+
+refValue *
+mkstring_utf16(refRuntime *rt, const natusChar *str, size_t len);
+
+refValue *
+mkstring_utf8(refRuntime *rt, const char *str, size_t len);
+
+refValue *
+string_concat(refRuntime *rt, const refValue *a, const refValue *b);
+
+int
+string_compare(const refValue *a, const refValue *b);
+
+refValue *
+number_to_string(refRuntime *rt, double d);
+
+bool
+is_space(natusChar c);
+
+bool
+string_to_index(const refValue *str, uint32_t *index);
+
+refValue *
+object_new(refRuntime *rt, refClass cls, refValue *proto);
+
+size_t
+prop_find(const refObject *obj, const refValue *key);
+
+bool
+prop_put(refRuntime *rt, refObject *obj, refValue *key, refValue *value, unsigned attrs);
+
+bool
+prop_put_ascii(refRuntime *rt, refValue *obj, const char *name, refValue *value, unsigned attrs);
+
+bool
+array_push(refRuntime *rt, refObject *obj, refValue *value);
+
+refValue *
+array_new(refRuntime *rt, size_t len, refValue **items);
+
+bool
+key_init(refRuntime *rt, refKey *key, refValue *val);
+
+void
+key_free(refRuntime *rt, refKey *key);
+
+refValue *
+own_lookup(refRuntime *rt, refValue *obj, refKey *key);
+
+refValue *
+get_property(refRuntime *rt, refValue *val, refValue *id);
+
+refValue *
+get_named(refRuntime *rt, refValue *val, refValue *name);
+
+bool
+put_property(refRuntime *rt, refValue *val, refValue *id, refValue *value);
+
+refValue *
+del_key(refRuntime *rt, refValue *val, refKey *key);
+
+refValue *
+own_keys(refRuntime *rt, refValue *val, bool hooks);
+
+bool
+to_boolean(const refValue *val);
+
+refValue *
+to_primitive(refRuntime *rt, refValue *val, bool string);
+
+refValue *
+to_string(refRuntime *rt, refValue *val);
+
+bool
+to_number(refRuntime *rt, refValue *val, double *d);
+
+bool
+strict_equal(const refValue *a, const refValue *b);
+
+int
+loose_equal(refRuntime *rt, refValue *a, refValue *b);
+
+const char *
+type_of(const refValue *val);
+
+refValue *
+throw_error(refRuntime *rt, refProto type, const char *fmt, ...);
+
+void
+program_decref(refProgram *prg);
+
+refProgram *
+program_parse(refRuntime *rt, const natusChar *src, size_t len, unsigned lineno);
+
+refValue *
+call_function(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv);
+
+refValue *
+construct(refRuntime *rt, refValue *fnc, size_t argc, refValue **argv);
+
+refValue *
+program_run(refRuntime *rt, refProgram *prg, refValue *global, refValue *ths);
+
+bool
+realm_init(refRuntime *rt);
+
+bool
+global_init(refRuntime *rt, refValue *glb);
+
+static inline refValue *
+incref(refValue *val)
+{
+  if (val)
+    val->refs++;
+  return val;
+}
+
+static inline refValue *
+mkbool(refRuntime *rt, bool b)
+{
+  return incref(b ? rt->yes : rt->no);
+}
+
+static inline refValue *
+mkstring(refRuntime *rt, const char *str)
+{
+  return mkstring_utf8(rt, str, strlen(str));
+}
+
+static inline refValue *
+object_new_plain(refRuntime *rt)
+{
+  return object_new(rt, refClassObject, rt->protos[refProtoObject]);
+}
+
+static inline bool
+has_hook(const refValue *obj, size_t offset)
+{
+  const refObject *o = OBJ(obj);
+  return o->hooks && o->priv && *(void**) ((char*) o->hooks + offset);
+}
+#define HAS_HOOK(obj, hook) has_hook(obj, offsetof(natusClass, hook))
+
+static inline bool
+is_callable(const refValue *val)
+{
+  return IS_OBJECT(val) && (OBJ(val)->cls == refClassFunction || HAS_HOOK(val, call));
+}
+
+#endif /* REFERENCE_H_ */
@@ -0,0 +1,2644 @@
+/*
+ * Copyright (c) 2010 Nathaniel McCallum <nathaniel@natemccallum.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * The script half of the Reference engine: a parser and tree walking
+ * interpreter for the subset of javascript the test suite and the
+ * benchmarks use: var, function, if, for, return and throw, the usual
+ * operators, and a handful of builtins (Object.keys, call/apply,
+ * push/pop/join/filter, charCodeAt, indexOf, split, toUpperCase, the errors
+ * and JSON.parse).
+ *
+ * The benchmarks alone would do with much less, but every native test and
+ * runjstest evaluate scripts, and this is what lets them run on a build
+ * box without SpiderMonkey, v8 or JavaScriptCore.  Nothing beyond what they
+ * use belongs here: this is not meant to become a javascript engine.
+ */
+
+#include "Reference.h"
+
+/*
+ * Programs
+ */
+
+typedef enum {
+  N_NUMBER, N_STRING, N_IDENT, N_THIS, N_TRUE, N_FALSE, N_NULL,
+  N_ARRAY, N_OBJECT, N_FUNCTION, N_DOT, N_INDEX, N_CALL, N_NEW,
+  N_UNARY, N_PREFIX, N_POSTFIX, N_BINARY, N_AND, N_OR, N_ASSIGN,
+  N_COMMA,
+  N_PROGRAM, N_VAR, N_EXPR, N_BLOCK, N_IF, N_FOR, N_RETURN, N_THROW,
+  N_EMPTY
+} refNodeType;
+
+enum {
+  P_LE = 256, P_GE, P_EQ, P_NE, P_SEQ, P_SNE, P_INC, P_DEC, P_AND, P_OR,
+  P_ADDA, P_SUBA, P_MULA, P_DIVA, P_MODA,
+  /* Keyword operators */
+  P_TYPEOF, P_DELETE
+};
+
+struct refNode {
+  refNodeType type;
+  int         op;
+  unsigned    line;
+  refValue   *value;    /* Literal or identifier/property name */
+  refNode    *a;
+  refNode    *b;
+  refNode    *c;
+  refNode    *d;
+  refNode   **list;
+  size_t      count;
+
+  /* Functions and programs */
+  refNode   **params;
+  size_t      nparams;
+  refNode   **vars;
+  size_t      nvars;
+  refNode   **funcs;
+  size_t      nfuncs;
+  bool        arguments;
+  size_t      start;
+  size_t      end;
+};
+
+struct refArena {
+  refArena *next;
+  size_t    used;
+  size_t    size;
+  char      data[];
+};
+
+static void *
+arena_alloc(refProgram *prg, size_t size)
+{
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  if (!prg->arena || prg->arena->used + size > prg->arena->size) {
+    size_t asize = size > 16384 ? size : 16384;
+    refArena *a = malloc(sizeof(refArena) + asize);
+    if (!a)
+      return NULL;
+    a->next = prg->arena;
+    a->used = 0;
+    a->size = asize;
+    prg->arena = a;
+  }
+
+  void *ptr = prg->arena->data + prg->arena->used;
+  prg->arena->used += size;
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+void
+program_decref(refProgram *prg)
+{
+  size_t i;
+
+  if (!prg || --prg->refs > 0)
+    return;
+
+  for (i = 0; i < prg->ncells; i++)
+    decref(prg->rt, prg->cells[i]);
+  free(prg->cells);
+  while (prg->arena) {
+    refArena *next = prg->arena->next;
+    free(prg->arena);
+    prg->arena = next;
+  }
+  free(prg->source);
+  free(prg);
+}
+
+/*
+ * Lexer
+ */
+
+typedef enum {
+  T_EOF, T_NUMBER, T_STRING, T_IDENT, T_PUNCT
+} refToken;
+
+typedef struct {
+  refProgram      *prg;
+  refRuntime      *rt;
+  const natusChar *src;
+  size_t           len;
+  size_t           pos;
+  unsigned         line;
+  jmp_buf          jmp;
+  char             error[256];
+
+  /* Current token */
+  refToken         tok;
+  int              punct;
+  double           number;
+  natusChar       *chars;
+  size_t           nchars;
+  size_t           start;
+  unsigned         tokline;
+  bool             newline;
+
+  /* Current function */
+  refNode         *func;
+} refParser;
+
+static void
+parse_error(refParser *p, const char *msg)
+{
+  snprintf(p->error, sizeof(p->error), "%s (line %u)", msg, p->tokline);
+  longjmp(p->jmp, 1);
+}
+
+static refValue *
+parser_cell(refParser *p, refValue *cell)
+{
+  if (!cell)
+    parse_error(p, "Out of memory");
+
+  if (p->prg->ncells == p->prg->acells) {
+    size_t size = p->prg->acells ? p->prg->acells * 2 : 16;
+    refValue **tmp = realloc(p->prg->cells, sizeof(refValue*) * size);
+    if (!tmp) {
+      decref(p->rt, cell);
+      parse_error(p, "Out of memory");
+    }
+    p->prg->cells = tmp;
+    p->prg->acells = size;
+  }
+
+  p->prg->cells[p->prg->ncells++] = cell;
+  return cell;
+}
+
+static inline bool
+is_ident_start(natusChar c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '$' || c == '_' || c > 127;
+}
+
+static inline bool
+is_ident_part(natusChar c)
+{
+  return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static int
+hexval(natusChar c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+static void
+lex_chars_push(refParser *p, size_t *alloc, natusChar c)
+{
+  if (p->nchars + 1 >= *alloc) {
+    *alloc = *alloc ? *alloc * 2 : 32;
+    natusChar *tmp = realloc(p->chars, sizeof(natusChar) * *alloc);
+    if (!tmp)
+      parse_error(p, "Out of memory");
+    p->chars = tmp;
+  }
+  p->chars[p->nchars++] = c;
+}
+
+static void
+lex_next(refParser *p)
+{
+  static const struct {
+    const char *str;
+    int         punct;
+  } puncts[] = {
+    { "===", P_SEQ }, { "!==", P_SNE }, { "<=", P_LE }, { ">=", P_GE },
+    { "==", P_EQ }, { "!=", P_NE }, { "++", P_INC }, { "--", P_DEC },
+    { "&&", P_AND }, { "||", P_OR }, { "+=", P_ADDA }, { "-=", P_SUBA },
+    { "*=", P_MULA }, { "/=", P_DIVA }, { "%=", P_MODA },
+    { NULL, 0 }
+  };
+  const natusChar *s = p->src;
+  size_t alloc = 0, i, j;
+
+  p->newline = false;
+  p->nchars = 0;
+
+  /* Skip whitespace and comments */
+  while (p->pos < p->len) {
+    natusChar c = s[p->pos];
+    if (c == '\n' || c == 0x2028 || c == 0x2029) {
+      p->newline = true;
+      p->line++;
+      p->pos++;
+    } else if (is_space(c))
+      p->pos++;
+    else if (c == '/' && p->pos + 1 < p->len && s[p->pos + 1] == '/') {
+      while (p->pos < p->len && s[p->pos] != '\n')
+        p->pos++;
+    } else if (c == '/' && p->pos + 1 < p->len && s[p->pos + 1] == '*') {
+      p->pos += 2;
+      while (p->pos < p->len && !(s[p->pos] == '*' && p->pos + 1 < p->len && s[p->pos + 1] == '/')) {
+        if (s[p->pos] == '\n') {
+          p->newline = true;
+          p->line++;
+        }
+        p->pos++;
+      }
+      p->pos += 2;
+    } else
+      break;
+  }
+
+  p->start = p->pos;
+  p->tokline = p->line;
+  if (p->pos >= p->len) {
+    p->tok = T_EOF;
+    return;
+  }
+
+  natusChar c = s[p->pos];
+
+  /* Numbers */
+  if ((c >= '0' && c <= '9') || (c == '.' && p->pos + 1 < p->len && s[p->pos + 1] >= '0' && s[p->pos + 1] <= '9')) {
+    char buf[128];
+    size_t n = 0;
+
+    if (c == '0' && p->pos + 1 < p->len && (s[p->pos + 1] == 'x' || s[p->pos + 1] == 'X')) {
+      double d = 0;
+      p->pos += 2;
+      if (p->pos >= p->len || hexval(s[p->pos]) < 0)
+        parse_error(p, "Invalid hexadecimal literal");
+      while (p->pos < p->len && hexval(s[p->pos]) >= 0)
+        d = d * 16 + hexval(s[p->pos++]);
+      p->tok = T_NUMBER;
+      p->number = d;
+      return;
+    }
+
+    while (p->pos < p->len && n < sizeof(buf) - 1) {
+      c = s[p->pos];
+      if ((c >= '0' && c <= '9') || c == '.')
+        buf[n++] = c;
+      else if ((c == 'e' || c == 'E') && n > 0) {
+        buf[n++] = c;
+        if (p->pos + 1 < p->len && (s[p->pos + 1] == '+' || s[p->pos + 1] == '-'))
+          buf[n++] = s[++p->pos];
+      } else
+        break;
+      p->pos++;
+    }
+    buf[n] = '\0';
+
+    char *end;
+    p->tok = T_NUMBER;
+    p->number = strtod(buf, &end);
+    if (*end || (p->pos < p->len && is_ident_start(s[p->pos])))
+      parse_error(p, "Invalid number literal");
+    return;
+  }
+
+  /* Identifiers */
+  if (is_ident_start(c) || c == '\\') {
+    while (p->pos < p->len && is_ident_part(s[p->pos]))
+      lex_chars_push(p, &alloc, s[p->pos++]);
+    if (p->nchars == 0)
+      parse_error(p, "Unexpected character");
+    p->tok = T_IDENT;
+    return;
+  }
+
+  /* Strings */
+  if (c == '"' || c == '\'') {
+    natusChar quote = c;
+    p->pos++;
+    for (;;) {
+      if (p->pos >= p->len || s[p->pos] == '\n')
+        parse_error(p, "Unterminated string literal");
+      c = s[p->pos++];
+      if (c == quote)
+        break;
+      if (c != '\\') {
+        lex_chars_push(p, &alloc, c);
+        continue;
+      }
+
+      if (p->pos >= p->len)
+        parse_error(p, "Unterminated string literal");
+      c = s[p->pos++];
+      switch (c) {
+      case 'n':  c = '\n'; break;
+      case 't':  c = '\t'; break;
+      case 'r':  c = '\r'; break;
+      case 'b':  c = '\b'; break;
+      case 'f':  c = '\f'; break;
+      case 'v':  c = '\v'; break;
+      case '0':  c = '\0'; break;
+      case '\n': p->line++; continue;
+      case 'x':
+      case 'u': {
+        size_t digits = c == 'x' ? 2 : 4;
+        c = 0;
+        for (i = 0; i < digits; i++) {
+          if (p->pos >= p->len || hexval(s[p->pos]) < 0)
+            parse_error(p, "Invalid escape sequence");
+          c = c * 16 + hexval(s[p->pos++]);
+        }
+        break;
+      }
+      default:
+        break;
+      }
+      lex_chars_push(p, &alloc, c);
+    }
+    p->tok = T_STRING;
+    return;
+  }
+
+  /* Punctuators */
+  for (i = 0; puncts[i].str; i++) {
+    for (j = 0; puncts[i].str[j]; j++)
+      if (p->pos + j >= p->len || s[p->pos + j] != (natusChar) puncts[i].str[j])
+        break;
+    if (!puncts[i].str[j]) {
+      p->pos += j;
+      p->tok = T_PUNCT;
+      p->punct = puncts[i].punct;
+      return;
+    }
+  }
+
+  if (strchr("{}()[];,<>+-*/%!:=.", c) && c < 128) {
+    p->pos++;
+    p->tok = T_PUNCT;
+    p->punct = c;
+    return;
+  }
+
+  parse_error(p, "Unexpected character");
+}
+
+/*
+ * Parser
+ */
+
+static bool
+is_punct(refParser *p, int punct)
+{
+  return p->tok == T_PUNCT && p->punct == punct;
+}
+
+static bool
+is_word(refParser *p, const char *word)
+{
+  size_t i;
+  if (p->tok != T_IDENT)
+    return false;
+  for (i = 0; i < p->nchars; i++)
+    if (!word[i] || p->chars[i] != (unsigned char) word[i])
+      return false;
+  return word[i] == '\0';
+}
+
+static bool
+is_reserved(refParser *p)
+{
+  static const char *words[] = {
+    "break", "case", "catch", "continue", "default", "delete", "do", "else",
+    "finally", "for", "function", "if", "in", "instanceof", "new", "return",
+    "switch", "this", "throw", "try", "typeof", "var", "void", "while",
+    "with", "null", "true", "false", NULL
+  };
+  size_t i;
+  for (i = 0; words[i]; i++)
+    if (is_word(p, words[i]))
+      return true;
+  return false;
+}
+
+static void
+expect(refParser *p, int punct)
+{
+  char msg[32];
+  if (!is_punct(p, punct)) {
+    snprintf(msg, sizeof(msg), "Expected '%c'", punct < 256 ? punct : '?');
+    parse_error(p, msg);
+  }
+  lex_next(p);
+}
+
+static void
+expect_semicolon(refParser *p)
+{
+  if (is_punct(p, ';')) {
+    lex_next(p);
+    return;
+  }
+
+  /* Automatic semicolon insertion */
+  if (is_punct(p, '}') || p->tok == T_EOF || p->newline)
+    return;
+  parse_error(p, "Expected ';'");
+}
+
+static refNode *
+node_new(refParser *p, refNodeType type)
+{
+  refNode *n = arena_alloc(p->prg, sizeof(refNode));
+  if (!n)
+    parse_error(p, "Out of memory");
+  n->type = type;
+  n->line = p->tokline;
+  return n;
+}
+
+static void
+node_push(refParser *p, refNode ***list, size_t *count, refNode *n)
+{
+  /* Lists grow in powers of two inside the arena */
+  if ((*count & (*count - 1)) == 0 && *count >= 4) {
+    refNode **tmp = arena_alloc(p->prg, sizeof(refNode*) * *count * 2);
+    if (!tmp)
+      parse_error(p, "Out of memory");
+    memcpy(tmp, *list, sizeof(refNode*) * *count);
+    *list = tmp;
+  } else if (*count == 0) {
+    *list = arena_alloc(p->prg, sizeof(refNode*) * 4);
+    if (!*list)
+      parse_error(p, "Out of memory");
+  }
+  (*list)[(*count)++] = n;
+}
+
+static refNode *
+node_ident(refParser *p)
+{
+  if (p->tok != T_IDENT || is_reserved(p))
+    parse_error(p, "Expected identifier");
+
+  refNode *n = node_new(p, N_IDENT);
+  n->value = parser_cell(p, mkstring_utf16(p->rt, p->chars, p->nchars));
+  if (is_word(p, "arguments") && p->func)
+    p->func->arguments = true;
+  lex_next(p);
+  return n;
+}
+
+static refNode *
+parse_expression(refParser *p);
+static refNode *
+parse_assignment(refParser *p);
+static refNode *
+parse_statement(refParser *p);
+static refNode *
+parse_function(refParser *p, bool declaration);
+
+static refNode *
+parse_primary(refParser *p)
+{
+  refNode *n;
+
+  switch (p->tok) {
+  case T_NUMBER:
+    n = node_new(p, N_NUMBER);
+    n->value = parser_cell(p, mknumber(p->rt, p->number));
+    lex_next(p);
+    return n;
+
+  case T_STRING:
+    n = node_new(p, N_STRING);
+    n->value = parser_cell(p, mkstring_utf16(p->rt, p->chars, p->nchars));
+    lex_next(p);
+    return n;
+
+  case T_IDENT:
+    if (is_word(p, "function"))
+      return parse_function(p, false);
+    if (is_word(p, "this") || is_word(p, "null") || is_word(p, "true") || is_word(p, "false")) {
+      n = node_new(p, is_word(p, "this") ? N_THIS : is_word(p, "null") ? N_NULL
+                      : is_word(p, "true") ? N_TRUE : N_FALSE);
+      lex_next(p);
+      return n;
+    }
+    return node_ident(p);
+
+  case T_PUNCT:
+    if (is_punct(p, '(')) {
+      lex_next(p);
+      n = parse_expression(p);
+      expect(p, ')');
+      return n;
+    }
+
+    if (is_punct(p, '[')) {
+      n = node_new(p, N_ARRAY);
+      lex_next(p);
+      while (!is_punct(p, ']')) {
+        if (is_punct(p, ',')) {
+          node_push(p, &n->list, &n->count, NULL);
+          lex_next(p);
+          continue;
+        }
+        node_push(p, &n->list, &n->count, parse_assignment(p));
+        if (!is_punct(p, ']'))
+          expect(p, ',');
+      }
+      lex_next(p);
+      return n;
+    }
+
+    if (is_punct(p, '{')) {
+      n = node_new(p, N_OBJECT);
+      lex_next(p);
+      while (!is_punct(p, '}')) {
+        refNode *key = node_new(p, N_STRING);
+        if (p->tok == T_IDENT || p->tok == T_STRING)
+          key->value = parser_cell(p, mkstring_utf16(p->rt, p->chars, p->nchars));
+        else if (p->tok == T_NUMBER)
+          key->value = parser_cell(p, number_to_string(p->rt, p->number));
+        else
+          parse_error(p, "Invalid property name");
+        lex_next(p);
+        expect(p, ':');
+        key->a = parse_assignment(p);
+        node_push(p, &n->list, &n->count, key);
+        if (!is_punct(p, '}'))
+          expect(p, ',');
+      }
+      lex_next(p);
+      return n;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  parse_error(p, p->tok == T_EOF ? "Unexpected end of input" : "Unexpected token");
+  return NULL;
+}
+
+static void
+parse_arguments(refParser *p, refNode *n)
+{
+  expect(p, '(');
+  while (!is_punct(p, ')')) {
+    node_push(p, &n->list, &n->count, parse_assignment(p));
+    if (!is_punct(p, ')'))
+      expect(p, ',');
+  }
+  lex_next(p);
+}
+
+static refNode *
+parse_member(refParser *p, bool call)
+{
+  refNode *n;
+
+  if (is_word(p, "new")) {
+    n = node_new(p, N_NEW);
+    lex_next(p);
+    n->a = parse_member(p, false);
+    if (is_punct(p, '('))
+      parse_arguments(p, n);
+  } else
+    n = parse_primary(p);
+
+  for (;;) {
+    if (is_punct(p, '.')) {
+      refNode *m = node_new(p, N_DOT);
+      lex_next(p);
+      if (p->tok != T_IDENT)
+        parse_error(p, "Expected property name");
+      m->a = n;
+      m->value = parser_cell(p, mkstring_utf16(p->rt, p->chars, p->nchars));
+      lex_next(p);
+      n = m;
+    } else if (is_punct(p, '[')) {
+      refNode *m = node_new(p, N_INDEX);
+      lex_next(p);
+      m->a = n;
+      m->b = parse_expression(p);
+      expect(p, ']');
+      n = m;
+    } else if (call && is_punct(p, '(')) {
+      refNode *m = node_new(p, N_CALL);
+      m->a = n;
+      parse_arguments(p, m);
+      n = m;
+    } else
+      return n;
+  }
+}
+
+static refNode *
+parse_postfix(refParser *p)
+{
+  refNode *n = parse_member(p, true);
+  if ((is_punct(p, P_INC) || is_punct(p, P_DEC)) && !p->newline) {
+    refNode *m = node_new(p, N_POSTFIX);
+    m->op = p->punct;
+    m->a = n;
+    lex_next(p);
+    return m;
+  }
+  return n;
+}
+
+static refNode *
+parse_unary(refParser *p)
+{
+  int op = 0;
+
+  if (p->tok == T_PUNCT && strchr("!+-", p->punct) && p->punct < 128)
+    op = p->punct;
+  else if (is_word(p, "typeof"))
+    op = P_TYPEOF;
+  else if (is_word(p, "delete"))
+    op = P_DELETE;
+  else if (is_punct(p, P_INC) || is_punct(p, P_DEC)) {
+    refNode *n = node_new(p, N_PREFIX);
+    n->op = p->punct;
+    lex_next(p);
+    n->a = parse_unary(p);
+    return n;
+  }
+
+  if (!op)
+    return parse_postfix(p);
+
+  refNode *n = node_new(p, N_UNARY);
+  n->op = op;
+  lex_next(p);
+  n->a = parse_unary(p);
+  return n;
+}
+
+static int
+binary_precedence(refParser *p, int *op)
+{
+  if (p->tok != T_PUNCT)
+    return 0;
+
+  *op = p->punct;
+  switch (p->punct) {
+  case P_OR:  return 1;
+  case P_AND: return 2;
+  case P_EQ:
+  case P_NE:
+  case P_SEQ:
+  case P_SNE: return 3;
+  case '<':
+  case '>':
+  case P_LE:
+  case P_GE:  return 4;
+  case '+':
+  case '-':   return 5;
+  case '*':
+  case '/':
+  case '%':   return 6;
+  default:    return 0;
+  }
+}
+
+static refNode *
+parse_binary(refParser *p, int minprec)
+{
+  refNode *left = parse_unary(p);
+  int op = 0, prec;
+
+  while ((prec = binary_precedence(p, &op)) > minprec) {
+    refNode *n = node_new(p, op == P_AND ? N_AND : op == P_OR ? N_OR : N_BINARY);
+    lex_next(p);
+    n->op = op;
+    n->a = left;
+    n->b = parse_binary(p, prec);
+    left = n;
+  }
+
+  return left;
+}
+
+static refNode *
+parse_assignment(refParser *p)
+{
+  refNode *n = parse_binary(p, 0);
+  if (p->tok != T_PUNCT)
+    return n;
+
+  switch (p->punct) {
+  case '=':
+  case P_ADDA:
+  case P_SUBA:
+  case P_MULA:
+  case P_DIVA:
+  case P_MODA:
+    break;
+  default:
+    return n;
+  }
+
+  if (n->type != N_IDENT && n->type != N_DOT && n->type != N_INDEX)
+    parse_error(p, "Invalid assignment target");
+
+  refNode *a = node_new(p, N_ASSIGN);
+  a->op = p->punct;
+  lex_next(p);
+  a->a = n;
+  a->b = parse_assignment(p);
+  return a;
+}
+
+static refNode *
+parse_expression(refParser *p)
+{
+  refNode *n = parse_assignment(p);
+  while (is_punct(p, ',')) {
+    refNode *c = node_new(p, N_COMMA);
+    lex_next(p);
+    c->a = n;
+    c->b = parse_assignment(p);
+    n = c;
+  }
+  return n;
+}
+
+static refNode *
+parse_var(refParser *p)
+{
+  refNode *n = node_new(p, N_VAR);
+  lex_next(p);
+
+  do {
+    refNode *id = node_ident(p);
+    node_push(p, &p->func->vars, &p->func->nvars, id);
+    if (is_punct(p, '=')) {
+      lex_next(p);
+      id->a = parse_assignment(p);
+    }
+    node_push(p, &n->list, &n->count, id);
+  } while (is_punct(p, ',') && (lex_next(p), true));
+
+  return n;
+}
+
+static refNode *
+parse_block(refParser *p)
+{
+  refNode *n = node_new(p, N_BLOCK);
+  expect(p, '{');
+  while (!is_punct(p, '}')) {
+    if (p->tok == T_EOF)
+      parse_error(p, "Unexpected end of input");
+    node_push(p, &n->list, &n->count, parse_statement(p));
+  }
+  lex_next(p);
+  return n;
+}
+
+static refNode *
+parse_function(refParser *p, bool declaration)
+{
+  refNode *n = node_new(p, N_FUNCTION);
+  refNode *outer = p->func;
+
+  n->start = p->start;
+  lex_next(p);
+  if (p->tok == T_IDENT)
+    n->a = node_ident(p);
+  else if (declaration)
+    parse_error(p, "Expected function name");
+
+  p->func = n;
+  expect(p, '(');
+  while (!is_punct(p, ')')) {
+    node_push(p, &n->params, &n->nparams, node_ident(p));
+    if (!is_punct(p, ')'))
+      expect(p, ',');
+  }
+  lex_next(p);
+
+  if (!is_punct(p, '{'))
+    parse_error(p, "Expected '{'");
+  lex_next(p);
+  while (!is_punct(p, '}')) {
+    if (p->tok == T_EOF)
+      parse_error(p, "Unexpected end of input");
+    node_push(p, &n->list, &n->count, parse_statement(p));
+  }
+  n->end = p->pos;
+  p->func = outer;
+  lex_next(p);
+  return n;
+}
+
+static refNode *
+parse_statement(refParser *p)
+{
+  refNode *n;
+
+  if (is_punct(p, '{'))
+    return parse_block(p);
+
+  if (is_punct(p, ';')) {
+    n = node_new(p, N_EMPTY);
+    lex_next(p);
+    return n;
+  }
+
+  if (p->tok == T_IDENT) {
+    if (is_word(p, "var")) {
+      n = parse_var(p);
+      expect_semicolon(p);
+      return n;
+    }
+
+    if (is_word(p, "function")) {
+      n = parse_function(p, true);
+      node_push(p, &p->func->funcs, &p->func->nfuncs, n);
+      return node_new(p, N_EMPTY);
+    }
+
+    if (is_word(p, "if")) {
+      n = node_new(p, N_IF);
+      lex_next(p);
+      expect(p, '(');
+      n->a = parse_expression(p);
+      expect(p, ')');
+      n->b = parse_statement(p);
+      if (is_word(p, "else")) {
+        lex_next(p);
+        n->c = parse_statement(p);
+      }
+      return n;
+    }
+
+    if (is_word(p, "for")) {
+      n = node_new(p, N_FOR);
+      lex_next(p);
+      expect(p, '(');
+      if (is_word(p, "var"))
+        n->a = parse_var(p);
+      else if (!is_punct(p, ';'))
+        n->a = parse_expression(p);
+      expect(p, ';');
+      if (!is_punct(p, ';'))
+        n->b = parse_expression(p);
+      expect(p, ';');
+      if (!is_punct(p, ')'))
+        n->c = parse_expression(p);
+      expect(p, ')');
+      n->d = parse_statement(p);
+      return n;
+    }
+
+    if (is_word(p, "return") || is_word(p, "throw")) {
+      n = node_new(p, is_word(p, "return") ? N_RETURN : N_THROW);
+      lex_next(p);
+      if (!is_punct(p, ';') && !is_punct(p, '}') && p->tok != T_EOF && !p->newline)
+        n->a = parse_expression(p);
+      else if (n->type == N_THROW)
+        parse_error(p, "Expected expression");
+      expect_semicolon(p);
+      return n;
+    }
+  }
+
+  n = node_new(p, N_EXPR);
+  n->a = parse_expression(p);
+  expect_semicolon(p);
+  return n;
+}
+
+/* Parses the source into a new program; the source is copied.  On failure
+ * NULL is returned and a SyntaxError is pending. */
+refProgram *
+program_parse(refRuntime *rt, const natusChar *src, size_t len, unsigned lineno)
+{
+  refProgram *prg = calloc(1, sizeof(refProgram));
+  if (!prg) {
+    throw_error(rt, refProtoRangeError, "Out of memory");
+    return NULL;
+  }
+  prg->refs = 1;
+  prg->rt = rt;
+
+  prg->source = malloc(sizeof(natusChar) * (len + 1));
+  if (!prg->source) {
+    free(prg);
+    throw_error(rt, refProtoRangeError, "Out of memory");
+    return NULL;
+  }
+  if (len > 0)
+    memcpy(prg->source, src, sizeof(natusChar) * len);
+  prg->source[len] = 0;
+  prg->length = len;
+
+  refParser *p = calloc(1, sizeof(refParser));
+  if (!p) {
+    program_decref(prg);
+    throw_error(rt, refProtoRangeError, "Out of memory");
+    return NULL;
+  }
+  p->prg = prg;
+  p->rt = rt;
+  p->src = prg->source;
+  p->len = len;
+  p->line = lineno;
+
+  if (setjmp(p->jmp)) {
+    char msg[sizeof(p->error)];
+    strcpy(msg, p->error);
+    free(p->chars);
+    free(p);
+    program_decref(prg);
+    throw_error(rt, refProtoSyntaxError, "%s", msg);
+    return NULL;
+  }
+
+  prg->root = p->func = node_new(p, N_PROGRAM);
+  lex_next(p);
+  while (p->tok != T_EOF)
+    node_push(p, &prg->root->list, &prg->root->count, parse_statement(p));
+
+  free(p->chars);
+  free(p);
+  return prg;
+}
+
+/*
+ * Interpreter
+ */
+
+typedef enum {
+  C_NORMAL,
+  C_RETURN,
+  C_THROW
+} refCompletion;
+
+typedef struct {
+  refValue  *scope;
+  refValue  *ths;
+  refValue  *callee;
+  size_t     argc;
+  refValue **argv;
+  refProgram *program;
+  refValue  *completion;
+  bool       toplevel;
+} refFrame;
+
+static refValue *
+eval(refRuntime *rt, refFrame *f, refNode *n);
+static refCompletion
+exec(refRuntime *rt, refFrame *f, refNode *n, refValue **rv);
+static refCompletion
+exec_list(refRuntime *rt, refFrame *f, refNode **list, size_t count, refValue **rv);
+
+static refValue *
+function_new(refRuntime *rt, refNode *node, refProgram *prg, refValue *scope)
+{
+  refValue *fnc = object_new(rt, refClassFunction, rt->protos[refProtoFunction]);
+  if (!fnc)
+    return NULL;
+
+  /* No prototype object: it would make a cycle with the function, and
+   * `new' falls back to Object.prototype without one */
+  prg->refs++;
+  OBJ(fnc)->func = node;
+  OBJ(fnc)->program = prg;
+  OBJ(fnc)->scope = incref(scope);
+  if (node->a && !prop_put(rt, OBJ(fnc), rt->s_name, node->a->value, natusPropAttrProtected)) {
+    decref(rt, fnc);
+    return NULL;
+  }
+  return fnc;
+}
+
+/* Returns a borrowed pointer to the slot holding a variable, or NULL if the
+ * variable lives on the global object (or doesn't exist) */
+static refProperty *
+scope_find(refValue *scope, refValue *name, refValue **global)
+{
+  for (; scope; scope = OBJ(scope)->scope) {
+    refObject *obj = OBJ(scope);
+    if (obj->cls != refClassScope) {
+      *global = scope;
+      return NULL;
+    }
+
+    size_t i = prop_find(obj, name);
+    if (i != SIZE_MAX)
+      return &obj->props[i];
+  }
+
+  *global = NULL;
+  return NULL;
+}
+
+static refValue *
+var_get(refRuntime *rt, refFrame *f, refValue *name, bool throws)
+{
+  refValue *global = NULL;
+  refProperty *prop = scope_find(f->scope, name, &global);
+  if (prop)
+    return incref(prop->value);
+
+  if (global) {
+    refKey key;
+    memset(&key, 0, sizeof(key));
+    key.orig = key.string = name;
+    key.isindex = string_to_index(name, &key.index);
+
+    refValue *obj;
+    for (obj = global; obj; obj = OBJ(obj)->proto) {
+      refValue *res = own_lookup(rt, obj, &key);
+      if (res)
+        return incref(res);
+    }
+  }
+
+  if (!throws)
+    return incref(rt->undefined);
+  return throw_error(rt, refProtoReferenceError, "%S is not defined", name);
+}
+
+static bool
+var_put(refRuntime *rt, refFrame *f, refValue *name, refValue *value)
+{
+  refValue *global = NULL;
+  refProperty *prop = scope_find(f->scope, name, &global);
+  if (prop) {
+    refValue *old = prop->value;
+    prop->value = incref(value);
+    decref(rt, old);
+    return true;
+  }
+
+  return put_property(rt, global ? global : rt->global, name, value);
+}
+
+static bool
+hoist(refRuntime *rt, refNode *func, refProgram *prg, refValue *scope)
+{
+  size_t i;
+
+  for (i = 0; i < func->nvars; i++) {
+    refValue *name = func->vars[i]->value;
+    if (prop_find(OBJ(scope), name) != SIZE_MAX)
+      continue;
+    if (!prop_put(rt, OBJ(scope), name, rt->undefined,
+                  OBJ(scope)->cls == refClassScope ? 0 : natusPropAttrDontDelete))
+      return throw_error(rt, refProtoRangeError, "Out of memory");
+  }
+
+  for (i = 0; i < func->nfuncs; i++) {
+    refValue *fnc = function_new(rt, func->funcs[i], prg, scope);
+    if (!fnc)
+      return false;
+    bool res = prop_put(rt, OBJ(scope), func->funcs[i]->a->value, fnc, natusPropAttrNone);
+    decref(rt, fnc);
+    if (!res)
+      return throw_error(rt, refProtoRangeError, "Out of memory");
+  }
+
+  return true;
+}
+
+static refValue *
+call_script(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv)
+{
+  refObject *obj = OBJ(fnc);
+  refNode *node = obj->func;
+  refValue *rv = NULL, *global = rt->global;
+  refFrame frame;
+  size_t i;
+
+  refValue *scope = object_new(rt, refClassScope, NULL);
+  if (!scope)
+    return NULL;
+  OBJ(scope)->scope = incref(obj->scope);
+
+  memset(&frame, 0, sizeof(frame));
+  frame.scope = scope;
+  frame.ths = ths;
+  frame.callee = fnc;
+  frame.argc = argc;
+  frame.argv = argv;
+  frame.program = obj->program;
+
+  if (node->a && !prop_put(rt, OBJ(scope), node->a->value, fnc, natusPropAttrNone))
+    goto oom;
+  for (i = 0; i < node->nparams; i++)
+    if (!prop_put(rt, OBJ(scope), node->params[i]->value, i < argc ? argv[i] : rt->undefined, natusPropAttrNone))
+      goto oom;
+  if (node->arguments) {
+    refValue *args = array_new(rt, argc, argv);
+    if (!args)
+      goto oom;
+    bool res = prop_put(rt, OBJ(scope), rt->s_arguments, args, natusPropAttrNone);
+    decref(rt, args);
+    if (!res)
+      goto oom;
+  }
+
+  if (!hoist(rt, node, obj->program, scope)) {
+    decref(rt, scope);
+    return NULL;
+  }
+
+  if (obj->global)
+    rt->global = obj->global;
+  obj->program->refs++;
+  switch (exec_list(rt, &frame, node->list, node->count, &rv)) {
+  case C_RETURN:
+    break;
+  case C_THROW:
+    rv = NULL;
+    break;
+  default:
+    decref(rt, rv);
+    rv = incref(rt->undefined);
+    break;
+  }
+  program_decref(obj->program);
+  rt->global = global;
+
+  decref(rt, scope);
+  return rv;
+
+oom:
+  decref(rt, scope);
+  return throw_error(rt, refProtoRangeError, "Out of memory");
+}
+
+static refValue *
+call_native(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv)
+{
+  natusEngValFlags flags = natusEngValFlagNone;
+  rt->callouts++;
+  refValue *res = natus_handle_call_argv(incref(fnc), OBJ(fnc)->priv, incref(ths),
+                                         argc, (natusEngVal*) argv, &flags);
+  rt->callouts--;
+  if (flags & natusEngValFlagException) {
+    decref(rt, rt->exception);
+    rt->exception = incref(res ? res : rt->undefined);
+    if (res && (flags & natusEngValFlagUnlock))
+      decref(rt, res);
+    return NULL;
+  }
+
+  incref(res);
+  if (flags & natusEngValFlagUnlock)
+    decref(rt, res);
+  return res;
+}
+
+refValue *
+call_function(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv)
+{
+  if (!is_callable(fnc))
+    return throw_error(rt, refProtoTypeError, "%s is not a function", type_of(fnc));
+
+  if (rt->depth >= REF_MAX_DEPTH)
+    return throw_error(rt, refProtoRangeError, "Maximum call stack size exceeded");
+
+  if (!ths || ths->kind == refKindUndefined || ths->kind == refKindNull)
+    ths = OBJ(fnc)->global ? OBJ(fnc)->global : rt->global;
+
+  refValue *res;
+  rt->depth++;
+  if (OBJ(fnc)->builtin)
+    res = OBJ(fnc)->builtin(rt, fnc, ths, argc, argv, false);
+  else if (OBJ(fnc)->func)
+    res = call_script(rt, fnc, ths, argc, argv);
+  else
+    res = call_native(rt, fnc, ths, argc, argv);
+  rt->depth--;
+  return res;
+}
+
+refValue *
+construct(refRuntime *rt, refValue *fnc, size_t argc, refValue **argv)
+{
+  if (!is_callable(fnc))
+    return throw_error(rt, refProtoTypeError, "%s is not a constructor", type_of(fnc));
+
+  if (rt->depth >= REF_MAX_DEPTH)
+    return throw_error(rt, refProtoRangeError, "Maximum call stack size exceeded");
+
+  refValue *res = NULL;
+  rt->depth++;
+  if (OBJ(fnc)->builtin)
+    res = OBJ(fnc)->builtin(rt, fnc, NULL, argc, argv, true);
+  else if (OBJ(fnc)->func) {
+    refValue *proto = get_named(rt, fnc, rt->s_prototype);
+    if (proto) {
+      refValue *obj = object_new(rt, refClassObject, IS_OBJECT(proto) ? proto : rt->protos[refProtoObject]);
+      decref(rt, proto);
+      if (obj) {
+        res = call_script(rt, fnc, obj, argc, argv);
+        if (res && !IS_OBJECT(res)) {
+          decref(rt, res);
+          res = incref(obj);
+        }
+        decref(rt, obj);
+      }
+    }
+  } else
+    res = call_native(rt, fnc, rt->undefined, argc, argv);
+  rt->depth--;
+  return res;
+}
+
+/* A resolved assignment target */
+typedef struct {
+  refValue *base;  /* NULL for variables */
+  refValue *name;
+} refRef;
+
+static bool
+target_resolve(refRuntime *rt, refFrame *f, refNode *n, refRef *r)
+{
+  memset(r, 0, sizeof(refRef));
+
+  if (n->type == N_IDENT) {
+    r->name = incref(n->value);
+    return true;
+  }
+
+  r->base = eval(rt, f, n->a);
+  if (!r->base)
+    return false;
+
+  if (n->type == N_DOT) {
+    r->name = incref(n->value);
+    return true;
+  }
+
+  r->name = eval(rt, f, n->b);
+  if (!r->name) {
+    decref(rt, r->base);
+    r->base = NULL;
+    return false;
+  }
+  return true;
+}
+
+static refValue *
+target_get(refRuntime *rt, refFrame *f, refRef *r)
+{
+  if (!r->base)
+    return var_get(rt, f, r->name, true);
+  return get_property(rt, r->base, r->name);
+}
+
+static bool
+target_put(refRuntime *rt, refFrame *f, refRef *r, refValue *value)
+{
+  if (!r->base)
+    return var_put(rt, f, r->name, value);
+  return put_property(rt, r->base, r->name, value);
+}
+
+static void
+target_free(refRuntime *rt, refRef *r)
+{
+  decref(rt, r->base);
+  decref(rt, r->name);
+}
+
+/* Evaluates a binary operator; both operands are borrowed */
+static refValue *
+binary(refRuntime *rt, int op, refValue *a, refValue *b)
+{
+  double x, y;
+  int eq;
+
+  switch (op) {
+  case '+': {
+    refValue *pa = to_primitive(rt, a, false);
+    if (!pa)
+      return NULL;
+    refValue *pb = to_primitive(rt, b, false);
+    if (!pb) {
+      decref(rt, pa);
+      return NULL;
+    }
+
+    refValue *res = NULL;
+    if (IS_STRING(pa) || IS_STRING(pb)) {
+      refValue *sa = to_string(rt, pa);
+      refValue *sb = sa ? to_string(rt, pb) : NULL;
+      if (sa && sb)
+        res = string_concat(rt, sa, sb);
+      decref(rt, sa);
+      decref(rt, sb);
+    } else if (to_number(rt, pa, &x) && to_number(rt, pb, &y))
+      res = mknumber(rt, x + y);
+
+    decref(rt, pa);
+    decref(rt, pb);
+    return res;
+  }
+
+  case P_SEQ:
+    return mkbool(rt, strict_equal(a, b));
+  case P_SNE:
+    return mkbool(rt, !strict_equal(a, b));
+  case P_EQ:
+  case P_NE:
+    eq = loose_equal(rt, a, b);
+    if (eq < 0)
+      return NULL;
+    return mkbool(rt, op == P_EQ ? eq : !eq);
+
+  case '<':
+  case '>':
+  case P_LE:
+  case P_GE: {
+    refValue *pa = to_primitive(rt, a, false);
+    if (!pa)
+      return NULL;
+    refValue *pb = to_primitive(rt, b, false);
+    if (!pb) {
+      decref(rt, pa);
+      return NULL;
+    }
+
+    bool res = false;
+    if (IS_STRING(pa) && IS_STRING(pb)) {
+      int cmp = string_compare(pa, pb);
+      res = op == '<' ? cmp < 0 : op == '>' ? cmp > 0 : op == P_LE ? cmp <= 0 : cmp >= 0;
+    } else {
+      bool ok = to_number(rt, pa, &x) && to_number(rt, pb, &y);
+      if (!ok) {
+        decref(rt, pa);
+        decref(rt, pb);
+        return NULL;
+      }
+      res = op == '<' ? x < y : op == '>' ? x > y : op == P_LE ? x <= y : x >= y;
+    }
+
+    decref(rt, pa);
+    decref(rt, pb);
+    return mkbool(rt, res);
+  }
+
+  default:
+    break;
+  }
+
+  if (!to_number(rt, a, &x) || !to_number(rt, b, &y))
+    return NULL;
+
+  switch (op) {
+  case '-':
+    return mknumber(rt, x - y);
+  case '*':
+    return mknumber(rt, x * y);
+  case '/':
+    return mknumber(rt, x / y);
+  case '%':
+    return mknumber(rt, fmod(x, y));
+  default:
+    assert(false);
+    return NULL;
+  }
+}
+
+static int
+assign_operator(int op)
+{
+  switch (op) {
+  case P_ADDA:  return '+';
+  case P_SUBA:  return '-';
+  case P_MULA:  return '*';
+  case P_DIVA:  return '/';
+  case P_MODA:  return '%';
+  default:      return 0;
+  }
+}
+
+static refValue *
+eval_call(refRuntime *rt, refFrame *f, refNode *n)
+{
+  refValue *stackargs[8], **argv = stackargs;
+  refValue *fnc = NULL, *ths = NULL, *res = NULL;
+  size_t i, argc = 0;
+
+  if (n->type == N_CALL && (n->a->type == N_DOT || n->a->type == N_INDEX)) {
+    refRef r;
+    if (!target_resolve(rt, f, n->a, &r))
+      return NULL;
+    fnc = get_property(rt, r.base, r.name);
+    ths = incref(r.base);
+    target_free(rt, &r);
+  } else
+    fnc = eval(rt, f, n->a);
+  if (!fnc) {
+    decref(rt, ths);
+    return NULL;
+  }
+
+  if (n->count > sizeof(stackargs) / sizeof(*stackargs)) {
+    argv = malloc(sizeof(refValue*) * n->count);
+    if (!argv) {
+      decref(rt, fnc);
+      decref(rt, ths);
+      return throw_error(rt, refProtoRangeError, "Out of memory");
+    }
+  }
+
+  for (argc = 0; argc < n->count; argc++)
+    if (!(argv[argc] = eval(rt, f, n->list[argc])))
+      goto out;
+
+  if (n->type == N_NEW)
+    res = construct(rt, fnc, argc, argv);
+  else if (!is_callable(fnc) && n->a->type != N_CALL) {
+    refValue *name = n->a->type == N_INDEX ? NULL : n->a->value;
+    if (name)
+      throw_error(rt, refProtoTypeError, "%S is not a function", name);
+    else
+      throw_error(rt, refProtoTypeError, "%s is not a function", type_of(fnc));
+  } else
+    res = call_function(rt, fnc, ths, argc, argv);
+
+out:
+  for (i = 0; i < argc; i++)
+    decref(rt, argv[i]);
+  if (argv != stackargs)
+    free(argv);
+  decref(rt, fnc);
+  decref(rt, ths);
+  return res;
+}
+
+static refValue *
+eval(refRuntime *rt, refFrame *f, refNode *n)
+{
+  refValue *a, *b, *res;
+  size_t i;
+
+  switch (n->type) {
+  case N_NUMBER:
+  case N_STRING:
+    return incref(n->value);
+  case N_TRUE:
+    return mkbool(rt, true);
+  case N_FALSE:
+    return mkbool(rt, false);
+  case N_NULL:
+    return incref(rt->null);
+  case N_THIS:
+    return incref(f->ths);
+  case N_IDENT:
+    return var_get(rt, f, n->value, true);
+
+  case N_ARRAY:
+    res = array_new(rt, n->count, NULL);
+    if (!res)
+      return NULL;
+    for (i = 0; i < n->count; i++) {
+      if (!n->list[i])
+        continue;
+      if (!(a = eval(rt, f, n->list[i]))) {
+        decref(rt, res);
+        return NULL;
+      }
+      OBJ(res)->items[i] = a;
+    }
+    return res;
+
+  case N_OBJECT:
+    res = object_new_plain(rt);
+    if (!res)
+      return NULL;
+    for (i = 0; i < n->count; i++) {
+      if (!(a = eval(rt, f, n->list[i]->a)) || !put_property(rt, res, n->list[i]->value, a)) {
+        decref(rt, a);
+        decref(rt, res);
+        return NULL;
+      }
+      decref(rt, a);
+    }
+    return res;
+
+  case N_FUNCTION:
+    return function_new(rt, n, f->program, f->scope);
+
+  case N_DOT:
+    if (!(a = eval(rt, f, n->a)))
+      return NULL;
+    res = get_named(rt, a, n->value);
+    decref(rt, a);
+    return res;
+
+  case N_INDEX:
+    if (!(a = eval(rt, f, n->a)))
+      return NULL;
+    if (!(b = eval(rt, f, n->b))) {
+      decref(rt, a);
+      return NULL;
+    }
+    res = get_property(rt, a, b);
+    decref(rt, a);
+    decref(rt, b);
+    return res;
+
+  case N_CALL:
+  case N_NEW:
+    return eval_call(rt, f, n);
+
+  case N_UNARY:
+    if (n->op == P_TYPEOF && n->a->type == N_IDENT) {
+      if (!(a = var_get(rt, f, n->a->value, false)))
+        return NULL;
+    } else if (n->op == P_DELETE) {
+      refRef r;
+      if (n->a->type == N_IDENT)
+        return mkbool(rt, false);
+      if (n->a->type != N_DOT && n->a->type != N_INDEX)
+        return mkbool(rt, true);
+      if (!target_resolve(rt, f, n->a, &r))
+        return NULL;
+
+      refKey key;
+      res = NULL;
+      if (key_init(rt, &key, r.name)) {
+        res = del_key(rt, r.base, &key);
+        key_free(rt, &key);
+      }
+      target_free(rt, &r);
+      return res;
+    } else if (!(a = eval(rt, f, n->a)))
+      return NULL;
+
+    switch (n->op) {
+    case '!':
+      res = mkbool(rt, !to_boolean(a));
+      break;
+    case P_TYPEOF:
+      res = mkstring(rt, type_of(a));
+      break;
+    default: {
+      double d;
+      res = NULL;
+      if (to_number(rt, a, &d))
+        res = mknumber(rt, n->op == '-' ? -d : d);
+      break;
+    }
+    }
+    decref(rt, a);
+    return res;
+
+  case N_PREFIX:
+  case N_POSTFIX: {
+    refRef r;
+    double d;
+    if (!target_resolve(rt, f, n->a, &r))
+      return NULL;
+
+    res = NULL;
+    a = target_get(rt, f, &r);
+    if (a && to_number(rt, a, &d)) {
+      b = mknumber(rt, n->op == P_INC ? d + 1 : d - 1);
+      if (b && target_put(rt, f, &r, b))
+        res = n->type == N_PREFIX ? incref(b) : mknumber(rt, d);
+      decref(rt, b);
+    }
+    decref(rt, a);
+    target_free(rt, &r);
+    return res;
+  }
+
+  case N_BINARY:
+    if (!(a = eval(rt, f, n->a)))
+      return NULL;
+    if (!(b = eval(rt, f, n->b))) {
+      decref(rt, a);
+      return NULL;
+    }
+    res = binary(rt, n->op, a, b);
+    decref(rt, a);
+    decref(rt, b);
+    return res;
+
+  case N_AND:
+  case N_OR:
+    if (!(a = eval(rt, f, n->a)))
+      return NULL;
+    if (to_boolean(a) == (n->type == N_OR))
+      return a;
+    decref(rt, a);
+    return eval(rt, f, n->b);
+
+  case N_ASSIGN: {
+    refRef r;
+    if (!target_resolve(rt, f, n->a, &r))
+      return NULL;
+
+    if (n->op == '=')
+      res = eval(rt, f, n->b);
+    else {
+      res = NULL;
+      a = target_get(rt, f, &r);
+      if (a && (b = eval(rt, f, n->b))) {
+        res = binary(rt, assign_operator(n->op), a, b);
+        decref(rt, b);
+      }
+      decref(rt, a);
+    }
+
+    if (res && !target_put(rt, f, &r, res)) {
+      decref(rt, res);
+      res = NULL;
+    }
+    target_free(rt, &r);
+    return res;
+  }
+
+  case N_COMMA:
+    if (!(a = eval(rt, f, n->a)))
+      return NULL;
+    decref(rt, a);
+    return eval(rt, f, n->b);
+
+  default:
+    assert(false);
+    return NULL;
+  }
+}
+
+static refCompletion
+exec_list(refRuntime *rt, refFrame *f, refNode **list, size_t count, refValue **rv)
+{
+  refCompletion c = C_NORMAL;
+  size_t i;
+
+  for (i = 0; i < count && c == C_NORMAL; i++)
+    c = exec(rt, f, list[i], rv);
+  return c;
+}
+
+/* Evaluates a condition; returns -1 on exception */
+static int
+condition(refRuntime *rt, refFrame *f, refNode *n)
+{
+  if (!n)
+    return 1;
+  refValue *v = eval(rt, f, n);
+  if (!v)
+    return -1;
+  int res = to_boolean(v);
+  decref(rt, v);
+  return res;
+}
+
+static refCompletion
+exec(refRuntime *rt, refFrame *f, refNode *n, refValue **rv)
+{
+  refCompletion c = C_NORMAL;
+  refValue *v;
+  size_t i;
+  int cond;
+
+  switch (n->type) {
+  case N_EMPTY:
+    return C_NORMAL;
+
+  case N_EXPR:
+    if (!(v = eval(rt, f, n->a)))
+      return C_THROW;
+    if (f->toplevel) {
+      decref(rt, f->completion);
+      f->completion = v;
+    } else
+      decref(rt, v);
+    return C_NORMAL;
+
+  case N_VAR:
+    for (i = 0; i < n->count; i++) {
+      refNode *id = n->list[i];
+      if (!id->a)
+        continue;
+      if (!(v = eval(rt, f, id->a)))
+        return C_THROW;
+      bool ok = var_put(rt, f, id->value, v);
+      decref(rt, v);
+      if (!ok)
+        return C_THROW;
+    }
+    return C_NORMAL;
+
+  case N_BLOCK:
+    return exec_list(rt, f, n->list, n->count, rv);
+
+  case N_IF:
+    if ((cond = condition(rt, f, n->a)) < 0)
+      return C_THROW;
+    if (cond)
+      return exec(rt, f, n->b, rv);
+    return n->c ? exec(rt, f, n->c, rv) : C_NORMAL;
+
+  case N_FOR:
+    if (n->a) {
+      if (n->a->type == N_VAR) {
+        if ((c = exec(rt, f, n->a, rv)) != C_NORMAL)
+          return c;
+      } else {
+        if (!(v = eval(rt, f, n->a)))
+          return C_THROW;
+        decref(rt, v);
+      }
+    }
+    while ((cond = condition(rt, f, n->b)) > 0) {
+      if ((c = exec(rt, f, n->d, rv)) != C_NORMAL)
+        return c;
+      if (n->c) {
+        if (!(v = eval(rt, f, n->c)))
+          return C_THROW;
+        decref(rt, v);
+      }
+    }
+    return cond < 0 ? C_THROW : C_NORMAL;
+
+  case N_RETURN:
+    v = n->a ? eval(rt, f, n->a) : incref(rt->undefined);
+    if (!v)
+      return C_THROW;
+    decref(rt, *rv);
+    *rv = v;
+    return C_RETURN;
+
+  case N_THROW:
+    if (!(v = eval(rt, f, n->a)))
+      return C_THROW;
+    decref(rt, rt->exception);
+    rt->exception = v;
+    return C_THROW;
+
+  default:
+    if (!(v = eval(rt, f, n)))
+      return C_THROW;
+    decref(rt, v);
+    return C_NORMAL;
+  }
+}
+
+/* Runs a program against the given global; returns the completion value */
+refValue *
+program_run(refRuntime *rt, refProgram *prg, refValue *global, refValue *ths)
+{
+  refValue *saved = rt->global, *rv = NULL;
+  refFrame frame;
+
+  memset(&frame, 0, sizeof(frame));
+  frame.scope = global;
+  frame.ths = ths;
+  frame.program = prg;
+  frame.toplevel = true;
+
+  rt->global = global;
+  prg->refs++;
+  if (!hoist(rt, prg->root, prg, global)) {
+    program_decref(prg);
+    rt->global = saved;
+    return NULL;
+  }
+
+  refCompletion c = exec_list(rt, &frame, prg->root->list, prg->root->count, &rv);
+  program_decref(prg);
+  rt->global = saved;
+  decref(rt, rv);
+
+  if (c == C_THROW) {
+    decref(rt, frame.completion);
+    return NULL;
+  }
+  if (c == C_RETURN) {
+    decref(rt, frame.completion);
+    return throw_error(rt, refProtoSyntaxError, "Illegal return statement");
+  }
+
+  return frame.completion ? frame.completion : incref(rt->undefined);
+}
+
+/*
+ * Builtins
+ */
+
+#define ARG(i) ((i) < argc ? argv[i] : rt->undefined)
+
+static refValue *
+builtin_new(refRuntime *rt, const char *name, refBuiltin func)
+{
+  refValue *fnc = object_new(rt, refClassFunction, rt->protos[refProtoFunction]);
+  if (!fnc)
+    return NULL;
+  OBJ(fnc)->builtin = func;
+
+  refValue *nm = mkstring(rt, name);
+  if (!nm || !prop_put(rt, OBJ(fnc), rt->s_name, nm, natusPropAttrProtected)) {
+    decref(rt, nm);
+    decref(rt, fnc);
+    return NULL;
+  }
+  decref(rt, nm);
+  return fnc;
+}
+
+static bool
+builtin_define(refRuntime *rt, refValue *obj, const char *name, refBuiltin func)
+{
+  refValue *fnc = builtin_new(rt, name, func);
+  if (!fnc)
+    return false;
+  bool res = prop_put_ascii(rt, obj, name, fnc, natusPropAttrDontEnum);
+  decref(rt, fnc);
+  return res;
+}
+
+static refValue *
+this_array(refRuntime *rt, refValue *ths, const char *method)
+{
+  if (ths && IS_OBJECT(ths) && OBJ(ths)->cls == refClassArray)
+    return ths;
+  return throw_error(rt, refProtoTypeError, "Array.prototype.%s called on a non-array", method);
+}
+
+/* Object */
+
+static refValue *
+bi_Object(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  if (IS_OBJECT(ARG(0)))
+    return incref(ARG(0));
+  return object_new_plain(rt);
+}
+
+static refValue *
+bi_Object_keys(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  if (!IS_OBJECT(ARG(0)))
+    return throw_error(rt, refProtoTypeError, "Object.keys called on a non-object");
+  return own_keys(rt, ARG(0), true);
+}
+
+static refValue *
+bi_Object_prototype_toString(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  static const char *names[] = {
+    "Object", "Array", "Function", "Error", "global", "Object", "Buffer", "Script"
+  };
+  char buf[32];
+
+  if (ths->kind == refKindUndefined)
+    return mkstring(rt, "[object Undefined]");
+  if (ths->kind == refKindNull)
+    return mkstring(rt, "[object Null]");
+  // Numbers and booleans have no prototypes of their own, and borrow this
+  if (!IS_OBJECT(ths))
+    return to_string(rt, ths);
+
+  snprintf(buf, sizeof(buf), "[object %s]", names[OBJ(ths)->cls]);
+  return mkstring(rt, buf);
+}
+
+/* Function */
+
+static refValue *
+bi_noop(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  return incref(rt->undefined);
+}
+
+static refValue *
+bi_Function_prototype_apply(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  refValue *args = ARG(1);
+
+  if (args->kind == refKindUndefined || args->kind == refKindNull)
+    return call_function(rt, ths, ARG(0), 0, NULL);
+  if (!IS_OBJECT(args) || OBJ(args)->cls != refClassArray)
+    return throw_error(rt, refProtoTypeError, "Function.prototype.apply requires an array");
+
+  /* Holes become undefined */
+  size_t i, len = OBJ(args)->nitems;
+  refValue **vals = malloc(sizeof(refValue*) * (len + 1));
+  if (!vals)
+    return throw_error(rt, refProtoRangeError, "Out of memory");
+  for (i = 0; i < len; i++)
+    vals[i] = incref(OBJ(args)->items[i] ? OBJ(args)->items[i] : rt->undefined);
+
+  refValue *res = call_function(rt, ths, ARG(0), len, vals);
+  for (i = 0; i < len; i++)
+    decref(rt, vals[i]);
+  free(vals);
+  return res;
+}
+
+/* Array */
+
+static refValue *
+bi_Array_prototype_push(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  size_t i;
+  if (!this_array(rt, ths, "push"))
+    return NULL;
+  for (i = 0; i < argc; i++)
+    if (!array_push(rt, OBJ(ths), argv[i]))
+      return throw_error(rt, refProtoRangeError, "Out of memory");
+  return mknumber(rt, OBJ(ths)->nitems);
+}
+
+static refValue *
+bi_Array_prototype_pop(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  if (!this_array(rt, ths, "pop"))
+    return NULL;
+
+  refObject *obj = OBJ(ths);
+  if (obj->nitems == 0)
+    return incref(rt->undefined);
+
+  refValue *res = obj->items[--obj->nitems];
+  obj->items[obj->nitems] = NULL;
+  return res ? res : incref(rt->undefined);
+}
+
+static refValue *
+bi_Array_prototype_join(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  natusChar *buf = NULL;
+  size_t len = 0, alloc = 0, i;
+
+  if (!this_array(rt, ths, "join"))
+    return NULL;
+
+  refValue *sep = ARG(0)->kind == refKindUndefined ? mkstring(rt, ",") : to_string(rt, ARG(0));
+  if (!sep)
+    return NULL;
+
+  for (i = 0; i < OBJ(ths)->nitems; i++) {
+    refValue *item = OBJ(ths)->items[i], *str = NULL;
+    if (item && item->kind != refKindUndefined && item->kind != refKindNull) {
+      if (!(str = to_string(rt, item))) {
+        free(buf);
+        decref(rt, sep);
+        return NULL;
+      }
+    }
+
+    size_t need = len + (i > 0 ? sep->u.string.len : 0) + (str ? str->u.string.len : 0) + 1;
+    if (need > alloc) {
+      alloc = need * 2;
+      natusChar *tmp = realloc(buf, sizeof(natusChar) * alloc);
+      if (!tmp) {
+        decref(rt, str);
+        decref(rt, sep);
+        free(buf);
+        return throw_error(rt, refProtoRangeError, "Out of memory");
+      }
+      buf = tmp;
+    }
+
+    if (i > 0) {
+      memcpy(buf + len, sep->u.string.chars, sizeof(natusChar) * sep->u.string.len);
+      len += sep->u.string.len;
+    }
+    if (str) {
+      memcpy(buf + len, str->u.string.chars, sizeof(natusChar) * str->u.string.len);
+      len += str->u.string.len;
+      decref(rt, str);
+    }
+  }
+  decref(rt, sep);
+
+  if (!buf)
+    return mkstring(rt, "");
+  buf[len] = 0;
+  return mkstring_take(rt, buf, len);
+}
+
+static refValue *
+bi_Array_prototype_filter(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  size_t i;
+
+  if (!this_array(rt, ths, "filter"))
+    return NULL;
+  if (!is_callable(ARG(0)))
+    return throw_error(rt, refProtoTypeError, "%s is not a function", type_of(ARG(0)));
+
+  refValue *res = array_new(rt, 0, NULL);
+  if (!res)
+    return NULL;
+
+  incref(ths);
+  for (i = 0; i < OBJ(ths)->nitems; i++) {
+    refValue *item = OBJ(ths)->items[i];
+    if (!item)
+      continue;
+
+    refValue *args[3] = { incref(item), mknumber(rt, i), ths };
+    refValue *r = args[1] ? call_function(rt, ARG(0), ARG(1), 3, args) : NULL;
+    bool ok = r && (!to_boolean(r) || array_push(rt, OBJ(res), args[0]));
+    decref(rt, args[0]);
+    decref(rt, args[1]);
+    decref(rt, r);
+    if (!ok) {
+      decref(rt, res);
+      res = NULL;
+      break;
+    }
+  }
+  decref(rt, ths);
+  return res;
+}
+
+/* String */
+
+static refValue *
+bi_String_prototype_charCodeAt(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  double d = 0;
+  refValue *str = to_string(rt, ths), *res;
+  if (!str)
+    return NULL;
+  if (!to_number(rt, ARG(0), &d)) {
+    decref(rt, str);
+    return NULL;
+  }
+  if (isnan(d))
+    d = 0;
+
+  if (d < 0 || d >= str->u.string.len)
+    res = mknumber(rt, NAN);
+  else
+    res = mknumber(rt, str->u.string.chars[(size_t) d]);
+  decref(rt, str);
+  return res;
+}
+
+static refValue *
+bi_String_prototype_indexOf(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  refValue *str = to_string(rt, ths);
+  if (!str)
+    return NULL;
+  refValue *sub = to_string(rt, ARG(0));
+  if (!sub) {
+    decref(rt, str);
+    return NULL;
+  }
+
+  size_t i, len = str->u.string.len, slen = sub->u.string.len;
+  double res = -1;
+  for (i = 0; slen <= len && i <= len - slen; i++) {
+    if (!memcmp(str->u.string.chars + i, sub->u.string.chars, sizeof(natusChar) * slen)) {
+      res = i;
+      break;
+    }
+  }
+  decref(rt, sub);
+  decref(rt, str);
+  return mknumber(rt, res);
+}
+
+static refValue *
+bi_String_prototype_split(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  size_t i, last = 0;
+
+  refValue *str = to_string(rt, ths);
+  if (!str)
+    return NULL;
+
+  refValue *res = array_new(rt, 0, NULL);
+  if (!res || ARG(0)->kind == refKindUndefined) {
+    if (res && !array_push(rt, OBJ(res), str)) {
+      decref(rt, res);
+      res = NULL;
+    }
+    decref(rt, str);
+    return res;
+  }
+
+  refValue *sep = to_string(rt, ARG(0));
+  if (!sep)
+    goto error;
+
+  size_t slen = sep->u.string.len, len = str->u.string.len;
+  for (i = 0; i < len; i++) {
+    if (slen > 0 && (i + slen > len || memcmp(str->u.string.chars + i, sep->u.string.chars, sizeof(natusChar) * slen)))
+      continue;
+
+    size_t plen = slen > 0 ? i - last : 1;
+    refValue *part = mkstring_utf16(rt, str->u.string.chars + (slen > 0 ? last : i), plen);
+    if (!part || !array_push(rt, OBJ(res), part)) {
+      decref(rt, part);
+      goto error;
+    }
+    decref(rt, part);
+    if (slen > 0) {
+      i += slen - 1;
+      last = i + 1;
+    }
+  }
+
+  if (slen > 0) {
+    refValue *part = mkstring_utf16(rt, str->u.string.chars + last, len - last);
+    if (!part || !array_push(rt, OBJ(res), part)) {
+      decref(rt, part);
+      goto error;
+    }
+    decref(rt, part);
+  }
+
+  decref(rt, sep);
+  decref(rt, str);
+  return res;
+
+error:
+  decref(rt, sep);
+  decref(rt, str);
+  decref(rt, res);
+  return NULL;
+}
+
+static refValue *
+bi_String_prototype_toUpperCase(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  size_t i;
+  refValue *str = to_string(rt, ths);
+  if (!str)
+    return NULL;
+
+  refValue *res = mkstring_utf16(rt, str->u.string.chars, str->u.string.len);
+  decref(rt, str);
+  if (!res)
+    return NULL;
+
+  for (i = 0; i < res->u.string.len; i++) {
+    natusChar c = res->u.string.chars[i];
+    if (c < 128)
+      res->u.string.chars[i] = toupper(c);
+  }
+  res->u.string.hash = chars_hash(res->u.string.chars, res->u.string.len);
+  return res;
+}
+
+/* Errors */
+
+static refValue *
+bi_Error(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  refValue *proto = get_named(rt, fnc, rt->s_prototype);
+  if (!proto)
+    return NULL;
+
+  refValue *err = object_new(rt, refClassError, IS_OBJECT(proto) ? proto : rt->protos[refProtoError]);
+  decref(rt, proto);
+  if (!err)
+    return NULL;
+
+  if (argc > 0 && argv[0]->kind != refKindUndefined) {
+    refValue *msg = to_string(rt, argv[0]);
+    if (!msg || !prop_put(rt, OBJ(err), rt->s_message, msg, natusPropAttrDontEnum)) {
+      decref(rt, msg);
+      decref(rt, err);
+      return NULL;
+    }
+    decref(rt, msg);
+  }
+
+  return err;
+}
+
+static refValue *
+bi_Error_prototype_toString(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  refValue *name = NULL, *msg = NULL, *sname = NULL, *smsg = NULL, *res = NULL;
+
+  if (!IS_OBJECT(ths))
+    return throw_error(rt, refProtoTypeError, "Error.prototype.toString called on a non-object");
+
+  if (!(name = get_named(rt, ths, rt->s_name)) || !(msg = get_named(rt, ths, rt->s_message)))
+    goto out;
+
+  sname = name->kind == refKindUndefined ? mkstring(rt, "Error") : to_string(rt, name);
+  smsg = msg->kind == refKindUndefined ? mkstring(rt, "") : to_string(rt, msg);
+  if (!sname || !smsg)
+    goto out;
+
+  if (sname->u.string.len == 0)
+    res = incref(smsg);
+  else if (smsg->u.string.len == 0)
+    res = incref(sname);
+  else {
+    refValue *sep = mkstring(rt, ": ");
+    refValue *tmp = sep ? string_concat(rt, sname, sep) : NULL;
+    res = tmp ? string_concat(rt, tmp, smsg) : NULL;
+    decref(rt, sep);
+    decref(rt, tmp);
+  }
+
+out:
+  decref(rt, name);
+  decref(rt, msg);
+  decref(rt, sname);
+  decref(rt, smsg);
+  return res;
+}
+
+/*
+ * JSON
+ */
+
+typedef struct {
+  natusChar *buf;
+  size_t     len;
+  size_t     alloc;
+} refBuffer;
+
+static bool
+buffer_append(refBuffer *b, const natusChar *chars, size_t len)
+{
+  if (b->len + len + 1 > b->alloc) {
+    size_t size = b->alloc ? b->alloc : 64;
+    while (size < b->len + len + 1)
+      size *= 2;
+    natusChar *tmp = realloc(b->buf, sizeof(natusChar) * size);
+    if (!tmp)
+      return false;
+    b->buf = tmp;
+    b->alloc = size;
+  }
+  memcpy(b->buf + b->len, chars, sizeof(natusChar) * len);
+  b->len += len;
+  return true;
+}
+
+typedef struct {
+  const natusChar *c;
+  size_t           len;
+  size_t           pos;
+} refJSONParser;
+
+static void
+json_ws(refJSONParser *p)
+{
+  while (p->pos < p->len && (p->c[p->pos] == ' ' || p->c[p->pos] == '\t'
+         || p->c[p->pos] == '\n' || p->c[p->pos] == '\r'))
+    p->pos++;
+}
+
+static refValue *
+json_parse_value(refRuntime *rt, refJSONParser *p, unsigned depth);
+
+static refValue *
+json_parse_string(refRuntime *rt, refJSONParser *p)
+{
+  refBuffer b;
+  size_t last;
+
+  memset(&b, 0, sizeof(b));
+  last = ++p->pos;
+  while (p->pos < p->len && p->c[p->pos] != '"') {
+    natusChar c = p->c[p->pos];
+    if (c < 0x20)
+      goto error;
+    if (c != '\\') {
+      p->pos++;
+      continue;
+    }
+
+    if (!buffer_append(&b, p->c + last, p->pos - last) || ++p->pos >= p->len)
+      goto error;
+    switch (p->c[p->pos]) {
+    case 'b': c = '\b'; break;
+    case 'f': c = '\f'; break;
+    case 'n': c = '\n'; break;
+    case 'r': c = '\r'; break;
+    case 't': c = '\t'; break;
+    case '"':
+    case '\\':
+    case '/': c = p->c[p->pos]; break;
+    case 'u': {
+      int i;
+      c = 0;
+      for (i = 0; i < 4; i++) {
+        if (++p->pos >= p->len || hexval(p->c[p->pos]) < 0)
+          goto error;
+        c = c * 16 + hexval(p->c[p->pos]);
+      }
+      break;
+    }
+    default:
+      goto error;
+    }
+    if (!buffer_append(&b, &c, 1))
+      goto error;
+    last = ++p->pos;
+  }
+  if (p->pos >= p->len || !buffer_append(&b, p->c + last, p->pos - last))
+    goto error;
+  p->pos++;
+
+  if (!b.buf)
+    return mkstring(rt, "");
+  b.buf[b.len] = 0;
+  return mkstring_take(rt, b.buf, b.len);
+
+error:
+  free(b.buf);
+  return throw_error(rt, refProtoSyntaxError, "JSON.parse: bad string");
+}
+
+static refValue *
+json_parse_value(refRuntime *rt, refJSONParser *p, unsigned depth)
+{
+  refValue *res = NULL;
+
+  json_ws(p);
+  if (p->pos >= p->len)
+    return throw_error(rt, refProtoSyntaxError, "JSON.parse: unexpected end of data");
+  if (depth > REF_MAX_DEPTH)
+    return throw_error(rt, refProtoRangeError, "JSON.parse: nesting too deep");
+
+  natusChar c = p->c[p->pos];
+  if (c == '"')
+    return json_parse_string(rt, p);
+
+  if (c == '{' || c == '[') {
+    bool array = c == '[';
+    natusChar close = array ? ']' : '}';
+
+    res = array ? array_new(rt, 0, NULL) : object_new_plain(rt);
+    if (!res)
+      return NULL;
+
+    p->pos++;
+    json_ws(p);
+    if (p->pos < p->len && p->c[p->pos] == close) {
+      p->pos++;
+      return res;
+    }
+
+    for (;;) {
+      refValue *key = NULL, *val;
+      if (!array) {
+        json_ws(p);
+        if (p->pos >= p->len || p->c[p->pos] != '"')
+          goto error;
+        if (!(key = json_parse_string(rt, p)))
+          goto exception;
+        json_ws(p);
+        if (p->pos >= p->len || p->c[p->pos++] != ':') {
+          decref(rt, key);
+          goto error;
+        }
+      }
+
+      if (!(val = json_parse_value(rt, p, depth + 1))) {
+        decref(rt, key);
+        goto exception;
+      }
+      bool ok = array ? array_push(rt, OBJ(res), val) : put_property(rt, res, key, val);
+      decref(rt, key);
+      decref(rt, val);
+      if (!ok)
+        goto exception;
+
+      json_ws(p);
+      if (p->pos < p->len && p->c[p->pos] == ',') {
+        p->pos++;
+        continue;
+      }
+      if (p->pos < p->len && p->c[p->pos] == close) {
+        p->pos++;
+        return res;
+      }
+      goto error;
+    }
+  }
+
+  if (c == '-' || (c >= '0' && c <= '9')) {
+    char buf[64];
+    size_t n = 0;
+    while (p->pos < p->len && n < sizeof(buf) - 1 && p->c[p->pos] < 128
+           && strchr("0123456789+-.eE", p->c[p->pos]))
+      buf[n++] = p->c[p->pos++];
+    buf[n] = '\0';
+
+    char *end;
+    double d = strtod(buf, &end);
+    if (*end)
+      return throw_error(rt, refProtoSyntaxError, "JSON.parse: bad number");
+    return mknumber(rt, d);
+  }
+
+  static const char *words[] = { "true", "false", "null", NULL };
+  size_t i, k;
+  for (i = 0; words[i]; i++) {
+    for (k = 0; words[i][k] && p->pos + k < p->len && p->c[p->pos + k] == (natusChar) words[i][k]; k++)
+      ;
+    if (!words[i][k]) {
+      p->pos += k;
+      return i == 2 ? incref(rt->null) : mkbool(rt, i == 0);
+    }
+  }
+
+  return throw_error(rt, refProtoSyntaxError, "JSON.parse: unexpected character");
+
+error:
+  throw_error(rt, refProtoSyntaxError, "JSON.parse: unexpected character");
+exception:
+  decref(rt, res);
+  return NULL;
+}
+
+static refValue *
+bi_JSON_parse(refRuntime *rt, refValue *fnc, refValue *ths, size_t argc, refValue **argv, bool construct)
+{
+  refJSONParser p;
+
+  refValue *str = to_string(rt, ARG(0));
+  if (!str)
+    return NULL;
+
+  p.c = str->u.string.chars;
+  p.len = str->u.string.len;
+  p.pos = 0;
+
+  refValue *res = json_parse_value(rt, &p, 0);
+  if (res) {
+    json_ws(&p);
+    if (p.pos < p.len) {
+      decref(rt, res);
+      res = throw_error(rt, refProtoSyntaxError, "JSON.parse: unexpected data after the value");
+    }
+  }
+  decref(rt, str);
+  return res;
+}
+
+/*
+ * Realm setup
+ */
+
+typedef struct {
+  const char *name;
+  refBuiltin  func;
+} refMethod;
+
+static const char *protoNames[refProtoCount] = {
+  "Object", "Function", "Array", "String",
+  "Error", "RangeError", "ReferenceError", "SyntaxError", "TypeError"
+};
+
+static bool
+define_methods(refRuntime *rt, refValue *obj, const refMethod *methods)
+{
+  for (; methods->name; methods++)
+    if (!builtin_define(rt, obj, methods->name, methods->func))
+      return false;
+  return true;
+}
+
+/* Only Object and the errors have constructors */
+static bool
+define_ctor(refRuntime *rt, refProto proto, const refMethod *methods, const refMethod *statics)
+{
+  refValue *ctor = builtin_new(rt, protoNames[proto], proto == refProtoObject ? bi_Object : bi_Error);
+  if (!ctor)
+    return false;
+  rt->ctors[proto] = ctor;
+
+  if (!prop_put(rt, OBJ(ctor), rt->s_prototype, rt->protos[proto], natusPropAttrProtected)
+      || !prop_put(rt, OBJ(rt->protos[proto]), rt->s_constructor, ctor, natusPropAttrDontEnum))
+    return false;
+  if (methods && !define_methods(rt, rt->protos[proto], methods))
+    return false;
+  if (statics && !define_methods(rt, ctor, statics))
+    return false;
+  return true;
+}
+
+bool
+realm_init(refRuntime *rt)
+{
+  static const refMethod object_methods[] = {
+    { "toString", bi_Object_prototype_toString },
+    { NULL, NULL }
+  };
+  static const refMethod object_statics[] = {
+    { "keys", bi_Object_keys },
+    { NULL, NULL }
+  };
+  static const refMethod function_methods[] = {
+    { "apply", bi_Function_prototype_apply },
+    { NULL, NULL }
+  };
+  static const refMethod array_methods[] = {
+    { "push", bi_Array_prototype_push },
+    { "pop", bi_Array_prototype_pop },
+    { "join", bi_Array_prototype_join },
+    { "toString", bi_Array_prototype_join },
+    { "filter", bi_Array_prototype_filter },
+    { NULL, NULL }
+  };
+  static const refMethod string_methods[] = {
+    { "charCodeAt", bi_String_prototype_charCodeAt },
+    { "indexOf", bi_String_prototype_indexOf },
+    { "split", bi_String_prototype_split },
+    { "toUpperCase", bi_String_prototype_toUpperCase },
+    { NULL, NULL }
+  };
+  static const refMethod error_methods[] = {
+    { "toString", bi_Error_prototype_toString },
+    { NULL, NULL }
+  };
+  static const refMethod json_methods[] = {
+    { "parse", bi_JSON_parse },
+    { NULL, NULL }
+  };
+  int i;
+
+  /* Prototypes first, since everything else depends on them */
+  if (!(rt->protos[refProtoObject] = object_new(rt, refClassObject, NULL)))
+    return false;
+  if (!(rt->protos[refProtoFunction] = object_new(rt, refClassFunction, rt->protos[refProtoObject])))
+    return false;
+  OBJ(rt->protos[refProtoFunction])->builtin = bi_noop;
+  if (!(rt->protos[refProtoArray] = object_new(rt, refClassArray, rt->protos[refProtoObject])))
+    return false;
+  if (!(rt->protos[refProtoString] = object_new_plain(rt)))
+    return false;
+  for (i = refProtoError; i < refProtoCount; i++)
+    if (!(rt->protos[i] = object_new(rt, refClassObject, i == refProtoError ? rt->protos[refProtoObject] : rt->protos[refProtoError])))
+      return false;
+
+  if (!define_ctor(rt, refProtoObject, object_methods, object_statics)
+      || !define_methods(rt, rt->protos[refProtoFunction], function_methods)
+      || !define_methods(rt, rt->protos[refProtoArray], array_methods)
+      || !define_methods(rt, rt->protos[refProtoString], string_methods))
+    return false;
+
+  for (i = refProtoError; i < refProtoCount; i++) {
+    refValue *name = mkstring(rt, protoNames[i]);
+    refValue *empty = mkstring(rt, "");
+    bool ok = name && empty
+        && define_ctor(rt, i, i == refProtoError ? error_methods : NULL, NULL)
+        && prop_put(rt, OBJ(rt->protos[i]), rt->s_name, name, natusPropAttrDontEnum)
+        && prop_put(rt, OBJ(rt->protos[i]), rt->s_message, empty, natusPropAttrDontEnum);
+    decref(rt, name);
+    decref(rt, empty);
+    if (!ok)
+      return false;
+  }
+
+  return (rt->json = object_new_plain(rt)) && define_methods(rt, rt->json, json_methods);
+}
+
+bool
+global_init(refRuntime *rt, refValue *glb)
+{
+  int i;
+
+  for (i = 0; i < refProtoCount; i++)
+    if (rt->ctors[i] && !prop_put_ascii(rt, glb, protoNames[i], rt->ctors[i], natusPropAttrDontEnum))
+      return false;
+
+  refValue *nan = mknumber(rt, NAN), *inf = mknumber(rt, INFINITY);
+  bool ok = nan && inf
+      && prop_put_ascii(rt, glb, "NaN", nan, natusPropAttrProtected)
+      && prop_put_ascii(rt, glb, "Infinity", inf, natusPropAttrProtected)
+      && prop_put_ascii(rt, glb, "undefined", rt->undefined, natusPropAttrProtected)
+      && prop_put_ascii(rt, glb, "JSON", rt->json, natusPropAttrDontEnum);
+  decref(rt, nan);
+  decref(rt, inf);
+  return ok;
+}
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include <jsapi.h>
+#include <jsxdrapi.h>
 
 typedef JSContext* natusEngCtx;
 typedef jsval* natusEngVal;
@@ -125,22 +126,21 @@ property_handler(JSContext *ctx, JSObject *object, jsid id, jsval *vp, natusProp
 static inline JSBool
 call_handler(JSContext *ctx, uintN argc, jsval *vp, bool constr)
 {
-  // Allocate our array of arguments
-  JSObject *arga = JS_NewArrayObject(ctx, argc, JS_ARGV(ctx, vp));
-  if (!arga)
-    return JS_FALSE;
-
   // Get the private
   natusPrivate *priv = get_private(ctx, JSVAL_TO_OBJECT(JS_CALLEE(ctx, vp)));
   if (!priv)
     return JS_FALSE;
 
+  // Lend the arguments, they are rooted by the call frame
+  natusEngVal argv[argc > 0 ? argc : 1];
+  for (uintN i = 0; i < argc; i++)
+    argv[i] = &JS_ARGV(ctx, vp)[i];
+
   // Do the call
   natusEngValFlags flags;
   natusEngVal obj = mkjsval(ctx, JS_CALLEE(ctx, vp));
   natusEngVal ths = mkjsval(ctx, constr ? JSVAL_VOID : JS_THIS(ctx, vp));
-  natusEngVal arg = mkjsval(ctx, OBJECT_TO_JSVAL(arga));
-  natusEngVal res = natus_handle_call(obj, priv, ths, arg, &flags);
+  natusEngVal res = natus_handle_call_argv(obj, priv, ths, argc, argv, &flags);
 
   // Handle the results
   if (flags & natusEngValFlagException) {
@@ -267,6 +267,13 @@ static JSClass fncdef =
 static JSClass objdef =
   { "NativeObject", JSCLASS_HAS_PRIVATE, JS_PropertyStub, JS_PropertyStub, JS_PropertyStub, JS_StrictPropertyStub, JS_EnumerateStub, JS_ResolveStub, JS_ConvertStub, obj_finalize, };
 
+static JSClass bufdef =
+  { "Buffer", JSCLASS_HAS_PRIVATE | JSCLASS_NEW_ENUMERATE, JS_PropertyStub, obj_del, obj_get, obj_set, (JSEnumerateOp) obj_enum, JS_ResolveStub, JS_ConvertStub, obj_finalize, };
+
+// Holds a compiled script object in its reserved slot
+static JSClass scrdef =
+  { "Script", JSCLASS_HAS_RESERVED_SLOTS(1), JS_PropertyStub, JS_PropertyStub, JS_PropertyStub, JS_StrictPropertyStub, JS_EnumerateStub, JS_ResolveStub, JS_ConvertStub, JS_FinalizeStub, };
+
 static void
 report_error(JSContext *cx, const char *message, JSErrorReport *report)
 {
@@ -409,6 +416,60 @@ sm_new_string_utf16(const natusEngCtx ctx, const natusChar *str, size_t len, nat
   return mkjsval(ctx, STRING_TO_JSVAL(s));
 }
 
+static natusEngVal
+sm_new_string_external_utf8(const natusEngCtx ctx, const char *str, size_t len, natusFreeFunction freefnc, natusEngValFlags *flags)
+{
+  // SpiderMonkey only shares UTF-16, so this one copies
+  natusEngVal ret = sm_new_string_utf8(ctx, str, len, flags);
+  if (freefnc)
+    freefnc((void *) str);
+  return ret;
+}
+
+typedef struct {
+  natusFreeFunction free;
+  const natusChar  *chars;
+} smExternal;
+
+static intN exttype = -1;
+
+static void
+sm_external_finalize(JSContext *ctx, JSString *str)
+{
+  smExternal *ext = JS_GetExternalStringClosure(ctx, str);
+  if (ext) {
+    ext->free((void *) ext->chars);
+    free(ext);
+  }
+}
+
+static natusEngVal
+sm_new_string_external_utf16(const natusEngCtx ctx, const natusChar *str, size_t len, natusFreeFunction freefnc, natusEngValFlags *flags)
+{
+  smExternal *ext = NULL;
+  JSString *s = NULL;
+
+
+  // Static strings need no closure
+  if (exttype >= 0 && (!freefnc || (ext = malloc(sizeof(smExternal))))) {
+    if (ext) {
+      ext->free = freefnc;
+      ext->chars = str;
+    }
+    s = JS_NewExternalStringWithClosure(ctx, str, len, exttype, ext);
+  }
+
+  if (!s) {
+    natusEngVal ret = sm_new_string_utf16(ctx, str, len, flags);
+    free(ext);
+    if (freefnc)
+      freefnc((void *) str);
+    return ret;
+  }
+
+  return mkjsval(ctx, STRING_TO_JSVAL(s));
+}
+
 static natusEngVal
 sm_new_array(const natusEngCtx ctx, const natusEngVal *array, size_t len, natusEngValFlags *flags)
 {
@@ -432,6 +493,31 @@ sm_new_array(const natusEngCtx ctx, const natusEngVal *array, size_t len, natusE
   return mkjsval(ctx, v);
 }
 
+static natusEngVal
+sm_new_array_doubles(const natusEngCtx ctx, const double *array, size_t len, natusEngValFlags *flags)
+{
+  jsval *valv = calloc(len, sizeof(jsval));
+  if (!valv)
+    return NULL;
+
+  int i;
+  for (i = 0; i < len; i++) {
+    if (!JS_NewNumberValue(ctx, array[i], &valv[i]))
+      break;
+  }
+
+  JSObject* obj = i == len ? JS_NewArrayObject(ctx, i, valv) : NULL;
+  free(valv);
+
+  jsval v;
+  if (obj)
+    v = OBJECT_TO_JSVAL(obj);
+  else if (JS_IsExceptionPending(ctx) && JS_GetPendingException(ctx, &v))
+    *flags |= natusEngValFlagException;
+
+  return mkjsval(ctx, v);
+}
+
 static natusEngVal
 sm_new_function(const natusEngCtx ctx, const char *name, natusPrivate *priv, natusEngValFlags *flags)
 {
@@ -452,32 +538,39 @@ sm_new_function(const natusEngCtx ctx, const char *name, natusPrivate *priv, nat
   return mkjsval(ctx, v);
 }
 
-static natusEngVal
-sm_new_object(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, natusEngValFlags *flags)
+/* One JSClass per set of hooks, shared by every natusClass which has it.
+ * These and the external string type are process wide, so they are all
+ * set up when we are loaded, before any context can race to use them. */
+static JSClass clsdefs[natusClassHookAll + 1];
+
+__attribute__((constructor))
+static void
+_init()
 {
-  JSClass *jscls = NULL;
-  if (cls) {
-    jscls = malloc(sizeof(JSClass));
-    if (!jscls)
-      goto error;
+  JS_SetCStringsAreUTF8();
+  exttype = JS_AddExternalStringFinalizer(sm_external_finalize);
 
-    memset(jscls, 0, sizeof(JSClass));
-    jscls->name = cls->call ? "NativeFunction" : "NativeObject";
-    jscls->flags = cls->enumerate ? JSCLASS_HAS_PRIVATE | JSCLASS_NEW_ENUMERATE : JSCLASS_HAS_PRIVATE;
+  for (size_t hooks = 0; hooks <= natusClassHookAll; hooks++) {
+    JSClass *jscls = &clsdefs[hooks];
+    jscls->flags = hooks & natusClassHookEnumerate ? JSCLASS_HAS_PRIVATE | JSCLASS_NEW_ENUMERATE : JSCLASS_HAS_PRIVATE;
     jscls->addProperty = JS_PropertyStub;
-    jscls->delProperty = cls->del ? obj_del : JS_PropertyStub;
-    jscls->getProperty = cls->get ? obj_get : JS_PropertyStub;
-    jscls->setProperty = cls->set ? obj_set : JS_StrictPropertyStub;
-    jscls->enumerate = cls->enumerate ? (JSEnumerateOp) obj_enum : JS_EnumerateStub;
+    jscls->delProperty = hooks & natusClassHookDel ? obj_del : JS_PropertyStub;
+    jscls->getProperty = hooks & natusClassHookGet ? obj_get : JS_PropertyStub;
+    jscls->setProperty = hooks & natusClassHookSet ? obj_set : JS_StrictPropertyStub;
+    jscls->enumerate = hooks & natusClassHookEnumerate ? (JSEnumerateOp) obj_enum : JS_EnumerateStub;
     jscls->resolve = JS_ResolveStub;
     jscls->convert = JS_ConvertStub;
     jscls->finalize = obj_finalize;
-    jscls->call = cls->call ? obj_call : NULL;
-    jscls->construct = cls->call ? obj_new : NULL;
-
-    if (!natus_private_push(priv, jscls, free))
-      goto error;
+    jscls->call = hooks & natusClassHookCall ? obj_call : NULL;
+    jscls->construct = hooks & natusClassHookCall ? obj_new : NULL;
+    jscls->name = hooks & natusClassHookCall ? "NativeFunction" : "NativeObject";
   }
+}
+
+static natusEngVal
+sm_new_object(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, natusEngValFlags *flags)
+{
+  JSClass *jscls = cls ? &clsdefs[natus_class_hooks(cls)] : NULL;
 
   // Build the object
   jsval v = JSVAL_VOID;
@@ -498,6 +591,24 @@ error:
   return NULL;
 }
 
+static natusEngVal
+sm_new_buffer(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, void *data, size_t len, natusEngValFlags *flags)
+{
+  // The bytes are served by the buffer class hooks
+  jsval v = JSVAL_VOID;
+  JSObject* obj = JS_NewObject(ctx, &bufdef, NULL, NULL);
+  if (obj && JS_SetPrivate(ctx, obj, priv))
+    v = OBJECT_TO_JSVAL(obj);
+  else {
+    natus_private_free(priv);
+    if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &v))
+      return NULL;
+    *flags |= natusEngValFlagException;
+  }
+
+  return mkjsval(ctx, v);
+}
+
 static natusEngVal
 sm_new_null(const natusEngCtx ctx, natusEngValFlags *flags)
 {
@@ -516,6 +627,19 @@ sm_to_bool(const natusEngCtx ctx, const natusEngVal val)
   return JSVAL_TO_BOOLEAN(*val);
 }
 
+static jsid
+index_id(JSContext *ctx, uint32_t idx)
+{
+  if (idx <= JSID_INT_MAX)
+    return INT_TO_JSID(idx);
+
+  jsid vid = JSID_VOID;
+  jsval num;
+  if (JS_NewNumberValue(ctx, idx, &num))
+    JS_ValueToId(ctx, num, &vid);
+  return vid;
+}
+
 static double
 sm_to_double(const natusEngCtx ctx, const natusEngVal val)
 {
@@ -524,6 +648,19 @@ sm_to_double(const natusEngCtx ctx, const natusEngVal val)
   return d;
 }
 
+static bool
+sm_to_doubles(const natusEngCtx ctx, const natusEngVal val, double *array, size_t len)
+{
+  JSObject *obj = JSVAL_TO_OBJECT(*val);
+  jsval v;
+
+  for (size_t i = 0; i < len; i++) {
+    if (!JS_GetPropertyById(ctx, obj, index_id(ctx, i), &v) || !JS_ValueToNumber(ctx, v, &array[i]))
+      return false;
+  }
+  return true;
+}
+
 static char *
 sm_to_string_utf8(const natusEngCtx ctx, const natusEngVal val, size_t *len)
 {
@@ -561,6 +698,58 @@ sm_to_string_utf16(const natusEngCtx ctx, const natusEngVal val, size_t *len)
   return NULL;
 }
 
+static size_t
+sm_to_string_utf8_buffer(const natusEngCtx ctx, const natusEngVal val, char *buf, size_t size)
+{
+  JSString *str = JS_ValueToString(ctx, *val);
+  if (!str)
+    return (size_t) -1;
+
+  size_t len = JS_GetStringEncodingLength(ctx, str);
+  if (len == (size_t) -1 || size == 0)
+    return len;
+
+  // Only whole characters are encoded, and the rest of buf is zeroed
+  if (JS_EncodeStringToBuffer(str, buf, size - 1) == (size_t) -1)
+    return (size_t) -1;
+  buf[len < size - 1 ? len : size - 1] = '\0';
+  return len;
+}
+
+static size_t
+sm_to_string_utf16_range(const natusEngCtx ctx, const natusEngVal val, size_t offset, natusChar *buf, size_t size)
+{
+  JSString *str = JS_ValueToString(ctx, *val);
+  if (!str)
+    return (size_t) -1;
+
+  size_t len;
+  const jschar *chars = JS_GetStringCharsAndLength(ctx, str, &len);
+  if (!chars)
+    return (size_t) -1;
+
+  if (offset >= len)
+    return 0;
+  if (size > len - offset)
+    size = len - offset;
+  memcpy(buf, chars + offset, sizeof(natusChar) * size);
+  return size;
+}
+
+static const natusChar *
+sm_string_view(const natusEngCtx ctx, const natusEngVal val, size_t *len, void **token)
+{
+  // Flattens ropes in place; the value keeps the string alive
+  if (!JSVAL_IS_STRING(*val))
+    return NULL;
+  return JS_GetStringCharsAndLength(ctx, JSVAL_TO_STRING(*val), len);
+}
+
+static void
+sm_string_release(const natusEngCtx ctx, void *token)
+{
+}
+
 natusEngVal
 sm_del(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, natusEngValFlags *flags)
 {
@@ -626,6 +815,34 @@ sm_set(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, const natus
   return mkjsval(ctx, rval);
 }
 
+natusEngVal
+sm_get_index(const natusEngCtx ctx, natusEngVal val, uint32_t idx, natusEngValFlags *flags)
+{
+  jsval rval = JSVAL_VOID;
+  if (!JS_GetPropertyById(ctx, JSVAL_TO_OBJECT(*val), index_id(ctx, idx), &rval)) {
+    *flags |= natusEngValFlagException;
+    if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &rval))
+      return NULL;
+  }
+
+  return mkjsval(ctx, rval);
+}
+
+natusEngVal
+sm_set_index(const natusEngCtx ctx, natusEngVal val, uint32_t idx, const natusEngVal value, natusEngValFlags *flags)
+{
+  jsval rval = *value;
+  if (JS_SetPropertyById(ctx, JSVAL_TO_OBJECT(*val), index_id(ctx, idx), &rval))
+    rval = BOOLEAN_TO_JSVAL(true);
+  else {
+    *flags |= natusEngValFlagException;
+    if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &rval))
+      return NULL;
+  }
+
+  return mkjsval(ctx, rval);
+}
+
 natusEngVal
 sm_enumerate(const natusEngCtx ctx, natusEngVal val, natusEngValFlags *flags)
 {
@@ -653,6 +870,30 @@ sm_enumerate(const natusEngCtx ctx, natusEngVal val, natusEngValFlags *flags)
   return mkjsval(ctx, OBJECT_TO_JSVAL(array));
 }
 
+static natusEngVal
+do_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, uintN argc, jsval *argv, natusEngValFlags *flags)
+{
+  jsval rval = JSVAL_VOID;
+  if (JSVAL_IS_VOID(*ths)) {
+    JSObject *obj = JS_New(ctx, JSVAL_TO_OBJECT(*func), argc, argv);
+    if (obj)
+      rval = OBJECT_TO_JSVAL(obj);
+    else {
+      *flags |= natusEngValFlagException;
+      if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &rval))
+        return NULL;
+    }
+  } else {
+    if (!JS_CallFunctionValue(ctx, JSVAL_TO_OBJECT(*ths), *func, argc, argv, &rval)) {
+      *flags |= natusEngValFlagException;
+      if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &rval))
+        return NULL;
+    }
+  }
+
+  return mkjsval(ctx, rval);
+}
+
 static natusEngVal
 sm_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal args, natusEngValFlags *flags)
 {
@@ -676,30 +917,19 @@ sm_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal ar
   }
 
   // Call the function
-  jsval rval = JSVAL_VOID;
-  if (JSVAL_IS_VOID(*ths)) {
-    JSObject *obj = JS_New(ctx, JSVAL_TO_OBJECT(*func), len, argv);
-    if (obj)
-      rval = OBJECT_TO_JSVAL(obj);
-    else {
-      *flags |= natusEngValFlagException;
-      if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &rval)) {
-        free(argv);
-        return NULL;
-      }
-    }
-  } else {
-    if (!JS_CallFunctionValue(ctx, JSVAL_TO_OBJECT(*ths), *func, len, argv, &rval)) {
-      *flags |= natusEngValFlagException;
-      if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &rval)) {
-        free(argv);
-        return NULL;
-      }
-    }
-  }
+  natusEngVal rslt = do_call(ctx, func, ths, len, argv, flags);
   free(argv);
+  return rslt;
+}
 
-  return mkjsval(ctx, rval);
+static natusEngVal
+sm_call_argv(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, size_t argc, const natusEngVal *argv, natusEngValFlags *flags)
+{
+  jsval args[argc > 0 ? argc : 1];
+  for (size_t i = 0; i < argc; i++)
+    args[i] = *argv[i];
+
+  return do_call(ctx, func, ths, argc, args, flags);
 }
 
 static natusEngVal
@@ -722,6 +952,130 @@ sm_evaluate(const natusEngCtx ctx, natusEngVal ths, const natusEngVal jscript, c
   return mkjsval(ctx, rval);
 }
 
+static JSObject *
+script_wrap(JSContext *ctx, JSObject *script)
+{
+  JSObject *obj = JS_NewObject(ctx, &scrdef, NULL, NULL);
+  if (obj && JS_SetReservedSlot(ctx, obj, 0, OBJECT_TO_JSVAL(script)))
+    return obj;
+  return NULL;
+}
+
+static JSObject *
+script_unwrap(JSContext *ctx, jsval val)
+{
+  jsval script = JSVAL_VOID;
+  if (!JSVAL_IS_OBJECT(val) || JSVAL_IS_NULL(val)
+      || JS_GET_CLASS(ctx, JSVAL_TO_OBJECT(val)) != &scrdef
+      || !JS_GetReservedSlot(ctx, JSVAL_TO_OBJECT(val), 0, &script)
+      || !JSVAL_IS_OBJECT(script))
+    return NULL;
+  return JSVAL_TO_OBJECT(script);
+}
+
+static natusEngVal
+sm_compile(const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno, natusEngValFlags *flags)
+{
+  size_t jslen = 0, fnlen = 0;
+  const jschar *jschars = JS_GetStringCharsAndLength(ctx, JS_ValueToString(ctx, *jscript), &jslen);
+  char *fnchars = filename ? sm_to_string_utf8(ctx, filename, &fnlen) : NULL;
+
+  jsval rval = JSVAL_VOID;
+  JSObject *glb = JS_GetGlobalObject(ctx);
+  JSObject *script = JS_CompileUCScript(ctx, glb, jschars, jslen, fnchars, lineno);
+  free(fnchars);
+  if (script) {
+    JSObject *obj = script_wrap(ctx, script);
+    if (obj)
+      return mkjsval(ctx, OBJECT_TO_JSVAL(obj));
+  }
+
+  *flags |= natusEngValFlagException;
+  if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &rval))
+    return NULL;
+  return mkjsval(ctx, rval);
+}
+
+static natusEngVal
+sm_run(const natusEngCtx ctx, natusEngVal ths, const natusEngVal script, natusEngValFlags *flags)
+{
+  jsval rval = JSVAL_VOID;
+
+  JSObject *obj = script_unwrap(ctx, *script);
+  if (!obj) {
+    // Thrown as a TypeError, like the errors natus throws itself
+    jsval ctor = JSVAL_VOID;
+    JSString *msg = JS_NewStringCopyZ(ctx, "Not a compiled script");
+    rval = msg ? STRING_TO_JSVAL(msg) : JSVAL_VOID;
+    if (msg && JS_GetProperty(ctx, JS_GetGlobalObject(ctx), "TypeError", &ctor) && !JSVAL_IS_PRIMITIVE(ctor)) {
+      JSObject *exc = JS_New(ctx, JSVAL_TO_OBJECT(ctor), 1, &rval);
+      if (exc)
+        rval = OBJECT_TO_JSVAL(exc);
+    }
+    *flags |= natusEngValFlagException;
+    return msg ? mkjsval(ctx, rval) : NULL;
+  }
+
+  if (!JS_ExecuteScript(ctx, JSVAL_TO_OBJECT(*ths), obj, &rval)) {
+    *flags |= natusEngValFlagException;
+    if (!JS_IsExceptionPending(ctx) || !JS_GetPendingException(ctx, &rval))
+      return NULL;
+  }
+
+  return mkjsval(ctx, rval);
+}
+
+static void *
+sm_serialize(const natusEngCtx ctx, const natusEngVal script, size_t *len)
+{
+  JSObject *obj = script_unwrap(ctx, *script);
+  if (!obj)
+    return NULL;
+
+  JSXDRState *xdr = JS_XDRNewMem(ctx, JSXDR_ENCODE);
+  if (!xdr)
+    return NULL;
+
+  void *data = NULL;
+  if (JS_XDRScriptObject(xdr, &obj)) {
+    uint32 xlen = 0;
+    void *buf = JS_XDRMemGetData(xdr, &xlen);
+    if (buf && xlen > 0 && (data = malloc(xlen))) {
+      memcpy(data, buf, xlen);
+      *len = xlen;
+    }
+  }
+
+  JS_XDRDestroy(xdr);
+  return data;
+}
+
+static natusEngVal
+sm_deserialize(const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno,
+               const void *data, size_t len, natusEngValFlags *flags)
+{
+  if (len > UINT32_MAX)
+    return NULL;
+
+  JSXDRState *xdr = JS_XDRNewMem(ctx, JSXDR_DECODE);
+  if (!xdr)
+    return NULL;
+
+  // XDR checks its own version, so data from another build just fails
+  JSObject *script = NULL;
+  JS_XDRMemSetData(xdr, (void *) data, len);
+  JSBool ok = JS_XDRScriptObject(xdr, &script);
+  JS_XDRMemSetData(xdr, NULL, 0);
+  JS_XDRDestroy(xdr);
+
+  JSObject *obj = ok && script ? script_wrap(ctx, script) : NULL;
+  if (!obj) {
+    JS_ClearPendingException(ctx);
+    return NULL;
+  }
+  return mkjsval(ctx, OBJECT_TO_JSVAL(obj));
+}
+
 static natusPrivate *
 sm_get_private(const natusEngCtx ctx, const natusEngVal val)
 {
@@ -760,6 +1114,8 @@ sm_get_type(const natusEngCtx ctx, const natusEngVal val)
       return natusValueTypeArray;
     else if (JS_ObjectIsFunction(ctx, JSVAL_TO_OBJECT(*val)))
       return natusValueTypeFunction;
+    else if (JS_GET_CLASS(ctx, JSVAL_TO_OBJECT(*val)) == &bufdef)
+      return natusValueTypeBuffer;
     else
       return natusValueTypeObject;
   }
@@ -794,11 +1150,10 @@ sm_equal(const natusEngCtx ctx, const natusEngVal val1, const natusEngVal val2,
   return eql;
 }
 
-__attribute__((constructor))
-static void
-_init()
+static uintptr_t
+sm_identity(const natusEngCtx ctx, const natusEngVal val)
 {
-  JS_SetCStringsAreUTF8();
+  return JSVAL_IS_OBJECT(*val) ? (uintptr_t) JSVAL_TO_OBJECT(*val) : 0;
 }
 
 __attribute__((destructor))
@@ -808,4 +1163,4 @@ _fini()
   JS_ShutDown();
 }
 
-NATUS_ENGINE("SpiderMonkey", "JS_GetProperty", sm);
+NATUS_ENGINE("SpiderMonkey", "JS_GetProperty", natusEngineFlagThreadSafe, sm);
@@ -24,19 +24,23 @@
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <new>
 
 #include <v8.h>
 using namespace v8;
 
-typedef Persistent<Context>* natusEngCtx;
+struct v8Context;
+typedef v8Context* natusEngCtx;
 typedef Persistent<Value>* natusEngVal;
 #define NATUS_ENGINE_TYPES_DEFINED
 #define I_ACKNOWLEDGE_THAT_NATUS_IS_NOT_STABLE
 #include <natus-engine.h>
 
 #define V8_PRIV_SLOT 0
+#define V8_ARGV_STACK 16
 #define V8_PRIV_STRING String::New("natus::v8::private")
+#define V8_SCRIPT_STRING String::New("natus::v8::script")
 
 static natusEngVal
 makeval(Handle<Value> val)
@@ -46,6 +50,26 @@ makeval(Handle<Value> val)
   return tmp;
 }
 
+// The context, with the templates made for it. Object templates are
+// shared by all natusClasses with the same hooks, and hand their
+// callbacks the context as data.
+struct v8Context : public Persistent<Context> {
+  v8Context(Persistent<Context> context) : Persistent<Context>(context) {}
+  Persistent<String>         privkey; // V8_PRIV_STRING, made once
+  Persistent<ObjectTemplate> prvtmpl;
+  Persistent<ObjectTemplate> scrtmpl;
+  Persistent<ObjectTemplate> objtmpls[natusClassHookAll + 1];
+};
+
+static natusPrivate *
+get_private(natusEngCtx ctx, Handle<Object> obj)
+{
+  Handle<Value> hidden = obj->GetHiddenValue(ctx->privkey);
+  if (hidden.IsEmpty() || !hidden->IsObject())
+    return NULL;
+  return (natusPrivate*) hidden->ToObject()->GetPointerFromInternalField(V8_PRIV_SLOT);
+}
+
 static void
 on_free(Persistent<Value> object, void* parameter)
 {
@@ -59,7 +83,8 @@ property_handler(const AccessorInfo& info, Handle<Value> property, Handle<Value>
 {
   HandleScope hs;
 
-  natusPrivate *priv = (natusPrivate*) info.Data()->ToObject()->GetPointerFromInternalField(V8_PRIV_SLOT);
+  natusEngCtx ctx = (natusEngCtx) External::Cast(*info.Data())->Value();
+  natusPrivate *priv = get_private(ctx, info.Holder());
 
   natusEngValFlags flags = natusEngValFlagNone;
   natusEngVal ths = makeval(info.This());
@@ -134,7 +159,8 @@ obj_enumerate(const AccessorInfo& info)
   HandleScope hs;
 
   natusEngValFlags flags = natusEngValFlagNone;
-  natusPrivate* prv = (natusPrivate*) External::Unwrap(info.Data()->ToObject());
+  natusEngCtx ctx = (natusEngCtx) External::Cast(*info.Data())->Value();
+  natusPrivate* prv = get_private(ctx, info.Holder());
   natusEngVal res = natus_handle_property(natusPropertyActionEnumerate, makeval(info.This()), prv, NULL, NULL, &flags);
   if (!res)
     return Handle<Array>();
@@ -154,25 +180,37 @@ obj_enumerate(const AccessorInfo& info)
 }
 
 static Handle<Value>
-int_call(const Arguments& args, Handle<Value> object)
+int_call(const Arguments& args, Handle<Value> object, natusPrivate *priv)
 {
   HandleScope hs;
 
-  // Get the private pointer
-  natusPrivate *priv = (natusPrivate*) args.Data()->ToObject()->GetPointerFromInternalField(V8_PRIV_SLOT);
-
-  // Convert the arguments
-  Handle<Array> array = Array::New(args.Length());
-  for (int i = 0; i < args.Length(); i++)
-    array->Set(i, args[i]);
+  // Lend the arguments for the duration of the call: these share the
+  // storage cells of the local handles, so nothing is allocated and there
+  // is nothing to dispose of; natus duplicates any it keeps
+  int argc = args.Length();
+  Persistent<Value> lentstack[V8_ARGV_STACK];
+  natusEngVal argvstack[V8_ARGV_STACK];
+  Persistent<Value> *lent = lentstack;
+  natusEngVal *argv = argvstack;
+  if (argc > V8_ARGV_STACK) {
+    lent = new Persistent<Value>[argc];
+    argv = new natusEngVal[argc];
+  }
+  for (int i = 0; i < argc; i++) {
+    lent[i] = Persistent<Value>(args[i]);
+    argv[i] = &lent[i];
+  }
 
   // Note: when called as an object,
   // This() is *not* this. Upstream bug.
   natusEngValFlags flags = natusEngValFlagNone;
   natusEngVal obj = makeval(object);
   natusEngVal ths = makeval(args.IsConstructCall() ? (Handle<Value> ) Undefined() : args.This());
-  natusEngVal arg = makeval(array);
-  natusEngVal res = natus_handle_call(obj, priv, ths, arg, &flags);
+  natusEngVal res = natus_handle_call_argv(obj, priv, ths, argc, argv, &flags);
+  if (lent != lentstack) {
+    delete[] lent;
+    delete[] argv;
+  }
   if (!res)
     return ThrowException(Undefined());
 
@@ -193,13 +231,15 @@ int_call(const Arguments& args, Handle<Value> object)
 static Handle<Value>
 obj_call(const Arguments& args)
 {
-  return int_call(args, args.Holder());
+  natusEngCtx ctx = (natusEngCtx) External::Cast(*args.Data())->Value();
+  return int_call(args, args.Holder(), get_private(ctx, args.Holder()));
 }
 
 static Handle<Value>
 fnc_call(const Arguments& args)
 {
-  return int_call(args, args.Callee());
+  natusPrivate *priv = (natusPrivate*) args.Data()->ToObject()->GetPointerFromInternalField(V8_PRIV_SLOT);
+  return int_call(args, args.Callee(), priv);
 }
 
 static void
@@ -210,12 +250,17 @@ v8_ctx_free(natusEngCtx ctx)
 
   FORCE_GC();
   natusPrivate *priv = (natusPrivate*) (*ctx)->Global()
-      ->GetHiddenValue(V8_PRIV_STRING)
+      ->GetHiddenValue(ctx->privkey)
       ->ToObject()
       ->GetPointerFromInternalField(V8_PRIV_SLOT);
   natus_private_free(priv);
   FORCE_GC();
 
+  ctx->privkey.Dispose();
+  ctx->prvtmpl.Dispose();
+  ctx->scrtmpl.Dispose();
+  for (size_t i = 0; i <= natusClassHookAll; i++)
+    ctx->objtmpls[i].Dispose();
   ctx->Dispose();
   ctx->Clear();
   delete ctx;
@@ -257,15 +302,16 @@ v8_new_global(natusEngCtx ctx, natusEngVal val, natusPrivate *priv, natusEngCtx
   Handle<Object> prv = ot->NewInstance();
   prv->SetPointerInInternalField(V8_PRIV_SLOT, priv);
 
+  V8::AdjustAmountOfExternalAllocatedMemory(sizeof(v8Context));
+  *newctx = new v8Context(context);
+  (*newctx)->privkey = Persistent<String>::New(V8_PRIV_STRING);
+
   Handle<Object> global = context->Global();
-  global->SetHiddenValue(V8_PRIV_STRING, prv);
+  global->SetHiddenValue((*newctx)->privkey, prv);
 
   if (ctx)
     context->SetSecurityToken((*ctx)->GetSecurityToken());
 
-  V8::AdjustAmountOfExternalAllocatedMemory(sizeof(Persistent<Context> ));
-  *newctx = new Persistent<Context>();
-  **newctx = context;
   return makeval(global);
 }
 
@@ -301,6 +347,53 @@ v8_new_string_utf16(const natusEngCtx ctx, const natusChar *str, size_t len, nat
   return makeval(String::New(str, len));
 }
 
+// External strings keep pointing at the caller's characters until v8 collects them
+template <typename C, typename R>
+class ExternalString : public R {
+public:
+  ExternalString(const C *str, size_t len, natusFreeFunction freefnc)
+    : str(str), len(len), freefnc(freefnc) {}
+  virtual ~ExternalString() {
+    if (freefnc)
+      freefnc((void *) str);
+  }
+  virtual const C *data() const { return str; }
+  virtual size_t length() const { return len; }
+
+private:
+  const C          *str;
+  size_t            len;
+  natusFreeFunction freefnc;
+};
+typedef ExternalString<char, String::ExternalAsciiStringResource> ExternalAscii;
+typedef ExternalString<uint16_t, String::ExternalStringResource>  ExternalUTF16;
+
+static natusEngVal
+v8_new_string_external_utf8(const natusEngCtx ctx, const char *str, size_t len, natusFreeFunction freefnc, natusEngValFlags *flags)
+{
+  // v8 can only share ASCII; anything else must be decoded
+  for (size_t i=0; i < len; i++) {
+    if (str[i] & 0x80) {
+      natusEngVal ret = v8_new_string_utf8(ctx, str, len, flags);
+      if (freefnc)
+        freefnc((void *) str);
+      return ret;
+    }
+  }
+
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+  return makeval(String::NewExternal(new ExternalAscii(str, len, freefnc)));
+}
+
+static natusEngVal
+v8_new_string_external_utf16(const natusEngCtx ctx, const natusChar *str, size_t len, natusFreeFunction freefnc, natusEngValFlags *flags)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+  return makeval(String::NewExternal(new ExternalUTF16((const uint16_t *) str, len, freefnc)));
+}
+
 static natusEngVal
 v8_new_array(const natusEngCtx ctx, const natusEngVal *array, size_t len, natusEngValFlags *flags)
 {
@@ -313,6 +406,18 @@ v8_new_array(const natusEngCtx ctx, const natusEngVal *array, size_t len, natusE
   return makeval(valv);
 }
 
+static natusEngVal
+v8_new_array_doubles(const natusEngCtx ctx, const double *array, size_t len, natusEngValFlags *flags)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  Handle<Array> valv = Array::New(len);
+  for (unsigned int i = 0; i < len; i++)
+    valv->Set(i, Number::New(array[i]));
+  return makeval(valv);
+}
+
 static natusEngVal
 v8_new_function(const natusEngCtx ctx, const char *name, natusPrivate *priv, natusEngValFlags *flags)
 {
@@ -355,7 +460,7 @@ v8_new_function(const natusEngCtx ctx, const char *name, natusPrivate *priv, nat
   if (tc.HasCaught())
     goto exception;
 
-  fnc->SetHiddenValue(V8_PRIV_STRING, prv);
+  fnc->SetHiddenValue(ctx->privkey, prv);
   if (tc.HasCaught())
     goto exception;
 
@@ -368,26 +473,50 @@ exception:
   return makeval(tc.Exception());
 }
 
+static Handle<ObjectTemplate>
+object_template(natusEngCtx ctx, natusClass *cls)
+{
+  natusClassHooks hooks = natus_class_hooks(cls);
+  if (!ctx->objtmpls[hooks].IsEmpty())
+    return ctx->objtmpls[hooks];
+
+  Handle<ObjectTemplate> ot = ObjectTemplate::New();
+  Handle<Value> data = External::New(ctx);
+  if (hooks & (natusClassHookGet | natusClassHookSet | natusClassHookDel | natusClassHookEnumerate)) {
+    ot->SetNamedPropertyHandler(cls->get ? obj_property_get : NULL,
+    cls->set ? obj_property_set : NULL, NULL,
+    cls->del ? obj_property_del : NULL,
+    cls->enumerate ? obj_enumerate : NULL, data);
+    ot->SetIndexedPropertyHandler(cls->get ? obj_item_get : NULL,
+    cls->set ? obj_item_set : NULL, NULL,
+    cls->del ? obj_item_del : NULL,
+    cls->enumerate ? obj_enumerate : NULL, data);
+  }
+
+  if (hooks & natusClassHookCall)
+    ot->SetCallAsFunctionHandler(obj_call, data);
+
+  ctx->objtmpls[hooks] = Persistent<ObjectTemplate>::New(ot);
+  return ctx->objtmpls[hooks];
+}
+
 static natusEngVal
 v8_new_object(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, natusEngValFlags *flags)
 {
   HandleScope hs;
   Context::Scope cs(*ctx);
 
-  Handle<ObjectTemplate> ot;
   Handle<Object> obj;
   Handle<Object> prv;
 
   TryCatch tc;
-  ot = ObjectTemplate::New();
-  if (tc.HasCaught())
-    goto exception;
-
-  ot->SetInternalFieldCount(V8_PRIV_SLOT + 1);
-  if (tc.HasCaught())
-    goto exception;
+  if (ctx->prvtmpl.IsEmpty()) {
+    Handle<ObjectTemplate> ot = ObjectTemplate::New();
+    ot->SetInternalFieldCount(V8_PRIV_SLOT + 1);
+    ctx->prvtmpl = Persistent<ObjectTemplate>::New(ot);
+  }
 
-  prv = ot->NewInstance();
+  prv = ctx->prvtmpl->NewInstance();
   if (tc.HasCaught())
     goto exception;
 
@@ -395,31 +524,12 @@ v8_new_object(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, natusE
   if (tc.HasCaught())
     goto exception;
 
-  ot = ObjectTemplate::New();
-  if (tc.HasCaught())
-    goto exception;
-
-  if (cls) {
-    if (cls->get || cls->set || cls->del || cls->enumerate) {
-      ot->SetNamedPropertyHandler(cls->get ? obj_property_get : NULL,
-      cls->set ? obj_property_set : NULL, NULL,
-      cls->del ? obj_property_del : NULL,
-      cls->enumerate ? obj_enumerate : NULL, prv);
-      ot->SetIndexedPropertyHandler(cls->get ? obj_item_get : NULL,
-      cls->set ? obj_item_set : NULL, NULL,
-      cls->del ? obj_item_del : NULL,
-      cls->enumerate ? obj_enumerate : NULL, prv);
-    }
-
-    if (cls->call)
-      ot->SetCallAsFunctionHandler(obj_call, prv);
-  }
-
-  obj = ot->NewInstance();
+  // The handlers find priv through the hidden value
+  obj = object_template(ctx, cls)->NewInstance();
   if (tc.HasCaught())
     goto exception;
 
-  obj->SetHiddenValue(V8_PRIV_STRING, prv);
+  obj->SetHiddenValue(ctx->privkey, prv);
   if (tc.HasCaught())
     goto exception;
 
@@ -432,6 +542,30 @@ exception:
   return makeval(tc.Exception());
 }
 
+static natusEngVal
+v8_new_buffer(const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, void *data, size_t len, natusEngValFlags *flags)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  // External array lengths are ints
+  if (len > INT_MAX) {
+    natus_private_free(priv);
+    *flags = (natusEngValFlags) (*flags | natusEngValFlagException);
+    return makeval(Exception::RangeError(String::New("Buffer is too large")));
+  }
+
+  // v8 reads and writes the bytes itself, the class only serves native callers
+  natusEngVal val = v8_new_object(ctx, NULL, priv, flags);
+  if (*flags & natusEngValFlagException)
+    return val;
+
+  Handle<Object> obj = (*val)->ToObject();
+  obj->SetIndexedPropertiesToExternalArrayData(data, kExternalUnsignedByteArray, (int) len);
+  obj->Set(String::New("length"), Integer::NewFromUnsigned(len), (PropertyAttribute) (ReadOnly | DontEnum | DontDelete));
+  return val;
+}
+
 static natusEngVal
 v8_new_null(const natusEngCtx ctx, natusEngValFlags *flags)
 {
@@ -464,6 +598,19 @@ v8_to_double(const natusEngCtx ctx, const natusEngVal val)
   return (*val)->NumberValue();
 }
 
+static bool
+v8_to_doubles(const natusEngCtx ctx, const natusEngVal val, double *array, size_t len)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  TryCatch tc;
+  Handle<Object> obj = (*val)->ToObject();
+  for (unsigned int i = 0; i < len && !tc.HasCaught(); i++)
+    array[i] = obj->Get(i)->NumberValue();
+  return !tc.HasCaught();
+}
+
 static char *
 v8_to_string_utf8(const natusEngCtx ctx, const natusEngVal val, size_t *len)
 {
@@ -512,6 +659,78 @@ v8_to_string_utf16(const natusEngCtx ctx, const natusEngVal val, size_t *len)
   return buff;
 }
 
+static size_t
+v8_to_string_utf8_buffer(const natusEngCtx ctx, const natusEngVal val, char *buf, size_t size)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  TryCatch tc;
+  Handle<String> str = (*val)->ToString();
+  if (tc.HasCaught()) {
+    assert((*val)->IsObject());
+    str = String::New("[object NativeObject]");
+  }
+
+  // WriteUtf8() only writes whole characters
+  if (size > 0) {
+    int cap = size - 1 > INT_MAX ? INT_MAX : (int) (size - 1);
+    int n = cap > 0 ? str->WriteUtf8(buf, cap) : 0;
+    if (n > 0 && buf[n - 1] == '\0')
+      n--;
+    buf[n] = '\0';
+  }
+
+  return str->Utf8Length();
+}
+
+static size_t
+v8_to_string_utf16_range(const natusEngCtx ctx, const natusEngVal val, size_t offset, natusChar *buf, size_t size)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  TryCatch tc;
+  Handle<String> str = (*val)->ToString();
+  if (tc.HasCaught()) {
+    assert((*val)->IsObject());
+    str = String::New("[object NativeObject]");
+  }
+
+  size_t len = str->Length();
+  if (offset >= len || size == 0)
+    return 0;
+  if (size > len - offset)
+    size = len - offset;
+  return str->Write(buf, offset, size);
+}
+
+static const natusChar *
+v8_string_view(const natusEngCtx ctx, const natusEngVal val, size_t *len, void **token)
+{
+  // Only external strings have storage of their own we can point at;
+  // the value keeps them alive
+  if (!(*val)->IsString())
+    return NULL;
+
+  HandleScope hs;
+  Handle<String> str = Handle<String>::Cast(*val);
+  if (!str->IsExternal())
+    return NULL;
+
+  String::ExternalStringResource *res = str->GetExternalStringResource();
+  if (!res)
+    return NULL;
+
+  *len = res->length();
+  return (const natusChar *) res->data();
+}
+
+static void
+v8_string_release(const natusEngCtx ctx, void *token)
+{
+}
+
 static natusEngVal
 v8_del(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, natusEngValFlags *flags)
 {
@@ -564,35 +783,56 @@ v8_set(const natusEngCtx ctx, natusEngVal val, const natusEngVal id, const natus
 }
 
 static natusEngVal
-v8_enumerate(const natusEngCtx ctx, natusEngVal val, natusEngValFlags *flags)
+v8_get_index(const natusEngCtx ctx, natusEngVal val, uint32_t idx, natusEngValFlags *flags)
 {
   HandleScope hs;
   Context::Scope cs(*ctx);
 
-  return makeval((*val)->ToObject()->GetPropertyNames());
+  TryCatch tc;
+  Handle<Value> rslt = (*val)->ToObject()->Get(idx);
+  if (!tc.HasCaught())
+    return makeval(rslt);
+
+  *flags = (natusEngValFlags) (*flags | natusEngValFlagException);
+  return makeval(tc.Exception());
 }
 
 static natusEngVal
-v8_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal args, natusEngValFlags *flags)
+v8_set_index(const natusEngCtx ctx, natusEngVal val, uint32_t idx, const natusEngVal value, natusEngValFlags *flags)
 {
   HandleScope hs;
   Context::Scope cs(*ctx);
 
-  assert((*func)->IsFunction());
+  TryCatch tc;
+  bool rslt = (*val)->ToObject()->Set(idx, *value);
+  if (!tc.HasCaught())
+    return makeval(Boolean::New(rslt));
 
-  // Convert arguments
-  uint32_t len = (*args)->ToObject()->Get(String::New("length"))->ToArrayIndex()->Uint32Value();
-  Handle<Value> argv[len];
-  for (uint32_t i = 0; i < len; i++)
-    argv[i] = (*args)->ToObject()->Get(i);
+  *flags = (natusEngValFlags) (*flags | natusEngValFlagException);
+  return makeval(tc.Exception());
+}
+
+static natusEngVal
+v8_enumerate(const natusEngCtx ctx, natusEngVal val, natusEngValFlags *flags)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  return makeval((*val)->ToObject()->GetPropertyNames());
+}
+
+static natusEngVal
+do_call(natusEngVal func, natusEngVal ths, int argc, Handle<Value> *argv, natusEngValFlags *flags)
+{
+  assert((*func)->IsFunction());
 
   // Call it
   TryCatch tc;
   Handle<Value> res;
   if ((*ths)->IsUndefined())
-    res = Function::Cast(**func)->NewInstance(len, argv);
+    res = Function::Cast(**func)->NewInstance(argc, argv);
   else
-    res = Function::Cast(**func)->Call((*ths)->ToObject(), len, argv);
+    res = Function::Cast(**func)->Call((*ths)->ToObject(), argc, argv);
 
   if (!tc.HasCaught())
     return makeval(res);
@@ -601,6 +841,34 @@ v8_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal ar
   return makeval(tc.Exception());
 }
 
+static natusEngVal
+v8_call(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal args, natusEngValFlags *flags)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  // Convert arguments
+  uint32_t len = (*args)->ToObject()->Get(String::New("length"))->ToArrayIndex()->Uint32Value();
+  Handle<Value> argv[len];
+  for (uint32_t i = 0; i < len; i++)
+    argv[i] = (*args)->ToObject()->Get(i);
+
+  return do_call(func, ths, len, argv, flags);
+}
+
+static natusEngVal
+v8_call_argv(const natusEngCtx ctx, natusEngVal func, natusEngVal ths, size_t argc, const natusEngVal *argv, natusEngValFlags *flags)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  Handle<Value> args[argc > 0 ? argc : 1];
+  for (size_t i = 0; i < argc; i++)
+    args[i] = *argv[i];
+
+  return do_call(func, ths, argc, args, flags);
+}
+
 static natusEngVal
 v8_evaluate(const natusEngCtx ctx, natusEngVal ths, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno, natusEngValFlags *flags)
 {
@@ -619,16 +887,97 @@ v8_evaluate(const natusEngCtx ctx, natusEngVal ths, const natusEngVal jscript, c
   return makeval(tc.Exception());
 }
 
+static void
+on_script_free(Persistent<Value> object, void* parameter)
+{
+  Persistent<Script> *script = (Persistent<Script>*) parameter;
+  script->Dispose();
+  delete script;
+  object.Dispose();
+  object.ClearWeak();
+}
+
+static natusEngVal
+v8_compile(const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno, natusEngValFlags *flags)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  TryCatch tc;
+  ScriptOrigin so = ScriptOrigin(filename ? *filename : Handle<Value>(Undefined()), Integer::New(lineno));
+  Handle<Script> script = Script::Compile((*jscript)->ToString(), &so);
+  if (tc.HasCaught() || script.IsEmpty()) {
+    *flags = (natusEngValFlags) (*flags | natusEngValFlagException);
+    return makeval(tc.Exception());
+  }
+
+  if (ctx->scrtmpl.IsEmpty()) {
+    Handle<ObjectTemplate> ot = ObjectTemplate::New();
+    ot->SetInternalFieldCount(1);
+    ctx->scrtmpl = Persistent<ObjectTemplate>::New(ot);
+  }
+
+  // Like privates, the compiled script hangs off a hidden value
+  Handle<Object> holder = ctx->scrtmpl->NewInstance();
+  Handle<Object> obj = Object::New();
+  if (tc.HasCaught() || holder.IsEmpty() || obj.IsEmpty()) {
+    *flags = (natusEngValFlags) (*flags | natusEngValFlagException);
+    return makeval(tc.Exception());
+  }
+
+  Persistent<Script> *p = new Persistent<Script>(Persistent<Script>::New(script));
+  holder->SetPointerInInternalField(0, p);
+  obj->SetHiddenValue(V8_SCRIPT_STRING, holder);
+  Persistent<Value>::New(holder).MakeWeak(p, on_script_free);
+  return makeval(obj);
+}
+
+static natusEngVal
+v8_run(const natusEngCtx ctx, natusEngVal ths, const natusEngVal script, natusEngValFlags *flags)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  Handle<Value> holder;
+  if ((*script)->IsObject())
+    holder = (*script)->ToObject()->GetHiddenValue(V8_SCRIPT_STRING);
+  if (holder.IsEmpty() || !holder->IsObject()) {
+    *flags = (natusEngValFlags) (*flags | natusEngValFlagException);
+    return makeval(Exception::TypeError(String::New("Not a compiled script")));
+  }
+
+  Persistent<Script> *p = (Persistent<Script>*) holder->ToObject()->GetPointerFromInternalField(0);
+
+  TryCatch tc;
+  Handle<Value> res = (*p)->Run();
+  if (!tc.HasCaught())
+    return makeval(res);
+
+  *flags = (natusEngValFlags) (*flags | natusEngValFlagException);
+  return makeval(tc.Exception());
+}
+
+// v8 has no way to save compiled code
+static void *
+v8_serialize(const natusEngCtx ctx, const natusEngVal script, size_t *len)
+{
+  return NULL;
+}
+
+static natusEngVal
+v8_deserialize(const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno,
+               const void *data, size_t len, natusEngValFlags *flags)
+{
+  return NULL;
+}
+
 static natusPrivate *
 v8_get_private(const natusEngCtx ctx, const natusEngVal val)
 {
   HandleScope hs;
   Context::Scope cs(*ctx);
 
-  Handle<Value> hidden = (*val)->ToObject()->GetHiddenValue(V8_PRIV_STRING);
-  if (hidden.IsEmpty() || !hidden->IsObject())
-    return NULL;
-  return (natusPrivate*) hidden->ToObject()->GetPointerFromInternalField(V8_PRIV_SLOT);
+  return get_private(ctx, (*val)->ToObject());
 }
 
 static natusEngVal
@@ -652,8 +1001,12 @@ v8_get_type(const natusEngCtx ctx, const natusEngVal val)
     return natusValueTypeNull;
   else if ((*val)->IsNumber() || (*val)->IsInt32() || (*val)->IsUint32())
     return natusValueTypeNumber;
-  else if ((*val)->IsObject() || (*val)->IsDate() /*|| (*val)->IsRegExp()*/)
+  else if ((*val)->IsObject() || (*val)->IsDate() /*|| (*val)->IsRegExp()*/) {
+    HandleScope hs;
+    if ((*val)->ToObject()->HasIndexedPropertiesInExternalArrayData())
+      return natusValueTypeBuffer;
     return natusValueTypeObject;
+  }
   else if ((*val)->IsString())
     return natusValueTypeString;
   else if ((*val)->IsUndefined())
@@ -681,6 +1034,17 @@ v8_equal(const natusEngCtx ctx, const natusEngVal val1, const natusEngVal val2,
   return (*val1)->Equals(*val2);
 }
 
+static uintptr_t
+v8_identity(const natusEngCtx ctx, const natusEngVal val)
+{
+  HandleScope hs;
+  Context::Scope cs(*ctx);
+
+  if (!(*val)->IsObject())
+    return 0;
+  return (uintptr_t) (*val)->ToObject()->GetIdentityHash();
+}
+
 __attribute__((constructor))
 static void
 _init()
@@ -692,6 +1056,7 @@ _init()
   assert(DontDelete == (PropertyAttribute) natusPropAttrDontDelete);
 }
 
+// Every global lives in the one default isolate, so none is thread safe.
 // V8_Fatal appears to be the only v8 unique extern "C" symbol
 // Let's hope it doesn't get removed...
-NATUS_ENGINE("v8", "V8_Fatal", v8);
+NATUS_ENGINE("v8", "V8_Fatal", natusEngineFlagNone, v8);
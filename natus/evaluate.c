@@ -27,9 +27,13 @@ natus_evaluate(natusValue *ths, natusValue *javascript, natusValue *filename, un
     assert(javascript);
   }
 
+  char buf[TRACE_NAME];
+  const char *name = trace_enter(ths, natusTraceEvaluate, NULL, filename, "(eval)", buf);
+  ths->ctx->stats.evaluations++;
   callandmkval(natusValue *rslt, natusValueTypeUnknown, ths, evaluate,
-               ths->ctx->ctx, ths->val, javascript->val,
-               filename ? filename->val : NULL, lineno);
+               ths->ctx->ctx, engval(ths), engval(javascript),
+               filename ? engval(filename) : NULL, lineno);
+  trace_leave(ths, natusTraceEvaluate, name);
 
   for (tmp = ths->ctx->evalhooks ; tmp ; tmp = tmp->next)
     tmp->hook(ths, &rslt, &filename, NULL, tmp->misc);
@@ -66,6 +70,109 @@ natus_evaluate_utf8(natusValue *ths, const char *javascript, const char *filenam
   return ret;
 }
 
+natusValue *
+natus_compile(natusValue *ctx, natusValue *javascript, natusValue *filename, unsigned int lineno)
+{
+  return natus_compile_cached(ctx, javascript, filename, lineno, NULL, 0, NULL);
+}
+
+natusValue *
+natus_compile_cached(natusValue *ctx, natusValue *javascript, natusValue *filename, unsigned int lineno,
+                     const void *data, size_t len, bool *hit)
+{
+  natusValue *rslt = NULL;
+  evalHook *tmp;
+
+  if (hit)
+    *hit = false;
+  if (!ctx || !javascript)
+    return NULL;
+
+  natus_incref(javascript);
+  natus_incref(filename);
+  for (tmp = ctx->ctx->evalhooks ; tmp ; tmp = tmp->next) {
+    tmp->hook(ctx, &javascript, &filename, &lineno, tmp->misc);
+    assert(javascript);
+  }
+
+  if (data && len > 0) {
+    natusEngValFlags flags = natusEngValFlagUnlock | natusEngValFlagFree;
+    natusEngVal val = ctx->ctx->spec->deserialize(ctx->ctx->ctx, engval(javascript),
+                                                  filename ? engval(filename) : NULL,
+                                                  lineno, data, len, &flags);
+    if (val)
+      rslt = mkval(ctx, val, flags, natusValueTypeObject);
+    if (hit)
+      *hit = rslt != NULL;
+  }
+
+  if (!rslt) {
+    callandmkval(rslt, natusValueTypeObject, ctx, compile,
+                 ctx->ctx->ctx, engval(javascript),
+                 filename ? engval(filename) : NULL, lineno);
+  }
+
+  for (tmp = ctx->ctx->evalhooks ; tmp ; tmp = tmp->next)
+    tmp->hook(ctx, &rslt, &filename, NULL, tmp->misc);
+
+  natus_decref(javascript);
+  natus_decref(filename);
+  return rslt;
+}
+
+natusValue *
+natus_compile_utf8(natusValue *ctx, const char *javascript, const char *filename, unsigned int lineno)
+{
+  if (!ctx || !javascript)
+    return NULL;
+
+  natusValue *jscript = natus_new_string_utf8(ctx, javascript);
+  if (!jscript)
+    return NULL;
+
+  natusValue *fname = NULL;
+  if (filename) {
+    fname = natus_new_string_utf8(ctx, filename);
+    if (!fname) {
+      natus_decref(jscript);
+      return NULL;
+    }
+  }
+
+  natusValue *ret = natus_compile(ctx, jscript, fname, lineno);
+  natus_decref(jscript);
+  natus_decref(fname);
+  return ret;
+}
+
+void *
+natus_serialize(natusValue *script, size_t *len)
+{
+  size_t intlen = 0;
+  if (!len)
+    len = &intlen;
+
+  if (!natus_is_object(script))
+    return NULL;
+  return script->ctx->spec->serialize(script->ctx->ctx, engval(script), len);
+}
+
+natusValue *
+natus_run(natusValue *ths, natusValue *script)
+{
+  if (!ths || !script)
+    return NULL;
+  if (!(natus_get_type(ths) & (natusValueTypeArray | natusValueTypeFunction | natusValueTypeObject)))
+    return NULL;
+
+  char buf[TRACE_NAME];
+  const char *name = trace_enter(ths, natusTraceEvaluate, NULL, NULL, "(script)", buf);
+  ths->ctx->stats.evaluations++;
+  callandmkval(natusValue *rslt, natusValueTypeUnknown, ths, run, ths->ctx->ctx, engval(ths), engval(script));
+  trace_leave(ths, natusTraceEvaluate, name);
+  return rslt;
+}
+
 static void
 hook_dtor(evalHook *hook)
 {
@@ -22,6 +22,34 @@ Value::evaluate(UTF16 javascript, UTF16 filename, unsigned int lineno)
   return natus_evaluate(internal, js.internal, fn.internal, lineno);
 }
 
+Value
+Value::compile(Value javascript, Value filename, unsigned int lineno)
+{
+  return natus_compile(internal, javascript.internal, filename.internal, lineno);
+}
+
+Value
+Value::compile(UTF8 javascript, UTF8 filename, unsigned int lineno)
+{
+  Value js = newString(javascript);
+  Value fn = newString(filename);
+  return natus_compile(internal, js.internal, fn.internal, lineno);
+}
+
+Value
+Value::compile(UTF16 javascript, UTF16 filename, unsigned int lineno)
+{
+  Value js = newString(javascript);
+  Value fn = newString(filename);
+  return natus_compile(internal, js.internal, fn.internal, lineno);
+}
+
+Value
+Value::run(Value script)
+{
+  return natus_run(internal, script.internal);
+}
+
 struct hook_data {
   void *misc;
   FreeFunction free;
@@ -45,7 +73,7 @@ cxx_hook(natusValue *ths, natusValue **javascript_or_return,
   Value vfnm(*filename, true);
   hook_data *hd = (hook_data*) misc;
 
-  hd->hook(ths, &vjsr, &vfnm, lineno, hd->misc);
+  hd->hook(vths, &vjsr, &vfnm, lineno, hd->misc);
 
   *javascript_or_return = natus_incref(vjsr.borrowCValue());
   if (filename)
@@ -53,8 +81,8 @@ cxx_hook(natusValue *ths, natusValue **javascript_or_return,
 }
 
 bool
-addEvaluateHook(Value ctx, const char *name, EvaluateHook hook,
-                void *misc, FreeFunction free)
+natus::addEvaluateHook(Value ctx, const char *name, EvaluateHook hook,
+                       void *misc, FreeFunction free)
 {
   hook_data *hd;
 
@@ -73,7 +101,7 @@ addEvaluateHook(Value ctx, const char *name, EvaluateHook hook,
 }
 
 bool
-delEvaluateHook(Value ctx, const char *name)
+natus::delEvaluateHook(Value ctx, const char *name)
 {
   return natus_evaluate_hook_del(ctx.borrowCValue(), name);
 }
@@ -41,6 +41,32 @@ typedef void* natusEngVal;
 #define  _str(s) # s
 #define __str(s) _str(s)
 
+#define SCOPE_BLOCK 64
+#define INTERN_MIN  32
+#define INTERN_MAX  4096
+
+typedef struct scopeBlock scopeBlock;
+struct scopeBlock {
+  scopeBlock *next;
+  size_t      used;
+  natusValue  values[SCOPE_BLOCK];
+};
+
+struct internKey {
+  const char *name;
+  size_t      hash;
+  natusValue *val;
+  bool        hot; /* Looked up since the clock hand last passed */
+};
+
+struct natusScope {
+  natusContext *ctx;
+  natusScope   *prev;
+  natusValue   *free; /* Released slots, chained through their val */
+  scopeBlock   *blocks;
+  scopeBlock    first;
+};
+
 static bool
 do_load_file(const char *filename, bool reqsym,
              void **dll, natusEngineSpec **spec)
@@ -83,6 +109,9 @@ do_load_dir(const char *dirname, bool reqsym,
   if (!dir)
     return res;
 
+  /* The Reference engine is only a last resort */
+  char *reference = NULL;
+
   struct dirent *ent = NULL;
   while ((ent = readdir(dir))) {
     size_t flen = strlen(ent->d_name);
@@ -102,13 +131,46 @@ do_load_dir(const char *dirname, bool reqsym,
     strcat(tmp, ent->d_name);
 
     if ((res = do_load_file(tmp, reqsym, dll, spec))) {
-      free(tmp);
-      break;
+      if (strcmp((*spec)->name, "Reference")) {
+        free(tmp);
+        break;
+      }
+      dlclose(*dll);
+      res = false;
+      free(reference);
+      reference = tmp;
+      continue;
     }
     free(tmp);
   }
 
   closedir(dir);
+  if (!res && reference)
+    res = do_load_file(reference, reqsym, dll, spec);
+  free(reference);
+  return res;
+}
+
+bool
+engine_load(const char *name_or_path, void **dll, natusEngineSpec **spec)
+{
+  bool res = false;
+
+  if (name_or_path) {
+    res = do_load_file(name_or_path, false, dll, spec);
+    if (!res) {
+      char *tmp = NULL;
+      if (asprintf(&tmp, "%s/%s%s", __str(ENGINEDIR), name_or_path, MODSUFFIX) >= 0) {
+        res = do_load_file(tmp, false, dll, spec);
+        free(tmp);
+      }
+    }
+  } else {
+      res = do_load_dir(__str(ENGINEDIR), true, dll, spec);
+      if (!res)
+        res = do_load_dir(__str(ENGINEDIR), false, dll, spec);
+  }
+
   return res;
 }
 
@@ -125,21 +187,159 @@ dll_dtor(void **dll)
 static void
 value_dtor(natusValue *self)
 {
+  if (self->ctx)
+    self->ctx->stats.live--;
+
   if (self->val && self->ctx && self->ctx->spec) {
     if (self->flag & natusEngValFlagUnlock)
       self->ctx->spec->val_unlock(self->ctx->ctx, self->val);
     if (self->flag & natusEngValFlagFree)
       self->ctx->spec->val_free(self->val);
   }
+
+  if (!self->weak)
+    context_decref(self->ctx);
+}
+
+/* Interned keys are weak and not counted as live. Let go of the engine
+ * value and of ctx ourselves, so a key someone natus_incref()ed is left
+ * holding neither once we are gone. */
+static void
+intern_drop(natusContext *ctx, natusValue *val)
+{
+  if (val->val && ctx->spec) {
+    if (val->flag & natusEngValFlagUnlock)
+      ctx->spec->val_unlock(ctx->ctx, val->val);
+    if (val->flag & natusEngValFlagFree)
+      ctx->spec->val_free(val->val);
+  }
+  val->val = NULL;
+  val->ctx = NULL;
+  mem_decref(NULL, val);
+}
+
+/* Interns the keys the context holds on to, once it is set up */
+static bool
+context_keys(natusValue *global)
+{
+  const natusValue *length = natus_intern_utf8(global, "length");
+  global->ctx->length = length ? natus_incref((natusValue*) length) : NULL;
+  return global->ctx->length;
 }
 
 static void
 context_dtor(natusContext *ctx)
 {
-  if (ctx && ctx->ctx && ctx->spec)
+  if (!ctx)
+    return;
+
+  /* The interned keys hold no reference on us, drop them while
+   * the engine context is still around to unlock them */
+  natus_decref(ctx->length);
+  for (size_t i=0; i < ctx->keyssize; i++)
+    if (ctx->keys[i].name)
+      intern_drop(ctx, ctx->keys[i].val);
+
+  if (ctx->ctx && ctx->spec)
     ctx->spec->ctx_free(ctx->ctx);
 }
 
+natusContext *
+context_incref(natusContext *ctx)
+{
+  if (ctx)
+    ctx->refs++;
+  return ctx;
+}
+
+void
+context_decref(natusContext *ctx)
+{
+  /* The context chunk is a root (or grouped with the other contexts of
+   * a shared global), so this only tears it down once its group is done */
+  if (ctx && ctx->refs > 0 && --ctx->refs == 0)
+    mem_free(ctx);
+}
+
+static internKey *
+intern_find(const natusContext *ctx, const char *name, size_t h)
+{
+  if (!ctx->keys)
+    return NULL;
+
+  for (size_t i=h & (ctx->keyssize - 1); ; i=(i + 1) & (ctx->keyssize - 1)) {
+    internKey *k = &ctx->keys[i];
+    if (!k->name || (k->hash == h && !strcmp(k->name, name)))
+      return k;
+  }
+}
+
+static bool
+intern_grow(natusContext *ctx)
+{
+  size_t size = ctx->keyssize ? ctx->keyssize * 2 : INTERN_MIN;
+  internKey *keys = mem_new_array_zero(ctx, internKey, size);
+  if (!keys)
+    return false;
+
+  internKey *old = ctx->keys;
+  size_t oldsize = ctx->keyssize;
+  ctx->keys = keys;
+  ctx->keyssize = size;
+  for (size_t i=0; i < oldsize; i++) {
+    if (old[i].name)
+      *intern_find(ctx, old[i].name, old[i].hash) = old[i];
+  }
+
+  mem_decref(ctx, old);
+  return true;
+}
+
+/* Drops the key in slot i, shifting back the keys probed past it */
+static void
+intern_remove(natusContext *ctx, size_t i)
+{
+  size_t mask = ctx->keyssize - 1;
+
+  intern_drop(ctx, ctx->keys[i].val);
+  mem_decref(ctx, (void*) ctx->keys[i].name);
+  ctx->nkeys--;
+
+  for (size_t j=(i + 1) & mask; ctx->keys[j].name; j=(j + 1) & mask) {
+    size_t home = ctx->keys[j].hash & mask;
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      ctx->keys[i] = ctx->keys[j];
+      i = j;
+    }
+  }
+  memset(&ctx->keys[i], 0, sizeof(internKey));
+}
+
+/* Second chance clock over the table: keys looked up since the last pass
+ * survive it, as do keys someone holds a reference on */
+static bool
+intern_evict(natusContext *ctx)
+{
+  if (ctx->keysbusy > 0)
+    return false;
+
+  for (size_t n=0; n < ctx->keyssize * 2; n++) {
+    size_t i = ctx->keyshand++ & (ctx->keyssize - 1);
+    internKey *k = &ctx->keys[i];
+    if (!k->name || mem_parents_count(k->val, NULL) > 1)
+      continue;
+    if (k->hot) {
+      k->hot = false;
+      continue;
+    }
+
+    intern_remove(ctx, i);
+    return true;
+  }
+
+  return false;
+}
+
 static bool
 ctx_get_dll(void *parent, void **child, void ***data)
 {
@@ -147,97 +347,314 @@ ctx_get_dll(void *parent, void **child, void ***data)
   return false;
 }
 
-natusValue *
-mkval(const natusValue *ctx, natusEngVal val, natusEngValFlags flags, natusValueType type)
+static natusValue *
+scope_alloc(natusScope *scope)
+{
+  natusValue *self = scope->free;
+  if (self)
+    scope->free = (natusValue*) self->val;
+  else {
+    if (scope->blocks->used == SCOPE_BLOCK) {
+      scopeBlock *blk = mem_new(scope, scopeBlock);
+      if (!blk)
+        return NULL;
+      blk->used = 0;
+      blk->next = scope->blocks;
+      scope->blocks = blk;
+    }
+    self = &scope->blocks->values[scope->blocks->used++];
+  }
+
+  memset(self, 0, sizeof(natusValue));
+  self->scope = scope;
+  self->refs  = 1;
+  return self;
+}
+
+static natusValue *
+value_new(const natusValue *ctx, natusEngVal val, natusEngValFlags flags,
+          natusValueType type, natusScope *scope)
 {
   if (!ctx || !val)
     return NULL;
 
-  natusValue *self = mem_new_zero(NULL, natusValue);
+  natusValue *self = scope ? scope_alloc(scope) : mem_new_zero(NULL, natusValue);
   if (!self) {
     if (flags & natusEngValFlagUnlock)
-      ctx->ctx->spec->val_unlock(ctx->ctx, val);
+      ctx->ctx->spec->val_unlock(ctx->ctx->ctx, val);
     if (flags & natusEngValFlagFree)
       ctx->ctx->spec->val_free(val);
     return NULL;
   }
-  mem_destructor_set(self, value_dtor);
+  if (!scope)
+    mem_destructor_set(self, value_dtor);
 
   self->type = flags & natusEngValFlagException ? natusValueTypeUnknown : type;
   self->flag = flags;
   self->val  = val;
-  self->ctx  = mem_incref(self, ctx->ctx);
-  if (!self->ctx) {
-    mem_free(self);
+  self->ctx  = context_incref(ctx->ctx);
+  self->ctx->stats.values++;
+  self->ctx->stats.live++;
+  return self;
+}
+
+natusValue *
+mkval(const natusValue *ctx, natusEngVal val, natusEngValFlags flags, natusValueType type)
+{
+  return value_new(ctx, val, flags, type, ctx ? ctx->ctx->scope : NULL);
+}
+
+natusValue *
+mkval_heap(const natusValue *ctx, natusEngVal val, natusEngValFlags flags, natusValueType type)
+{
+  return value_new(ctx, val, flags, type, NULL);
+}
+
+natusValue *
+argv_view(const natusValue *ctx, size_t argc, const natusEngVal *argv)
+{
+  static const natusEngVal noargs[1] = { NULL };
+  if (!ctx)
     return NULL;
-  }
 
+  natusScope *scope = ctx->ctx->scope;
+  natusValue *self = scope ? scope_alloc(scope) : mem_new_zero(NULL, natusValue);
+  if (!self)
+    return NULL;
+  if (!scope)
+    mem_destructor_set(self, value_dtor);
+
+  self->type = natusValueTypeArray;
+  self->ctx  = context_incref(ctx->ctx);
+  self->ctx->stats.values++;
+  self->ctx->stats.live++;
+  self->argv = argc > 0 ? argv : noargs;
+  self->argc = argc;
   return self;
 }
 
+natusEngVal
+argv_materialize(natusValue *view)
+{
+  if (!view->argv)
+    return view->val;
+
+  natusEngValFlags flags = natusEngValFlagUnlock | natusEngValFlagFree;
+  natusEngVal val = view->ctx->spec->new_array(view->ctx->ctx, view->argv, view->argc, &flags);
+  if (!val)
+    return NULL;
+  if (flags & natusEngValFlagException) {
+    if (flags & natusEngValFlagUnlock)
+      view->ctx->spec->val_unlock(view->ctx->ctx, val);
+    if (flags & natusEngValFlagFree)
+      view->ctx->spec->val_free(val);
+    return NULL;
+  }
+
+  view->val  = val;
+  view->flag = flags;
+  view->argv = NULL;
+  view->argc = 0;
+  return val;
+}
+
+natusValue *
+argv_index(const natusValue *view, size_t idx)
+{
+  if (idx >= view->argc)
+    return natus_new_undefined(view);
+
+  return mkval(view, view->ctx->spec->val_duplicate(view->ctx->ctx, view->argv[idx]),
+               natusEngValFlagUnlock | natusEngValFlagFree, natusValueTypeUnknown);
+}
+
+void
+argv_release(natusValue *view)
+{
+  if (!view)
+    return;
+
+  if (view->argv && (view->scope ? view->refs > 1 : mem_parents_count(view, NULL) > 1)) {
+    /* If this fails, what was kept is an empty array without a value */
+    if (!argv_materialize(view)) {
+      view->argv = NULL;
+      view->argc = 0;
+    }
+  }
+  natus_decref(view);
+}
+
 natusValue *
 natus_incref(natusValue *val)
 {
+  if (val && val->scope) {
+    val->refs++;
+    return val;
+  }
   return mem_incref(NULL, val);
 }
 
 void
 natus_decref(natusValue *val)
 {
+  if (val && val->scope) {
+    if (val->refs > 0 && --val->refs == 0) {
+      value_dtor(val);
+      val->val = (natusEngVal) val->scope->free;
+      val->scope->free = val;
+    }
+    return;
+  }
   mem_decref(NULL, val);
 }
 
+natusScope *
+natus_scope_enter(const natusValue *ctx)
+{
+  if (!ctx)
+    return NULL;
+
+  /* Slots are cleared as they are handed out, not here */
+  natusScope *scope = mem_new(NULL, natusScope);
+  if (!scope)
+    return NULL;
+
+  scope->ctx        = context_incref(ctx->ctx);
+  scope->prev       = ctx->ctx->scope;
+  scope->free       = NULL;
+  scope->blocks     = &scope->first;
+  scope->first.next = NULL;
+  scope->first.used = 0;
+  ctx->ctx->scope = scope;
+  return scope;
+}
+
+natusValue *
+natus_scope_escape(natusScope *scope, natusValue *val)
+{
+  if (!scope || !val)
+    return NULL;
+
+  /* Already outlives this scope */
+  if (val->scope != scope)
+    return natus_incref(val);
+
+  natusEngValFlags flags = natusEngValFlagUnlock | natusEngValFlagFree;
+  flags |= val->flag & natusEngValFlagException;
+  return value_new(val, val->ctx->spec->val_duplicate(val->ctx->ctx, engval(val)),
+                   flags, val->type, scope->prev);
+}
+
+void
+natus_scope_leave(natusScope *scope)
+{
+  if (!scope)
+    return;
+
+  /* Values created while we release ours belong to the enclosing scope */
+  if (scope->ctx->scope == scope)
+    scope->ctx->scope = scope->prev;
+
+  for (scopeBlock *blk = scope->blocks; blk; blk = blk->next) {
+    for (size_t i=0; i < blk->used; i++) {
+      if (blk->values[i].refs > 0) {
+        blk->values[i].refs = 0;
+        value_dtor(&blk->values[i]);
+      }
+    }
+  }
+
+  natusContext *ctx = scope->ctx;
+  mem_free(scope);
+  context_decref(ctx);
+}
+
+const natusValue *
+natus_intern_utf8(const natusValue *ctx, const char *key)
+{
+  if (!ctx || !key)
+    return NULL;
+
+  natusContext *c = ctx->ctx;
+  size_t h = hash_utf8(key);
+  internKey *k = intern_find(c, key, h);
+  if (k && k->name) {
+    k->hot = true;
+    return k->val;
+  }
+
+  /* Keep the table from growing without bound on generated names */
+  if (c->nkeys >= INTERN_MAX) {
+    if (!intern_evict(c))
+      return NULL;
+    k = intern_find(c, key, h);
+  }
+  if (!k || (c->nkeys + 1) * 4 > c->keyssize * 3) {
+    if (!intern_grow(c))
+      return NULL;
+    k = intern_find(c, key, h);
+  }
+
+  natusEngValFlags flags = natusEngValFlagUnlock | natusEngValFlagFree;
+  natusEngVal val = c->spec->new_string_utf8(c->ctx, key, strlen(key), &flags);
+  natusValue *self = mkval_heap(ctx, val, flags, natusValueTypeString);
+  if (!self)
+    return NULL;
+  if (natus_is_exception(self) || !(k->name = mem_strdup(c, key))) {
+    natus_decref(self);
+    return NULL;
+  }
+
+  /* See note in natus_set_private_name_value() */
+  self->weak = true;
+  context_decref(c);
+  c->stats.live--; /* Owned by the table, not a handle anyone can leak */
+
+  k->hash = h;
+  k->val = self;
+  c->nkeys++;
+  return self;
+}
+
 natusValue *
 natus_new_global(const char *name_or_path)
 {
   natusPrivate *priv = NULL;
   natusValue *self = NULL;
   void **dll = NULL;
-  bool res = false;
 
   self = mem_new_zero(NULL, natusValue);
   if (!self)
     goto error;
   mem_destructor_set(self, value_dtor);
 
-  self->ctx = mem_new_zero(self, natusContext);
+  self->ctx = mem_new_zero(NULL, natusContext);
   if (!self->ctx)
     goto error;
   mem_destructor_set(self->ctx, context_dtor);
+  self->ctx->refs = 1;
 
   dll = mem_new_zero(self->ctx, void*);
   if (!dll || !mem_name_set(dll, "dll"))
     goto error;
   mem_destructor_set(dll, dll_dtor);
 
-  priv = mem_new_size(dll, 0);
+  priv = private_new(dll);
   if (!priv)
     goto error;
 
   /* Load the engine */
-  if (name_or_path) {
-    res = do_load_file(name_or_path, false, dll, &self->ctx->spec);
-    if (!res) {
-      char *tmp = NULL;
-      if (asprintf(&tmp, "%s/%s%s", __str(ENGINEDIR), name_or_path, MODSUFFIX) >= 0) {
-        res = do_load_file(tmp, false, dll, &self->ctx->spec);
-        free(tmp);
-      }
-    }
-  } else {
-      res = do_load_dir(__str(ENGINEDIR), true, dll, &self->ctx->spec);
-      if (!res)
-        res = do_load_dir(__str(ENGINEDIR), false, dll, &self->ctx->spec);
-  }
-  if (!res)
+  if (!engine_load(name_or_path, dll, &self->ctx->spec))
     goto error;
 
-  if (!private_set(priv, NATUS_PRIV_GLOBAL, self, NULL))
+  if (!private_set_slot(priv, privateSlotGlobal, self, NULL))
     goto error;
 
   self->flag = natusEngValFlagUnlock | natusEngValFlagFree;
   if (!(self->val = self->ctx->spec->new_global(NULL, NULL, priv, &self->ctx->ctx, &self->flag)))
     goto error;
+  if (!context_keys(self))
+    goto error;
 
   return self;
 
@@ -262,37 +679,43 @@ natus_new_global_shared(const natusValue *global)
   if (!dll)
     return NULL;
 
-  natusPrivate *priv = mem_new_size(dll, 0);
+  natusPrivate *priv = private_new(dll);
   if (!priv)
     return NULL;
 
-  val = global->ctx->spec->new_global(global->ctx->ctx, global->val, priv, &ctx, &flags);
-  self = mkval(global, val, flags, natusValueTypeObject);
+  val = global->ctx->spec->new_global(global->ctx->ctx, engval(global), priv, &ctx, &flags);
+  self = mkval_heap(global, val, flags, natusValueTypeObject);
   if (!self)
     goto error;
 
   /* If a new context was created, wrap it */
   if (ctx && global->ctx->ctx != ctx) {
-    mem_decref(self, global->ctx);
-
-    self->ctx = mem_new_zero(self, natusContext);
-    if (!self->ctx) {
+    natusContext *nctx = mem_new_zero(NULL, natusContext);
+    if (!nctx) {
       mem_free(priv);
       mem_free(self);
       global->ctx->spec->ctx_free(ctx);
       return NULL;
     }
 
-    mem_destructor_set(self->ctx, context_dtor);
-    mem_group(global->ctx, self->ctx);
-    self->ctx->spec = global->ctx->spec;
-    self->ctx->ctx  = ctx;
+    mem_destructor_set(nctx, context_dtor);
+    mem_group(global->ctx, nctx);
+    nctx->spec = global->ctx->spec;
+    nctx->ctx  = ctx;
+    nctx->refs = 1;
+
+    self->ctx->stats.values--;
+    self->ctx->stats.live--;
+    context_decref(self->ctx);
+    self->ctx = nctx;
+    nctx->stats.values++;
+    nctx->stats.live++;
 
-    if (!mem_incref(self->ctx, dll))
+    if (!mem_incref(self->ctx, dll) || !context_keys(self))
       goto error;
   }
 
-  if (!private_set(priv, NATUS_PRIV_GLOBAL, self, NULL))
+  if (!private_set_slot(priv, privateSlotGlobal, self, NULL))
     goto error;
 
   return self;
@@ -309,12 +732,12 @@ natus_get_global(const natusValue *ctx)
   if (!ctx)
     return NULL;
 
-  natusValue *global = natus_get_private_name(ctx, NATUS_PRIV_GLOBAL);
+  natusValue *global = private_get_slot(private_of(ctx), privateSlotGlobal);
   if (global)
     return global;
 
   natusEngValFlags flags = natusEngValFlagUnlock | natusEngValFlagFree;
-  natusEngVal glb = ctx->ctx->spec->get_global(ctx->ctx->ctx, ctx->val, &flags);
+  natusEngVal glb = ctx->ctx->spec->get_global(ctx->ctx->ctx, engval(ctx), &flags);
   if (!glb)
     return NULL;
 
@@ -326,7 +749,7 @@ natus_get_global(const natusValue *ctx)
   if (!priv)
     return NULL;
 
-  return private_get(priv, NATUS_PRIV_GLOBAL);
+  return private_get_slot(priv, privateSlotGlobal);
 }
 
 const char *
@@ -342,5 +765,5 @@ natus_borrow_context(const natusValue *ctx, void **context, void **value)
 {
   if (!ctx)
     return false;
-  return ctx->ctx->spec->borrow_context(ctx->ctx->ctx, ctx->val, context, value);
+  return ctx->ctx->spec->borrow_context(ctx->ctx->ctx, engval(ctx), context, value);
 }
@@ -95,6 +95,40 @@ Value::getEngineName() const
   return natus_get_engine_name(internal);
 }
 
+bool
+Value::getContextStats(ContextStats* stats) const
+{
+  natusContextStats cs;
+  if (!stats || !natus_context_stats(internal, &cs))
+    return false;
+
+  stats->calls       = cs.calls;
+  stats->evaluations = cs.evaluations;
+  stats->callbacks   = cs.callbacks;
+  stats->properties  = cs.properties;
+  stats->values      = cs.values;
+  stats->live        = cs.live;
+  return true;
+}
+
+bool
+Value::exposeContextStats()
+{
+  return natus_context_stats_expose(internal);
+}
+
+bool
+Value::setTracer(TraceFunction func, void* misc, FreeFunction free) const
+{
+  return natus_trace_set(internal, (natusTraceFunction) func, misc, free);
+}
+
+bool
+Value::traceChrome(const char* filename) const
+{
+  return natus_trace_chrome(internal, filename);
+}
+
 bool
 Value::borrowContext(void **context, void **value) const
 {
@@ -106,3 +140,20 @@ Value::borrowCValue() const
 {
   return internal;
 }
+
+Scope::Scope(const Value& ctx)
+{
+  internal = natus_scope_enter(ctx.borrowCValue());
+}
+
+Scope::~Scope()
+{
+  natus_scope_leave(internal);
+  internal = NULL;
+}
+
+Value
+Scope::escape(const Value& val)
+{
+  return natus_scope_escape(internal, val.borrowCValue());
+}
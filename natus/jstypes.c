@@ -30,6 +30,8 @@ natus_get_type_name(const natusValue *ctx)
     return "string";
   case natusValueTypeUndefined:
     return "undefined";
+  case natusValueTypeBuffer:
+    return "buffer";
   default:
     return "unknown";
   }
@@ -95,6 +97,12 @@ natus_is_undefined(const natusValue *val)
   return !val || natus_is_type(val, natusValueTypeUndefined);
 }
 
+bool
+natus_is_buffer(const natusValue *val)
+{
+  return natus_is_type(val, natusValueTypeBuffer);
+}
+
 natusValue *
 natus_to_exception(natusValue *val)
 {
@@ -115,7 +123,7 @@ natus_equals(const natusValue *val1, const natusValue *val2)
     return true;
   if (!val1 || !val2)
     return false;
-  return val1->ctx->spec->equal(val1->ctx->ctx, val1->val, val2->val, false);
+  return val1->ctx->spec->equal(val1->ctx->ctx, engval(val1), engval(val2), false);
 }
 
 bool
@@ -129,5 +137,5 @@ natus_equals_strict(const natusValue *val1, const natusValue *val2)
     return true;
   if (!val1 || !val2)
     return false;
-  return val1->ctx->spec->equal(val1->ctx->ctx, val1->val, val2->val, true);
+  return val1->ctx->spec->equal(val1->ctx->ctx, engval(val1), engval(val2), true);
 }
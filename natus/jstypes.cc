@@ -180,6 +180,12 @@ Value::isUndefined() const
   return natus_is_undefined(internal);
 }
 
+bool
+Value::isBuffer() const
+{
+  return natus_is_buffer(internal);
+}
+
 Value
 Value::toException()
 {
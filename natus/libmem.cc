@@ -4,29 +4,47 @@
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
-using namespace std;
-
-#ifndef UINT16_MAX
-#define UINT16_MAX 65535
+#ifdef LIBMEM_SLAB
+#include <pthread.h>
 #endif
+using namespace std;
 
 #define DEFAULT_LINK_SIZE 2
 
+#ifdef LIBMEM_SLAB
+/* Links this small live inside the chunk itself */
+#define LINK_INLINE 2
+/* Freed blocks cached per size class and thread */
+#define SLAB_CACHE 1024
+#endif
+
 #define _GET_CHUNK(mem) \
   (mem >= sizeof(chunk) ? (mem - sizeof(chunk)) : 0)
 #define GET_CHUNK(mem) \
   ((chunk*) _GET_CHUNK((uintptr_t) (mem)))
 #define GET_ALLOC(chnk) \
   ((void*) (chnk ? chnk + 1 : NULL))
-#define OR_MAX(n) \
-  (n < UINT16_MAX ? n : UINT16_MAX)
+#define LINK_MAX \
+  (((size_t) -1) / sizeof(slot))
 
 struct chunk;
 
+/* One end of a parent/child link. back is the index of the other end in
+ * chnk's opposite link (children for a parent slot, parents for a child
+ * slot), so either end can be removed without searching. NULL parents
+ * have no other end. */
+struct slot {
+  chunk *chnk;
+  size_t back;
+};
+
 struct link {
-  chunk **chunks;
-  uint16_t size;
-  uint16_t used;
+  slot *slots;
+  size_t size;
+  size_t used;
+#ifdef LIBMEM_SLAB
+  slot inl[LINK_INLINE];
+#endif
 };
 
 struct chunk {
@@ -37,46 +55,268 @@ struct chunk {
   size_t size;
   char *name;
   memFree destructor;
+#ifdef LIBMEM_SLAB
+  uint8_t slab; /* Size class + 1, 0 when malloc()ed directly */
+#endif
 };
 
+#ifdef LIBMEM_SLAB
+static const size_t slab_sizes[] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512 };
+#define SLAB_COUNT (sizeof(slab_sizes) / sizeof(*slab_sizes))
+
+struct slab {
+  slab *next;
+};
+
+struct slabcache {
+  slab  *free[SLAB_COUNT];
+  size_t count[SLAB_COUNT];
+};
+
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slab_key;
+static __thread slabcache *slab_local;
+
+static void
+slab_cache_free(void *data)
+{
+  slabcache *cache = (slabcache*) data;
+  if (!cache)
+    return;
+
+  for (size_t i=0; i < SLAB_COUNT; i++) {
+    while (cache->free[i]) {
+      slab *tmp = cache->free[i];
+      cache->free[i] = tmp->next;
+      free(tmp);
+    }
+  }
+
+  free(cache);
+  slab_local = NULL;
+}
+
+static void
+slab_init()
+{
+  pthread_key_create(&slab_key, slab_cache_free);
+}
+
+static slabcache *
+slab_cache()
+{
+  if (!slab_local) {
+    pthread_once(&slab_once, slab_init);
+    slab_local = (slabcache*) calloc(1, sizeof(slabcache));
+    if (slab_local)
+      pthread_setspecific(slab_key, slab_local);
+  }
+  return slab_local;
+}
+
+static size_t
+slab_class(size_t size)
+{
+  size_t i;
+  for (i=0; i < SLAB_COUNT && slab_sizes[i] < size; i++)
+    ;
+  return i;
+}
+#endif
+
+static chunk *
+chunk_alloc(size_t size)
+{
+  chunk *chnk = NULL;
+
+#ifdef LIBMEM_SLAB
+  size_t cls = slab_class(size);
+  if (cls < SLAB_COUNT) {
+    slabcache *cache = slab_cache();
+    if (cache && cache->free[cls]) {
+      chnk = (chunk*) cache->free[cls];
+      cache->free[cls] = cache->free[cls]->next;
+      cache->count[cls]--;
+    } else if (!(chnk = (chunk*) malloc(sizeof(chunk) + slab_sizes[cls])))
+      return NULL;
+
+    memset(chnk, 0, sizeof(chunk));
+    chnk->slab = cls + 1;
+    chnk->size = size;
+    return chnk;
+  }
+#endif
+
+  chnk = (chunk*) malloc(sizeof(chunk) + size);
+  if (!chnk)
+    return NULL;
+  memset(chnk, 0, sizeof(chunk));
+  chnk->size = size;
+  return chnk;
+}
+
+static void
+chunk_dealloc(chunk *chnk)
+{
+#ifdef LIBMEM_SLAB
+  if (chnk && chnk->slab) {
+    size_t cls = chnk->slab - 1;
+    slabcache *cache = slab_cache();
+    if (cache && cache->count[cls] < SLAB_CACHE) {
+      slab *tmp = (slab*) chnk;
+      tmp->next = cache->free[cls];
+      cache->free[cls] = tmp;
+      cache->count[cls]++;
+      return;
+    }
+  }
+#endif
+  free(chnk);
+}
+
+static slot *
+link_grow(link *lnk, size_t size)
+{
+#ifdef LIBMEM_SLAB
+  if (lnk->size <= LINK_INLINE) {
+    if (size <= LINK_INLINE)
+      return lnk->inl;
+
+    slot *tmp = (slot*) malloc(size * sizeof(slot));
+    if (tmp && lnk->used > 0)
+      memcpy(tmp, lnk->slots, lnk->used * sizeof(slot));
+    return tmp;
+  }
+#endif
+  return (slot*) realloc(lnk->slots, size * sizeof(slot));
+}
+
+static void
+link_free(link *lnk)
+{
+#ifdef LIBMEM_SLAB
+  if (lnk->size <= LINK_INLINE)
+    return;
+#endif
+  free(lnk->slots);
+}
+
+/* Point everything that referenced a moved chunk at its new address */
+static void
+chunk_relocate(chunk *from, chunk *to)
+{
+  if (from == to)
+    return;
+
+#ifdef LIBMEM_SLAB
+  if (to->parents.size == LINK_INLINE)
+    to->parents.slots = to->parents.inl;
+  if (to->children.size == LINK_INLINE)
+    to->children.slots = to->children.inl;
+#endif
+
+  for (size_t i=0; i < to->parents.used; i++) {
+    slot *s = &to->parents.slots[i];
+    if (s->chnk)
+      s->chnk->children.slots[s->back].chnk = to;
+  }
+
+  for (size_t i=0; i < to->children.used; i++) {
+    slot *s = &to->children.slots[i];
+    s->chnk->parents.slots[s->back].chnk = to;
+  }
+
+  if (to->prev)
+    to->prev->next = to;
+  if (to->next)
+    to->next->prev = to;
+}
+
+static chunk *
+chunk_resize(chunk *chnk, size_t size)
+{
+  chunk *tmp;
+
+#ifdef LIBMEM_SLAB
+  if (chnk->slab) {
+    if (size <= slab_sizes[chnk->slab - 1]) {
+      chnk->size = size;
+      return chnk;
+    }
+
+    if (!(tmp = chunk_alloc(size)))
+      return NULL;
+    uint8_t cls = tmp->slab;
+    memcpy(tmp, chnk, sizeof(chunk) + chnk->size);
+    tmp->slab = cls;
+    chunk_dealloc(chnk);
+  } else
+#endif
+  if (!(tmp = (chunk*) realloc(chnk, sizeof(chunk) + size)))
+    return NULL;
+
+  tmp->size = size;
+  chunk_relocate(chnk, tmp);
+  return tmp;
+}
+
 static bool
-push(link* lnk, chunk *chnk)
+push(link* lnk, chunk *chnk, size_t back)
 {
   if (!lnk)
     return false;
 
   if (lnk->used == lnk->size) {
-    size_t size = lnk->size > 0
-                    ? OR_MAX(((size_t) lnk->size) * 2)
-                    : DEFAULT_LINK_SIZE;
     /* Check to make sure we don't roll over our ref */
-    if (size == lnk->size)
+    if (lnk->size > LINK_MAX / 2)
       return false;
-    chunk **tmp = (chunk**) realloc(lnk->chunks, size * sizeof(chunk*));
+    size_t size = lnk->size > 0 ? lnk->size * 2 : DEFAULT_LINK_SIZE;
+    slot *tmp = link_grow(lnk, size);
     if (!tmp)
       return false;
-    lnk->chunks = tmp;
+    lnk->slots = tmp;
     lnk->size = size;
   }
 
-  lnk->chunks[lnk->used++] = chnk;
+  lnk->slots[lnk->used].chnk = chnk;
+  lnk->slots[lnk->used].back = back;
+  lnk->used++;
   return true;
 }
 
-static bool
-pop(link *lnk, chunk *chnk)
+/* Remove slot i by moving the last slot into its place. The far end of the
+ * moved slot is told about its new index. */
+static void
+pop(link *lnk, size_t i, bool parents)
 {
-  size_t i;
-  if (!lnk || !lnk->chunks)
+  if (i != --lnk->used) {
+    slot *s = &lnk->slots[i];
+    *s = lnk->slots[lnk->used];
+    if (s->chnk)
+      (parents ? s->chnk->children : s->chnk->parents).slots[s->back].back = i;
+  }
+}
+
+/* Find which of chld's parent slots points at prnt, from the smaller side */
+static bool
+find(chunk *prnt, chunk *chld, size_t *i)
+{
+  if (prnt && prnt->children.used < chld->parents.used) {
+    for (size_t j=prnt->children.used; j > 0; j--) {
+      if (prnt->children.slots[j-1].chnk == chld) {
+        *i = prnt->children.slots[j-1].back;
+        return true;
+      }
+    }
     return false;
+  }
 
-  for (i = 0; i < lnk->used; i++) {
-    if (lnk->chunks[i] == chnk) {
-      lnk->chunks[i] = lnk->chunks[--lnk->used];
+  for (size_t j=chld->parents.used; j > 0; j--) {
+    if (chld->parents.slots[j-1].chnk == prnt) {
+      *i = j-1;
       return true;
     }
   }
-
   return false;
 }
 
@@ -92,13 +332,12 @@ pop(link *lnk, chunk *chnk)
   }
 
 static void
-_mem_unlink(chunk *prnt, chunk *chld, bool bothsides)
+_mem_unlink(chunk *chld, size_t i, bool bothsides)
 {
-  if (!chld)
-    return;
-
-  if (pop(&chld->parents, prnt) && prnt && bothsides)
-    pop(&prnt->children, chld);
+  slot s = chld->parents.slots[i];
+  pop(&chld->parents, i, true);
+  if (s.chnk && bothsides)
+    pop(&s.chnk->children, s.back, false);
 
   size_t count = 0;
   sib_loop(chld, tmp, count += tmp->parents.used);
@@ -112,23 +351,23 @@ _mem_unlink(chunk *prnt, chunk *chld, bool bothsides)
     /* Second loop: remove the children, do the free */
     sib_loop(chld, tmp,
       for (size_t i=tmp->children.used; i > 0; i--)
-        _mem_unlink(tmp, tmp->children.chunks[i-1], false);
+        _mem_unlink(tmp->children.slots[i-1].chnk,
+                    tmp->children.slots[i-1].back, false);
 
-      free(tmp->children.chunks);
-      free(tmp->parents.chunks);
-      free(tmp);
+      link_free(&tmp->children);
+      link_free(&tmp->parents);
+      chunk_dealloc(tmp);
     );
   }
 }
 
 #define domalloc(sz, parent, zero, err) \
-  chunk *chnk = (chunk*) malloc(sizeof(chunk) + (sz)); \
+  chunk *chnk = chunk_alloc(sz); \
   if (!chnk) { err; } \
-  memset(chnk, 0, sizeof(chunk)); \
-  chnk->size = sz; \
   void *tmp = mem::_incref(parent, GET_ALLOC(chnk)); \
   if (!tmp) { \
-    free(chnk); \
+    link_free(&chnk->parents); \
+    chunk_dealloc(chnk); \
     err; \
   } \
   if (zero) \
@@ -136,13 +375,13 @@ _mem_unlink(chunk *prnt, chunk *chld, bool bothsides)
   return tmp
 
 void*
-operator new(std::size_t size) throw (std::bad_alloc)
+operator new(std::size_t size) MEM_THROWS_BAD_ALLOC
 {
   domalloc(size, NULL, false, throw bad_alloc());
 }
 
 void*
-operator new[](std::size_t size) throw (std::bad_alloc)
+operator new[](std::size_t size) MEM_THROWS_BAD_ALLOC
 {
   domalloc(size, NULL, false, throw bad_alloc());
 }
@@ -160,13 +399,13 @@ operator new[](std::size_t size, const std::nothrow_t&) throw ()
 }
 
 void*
-operator new(size_t size, void* parent, bool zero) throw (std::bad_alloc)
+operator new(size_t size, void* parent, bool zero) MEM_THROWS_BAD_ALLOC
 {
   domalloc(size, parent, zero, throw bad_alloc());
 }
 
 void*
-operator new[](size_t size, void* parent, bool zero) throw (std::bad_alloc)
+operator new[](size_t size, void* parent, bool zero) MEM_THROWS_BAD_ALLOC
 {
   domalloc(size, parent, zero, throw bad_alloc());
 }
@@ -226,10 +465,9 @@ mem_resize_array_size(void **mem, size_t size, size_t count)
   chunk *chnk = GET_CHUNK(mem ? *mem : NULL);
   if (!chnk)
     return false;
-  chunk *tmp = (chunk*) realloc(chnk, sizeof(chunk) + (size * count));
+  chunk *tmp = chunk_resize(chnk, size * count);
   if (!tmp)
     return false;
-  tmp->size = size * count;
   *mem = GET_ALLOC(tmp);
   return true;
 }
@@ -403,11 +641,11 @@ _incref(void *parent, void *child)
   if (!chld)
     return NULL;
 
-  if (!push(&(chld->parents), prnt))
+  if (!push(&(chld->parents), prnt, prnt ? prnt->children.used : 0))
     return NULL;
 
-  if (prnt && !push(&(prnt->children), chld)) {
-    pop(&(chld->parents), prnt);
+  if (prnt && !push(&(prnt->children), chld, chld->parents.used - 1)) {
+    chld->parents.used--;
     return NULL;
   }
 
@@ -417,7 +655,10 @@ _incref(void *parent, void *child)
 void
 decref(void *parent, void *child)
 {
-  _mem_unlink(GET_CHUNK(parent), GET_CHUNK(child), true);
+  chunk *chld = GET_CHUNK(child);
+  size_t i;
+  if (chld && find(GET_CHUNK(parent), chld, &i))
+    _mem_unlink(chld, i, true);
 }
 
 void
@@ -428,9 +669,9 @@ decref_children(void *parent, const char *name)
     return;
 
   for (size_t i=chnk->children.used; i > 0; i--) {
-    chunk *tmp = chnk->children.chunks[i-1];
-    if (!name || (tmp->name && !strcmp(name, tmp->name)))
-      _mem_unlink(chnk, tmp, true);
+    slot s = chnk->children.slots[i-1];
+    if (!name || (s.chnk->name && !strcmp(name, s.chnk->name)))
+      _mem_unlink(s.chnk, s.back, true);
   }
 }
 
@@ -440,7 +681,7 @@ free(void *mem)
   chunk *chnk = GET_CHUNK(mem);
   if (!chnk || chnk->parents.used != 1)
     return;
-  _mem_unlink(chnk->parents.chunks[0], chnk, true);
+  _mem_unlink(chnk, 0, true);
   return;
 }
 
@@ -478,7 +719,7 @@ parents_count(void *mem, const char *name)
 
   size_t i, count;
   for (i=0, count=0; i < chnk->parents.used; i++)
-    if (!strcmp(chnk->parents.chunks[i]->name, name))
+    if (!strcmp(chnk->parents.slots[i].chnk->name, name))
       count++;
 
   return count;
@@ -492,9 +733,9 @@ _parents_foreach(void *mem, const char *name, memForEach cb, void *data)
     return;
 
   for (size_t i=chnk->parents.used; i > 0; i--)
-    if (!name || (chnk->parents.chunks[i-1]->name &&
-                  !strcmp(chnk->parents.chunks[i-1]->name, name)))
-      if (!cb(mem, GET_ALLOC(chnk->parents.chunks[i-1]), data))
+    if (!name || (chnk->parents.slots[i-1].chnk->name &&
+                  !strcmp(chnk->parents.slots[i-1].chnk->name, name)))
+      if (!cb(mem, GET_ALLOC(chnk->parents.slots[i-1].chnk), data))
         break;
 }
 
@@ -510,7 +751,7 @@ children_count(void *mem, const char *name)
 
   size_t i, count;
   for (i=0, count=0; i < chnk->children.used; i++)
-    if (!strcmp(chnk->children.chunks[i]->name, name))
+    if (!strcmp(chnk->children.slots[i].chnk->name, name))
       count++;
 
   return count;
@@ -524,9 +765,9 @@ _children_foreach(void *mem, const char *name, memForEach cb, void *data)
     return;
 
   for (size_t i=chnk->children.used; i > 0; i--)
-    if (!name || (chnk->children.chunks[i-1]->name &&
-                  !strcmp(chnk->children.chunks[i-1]->name, name)))
-      if (!cb(mem, GET_ALLOC(chnk->children.chunks[i-1]), data))
+    if (!name || (chnk->children.slots[i-1].chnk->name &&
+                  !strcmp(chnk->children.slots[i-1].chnk->name, name)))
+      if (!cb(mem, GET_ALLOC(chnk->children.slots[i-1].chnk), data))
         break;
 }
 
@@ -534,12 +775,21 @@ void *
 _steal(void *parent, void *child)
 {
   chunk *chld = GET_CHUNK(child);
+  chunk *prnt = GET_CHUNK(parent);
   if (!chld || chld->parents.used != 1)
     return NULL;
 
-  if (chld->parents.chunks[0])
-    pop(&chld->parents.chunks[0]->children, chld);
-  chld->parents.chunks[0] = GET_CHUNK(parent);
+  slot *s = &chld->parents.slots[0];
+  if (s->chnk == prnt)
+    return child;
+
+  if (prnt && !push(&prnt->children, chld, 0))
+    return NULL;
+  if (s->chnk)
+    pop(&s->chnk->children, s->back, false);
+
+  s->chnk = prnt;
+  s->back = prnt ? prnt->children.used - 1 : 0;
   return child;
 }
 
@@ -25,12 +25,18 @@
 #include <new>
 #include <cstddef>
 
-void* operator new(std::size_t) throw (std::bad_alloc);
-void* operator new[](std::size_t) throw (std::bad_alloc);
+#if __cplusplus >= 201103L
+#define MEM_THROWS_BAD_ALLOC
+#else
+#define MEM_THROWS_BAD_ALLOC throw (std::bad_alloc)
+#endif
+
+void* operator new(std::size_t) MEM_THROWS_BAD_ALLOC;
+void* operator new[](std::size_t) MEM_THROWS_BAD_ALLOC;
 void* operator new(std::size_t, const std::nothrow_t&) throw();
 void* operator new[](std::size_t, const std::nothrow_t&) throw();
-void* operator new(std::size_t, void* parent, bool zero=false) throw (std::bad_alloc);
-void* operator new[](std::size_t, void* parent, bool zero=false) throw (std::bad_alloc);
+void* operator new(std::size_t, void* parent, bool zero=false) MEM_THROWS_BAD_ALLOC;
+void* operator new[](std::size_t, void* parent, bool zero=false) MEM_THROWS_BAD_ALLOC;
 void* operator new(std::size_t, const std::nothrow_t&, void* parent, bool zero=false) throw();
 void* operator new[](std::size_t, const std::nothrow_t&, void* parent, bool zero=false) throw();
 void operator delete(void*) throw();
@@ -35,6 +35,7 @@ using namespace std;
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <regex.h>
+#include <unistd.h>
 
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -262,6 +263,7 @@ main(int argc, char** argv)
   vector<string> configs;
   const char *eng = NULL;
   const char *eval = NULL;
+  const char *trace = NULL;
   int c = 0, exitcode = 0;
   glbl = &global;
 
@@ -276,7 +278,7 @@ main(int argc, char** argv)
   path += __str(MODULEDIR);
 
   opterr = 0;
-  while ((c = getopt(argc, argv, "+C:c:e:n")) != -1) {
+  while ((c = getopt(argc, argv, "+C:c:e:nt:")) != -1) {
     switch (c) {
     case 'C':
       configs.push_back(optarg);
@@ -290,11 +292,14 @@ main(int argc, char** argv)
     case 'n':
       path.clear();
       break;
+    case 't':
+      trace = optarg;
+      break;
     case '?':
       if (optopt == 'e')
         fprintf(stderr, "Option -%c requires an engine name.\n", optopt);
       else {
-        fprintf(stderr, "Usage: %s [-C <config>=<jsonval>|-c <javascript>|-e <engine>|-n|<scriptfile>]\n\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-C <config>=<jsonval>|-c <javascript>|-e <engine>|-n|-t <tracefile>|<scriptfile>]\n\n", argv[0]);
         fprintf(stderr, "Unknown option `-%c'.\n", optopt);
       }
       return 1;
@@ -307,6 +312,8 @@ main(int argc, char** argv)
   global = Value::newGlobal(eng);
   if (global.isUndefined() || global.isException())
     error(2, 0, "Unable to init global!\n");
+  if (trace && !global.traceChrome(trace))
+    error(2, 0, "Unable to trace to '%s'!\n", trace);
 
   // Setup our config
   Value cfg = global.newObject();
@@ -348,6 +355,9 @@ main(int argc, char** argv)
   if (!require::init(global, cfg))
     error(3, 0, "Unable to init module loader\n!");
 
+  // Let scripts see what they cost
+  global.exposeContextStats();
+
   // Do the evaluation
   if (eval) {
     Value res = global.evaluate(eval);
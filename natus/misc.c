@@ -84,6 +84,7 @@ natus_throw_exception_varg(const natusValue *ctx, const char *base, const char *
   natusValue *argv = natus_new_array(err, vmsg, NULL);
   natusValue *exc = natus_call_new_array(err, argv);
   natus_decref(argv);
+  natus_decref(vmsg);
   natus_decref(err);
 
   // Set the name
@@ -748,14 +749,13 @@ natus_convert_arguments_varg(natusValue *arg, const char *fmt, va_list ap)
         d = va_arg(apc, void*);
         if (natus_is_undefined(val)) {
           if (d != NULL) {
-            ssize_t len = 0;
-            while (((natusChar*) d)[len++])
-              ;
+            size_t len = 0;
+            while (((natusChar*) d)[len])
+              len++;
             natusChar *tmp = calloc(len+1, sizeof(natusChar));
             if (!tmp)
               goto nomem;
-            for (; len >= 0; len--)
-              tmp[len] = ((natusChar*) d)[len];
+            memcpy(tmp, d, sizeof(natusChar) * len);
             d = tmp;
           }
           *((natusChar**) p) = (natusChar*) d;
@@ -29,13 +29,14 @@
 extern "C" {
 #endif /* __cplusplus */
 
-#define NATUS_ENGINE_VERSION 1
+#define NATUS_ENGINE_VERSION 12
 #define NATUS_ENGINE_ natus_engine__
-#define NATUS_ENGINE(name, symb, prfx) \
+#define NATUS_ENGINE(name, symb, flags, prfx) \
   natusEngineSpec NATUS_ENGINE_ = { \
     NATUS_ENGINE_VERSION, \
     name, \
     symb, \
+    flags, \
     prfx ## _ctx_free, \
     prfx ## _val_unlock, \
     prfx ## _val_duplicate, \
@@ -45,26 +46,43 @@ extern "C" {
     prfx ## _new_number, \
     prfx ## _new_string_utf8, \
     prfx ## _new_string_utf16, \
+    prfx ## _new_string_external_utf8, \
+    prfx ## _new_string_external_utf16, \
     prfx ## _new_array, \
+    prfx ## _new_array_doubles, \
     prfx ## _new_function, \
     prfx ## _new_object, \
+    prfx ## _new_buffer, \
     prfx ## _new_null, \
     prfx ## _new_undefined, \
     prfx ## _to_bool, \
     prfx ## _to_double, \
     prfx ## _to_string_utf8, \
     prfx ## _to_string_utf16, \
+    prfx ## _to_string_utf8_buffer, \
+    prfx ## _to_string_utf16_range, \
+    prfx ## _string_view, \
+    prfx ## _string_release, \
+    prfx ## _to_doubles, \
     prfx ## _del, \
     prfx ## _get, \
     prfx ## _set, \
+    prfx ## _get_index, \
+    prfx ## _set_index, \
     prfx ## _enumerate, \
     prfx ## _call, \
+    prfx ## _call_argv, \
     prfx ## _evaluate, \
+    prfx ## _compile, \
+    prfx ## _run, \
+    prfx ## _serialize, \
+    prfx ## _deserialize, \
     prfx ## _get_private, \
     prfx ## _get_global, \
     prfx ## _get_type, \
     prfx ## _borrow_context, \
-    prfx ## _equal \
+    prfx ## _equal, \
+    prfx ## _identity \
   }
 
 #ifndef NATUS_ENGINE_TYPES_DEFINED
@@ -88,10 +106,30 @@ typedef enum {
   natusEngValFlagFree      = 1 << 2
 } natusEngValFlags;
 
+/* The hooks a natusClass implements. Engines may share one engine-side
+ * class between all the natusClasses with the same mask. */
+typedef enum {
+  natusClassHookNone      = 0,
+  natusClassHookDel       = 1,
+  natusClassHookGet       = 1 << 1,
+  natusClassHookSet       = 1 << 2,
+  natusClassHookEnumerate = 1 << 3,
+  natusClassHookCall      = 1 << 4,
+  natusClassHookAll       = (1 << 5) - 1
+} natusClassHooks;
+
+typedef enum {
+  natusEngineFlagNone       = 0,
+  /* Globals from natus_new_global() may each be used on a thread of their
+   * own, at the same time. Natus pools only run on such engines. */
+  natusEngineFlagThreadSafe = 1
+} natusEngineFlags;
+
 typedef struct {
-  unsigned int version;
-  const char  *name;
-  const char  *symbol;
+  unsigned int     version;
+  const char      *name;
+  const char      *symbol;
+  natusEngineFlags flags;
 
   void           (*ctx_free)         (natusEngCtx ctx);
   void           (*val_unlock)       (natusEngCtx ctx, natusEngVal val);
@@ -103,9 +141,15 @@ typedef struct {
   natusEngVal    (*new_number)       (const natusEngCtx ctx, double n, natusEngValFlags *flags);
   natusEngVal    (*new_string_utf8)  (const natusEngCtx ctx, const char *str, size_t len, natusEngValFlags *flags);
   natusEngVal    (*new_string_utf16) (const natusEngCtx ctx, const natusChar *str, size_t len, natusEngValFlags *flags);
+  /* The engine may use str until it calls free(str), exactly once and
+   * possibly right away (it copies). A NULL free means str is static. */
+  natusEngVal    (*new_string_external_utf8) (const natusEngCtx ctx, const char *str, size_t len, natusFreeFunction free, natusEngValFlags *flags);
+  natusEngVal    (*new_string_external_utf16)(const natusEngCtx ctx, const natusChar *str, size_t len, natusFreeFunction free, natusEngValFlags *flags);
   natusEngVal    (*new_array)        (const natusEngCtx ctx, const natusEngVal *array, size_t len, natusEngValFlags *flags);
+  natusEngVal    (*new_array_doubles)(const natusEngCtx ctx, const double *array, size_t len, natusEngValFlags *flags);
   natusEngVal    (*new_function)     (const natusEngCtx ctx, const char *name, natusPrivate *priv, natusEngValFlags *flags);
   natusEngVal    (*new_object)       (const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, natusEngValFlags *flags);
+  natusEngVal    (*new_buffer)       (const natusEngCtx ctx, natusClass *cls, natusPrivate *priv, void *data, size_t len, natusEngValFlags *flags);
   natusEngVal    (*new_null)         (const natusEngCtx ctx, natusEngValFlags *flags);
   natusEngVal    (*new_undefined)    (const natusEngCtx ctx, natusEngValFlags *flags);
 
@@ -113,24 +157,52 @@ typedef struct {
   double         (*to_double)        (const natusEngCtx ctx, const natusEngVal val);
   char          *(*to_string_utf8)   (const natusEngCtx ctx, const natusEngVal val, size_t *len);
   natusChar     *(*to_string_utf16)  (const natusEngCtx ctx, const natusEngVal val, size_t *len);
+  /* Same contract as natus_to_string_utf8_buffer() */
+  size_t         (*to_string_utf8_buffer)(const natusEngCtx ctx, const natusEngVal val, char *buf, size_t size);
+  /* Same contract as natus_to_string_utf16_range() */
+  size_t         (*to_string_utf16_range)(const natusEngCtx ctx, const natusEngVal val, size_t offset, natusChar *buf, size_t size);
+  /* Lends a string value's characters until string_release(token), which
+   * is skipped for a NULL token. NULL if there is no flat storage to lend. */
+  const natusChar*(*string_view)     (const natusEngCtx ctx, const natusEngVal val, size_t *len, void **token);
+  void           (*string_release)   (const natusEngCtx ctx, void *token);
+  bool           (*to_doubles)       (const natusEngCtx ctx, const natusEngVal val, double *array, size_t len);
 
   natusEngVal    (*del)              (const natusEngCtx ctx, natusEngVal val, const natusEngVal id, natusEngValFlags *flags);
   natusEngVal    (*get)              (const natusEngCtx ctx, natusEngVal val, const natusEngVal id, natusEngValFlags *flags);
   natusEngVal    (*set)              (const natusEngCtx ctx, natusEngVal val, const natusEngVal id, const natusEngVal value, natusPropAttr attrs, natusEngValFlags *flags);
+  natusEngVal    (*get_index)        (const natusEngCtx ctx, natusEngVal val, uint32_t idx, natusEngValFlags *flags);
+  natusEngVal    (*set_index)        (const natusEngCtx ctx, natusEngVal val, uint32_t idx, const natusEngVal value, natusEngValFlags *flags);
   natusEngVal    (*enumerate)        (const natusEngCtx ctx, natusEngVal val, natusEngValFlags *flags);
 
   natusEngVal    (*call)             (const natusEngCtx ctx, natusEngVal func, natusEngVal ths, natusEngVal args, natusEngValFlags *flags);
+  natusEngVal    (*call_argv)        (const natusEngCtx ctx, natusEngVal func, natusEngVal ths, size_t argc, const natusEngVal *argv, natusEngValFlags *flags);
   natusEngVal    (*evaluate)         (const natusEngCtx ctx, natusEngVal ths, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno, natusEngValFlags *flags);
+  /* compile returns an object which only run understands; run must throw
+   * for anything else */
+  natusEngVal    (*compile)          (const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno, natusEngValFlags *flags);
+  natusEngVal    (*run)              (const natusEngCtx ctx, natusEngVal ths, const natusEngVal script, natusEngValFlags *flags);
+  /* serialize returns a malloc()ed copy of a compiled script, which
+   * deserialize may turn back into one in another process. Either may
+   * return NULL: when the engine can't, or the data doesn't fit. */
+  void          *(*serialize)        (const natusEngCtx ctx, const natusEngVal script, size_t *len);
+  natusEngVal    (*deserialize)      (const natusEngCtx ctx, const natusEngVal jscript, const natusEngVal filename, unsigned int lineno,
+                                      const void *data, size_t len, natusEngValFlags *flags);
 
   natusPrivate  *(*get_private)      (const natusEngCtx ctx, const natusEngVal val);
   natusEngVal    (*get_global)       (const natusEngCtx ctx, const natusEngVal val, natusEngValFlags *flags);
   natusValueType (*get_type)         (const natusEngCtx ctx, const natusEngVal val);
   bool           (*borrow_context)   (natusEngCtx ctx, natusEngVal val, void **context, void **value);
   bool           (*equal)            (const natusEngCtx ctx, const natusEngVal val1, const natusEngVal val2, bool strict);
+  /* The same for every handle on one object, and seldom shared with others;
+   * strict equal() tells them apart */
+  uintptr_t      (*identity)         (const natusEngCtx ctx, const natusEngVal val);
 } natusEngineSpec;
 
 natusEngVal natus_handle_property(natusPropertyAction act, natusEngVal obj, const natusPrivate *priv, natusEngVal idx, natusEngVal val, natusEngValFlags *flags);
 natusEngVal natus_handle_call    (natusEngVal obj, const natusPrivate *priv, natusEngVal ths, natusEngVal arg, natusEngValFlags *flags);
+/* Like natus_handle_call(), argv only has to stay valid until it returns */
+natusEngVal natus_handle_call_argv(natusEngVal obj, const natusPrivate *priv, natusEngVal ths, size_t argc, const natusEngVal *argv, natusEngValFlags *flags);
+natusClassHooks natus_class_hooks(const natusClass *cls);
 void natus_private_free(natusPrivate *priv);
 bool natus_private_push(natusPrivate *self, void *priv, natusFreeFunction free);
 
@@ -29,6 +29,7 @@
 #define NATUS_PRIV_CLASS     "natus::Class"
 #define NATUS_PRIV_FUNCTION  "natus::Function"
 #define NATUS_PRIV_GLOBAL    "natus::Global"
+#define NATUS_PRIV_BUFFER    "natus::Buffer"
 
 #define callandmkval(n, t, c, f, ...) \
   natusEngValFlags _flags = natusEngValFlagUnlock | natusEngValFlagFree; \
@@ -40,12 +41,24 @@
   return _value
 
 typedef struct evalHook evalHook;
+typedef struct internKey internKey;
+typedef struct natusTracer natusTracer;
 
 typedef struct natusContext natusContext;
 struct natusContext {
   natusEngCtx      ctx;
   natusEngineSpec *spec;
   evalHook        *evalhooks;
+  natusScope      *scope; /* Innermost open scope */
+  size_t           refs;
+  internKey       *keys;  /* Interned property names, open addressed */
+  size_t           nkeys;
+  size_t           keyssize;
+  size_t           keyshand; /* Clock hand for evicting keys */
+  size_t           keysbusy; /* Borrowed keys in use, none may be evicted */
+  natusValue      *length;   /* The "length" key, held for as long as we are */
+  natusContextStats stats;
+  natusTracer     *tracer;
 };
 
 struct natusValue {
@@ -53,11 +66,89 @@ struct natusValue {
   natusEngVal      val;
   natusEngValFlags flag;
   natusValueType   type;
+  bool             weak;  /* Holds no reference on ctx */
+  natusScope      *scope; /* Arena holding this value, NULL if on the heap */
+  size_t           refs;  /* References to a scoped value */
+  const natusEngVal *argv; /* Arguments not yet made into an array */
+  size_t           argc;
 };
 
+/* The engine value of v, turning an arguments view into an array first */
+#define engval(v) \
+  ((v)->argv ? argv_materialize((natusValue*) (v)) : (v)->val)
+
 natusValue *
 mkval(const natusValue *ctx, natusEngVal val, natusEngValFlags flags, natusValueType type);
 
+/* Like mkval(), but never allocates in a scope: for values natus keeps */
+natusValue *
+mkval_heap(const natusValue *ctx, natusEngVal val, natusEngValFlags flags, natusValueType type);
+
+/* An array-typed value over argv which is only valid during a call.
+ * Reading its length or an index never builds the engine array. */
+natusValue *
+argv_view(const natusValue *ctx, size_t argc, const natusEngVal *argv);
+
+natusEngVal
+argv_materialize(natusValue *view);
+
+natusValue *
+argv_index(const natusValue *view, size_t idx);
+
+/* Drops the caller's reference to view, giving it an array of its own
+ * first if anyone else kept one */
+void
+argv_release(natusValue *view);
+
+/* Opens the engine natus_new_global(name_or_path) would use */
+bool
+engine_load(const char *name_or_path, void **dll, natusEngineSpec **spec);
+
+natusContext *
+context_incref(natusContext *ctx);
+
+void
+context_decref(natusContext *ctx);
+
+size_t
+hash_utf8(const char *str);
+
+/* Names of traced crossings are cut at this many bytes */
+#define TRACE_NAME 128
+
+/* If ctx is traced, names the crossing into buf and reports entering it.
+ * The name is prefix, if any, then the "name" property of a function val
+ * or a string or number val itself; dflt if that is empty. Returns the
+ * name, NULL if not traced, for trace_leave(). */
+const char *
+trace_enter(const natusValue *ctx, natusTraceEvent event, const char *prefix,
+            const natusValue *val, const char *dflt, char *buf);
+
+void
+trace_leave(const natusValue *ctx, natusTraceEvent event, const char *name);
+
+/* Fixed slots for the built-in private keys */
+typedef enum {
+  privateSlotClass,
+  privateSlotFunction,
+  privateSlotGlobal,
+  privateSlotBuffer,
+  privateSlotCount
+} privateSlot;
+
+natusPrivate *
+private_new(void *parent);
+
+/* The private storage of obj, NULL if it has none */
+natusPrivate *
+private_of(const natusValue *obj);
+
+void *
+private_get_slot(const natusPrivate *self, privateSlot slot);
+
+bool
+private_set_slot(natusPrivate *self, privateSlot slot, void *priv, natusFreeFunction free);
+
 void *
 private_get(const natusPrivate *self, const char *name);
 
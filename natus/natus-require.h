@@ -58,6 +58,9 @@ natus_require_init_utf8(natusValue *ctx, const char *config);
 natusValue *
 natus_require_get_config(natusValue *ctx);
 
+bool
+natus_require_reload_config(natusValue *ctx);
+
 bool
 natus_require_hook_add(natusValue *ctx, const char *name, natusRequireHook func,
                        void *misc, natusFreeFunction free);
@@ -76,6 +79,9 @@ natus_require_origin_matcher_del(natusValue *ctx, const char *name);
 bool
 natus_require_origin_permitted(natusValue *ctx, const char *uri);
 
+bool
+natus_require_resolve_stats(natusValue *ctx, size_t *hits, size_t *misses);
+
 natusValue *
 natus_require(natusValue *ctx, natusValue *name);
 
@@ -81,9 +81,15 @@ namespace natus
     Value
     getConfig(Value ctx);
 
+    bool
+    reloadConfig(Value ctx);
+
     bool
     originPermitted(Value ctx, const char* name);
 
+    bool
+    resolveStats(Value ctx, size_t* hits, size_t* misses);
+
     Value
     require(Value ctx, UTF8 name);
 
@@ -42,12 +42,23 @@
 
 typedef struct natusValue natusValue;
 
+/* A scope collects every value created for a context while it is open and
+ * releases them all when it is left. See natus_scope_enter(). */
+typedef struct natusScope natusScope;
+
 #ifdef WIN32
 typedef wchar_t natusChar;
 #else
 typedef uint16_t natusChar;
 #endif
 
+/* A string's characters, lent by natus_string_view_utf16() */
+typedef struct {
+  const natusValue *val;
+  void             *token;
+  natusChar        *copy;
+} natusStringView;
+
 /* Type: natusFreeFunction
  * Function type for calls made back to free a memory value allocated outside natus.
  *
@@ -106,7 +117,8 @@ typedef enum {
   natusValueTypeObject = 1 << 5,
   natusValueTypeString = 1 << 6,
   natusValueTypeUndefined = 1 << 7,
-  natusValueTypeSupportsPrivate = natusValueTypeFunction | natusValueTypeObject,
+  natusValueTypeBuffer = 1 << 8,
+  natusValueTypeSupportsPrivate = natusValueTypeFunction | natusValueTypeObject | natusValueTypeBuffer,
 } natusValueType;
 
 typedef enum {
@@ -150,6 +162,28 @@ natus_incref(natusValue *val);
 void
 natus_decref(natusValue *val);
 
+/* Opens a new scope on the context of ctx. Until the matching
+ * natus_scope_leave(), values created in that context are carved from the
+ * scope's arena instead of being allocated one by one.
+ *
+ * Scoped values are still reference counted as usual, so existing code that
+ * natus_decref()s its temporaries keeps working, but anything left over is
+ * released when the scope is left. A scoped value must not be used after
+ * that; hand it to natus_scope_escape() to keep it.
+ *
+ * Scopes nest and must be left in the reverse order they were entered. */
+natusScope *
+natus_scope_enter(const natusValue *ctx);
+
+/* Returns a new reference to val which outlives scope: it belongs to the
+ * enclosing scope if there is one, otherwise it is an ordinary value which
+ * must be natus_decref()ed. */
+natusValue *
+natus_scope_escape(natusScope *scope, natusValue *val);
+
+void
+natus_scope_leave(natusScope *scope);
+
 natusValue *
 natus_new_global(const char *name_or_path);
 
@@ -180,6 +214,25 @@ natus_new_string_utf16(const natusValue *ctx, const natusChar *string);
 natusValue *
 natus_new_string_utf16_length(const natusValue *ctx, const natusChar *string, size_t len);
 
+/* Makes a string of len characters at string, sharing them where the
+ * engine can. The characters must stay valid and unchanged, followed by a
+ * NUL, until freefnc(string) is called; this is once the engine is done,
+ * right away when it copies, and also when this fails. A NULL freefnc
+ * means the characters are static. */
+natusValue *
+natus_new_string_external_utf8(const natusValue *ctx, const char *string, size_t len, natusFreeFunction freefnc);
+
+natusValue *
+natus_new_string_external_utf16(const natusValue *ctx, const natusChar *string, size_t len, natusFreeFunction freefnc);
+
+/* Returns the string key, shared by every caller on the same context.
+ * The value is owned by the context: do not natus_decref() it. Once the
+ * table is full, keys not looked up lately are evicted for new ones, so
+ * natus_incref() a key to keep it past the next natus_intern_utf8().
+ * Returns NULL when no key can be evicted. */
+const natusValue *
+natus_intern_utf8(const natusValue *ctx, const char *key);
+
 natusValue *
 natus_new_array(const natusValue *ctx, ...);
 
@@ -189,6 +242,20 @@ natus_new_array_vector(const natusValue *ctx, const natusValue **array);
 natusValue *
 natus_new_array_varg(const natusValue *ctx, va_list ap);
 
+/* Build a dense array in one engine call, without a value per item.
+ * NULL strings become null. */
+natusValue *
+natus_new_array_doubles(const natusValue *ctx, const double *array, size_t len);
+
+natusValue *
+natus_new_array_utf8_strings(const natusValue *ctx, const char * const *array, size_t len);
+
+/* Wraps len bytes at data, without copying them, as a Buffer whose items
+ * are the bytes. freefnc(data) is called once the engine is done with
+ * it, also when this fails. */
+natusValue *
+natus_new_buffer_external(const natusValue *ctx, void *data, size_t len, natusFreeFunction freefnc);
+
 natusValue *
 natus_new_function(const natusValue *ctx, natusNativeFunction func, const char *name);
 
@@ -207,6 +274,59 @@ natus_get_global(const natusValue *ctx);
 const char *
 natus_get_engine_name(const natusValue *ctx);
 
+/* Counters for the engine context a value belongs to. Crossings into the
+ * engine are calls of script functions through natus_call_array() and
+ * evaluations (natus_evaluate() and natus_run()); crossings out of it are
+ * calls of native functions and of class property hooks. */
+typedef struct {
+  size_t calls;
+  size_t evaluations;
+  size_t callbacks;
+  size_t properties;
+  size_t values; /* Values created */
+  size_t live;   /* Values created and not yet released */
+} natusContextStats;
+
+bool
+natus_context_stats(const natusValue *ctx, natusContextStats *stats);
+
+/* Defines natus.stats on global, a read-only object with the counters
+ * above as properties, read whenever they are looked up */
+bool
+natus_context_stats_expose(natusValue *global);
+
+/* The same crossings, as they happen. A tracer is called on entering
+ * and on leaving each of them with the time from CLOCK_MONOTONIC. */
+typedef enum {
+  natusTraceCall,     /* name: the function's */
+  natusTraceEvaluate, /* name: the filename */
+  natusTraceCallback, /* name: the native function's */
+  natusTraceProperty, /* name: the action and the property */
+  natusTraceRequire   /* name: the module's, its uri on leaving if found */
+} natusTraceEvent;
+
+typedef void
+(*natusTraceFunction)(natusTraceEvent event, bool enter, const char *name,
+                      uint64_t ns, void *misc);
+
+/* Replaces the tracer of ctx's context, none if func is NULL.
+ * free is called on misc when the tracer is replaced or the context freed. */
+bool
+natus_trace_set(const natusValue *ctx, natusTraceFunction func, void *misc,
+                natusFreeFunction free);
+
+bool
+natus_tracing(const natusValue *ctx);
+
+/* Reports a crossing of your own, like natus_require() does */
+void
+natus_trace(const natusValue *ctx, natusTraceEvent event, bool enter, const char *name);
+
+/* Traces ctx into filename as Chrome trace event JSON (chrome://tracing),
+ * which is complete once the tracer is replaced or the context freed. */
+bool
+natus_trace_chrome(const natusValue *ctx, const char *filename);
+
 natusValueType
 natus_get_type(const natusValue *ctx);
 
@@ -246,6 +366,9 @@ natus_is_string(const natusValue *val);
 bool
 natus_is_undefined(const natusValue *val);
 
+bool
+natus_is_buffer(const natusValue *val);
+
 natusValue *
 natus_to_exception(natusValue *val);
 
@@ -267,6 +390,39 @@ natus_to_string_utf8(const natusValue *val, size_t *len);
 natusChar *
 natus_to_string_utf16(const natusValue *val, size_t *len);
 
+/* Writes val as UTF-8 into buf, like snprintf(): at most size bytes with
+ * the NUL, never splitting a character. Returns the full length (without
+ * the NUL), so a result >= size means buf was too small; (size_t) -1 on
+ * error. buf may be NULL when size is 0. */
+size_t
+natus_to_string_utf8_buffer(const natusValue *val, char *buf, size_t size);
+
+/* Copies at most size characters of val, starting at offset, into buf
+ * without converting the rest of the string. Returns how many were
+ * copied, fewer than size only at the end of the string; (size_t) -1 on
+ * error. */
+size_t
+natus_to_string_utf16_range(const natusValue *val, size_t offset, natusChar *buf, size_t size);
+
+/* Points chars at val's characters without copying them when the engine
+ * can lend them, else at a copy. Either way they are not NUL terminated,
+ * must not be changed and are valid until natus_string_view_release(),
+ * which must come before val is released. */
+bool
+natus_string_view_utf16(const natusValue *val, const natusChar **chars, size_t *len, natusStringView *view);
+
+void
+natus_string_view_release(natusStringView *view);
+
+/* Returns every item of an array as a number (holes are NaN), in a buffer
+ * which the caller must free(). NULL if val is not an array. */
+double *
+natus_array_to_doubles(const natusValue *val, size_t *len);
+
+/* Points data at a Buffer's bytes, which stay valid as long as val does */
+bool
+natus_borrow_buffer(const natusValue *val, void **data, size_t *len);
+
 bool
 natus_as_bool(natusValue *val);
 
@@ -354,6 +510,32 @@ natus_evaluate(natusValue *ths, natusValue *javascript, natusValue *filename, un
 natusValue *
 natus_evaluate_utf8(natusValue *ths, const char *javascript, const char *filename, unsigned int lineno);
 
+/* Parses javascript once, for any number of natus_run() calls in the same
+ * context. Returns an opaque object, or an exception if it doesn't parse.
+ * Evaluate hooks see the compile, with the script as its return value,
+ * rather than each run. */
+natusValue *
+natus_compile(natusValue *ctx, natusValue *javascript, natusValue *filename, unsigned int lineno);
+
+natusValue *
+natus_compile_utf8(natusValue *ctx, const char *javascript, const char *filename, unsigned int lineno);
+
+natusValue *
+natus_run(natusValue *ths, natusValue *script);
+
+/* Returns a malloc()ed copy of a compiled script for a later
+ * natus_compile_cached() on the same engine, or NULL if the engine can't
+ * save its compiled code. */
+void *
+natus_serialize(natusValue *script, size_t *len);
+
+/* Like natus_compile(), but first tries data from natus_serialize(). hit,
+ * if given, tells whether data was used; stale or foreign data is not an
+ * error, the source is compiled instead. */
+natusValue *
+natus_compile_cached(natusValue *ctx, natusValue *javascript, natusValue *filename, unsigned int lineno,
+                     const void *data, size_t len, bool *hit);
+
 natusValue *
 natus_call(natusValue *func, natusValue *ths, ...);
 
@@ -363,6 +545,10 @@ natus_call_varg(natusValue *func, natusValue *ths, va_list ap);
 natusValue *
 natus_call_array(natusValue *func, natusValue *ths, natusValue *args);
 
+/* Calls func with argc arguments taken from argv, without building an array */
+natusValue *
+natus_call_argv(natusValue *func, natusValue *ths, size_t argc, natusValue **argv);
+
 natusValue *
 natus_call_utf8(natusValue *ths, const char *name, ...);
 
@@ -434,6 +620,67 @@ natus_evaluate_hook_add(natusValue *ctx, const char *name,
 bool
 natus_evaluate_hook_del(natusValue *ctx, const char *name);
 
+/* A copy of a value which belongs to no context or thread: undefined,
+ * null, booleans, numbers, strings, buffers, and arrays and plain objects
+ * of those, nested at most 1024 deep. Those met more than once are cloned
+ * once and stay shared; holes in arrays are skipped. natus_clone()
+ * returns NULL for anything else, such as functions, objects of native
+ * classes or cycles. */
+typedef struct natusClone natusClone;
+
+natusClone *
+natus_clone(const natusValue *val);
+
+natusValue *
+natus_clone_value(const natusValue *ctx, const natusClone *clone);
+
+bool
+natus_clone_is_exception(const natusClone *clone);
+
+void
+natus_clone_free(natusClone *clone);
+
+/* A pool of worker threads, each with a global of its own which lives as
+ * long as the pool does, so whatever a worker loads stays warm. Every
+ * worker uses the engine name_or_path picks for natus_new_global(), and
+ * natus_pool_new() fails unless that engine is thread safe (v8 isn't).
+ *
+ * setup is called on each worker thread, at once, with its new global;
+ * natus_pool_new() fails if it returns false for any of them.
+ *
+ * natus_pool_submit() queues script, which is compiled once per worker,
+ * and takes args. If args is given and the script evaluates to a
+ * function, it is called with args, which must clone an array. The
+ * result is cloned to the callback on the worker thread; the callback
+ * owns it. Exceptions thrown as objects, and results which don't clone,
+ * become exceptions carrying their message. */
+typedef struct natusPool natusPool;
+
+typedef bool
+(*natusPoolSetup)(natusValue *global, size_t worker, void *misc);
+
+typedef void
+(*natusPoolCallback)(natusClone *result, void *misc);
+
+natusPool *
+natus_pool_new(const char *name_or_path, size_t workers,
+               natusPoolSetup setup, void *misc);
+
+bool
+natus_pool_submit(natusPool *pool, const char *script, natusClone *args,
+                  natusPoolCallback func, void *misc);
+
+/* Returns once every job submitted so far is done */
+void
+natus_pool_wait(natusPool *pool);
+
+size_t
+natus_pool_size(const natusPool *pool);
+
+/* Runs the jobs still queued, then stops the workers */
+void
+natus_pool_free(natusPool *pool);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif /* __cplusplus */
@@ -38,6 +38,7 @@
   if (_exc.isException()) return _exc; }
 
 typedef struct natusValue natusValue;
+typedef struct natusScope natusScope;
 
 namespace natus
 {
@@ -97,6 +98,28 @@ typedef void
   typedef std::basic_string<char> UTF8;
   typedef std::basic_string<Char> UTF16;
 
+  /* See natusContextStats in natus.h */
+  struct ContextStats {
+    size_t calls;
+    size_t evaluations;
+    size_t callbacks;
+    size_t properties;
+    size_t values;
+    size_t live;
+  };
+
+  /* See natusTraceEvent in natus.h */
+  typedef enum {
+    TraceCall,
+    TraceEvaluate,
+    TraceCallback,
+    TraceProperty,
+    TraceRequire
+  } TraceEvent;
+
+  typedef void
+  (*TraceFunction)(TraceEvent event, bool enter, const char* name, uint64_t ns, void* misc);
+
   class Class {
   public:
     typedef enum {
@@ -150,7 +173,8 @@ typedef void
       TypeObject = 1 << 5,
       TypeString = 1 << 6,
       TypeUndefined = 1 << 7,
-      TypeSupportsPrivate = TypeFunction | TypeObject,
+      TypeBuffer = 1 << 8,
+      TypeSupportsPrivate = TypeFunction | TypeObject | TypeBuffer,
     } Type;
 
     typedef enum {
@@ -257,6 +281,12 @@ typedef void
     Value
     newString(UTF16 string) const;
 
+    Value
+    newStringExternal(const char* string, size_t len, FreeFunction free) const;
+
+    Value
+    newStringExternal(const Char* string, size_t len, FreeFunction free) const;
+
     Value
     newString(const char* fmt, va_list arg);
 
@@ -272,6 +302,15 @@ typedef void
     Value
     newArray(const Value* item, ...) const;
 
+    Value
+    newArray(const double* array, size_t len) const;
+
+    Value
+    newArray(const char* const * array, size_t len) const;
+
+    Value
+    newBuffer(void* data, size_t len, FreeFunction free) const;
+
     Value
     newFunction(NativeFunction func, const char* name = NULL) const;
 
@@ -290,6 +329,18 @@ typedef void
     const char*
     getEngineName() const;
 
+    bool
+    getContextStats(ContextStats* stats) const;
+
+    bool
+    exposeContextStats();
+
+    bool
+    setTracer(TraceFunction func, void* misc = NULL, FreeFunction free = NULL) const;
+
+    bool
+    traceChrome(const char* filename) const;
+
     Value::Type
     getType() const;
 
@@ -302,6 +353,15 @@ typedef void
     natusValue*
     borrowCValue() const;
 
+    bool
+    borrowBuffer(void **data, size_t *len) const;
+
+    size_t
+    toUTF8(char* buf, size_t size) const;
+
+    size_t
+    toUTF16(Char* buf, size_t offset, size_t size) const;
+
     bool
     isException() const;
 
@@ -332,6 +392,9 @@ typedef void
     bool
     isUndefined() const;
 
+    bool
+    isBuffer() const;
+
     Value
     toException();
     template<class T>
@@ -596,6 +659,18 @@ typedef void
     Value
     evaluate(UTF16 javascript, UTF16 filename, unsigned int lineno = 0);
 
+    Value
+    compile(Value javascript, Value filename, unsigned int lineno = 0);
+
+    Value
+    compile(UTF8 javascript, UTF8 filename = "", unsigned int lineno = 0);
+
+    Value
+    compile(UTF16 javascript, UTF16 filename, unsigned int lineno = 0);
+
+    Value
+    run(Value script);
+
     Value
     call(Value ths, va_list ap);
 
@@ -708,6 +783,28 @@ typedef void
     natusValue *internal;
   };
 
+  /* Collects the values created in the context of ctx for as long as it
+   * lives, and releases any that remain when it is destroyed. Declare it
+   * before the Values it should own, and use escape() on the one you want
+   * to return. See natus_scope_enter(). */
+  class Scope {
+  public:
+    Scope(const Value& ctx);
+
+    ~Scope();
+
+    Value
+    escape(const Value& val);
+
+  private:
+    natusScope *internal;
+
+    Scope(const Scope& scope);
+
+    Scope&
+    operator=(const Scope& scope);
+  };
+
   template<>
     bool
     Value::to<bool>() const;
@@ -6,6 +6,8 @@
 
 #include <libmem.h>
 
+#define ARRAY_STACK 16
+
 natusValue *
 natus_new_boolean(const natusValue *ctx, bool b)
 {
@@ -75,6 +77,32 @@ natus_new_string_utf16_length(const natusValue *ctx, const natusChar *string, si
   callandreturn(natusValueTypeString, ctx, new_string_utf16, ctx->ctx->ctx, string, len);
 }
 
+natusValue *
+natus_new_string_external_utf8(const natusValue *ctx, const char *string, size_t len, natusFreeFunction freefnc)
+{
+  if (!string)
+    return NULL;
+  if (!ctx) {
+    if (freefnc)
+      freefnc((void *) string);
+    return NULL;
+  }
+  callandreturn(natusValueTypeString, ctx, new_string_external_utf8, ctx->ctx->ctx, string, len, freefnc);
+}
+
+natusValue *
+natus_new_string_external_utf16(const natusValue *ctx, const natusChar *string, size_t len, natusFreeFunction freefnc)
+{
+  if (!string)
+    return NULL;
+  if (!ctx) {
+    if (freefnc)
+      freefnc((void *) string);
+    return NULL;
+  }
+  callandreturn(natusValueTypeString, ctx, new_string_external_utf16, ctx->ctx->ctx, string, len, freefnc);
+}
+
 natusValue *
 natus_new_array(const natusValue *ctx, ...) {
   va_list ap;
@@ -102,18 +130,58 @@ natus_new_array_vector(const natusValue *ctx, const natusValue **array)
   for (count = 0; array[count]; count++)
     ;
 
-  natusEngVal *vals = (natusEngVal*) malloc(sizeof(natusEngVal) * (count + 1));
-  if (!vals)
+  natusEngVal stack[ARRAY_STACK];
+  natusEngVal *vals = stack;
+  if (count > ARRAY_STACK && !(vals = (natusEngVal*) malloc(sizeof(natusEngVal) * count)))
     return NULL;
 
   for (i = 0; i < count; i++)
-    vals[i] = array[i]->val;
+    vals[i] = engval(array[i]);
 
-  callandmkval(natusValue *val, natusValueTypeUnknown, ctx, new_array, ctx->ctx->ctx, vals, count);
-  free(vals);
+  callandmkval(natusValue *val, natusValueTypeUnknown, ctx, new_array, ctx->ctx->ctx, count > 0 ? vals : NULL, count);
+  if (vals != stack)
+    free(vals);
   return val;
 }
 
+natusValue *
+natus_new_array_doubles(const natusValue *ctx, const double *array, size_t len)
+{
+  if (!ctx || (!array && len > 0))
+    return NULL;
+
+  callandreturn(natusValueTypeUnknown, ctx, new_array_doubles, ctx->ctx->ctx, array, len);
+}
+
+natusValue *
+natus_new_array_utf8_strings(const natusValue *ctx, const char * const *array, size_t len)
+{
+  const natusValue *stack[ARRAY_STACK + 1];
+  const natusValue **vals = stack;
+  natusValue *ret = NULL;
+  size_t i;
+
+  if (!ctx || (!array && len > 0))
+    return NULL;
+  if (len > ARRAY_STACK && !(vals = malloc(sizeof(natusValue*) * (len + 1))))
+    return NULL;
+
+  for (i = 0; i < len; i++) {
+    if (!(vals[i] = array[i] ? natus_new_string_utf8(ctx, array[i]) : natus_new_null(ctx)))
+      goto out;
+  }
+  vals[len] = NULL;
+
+  ret = natus_new_array_vector(ctx, vals);
+
+out:
+  while (i > 0)
+    natus_decref((natusValue*) vals[--i]);
+  if (vals != stack)
+    free(vals);
+  return ret;
+}
+
 natusValue *
 natus_new_array_varg(const natusValue *ctx, va_list ap)
 {
@@ -160,14 +228,14 @@ natus_new_function(const natusValue *ctx, natusNativeFunction func, const char *
   if (!dll)
     return NULL;
 
-  natusPrivate *priv = mem_new_size(dll, 0);
+  natusPrivate *priv = private_new(dll);
   if (!priv)
     return NULL;
 
-  if (!private_set(priv, NATUS_PRIV_GLOBAL, natus_get_global(ctx), NULL))
+  if (!private_set_slot(priv, privateSlotGlobal, natus_get_global(ctx), NULL))
     goto error;
 
-  if (!private_set(priv, NATUS_PRIV_FUNCTION, func, NULL))
+  if (!private_set_slot(priv, privateSlotFunction, func, NULL))
     goto error;
 
   callandreturn(natusValueTypeFunction, ctx, new_function, ctx->ctx->ctx, name, priv);
@@ -188,14 +256,14 @@ natus_new_object(const natusValue *ctx, natusClass *cls)
   if (!dll)
     return NULL;
 
-  natusPrivate *priv = mem_new_size(dll, 0);
+  natusPrivate *priv = private_new(dll);
   if (!priv)
     return NULL;
 
-  if (cls && !private_set(priv, NATUS_PRIV_GLOBAL, natus_get_global(ctx), NULL))
+  if (cls && !private_set_slot(priv, privateSlotGlobal, natus_get_global(ctx), NULL))
     goto error;
 
-  if (cls && !private_set(priv, NATUS_PRIV_CLASS, cls, (natusFreeFunction) cls->free))
+  if (cls && !private_set_slot(priv, privateSlotClass, cls, (natusFreeFunction) cls->free))
     goto error;
 
   callandreturn(natusValueTypeObject, ctx, new_object, ctx->ctx->ctx, cls, priv);
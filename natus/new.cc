@@ -81,7 +81,7 @@ struct txClass {
     assert(cls && ((txClass *) cls)->cls);
     Class *txcls = ((txClass *) cls)->cls;
     txcls->free();
-    delete cls;
+    delete (txClass *) cls;
   }
 
   txClass(Class* cls)
@@ -147,6 +147,18 @@ Value::newString(UTF16 string) const
   return natus_new_string_utf16_length(internal, string.data(), string.length());
 }
 
+Value
+Value::newStringExternal(const char* string, size_t len, FreeFunction free) const
+{
+  return natus_new_string_external_utf8(internal, string, len, free);
+}
+
+Value
+Value::newStringExternal(const Char* string, size_t len, FreeFunction free) const
+{
+  return natus_new_string_external_utf16(internal, string, len, free);
+}
+
 Value
 Value::newString(const char* fmt, va_list arg)
 {
@@ -177,6 +189,18 @@ Value::newArray(const Value* const * array) const
   return natus_new_array_vector(internal, a);
 }
 
+Value
+Value::newArray(const double* array, size_t len) const
+{
+  return natus_new_array_doubles(internal, array, len);
+}
+
+Value
+Value::newArray(const char* const * array, size_t len) const
+{
+  return natus_new_array_utf8_strings(internal, array, len);
+}
+
 Value
 Value::newArray(va_list ap) const
 {
@@ -207,6 +231,12 @@ Value::newArray(const Value* item, ...) const
   return ret;
 }
 
+Value
+Value::newBuffer(void* data, size_t len, FreeFunction free) const
+{
+  return natus_new_buffer_external(internal, data, len, free);
+}
+
 Value
 Value::newFunction(NativeFunction func, const char* name) const
 {
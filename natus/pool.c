@@ -0,0 +1,345 @@
+#define _GNU_SOURCE
+#include <natus-internal.h>
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <string.h>
+
+/* Each worker thread owns a global of its own, made and only ever used on
+ * that thread, so nothing natus or the engine keeps is shared. Jobs and
+ * their results cross threads as clones. */
+
+#define POOL_SCRIPTS 16
+
+typedef struct poolJob poolJob;
+struct poolJob {
+  poolJob          *next;
+  char             *script;
+  natusClone       *args;
+  natusPoolCallback func;
+  void             *misc;
+};
+
+typedef struct {
+  char       *source;
+  natusValue *script;
+} poolScript;
+
+typedef struct {
+  natusPool *pool;
+  pthread_t  thread;
+  size_t     id;
+  bool       running;
+  poolScript scripts[POOL_SCRIPTS]; /* Compiled job scripts, round robin */
+  size_t     nextscript;
+} poolWorker;
+
+struct natusPool {
+  pthread_mutex_t lock;
+  pthread_cond_t  work;    /* Jobs were queued, or the pool is stopping */
+  pthread_cond_t  done;    /* A worker started, or the queue drained */
+  poolJob        *head;
+  poolJob        *tail;
+  size_t          pending; /* Jobs queued or running */
+  size_t          started;
+  size_t          failed;
+  bool            stopping;
+  void           *dll;     /* Keeps the engine loaded between workers */
+  char           *engine;  /* Its file, so every worker loads the same */
+  natusPoolSetup  setup;
+  void           *misc;
+  size_t          count;
+  poolWorker     *workers;
+};
+
+static void
+job_free(poolJob *job)
+{
+  if (!job)
+    return;
+  natus_clone_free(job->args);
+  free(job->script);
+  free(job);
+}
+
+/* Compiles a job's script once per worker */
+static natusValue *
+worker_script(poolWorker *worker, natusValue *global, const char *source)
+{
+  for (size_t i=0; i < POOL_SCRIPTS; i++) {
+    if (worker->scripts[i].source && !strcmp(worker->scripts[i].source, source))
+      return natus_incref(worker->scripts[i].script);
+  }
+
+  natusValue *script = natus_compile_utf8(global, source, "<pool>", 0);
+  if (!script || natus_is_exception(script))
+    return script;
+
+  char *copy = strdup(source);
+  if (!copy)
+    return script;
+
+  poolScript *slot = &worker->scripts[worker->nextscript++ % POOL_SCRIPTS];
+  free(slot->source);
+  natus_decref(slot->script);
+  slot->source = copy;
+  slot->script = natus_incref(script);
+  return script;
+}
+
+/* Exceptions are usually Error objects, whose own properties are no use:
+ * send their message instead */
+static natusClone *
+clone_exception(natusValue *global, natusValue *exc)
+{
+  char *str = natus_to_string_utf8(exc, NULL);
+  if (!str)
+    return NULL;
+
+  natusValue *msg = natus_new_string_utf8(global, str);
+  free(str);
+  natusClone *clone = natus_clone(natus_to_exception(msg));
+  natus_decref(msg);
+  return clone;
+}
+
+static natusClone *
+worker_run(poolWorker *worker, natusValue *global, poolJob *job)
+{
+  natusValue *rslt = worker_script(worker, global, job->script);
+  if (rslt && !natus_is_exception(rslt)) {
+    natusValue *tmp = natus_run(global, rslt);
+    natus_decref(rslt);
+    rslt = tmp;
+  }
+
+  // A script evaluating to a function is called with the arguments
+  if (job->args && natus_is_function(rslt)) {
+    natusValue *args = natus_clone_value(global, job->args);
+    natusValue *tmp = args;
+    if (natus_is_array(args) && !natus_is_exception(args))
+      tmp = natus_call_array(rslt, global, args);
+    else if (args && !natus_is_exception(args)) {
+      natus_decref(args);
+      tmp = natus_throw_exception(global, NULL, "TypeError", "Pool arguments must be an array");
+    }
+    if (tmp != args)
+      natus_decref(args);
+    natus_decref(rslt);
+    rslt = tmp;
+  }
+
+  if (!rslt)
+    return NULL;
+
+  natusClone *clone = NULL;
+  if (natus_is_exception(rslt) && natus_is_object(rslt))
+    clone = clone_exception(global, rslt);
+  else if (!(clone = natus_clone(rslt))) {
+    natusValue *exc = natus_throw_exception(global, NULL, "DataCloneError", "A %s can't be cloned",
+                                            natus_get_type_name(rslt));
+    clone = clone_exception(global, exc);
+    natus_decref(exc);
+  }
+
+  natus_decref(rslt);
+  return clone;
+}
+
+static void *
+worker_main(void *arg)
+{
+  poolWorker *worker = arg;
+  natusPool *pool = worker->pool;
+
+  natusValue *global = natus_new_global(pool->engine);
+  bool ok = global && !natus_is_exception(global);
+  if (ok && pool->setup)
+    ok = pool->setup(global, worker->id, pool->misc);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->started++;
+  if (!ok)
+    pool->failed++;
+  pthread_cond_broadcast(&pool->done);
+
+  while (ok) {
+    // Queued jobs still run once the pool is stopping
+    while (!pool->head && !pool->stopping)
+      pthread_cond_wait(&pool->work, &pool->lock);
+    poolJob *job = pool->head;
+    if (!job)
+      break;
+    pool->head = job->next;
+    if (!pool->head)
+      pool->tail = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    natusClone *rslt = worker_run(worker, global, job);
+    if (job->func)
+      job->func(rslt, job->misc);
+    else
+      natus_clone_free(rslt);
+    job_free(job);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending == 0)
+      pthread_cond_broadcast(&pool->done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i=0; i < POOL_SCRIPTS; i++) {
+    free(worker->scripts[i].source);
+    natus_decref(worker->scripts[i].script);
+  }
+  natus_decref(global);
+  return NULL;
+}
+
+static void
+pool_stop(natusPool *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i=0; i < pool->count; i++) {
+    if (pool->workers[i].running)
+      pthread_join(pool->workers[i].thread, NULL);
+  }
+}
+
+natusPool *
+natus_pool_new(const char *name_or_path, size_t workers,
+               natusPoolSetup setup, void *misc)
+{
+  natusEngineSpec *spec = NULL;
+  Dl_info info;
+
+  if (workers == 0)
+    return NULL;
+
+  natusPool *pool = calloc(1, sizeof(natusPool));
+  if (!pool)
+    return NULL;
+
+  // Only engines whose globals don't share anything may run here
+  if (!engine_load(name_or_path, &pool->dll, &spec)) {
+    free(pool);
+    return NULL;
+  }
+  if ((spec->flags & natusEngineFlagThreadSafe) && dladdr(spec, &info) && info.dli_fname)
+    pool->engine = strdup(info.dli_fname);
+
+  pool->workers = calloc(workers, sizeof(poolWorker));
+  if (!pool->workers || !pool->engine) {
+    free(pool->workers);
+    free(pool->engine);
+    dlclose(pool->dll);
+    free(pool);
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pool->setup = setup;
+  pool->misc = misc;
+
+  for (pool->count=0; pool->count < workers; pool->count++) {
+    poolWorker *worker = &pool->workers[pool->count];
+    worker->pool = pool;
+    worker->id = pool->count;
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0)
+      break;
+    worker->running = true;
+  }
+
+  // Fail unless every worker has a global
+  pthread_mutex_lock(&pool->lock);
+  while (pool->started < pool->count)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  bool ok = pool->count == workers && pool->failed == 0;
+  pthread_mutex_unlock(&pool->lock);
+
+  if (!ok) {
+    natus_pool_free(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+bool
+natus_pool_submit(natusPool *pool, const char *script, natusClone *args,
+                  natusPoolCallback func, void *misc)
+{
+  poolJob *job = NULL;
+
+  if (!pool || !script)
+    goto error;
+
+  job = calloc(1, sizeof(poolJob));
+  if (!job || !(job->script = strdup(script)))
+    goto error;
+  job->args = args;
+  job->func = func;
+  job->misc = misc;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->stopping) {
+    pthread_mutex_unlock(&pool->lock);
+    goto error;
+  }
+  if (pool->tail)
+    pool->tail->next = job;
+  else
+    pool->head = job;
+  pool->tail = job;
+  pool->pending++;
+  pthread_cond_signal(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+  return true;
+
+error:
+  if (job)
+    job->args = NULL;
+  job_free(job);
+  natus_clone_free(args);
+  return false;
+}
+
+void
+natus_pool_wait(natusPool *pool)
+{
+  if (!pool)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->pending > 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+size_t
+natus_pool_size(const natusPool *pool)
+{
+  return pool ? pool->count : 0;
+}
+
+void
+natus_pool_free(natusPool *pool)
+{
+  if (!pool)
+    return;
+
+  pool_stop(pool);
+
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->work);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool->engine);
+  dlclose(pool->dll);
+  free(pool);
+}
@@ -26,40 +26,148 @@
 
 #include <libmem.h>
 #include <assert.h>
+#include <string.h>
+
+#define TABLE_MIN 8
 
 typedef struct {
   void   *priv;
   memFree free;
 } item;
 
-static bool
-foreach_get(void *parent, item *child, void **data)
+typedef struct {
+  const char *name;
+  size_t      hash;
+  item        itm;
+} entry;
+
+struct natusPrivate {
+  item   slots[privateSlotCount]; /* The built-in keys */
+  entry *table;                   /* Open addressed map of the other keys */
+  size_t size;
+  size_t used;
+};
+
+static const char *slotnames[privateSlotCount] = {
+  NATUS_PRIV_CLASS,
+  NATUS_PRIV_FUNCTION,
+  NATUS_PRIV_GLOBAL,
+  NATUS_PRIV_BUFFER,
+};
+
+static void
+item_dtor(item *itm)
+{
+  if (itm && itm->priv && itm->free)
+    itm->free(itm->priv);
+}
+
+static void
+private_dtor(natusPrivate *self)
+{
+  for (size_t i=0; i < privateSlotCount; i++)
+    item_dtor(&self->slots[i]);
+  for (size_t i=0; i < self->size; i++)
+    if (self->table[i].name)
+      item_dtor(&self->table[i].itm);
+}
+
+static int
+slot_find(const char *name)
 {
-  *data = child->priv;
-  return false;
+  /* All the built-in keys share the "natus::" prefix */
+  if (strncmp(name, "natus::", 7))
+    return -1;
+  for (int i=0; i < privateSlotCount; i++)
+    if (!strcmp(name + 7, slotnames[i] + 7))
+      return i;
+  return -1;
+}
+
+size_t
+hash_utf8(const char *str)
+{
+  /* FNV-1a */
+  size_t h = 2166136261u;
+  for (; *str; str++)
+    h = (h ^ (unsigned char) *str) * 16777619u;
+  return h;
+}
+
+static entry *
+table_find(const natusPrivate *self, const char *name, size_t h)
+{
+  if (!self->table)
+    return NULL;
+
+  for (size_t i=h & (self->size - 1); ; i=(i + 1) & (self->size - 1)) {
+    entry *e = &self->table[i];
+    if (!e->name || (e->hash == h && !strcmp(e->name, name)))
+      return e;
+  }
 }
 
 static bool
-foreach_free(void *parent, void *child, void *data)
+table_grow(natusPrivate *self)
 {
-  mem_decref(parent, child);
+  size_t size = self->size ? self->size * 2 : TABLE_MIN;
+  entry *table = mem_new_array_zero(self, entry, size);
+  if (!table)
+    return false;
+
+  entry *old = self->table;
+  size_t oldsize = self->size;
+  self->table = table;
+  self->size = size;
+  for (size_t i=0; i < oldsize; i++) {
+    if (old[i].name)
+      *table_find(self, old[i].name, old[i].hash) = old[i];
+  }
+
+  mem_decref(self, old);
   return true;
 }
 
-static void
-item_dtor(item *itm)
+natusPrivate *
+private_new(void *parent)
 {
-  if (itm && itm->priv && itm->free)
-    itm->free(itm->priv);
+  natusPrivate *self = mem_new_zero(parent, natusPrivate);
+  if (self)
+    mem_destructor_set(self, private_dtor);
+  return self;
+}
+
+void *
+private_get_slot(const natusPrivate *self, privateSlot slot)
+{
+  return self ? self->slots[slot].priv : NULL;
+}
+
+bool
+private_set_slot(natusPrivate *self, privateSlot slot, void *priv, natusFreeFunction free)
+{
+  if (!self)
+    return false;
+
+  item old = self->slots[slot];
+  self->slots[slot].priv = priv;
+  self->slots[slot].free = free;
+  item_dtor(&old);
+  return true;
 }
 
 void *
 private_get(const natusPrivate *self, const char *name)
 {
-  void *tmp = NULL;
-  if (self && name)
-    mem_children_foreach((natusPrivate*) self, name, foreach_get, &tmp);
-  return tmp;
+  if (!self || !name)
+    return NULL;
+
+  int slot = slot_find(name);
+  if (slot >= 0)
+    return private_get_slot(self, slot);
+
+  entry *e = table_find(self, name, hash_utf8(name));
+  return e && e->name ? e->itm.priv : NULL;
 }
 
 bool
@@ -68,33 +176,51 @@ private_set(natusPrivate *self, const char *name, void *priv, natusFreeFunction
   if (!self)
     return false;
 
-  if (name)
-    mem_children_foreach(self, name, foreach_free, NULL);
-
-  item *itm = mem_new(self, item);
-  if (itm) {
-    if (name && !mem_name_set(itm, name)) {
-      mem_decref(self, itm);
+  /* Unnamed items are only kept to be freed along with self */
+  if (!name) {
+    item *itm = mem_new(self, item);
+    if (!itm)
       return false;
-    }
     mem_destructor_set(itm, item_dtor);
     itm->priv = priv;
     itm->free = free;
+    return true;
+  }
+
+  int slot = slot_find(name);
+  if (slot >= 0)
+    return private_set_slot(self, slot, priv, free);
+
+  /* Keep the load factor under 3/4 */
+  size_t h = hash_utf8(name);
+  entry *e = table_find(self, name, h);
+  if (!e || (!e->name && (self->used + 1) * 4 > self->size * 3)) {
+    if (!table_grow(self))
+      return false;
+    e = table_find(self, name, h);
   }
 
-  return itm != NULL;
+  item old = e->itm;
+  if (!e->name) {
+    if (!(e->name = mem_strdup(self, name)))
+      return false;
+    e->hash = h;
+    self->used++;
+  }
+
+  /* Free the old item last, its destructor may call back into us */
+  e->itm.priv = priv;
+  e->itm.free = free;
+  item_dtor(&old);
+  return true;
 }
 
 bool
 natus_set_private_name(natusValue *obj, const char *key, void *priv, natusFreeFunction free)
 {
-  if (!natus_is_type(obj, natusValueTypeSupportsPrivate))
-    return false;
   if (!key)
     return false;
-
-  natusPrivate *prv = obj->ctx->spec->get_private(obj->ctx->ctx, obj->val);
-  return private_set(prv, key, priv, free);
+  return private_set(private_of(obj), key, priv, free);
 }
 
 static void
@@ -105,9 +231,10 @@ free_private_value(natusValue *pv)
 
   /* If the refcount is 0 it means that we are in the process of teardown,
    * and the value has already been unlocked because we are dismantling ctx.
-   * Thus, we only do unlock if we aren't in this teardown phase. */
-  if (mem_parents_count(pv->ctx, NULL) > 0)
-    pv->ctx->spec->val_unlock(pv->ctx->ctx, pv->val);
+   * Thus, we only do unlock if we aren't in this teardown phase. The unlock
+   * itself happens (once) in the value's destructor. */
+  if (pv->ctx->refs == 0)
+    pv->flag &= ~natusEngValFlagUnlock;
   mem_free(pv);
 }
 
@@ -125,15 +252,16 @@ natus_set_private_name_value(natusValue *obj, const char *key, natusValue* priv)
      *       So the way around this is that we don't store the normal natusValue,
      *       but instead store a special one without a refcount on the ctx.
      *       This means that ctx will be properly freed. */
-    val = mkval(priv, priv->ctx->spec->val_duplicate(priv->ctx->ctx, priv->val),
-                priv->flag, priv->type);
+    val = mkval_heap(priv, priv->ctx->spec->val_duplicate(priv->ctx->ctx, engval(priv)),
+                     priv->flag, priv->type);
     if (!val)
       return false;
 
     /* Don't keep a copy of this reference around,
      * guaranteed not to free in this case since we
-     * just added an additional link in mkval() */
-    mem_decref(val, val->ctx);
+     * just added an additional reference in mkval() */
+    val->weak = true;
+    context_decref(val->ctx);
   }
 
   if (!natus_set_private_name(obj, key, val, (natusFreeFunction) free_private_value)) {
@@ -143,15 +271,20 @@ natus_set_private_name_value(natusValue *obj, const char *key, natusValue* priv)
   return true;
 }
 
-void*
-natus_get_private_name(const natusValue *obj, const char *key)
+natusPrivate *
+private_of(const natusValue *obj)
 {
   if (!natus_is_type(obj, natusValueTypeSupportsPrivate))
     return NULL;
+  return obj->ctx->spec->get_private(obj->ctx->ctx, engval(obj));
+}
+
+void*
+natus_get_private_name(const natusValue *obj, const char *key)
+{
   if (!key)
     return NULL;
-  natusPrivate *prv = obj->ctx->spec->get_private(obj->ctx->ctx, obj->val);
-  return private_get(prv, key);
+  return private_get(private_of(obj), key);
 }
 
 natusValue *
@@ -10,7 +10,7 @@ natus_del(natusValue *val, const natusValue *id)
 
   // If the object is native, skip argument conversion and js overhead;
   //    call directly for increased speed
-  natusClass *cls = natus_get_private_name(val, NATUS_PRIV_CLASS);
+  natusClass *cls = private_get_slot(private_of(val), privateSlotClass);
   if (cls && cls->del) {
     natusValue *rslt = cls->del(cls, val, id);
     if (!natus_is_undefined(rslt) || !natus_is_exception(rslt))
@@ -18,12 +18,21 @@ natus_del(natusValue *val, const natusValue *id)
     natus_decref(rslt);
   }
 
-  callandreturn(natusValueTypeUnknown, val, del, val->ctx->ctx, val->val, id->val);
+  callandreturn(natusValueTypeUnknown, val, del, val->ctx->ctx, engval(val), engval(id));
 }
 
 natusValue *
 natus_del_utf8(natusValue *val, const char *id)
 {
+  const natusValue *key = natus_intern_utf8(val, id);
+  if (key) {
+    // The key is borrowed, keep it from being evicted by a nested lookup
+    val->ctx->keysbusy++;
+    natusValue *ret = natus_del(val, key);
+    val->ctx->keysbusy--;
+    return ret;
+  }
+
   natusValue *vid = natus_new_string_utf8(val, id);
   if (!vid)
     return NULL;
@@ -73,9 +82,20 @@ natus_get(natusValue *val, const natusValue *id)
   if (!natus_is_type(id, natusValueTypeNumber | natusValueTypeString))
     return NULL;
 
+  // Arguments views answer length and indexes without an engine array
+  if (val && val->argv) {
+    if (natus_is_number(id)) {
+      // Range checked first: casting NaN or a huge double is undefined
+      double idx = natus_to_double(id);
+      if (idx >= 0 && idx < val->argc && idx == (size_t) idx)
+        return argv_index(val, (size_t) idx);
+    } else if (id == val->ctx->length)
+      return natus_new_number(val, val->argc);
+  }
+
   // If the object is native, skip argument conversion and js overhead;
   //    call directly for increased speed
-  natusClass *cls = natus_get_private_name(val, NATUS_PRIV_CLASS);
+  natusClass *cls = private_get_slot(private_of(val), privateSlotClass);
   if (cls && cls->get) {
     natusValue *rslt = cls->get(cls, val, id);
     if (!natus_is_undefined(rslt) || !natus_is_exception(rslt))
@@ -83,12 +103,20 @@ natus_get(natusValue *val, const natusValue *id)
     natus_decref(rslt);
   }
 
-  callandreturn(natusValueTypeUnknown, val, get, val->ctx->ctx, val->val, id->val);
+  callandreturn(natusValueTypeUnknown, val, get, val->ctx->ctx, engval(val), engval(id));
 }
 
 natusValue *
 natus_get_utf8(natusValue *val, const char *id)
 {
+  const natusValue *key = natus_intern_utf8(val, id);
+  if (key) {
+    val->ctx->keysbusy++;
+    natusValue *ret = natus_get(val, key);
+    val->ctx->keysbusy--;
+    return ret;
+  }
+
   natusValue *vid = natus_new_string_utf8(val, id);
   if (!vid)
     return NULL;
@@ -100,6 +128,18 @@ natus_get_utf8(natusValue *val, const char *id)
 natusValue *
 natus_get_index(natusValue *val, size_t id)
 {
+  if (!val)
+    return NULL;
+  if (val->argv)
+    return argv_index(val, id);
+
+  // Hand plain indexes straight to the engine; native classes take ids
+  // as values and indexes past uint32 are ordinary names in JavaScript
+  natusClass *cls = private_get_slot(private_of(val), privateSlotClass);
+  if ((!cls || !cls->get) && id < UINT32_MAX) {
+    callandreturn(natusValueTypeUnknown, val, get_index, val->ctx->ctx, engval(val), (uint32_t) id);
+  }
+
   natusValue *vid = natus_new_number(val, id);
   if (!vid)
     return NULL;
@@ -142,7 +182,7 @@ natus_set(natusValue *val, const natusValue *id, const natusValue *value, natusP
 
   // If the object is native, skip argument conversion and js overhead;
   //    call directly for increased speed
-  natusClass *cls = natus_get_private_name(val, NATUS_PRIV_CLASS);
+  natusClass *cls = private_get_slot(private_of(val), privateSlotClass);
   if (cls && cls->set) {
     natusValue *rslt = cls->set(cls, val, id, value);
     if (!natus_is_undefined(rslt) || !natus_is_exception(rslt))
@@ -150,12 +190,20 @@ natus_set(natusValue *val, const natusValue *id, const natusValue *value, natusP
     natus_decref(rslt);
   }
 
-  callandreturn(natusValueTypeUnknown, val, set, val->ctx->ctx, val->val, id->val, value->val, attrs);
+  callandreturn(natusValueTypeUnknown, val, set, val->ctx->ctx, engval(val), engval(id), engval(value), attrs);
 }
 
 natusValue *
 natus_set_utf8(natusValue *val, const char *id, const natusValue *value, natusPropAttr attrs)
 {
+  const natusValue *key = natus_intern_utf8(val, id);
+  if (key) {
+    val->ctx->keysbusy++;
+    natusValue *ret = natus_set(val, key, value, attrs);
+    val->ctx->keysbusy--;
+    return ret;
+  }
+
   natusValue *vid = natus_new_string_utf8(val, id);
   if (!vid)
     return NULL;
@@ -167,6 +215,14 @@ natus_set_utf8(natusValue *val, const char *id, const natusValue *value, natusPr
 natusValue *
 natus_set_index(natusValue *val, size_t id, const natusValue *value)
 {
+  if (!val || !value)
+    return NULL;
+
+  natusClass *cls = private_get_slot(private_of(val), privateSlotClass);
+  if ((!cls || !cls->set) && id < UINT32_MAX) {
+    callandreturn(natusValueTypeUnknown, val, set_index, val->ctx->ctx, engval(val), (uint32_t) id, engval(value));
+  }
+
   natusValue *vid = natus_new_number(val, id);
   if (!vid)
     return NULL;
@@ -218,11 +274,11 @@ natus_enumerate(natusValue *val)
 {
   // If the object is native, skip argument conversion and js overhead;
   //    call directly for increased speed
-  natusClass *cls = natus_get_private_name(val, NATUS_PRIV_CLASS);
+  natusClass *cls = private_get_slot(private_of(val), privateSlotClass);
   if (cls && cls->enumerate)
     return cls->enumerate(cls, val);
 
-  callandreturn(natusValueTypeArray, val, enumerate, val->ctx->ctx, val->val);
+  callandreturn(natusValueTypeArray, val, enumerate, val->ctx->ctx, engval(val));
 }
 
 natusValue *
@@ -1,5 +1,17 @@
 #include <natus-internal.hh>
 
+#include <cstring>
+
+/* Property names go through the context's interned keys when possible */
+static Value
+key(const Value& ctx, UTF8 idx)
+{
+  const natusValue *k = NULL;
+  if (strlen(idx.c_str()) == idx.length())
+    k = natus_intern_utf8(ctx.borrowCValue(), idx.c_str());
+  return k ? Value((natusValue*) k, false) : ctx.newString(idx);
+}
+
 Value
 Value::operator[](long index)
 {
@@ -33,7 +45,7 @@ Value::del(Value idx)
 Value
 Value::del(UTF8 idx)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   return natus_del(internal, n.internal);
 }
 
@@ -65,7 +77,7 @@ Value::get(Value idx) const
 Value
 Value::get(UTF8 idx) const
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   return natus_get(internal, n.internal);
 }
 
@@ -167,14 +179,14 @@ Value::set(Value idx, NativeFunction value, const char *name, Value::PropAttr at
 Value
 Value::set(UTF8 idx, Value value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   return natus_set(internal, n.borrowCValue(), value.internal, (natusPropAttr) attrs);
 }
 
 Value
 Value::set(UTF8 idx, bool value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newBoolean(value);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -182,7 +194,7 @@ Value::set(UTF8 idx, bool value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, int value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newNumber(value);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -190,7 +202,7 @@ Value::set(UTF8 idx, int value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, long value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newNumber(value);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -198,7 +210,7 @@ Value::set(UTF8 idx, long value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, double value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newNumber(value);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -206,7 +218,7 @@ Value::set(UTF8 idx, double value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, const char* value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newString(value);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -214,7 +226,7 @@ Value::set(UTF8 idx, const char* value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, const Char* value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newString(value);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -222,7 +234,7 @@ Value::set(UTF8 idx, const Char* value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, UTF8 value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newString(value);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -230,7 +242,7 @@ Value::set(UTF8 idx, UTF8 value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, UTF16 value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newString(value);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -238,7 +250,7 @@ Value::set(UTF8 idx, UTF16 value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, NativeFunction value, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newFunction(value, idx.c_str());
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -246,7 +258,7 @@ Value::set(UTF8 idx, NativeFunction value, Value::PropAttr attrs)
 Value
 Value::set(UTF8 idx, NativeFunction value, const char *name, Value::PropAttr attrs)
 {
-  Value n = newString(idx);
+  Value n = key(*this, idx);
   Value v = newFunction(value, name);
   return natus_set(internal, n.borrowCValue(), v.internal, (natusPropAttr) attrs);
 }
@@ -25,11 +25,16 @@
 #include <limits.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
 
 #include <dlfcn.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <libgen.h>
 
@@ -48,6 +53,8 @@
 #define NATUS_REQUIRE_CACHE   "natus::Require::Cache"
 #define NATUS_REQUIRE_STACK   "natus::Require::Stack"
 #define CFG_PATH              "natus.require.path"
+#define CFG_CACHE             "natus.require.cache"
+#define CFG_RESOLVE           "natus.require.resolve"
 #define CFG_WHITELIST         "natus.require.whitelist"
 #define CFG_ORIGINS_WHITELIST "natus.origins.whitelist"
 #define CFG_ORIGINS_BLACKLIST "natus.origins.blacklist"
@@ -58,6 +65,13 @@
 #define JS_REQUIRE_PREFIX "(function(exports, require, module) {\n"
 #define JS_REQUIRE_SUFFIX "\n})"
 
+#define CACHE_MAGIC "natusjs" /* With the NUL, 8 bytes */
+
+#define RESOLVE_BUCKETS 64
+#define RESOLVE_MAX     1024
+#define SET_BUCKETS     64
+#define SET_MAX         1024
+
 typedef struct reqOriginMatcher reqOriginMatcher;
 struct reqOriginMatcher {
   reqOriginMatcher         *next;
@@ -74,14 +88,86 @@ struct reqHook {
   natusRequireHook  func;
 };
 
+/* A remembered resolution: the module name and, for relative names, the
+ * directory it was made in, and the files it found along with their last
+ * known mtime/size. */
+typedef struct reqResolved reqResolved;
+struct reqResolved {
+  reqResolved *next;
+  uint64_t     hash;
+  char        *key;
+  size_t       count;
+  char       **files;
+  time_t      *mtimes;
+  off_t       *sizes;
+};
+
+/* A set of strings, each carrying a flag */
+typedef struct reqSetItem reqSetItem;
+struct reqSetItem {
+  reqSetItem *next;
+  uint64_t    hash;
+  bool        flag;
+  char       *key;
+};
+
+typedef struct {
+  reqSetItem *buckets[SET_BUCKETS];
+  size_t      count;
+} reqSet;
+
+/* The security settings from the config, in native form. The module
+ * whitelist is a set of names; the origin lists stay lists, since any
+ * matcher may accept a pattern, but each uri's verdict is remembered
+ * until the matchers change or the config is reloaded. */
+typedef struct {
+  bool    sandboxed;
+  reqSet  modules;
+  char  **modlist;
+  size_t  nmodlist;
+  bool    whitelisted;
+  char  **whitelist;
+  size_t  nwhitelist;
+  char  **blacklist;
+  size_t  nblacklist;
+  reqSet  verdicts;
+} reqPolicy;
+
+typedef enum {
+  reqResolveMtime,
+  reqResolveMemo,
+  reqResolveNone
+} reqResolveMode;
+
 typedef struct {
   reqHook          *hooks;
   reqOriginMatcher *matchers;
+  reqPolicy        *policy;
+  reqResolveMode    resolve; /* Read from the config along with the policy */
+  reqResolved      *resolved[RESOLVE_BUCKETS];
+  size_t            nresolved;
+  size_t            hits;
+  size_t            misses;
 } natusRequire;
 
+/* Compiled modules are cached in files named after a hash of the module's
+ * path. The header checks that the entry is for the same file, unchanged,
+ * and the same engine; the path itself follows it, then the script. */
+typedef struct {
+  char     magic[sizeof(CACHE_MAGIC)];
+  char     engine[32];
+  uint64_t mtime;
+  uint64_t size;
+  uint64_t pathlen;
+  uint64_t datalen;
+} cacheHeader;
+
 static natusRequire *
 get_require(natusValue *ctx);
 
+static natusValue *
+require_module(natusRequire *req, natusValue *ctx, natusValue *name);
+
 static void
 dll_dtor(void **dll)
 {
@@ -138,76 +224,361 @@ check_path(struct stat *st, const char *fmt, ...) {
   return NULL;
 }
 
+static uint64_t
+hash_string(const char *str)
+{
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char *c = str; *c; c++)
+    hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+  return hash;
+}
+
+/* Remembered files are checked for changes unless "memo" is asked for */
+static reqResolveMode
+resolve_mode(natusValue *config)
+{
+  char *mode = natus_as_string_utf8(natus_get_recursive_utf8(config, CFG_RESOLVE), NULL);
+
+  reqResolveMode rslt = reqResolveMtime;
+  if (mode && !strcmp(mode, "memo"))
+    rslt = reqResolveMemo;
+  else if (mode && !strcmp(mode, "none"))
+    rslt = reqResolveNone;
+  free(mode);
+  return rslt;
+}
+
+static reqResolved *
+resolved_find(natusRequire *req, const char *key, uint64_t hash, reqResolveMode mode)
+{
+  reqResolved **res;
+  for (res = &req->resolved[hash % RESOLVE_BUCKETS]; *res; res = &(*res)->next)
+    if ((*res)->hash == hash && !strcmp((*res)->key, key))
+      break;
+  if (!*res || mode != reqResolveMtime)
+    return *res;
+
+  // Any file that changed or went away invalidates the entry
+  struct stat st;
+  for (size_t i = 0; i < (*res)->count; i++) {
+    if (stat((*res)->files[i], &st) != 0 ||
+        st.st_mtime != (*res)->mtimes[i] ||
+        st.st_size != (*res)->sizes[i]) {
+      reqResolved *tmp = *res;
+      *res = tmp->next;
+      req->nresolved--;
+      mem_free(tmp);
+      return NULL;
+    }
+  }
+
+  return *res;
+}
+
+static void
+resolved_clear(natusRequire *req)
+{
+  for (size_t i = 0; i < RESOLVE_BUCKETS; i++) {
+    while (req->resolved[i]) {
+      reqResolved *tmp = req->resolved[i];
+      req->resolved[i] = tmp->next;
+      mem_free(tmp);
+    }
+  }
+  req->nresolved = 0;
+}
+
+static void
+resolved_add(natusRequire *req, const char *key, uint64_t hash,
+             char **files, struct stat *sts, size_t count)
+{
+  if (req->nresolved >= RESOLVE_MAX)
+    resolved_clear(req);
+
+  reqResolved *res = mem_new_zero(req, reqResolved);
+  if (!res)
+    return;
+
+  res->hash = hash;
+  res->count = count;
+  res->key = mem_strdup(res, key);
+  res->files = mem_new_array_zero(res, char*, count);
+  res->mtimes = mem_new_array(res, time_t, count);
+  res->sizes = mem_new_array(res, off_t, count);
+  if (!res->key || !res->files || !res->mtimes || !res->sizes) {
+    mem_free(res);
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    res->files[i] = mem_strdup(res->files, files[i]);
+    res->mtimes[i] = sts[i].st_mtime;
+    res->sizes[i] = sts[i].st_size;
+    if (!res->files[i]) {
+      mem_free(res);
+      return;
+    }
+  }
+
+  res->next = req->resolved[hash % RESOLVE_BUCKETS];
+  req->resolved[hash % RESOLVE_BUCKETS] = res;
+  req->nresolved++;
+}
+
+static reqSetItem *
+set_find(reqSet *set, const char *key)
+{
+  uint64_t hash = hash_string(key);
+  reqSetItem *item;
+  for (item = set->buckets[hash % SET_BUCKETS]; item; item = item->next)
+    if (item->hash == hash && !strcmp(item->key, key))
+      return item;
+  return NULL;
+}
+
+static void
+set_clear(reqSet *set)
+{
+  for (size_t i = 0; i < SET_BUCKETS; i++) {
+    while (set->buckets[i]) {
+      reqSetItem *tmp = set->buckets[i];
+      set->buckets[i] = tmp->next;
+      mem_free(tmp);
+    }
+  }
+  set->count = 0;
+}
+
+static bool
+set_add(void *parent, reqSet *set, const char *key, bool flag)
+{
+  reqSetItem *item = mem_new_zero(parent, reqSetItem);
+  if (!item)
+    return false;
+
+  item->key = mem_strdup(item, key);
+  if (!item->key) {
+    mem_free(item);
+    return false;
+  }
+
+  item->hash = hash_string(key);
+  item->flag = flag;
+  item->next = set->buckets[item->hash % SET_BUCKETS];
+  set->buckets[item->hash % SET_BUCKETS] = item;
+  set->count++;
+  return true;
+}
+
+/* Converts a config array to UTF-8 strings, optionally only its strings */
+static char **
+policy_list(reqPolicy *policy, natusValue *array, bool strings, size_t *count)
+{
+  long i, len = natus_as_long(natus_get_utf8(array, "length"));
+  char **list = mem_new_array_zero(policy, char*, len > 0 ? len : 1);
+  if (!list)
+    return NULL;
+
+  for (*count = 0, i = 0; i < len; i++) {
+    natusValue *item = natus_get_index(array, i);
+    char *str = !strings || natus_is_string(item) ? natus_to_string_utf8(item, NULL) : NULL;
+    natus_decref(item);
+    if (!str)
+      continue;
+
+    list[*count] = mem_strdup(list, str);
+    free(str);
+    if (!list[(*count)++])
+      return NULL;
+  }
+
+  return list;
+}
+
+static reqPolicy *
+policy_compile(natusRequire *req, natusValue *config)
+{
+  reqPolicy *policy = mem_new_zero(req, reqPolicy);
+  if (!policy)
+    return NULL;
+
+  // Only strings can ever equal a module name
+  natusValue *modules = natus_get_recursive_utf8(config, CFG_WHITELIST);
+  policy->sandboxed = natus_is_array(modules);
+  if (policy->sandboxed) {
+    policy->modlist = policy_list(policy, modules, true, &policy->nmodlist);
+    for (size_t i = 0; policy->modlist && i < policy->nmodlist; i++) {
+      if (!set_find(&policy->modules, policy->modlist[i]) &&
+          !set_add(policy, &policy->modules, policy->modlist[i], true)) {
+        natus_decref(modules);
+        mem_free(policy);
+        return NULL;
+      }
+    }
+  }
+  bool ok = !policy->sandboxed || policy->modlist;
+  natus_decref(modules);
+
+  natusValue *whitelist = natus_get_recursive_utf8(config, CFG_ORIGINS_WHITELIST);
+  natusValue *blacklist = natus_get_recursive_utf8(config, CFG_ORIGINS_BLACKLIST);
+  policy->whitelisted = natus_is_array(whitelist);
+  if (policy->whitelisted)
+    policy->whitelist = policy_list(policy, whitelist, false, &policy->nwhitelist);
+  if (natus_is_array(blacklist))
+    policy->blacklist = policy_list(policy, blacklist, false, &policy->nblacklist);
+  ok = ok && (!policy->whitelisted || policy->whitelist)
+          && (!natus_is_array(blacklist) || policy->blacklist);
+  natus_decref(whitelist);
+  natus_decref(blacklist);
+  if (!ok) {
+    mem_free(policy);
+    return NULL;
+  }
+
+  return policy;
+}
+
+/* Compiles the policy and reads the resolve mode, at init and on an
+ * explicit reload only, so checks never read the config. Anything failing
+ * drops the policy, which denies everything until the config compiles. */
+static bool
+config_compile(natusRequire *req, natusValue *config)
+{
+  reqPolicy *policy = policy_compile(req, config);
+  mem_free(req->policy);
+  req->policy = policy;
+  if (!policy)
+    return false;
+
+  // The search path may have changed too
+  resolved_clear(req);
+  req->resolve = resolve_mode(config);
+  return true;
+}
+
 static natusValue *
 internal_require_resolve(natusValue *ctx, natusValue *name)
 {
   natusValue *path = NULL, *uris = NULL;
+  char **files = NULL, *dir = NULL, *key = NULL;
+  struct stat *sts = NULL;
+  size_t count = 0;
+  long i, len = 0;
+
+  natusRequire *req = get_require(ctx);
+  if (!req)
+    return NULL;
 
   char *modname = natus_to_string_utf8(name, NULL);
   if (!modname)
     return NULL;
 
   uris = natus_new_array(ctx, NULL);
-  if (!natus_is_array(uris)) {
-    free(modname);
-    return NULL;
-  }
+  if (!natus_is_array(uris))
+    goto error;
 
   // If the path is a relative path, use the top of the evaluation stack
-  if (modname && modname[0] == '.') {
+  if (modname[0] == '.') {
     natusValue *stack = natus_get_private_name_value(ctx, NATUS_REQUIRE_STACK);
-    long len = natus_as_long(natus_get_utf8(stack, "length"));
+    long depth = natus_as_long(natus_get_utf8(stack, "length"));
 
-    natusValue *prfx = natus_get_index(stack, len > 0 ? len - 1 : 0);
+    natusValue *prfx = natus_get_index(stack, depth > 0 ? depth - 1 : 0);
     natus_decref(stack);
-    if (natus_is_undefined(prfx)) {
-      natus_decref(prfx);
-      prfx = natus_new_string_utf8(ctx, ".");
-    }
-
-    path = natus_new_array(ctx, prfx, NULL);
+    dir = natus_is_undefined(prfx) ? strdup(".") : natus_to_string_utf8(prfx, NULL);
     natus_decref(prfx);
+    if (!dir)
+      goto error;
+  }
+
+  // The memo is keyed on the name and, for relative names, the directory
+  // they are relative to. It is cleared whenever the search path changes,
+  // so a hit needn't look at the path at all.
+  if (asprintf(&key, "%s\n%s", modname, dir ? dir : "") < 0) {
+    key = NULL;
+    goto error;
+  }
+
+  reqResolveMode mode = req->resolve;
+  uint64_t hash = hash_string(key);
+  reqResolved *res = NULL;
+  if (mode != reqResolveNone)
+    res = resolved_find(req, key, hash, mode);
+
+  if (res) {
+    req->hits++;
+    for (i = 0; i < (long) res->count; i++) {
+      natusValue *tmp = natus_new_string(ctx, URIPREFIX "%s", res->files[i]);
+      if (!natus_is_exception(tmp))
+        natus_push(uris, tmp);
+      natus_decref(tmp);
+    }
+    goto out;
+  }
 
   // Otherwise use the normal path
-  } else {
+  req->misses++;
+  if (!dir) {
     natusValue *config = natus_require_get_config(ctx);
-    if (!config) {
-      free(modname);
-      natus_decref(uris);
-      return NULL;
-    }
+    if (!config)
+      goto error;
 
     path = natus_get_recursive_utf8(config, CFG_PATH);
     natus_decref(config);
-  }
+    len = natus_as_long(natus_get_utf8(path, "length"));
+  } else
+    len = 1;
+
+  files = calloc(len > 0 ? len : 1, sizeof(char*));
+  sts = calloc(len > 0 ? len : 1, sizeof(struct stat));
+  if (!files || !sts)
+    goto error;
 
-  struct stat st;
-  long i, len = natus_as_long(natus_get_utf8(path, "length"));
   for (i = 0; i < len; i++) {
-    char *prefix = natus_as_string_utf8(natus_get_index(path, i), NULL);
+    char *prefix = dir ? dir : natus_as_string_utf8(natus_get_index(path, i), NULL);
+    if (!prefix)
+      continue;
 
     // Check for native modules
-    char *file = check_path(&st, "%s/%s%s", prefix, modname, MODSUFFIX);
+    char *file = check_path(&sts[count], "%s/%s%s", prefix, modname, MODSUFFIX);
     if (!file) {
       // Check for javascript modules
-      file = check_path(&st, "%s/%s.js", prefix, modname);
+      file = check_path(&sts[count], "%s/%s.js", prefix, modname);
       if (!file)
-        file = check_path(&st, "%s/%s/__init__.js", prefix, modname);
+        file = check_path(&sts[count], "%s/%s/__init__.js", prefix, modname);
     }
+    if (prefix != dir)
+      free(prefix);
 
     if (file) {
-      natusValue *tmp = natus_new_string(ctx, "file://%s", file);
+      natusValue *tmp = natus_new_string(ctx, URIPREFIX "%s", file);
       if (!natus_is_exception(tmp))
         natus_push(uris, tmp);
       natus_decref(tmp);
+      files[count++] = file;
     }
-
-    free(prefix);
   }
 
+  // Lookups which found nothing are not remembered, so that a module
+  // which appears later is still found
+  if (mode != reqResolveNone && count > 0)
+    resolved_add(req, key, hash, files, sts, count);
+
+out:
+  for (i = 0; files && i < (long) count; i++)
+    free(files[i]);
+  free(files);
+  free(sts);
+  free(key);
+  free(dir);
   natus_decref(path);
   free(modname);
   return uris;
+
+error:
+  natus_decref(uris);
+  uris = NULL;
+  goto out;
 }
 
 static natusValue *
@@ -239,53 +610,186 @@ internal_require_native(natusValue *ctx, natusValue *uri, const char *file)
   return module;
 }
 
+static char *
+cache_file(natusValue *ctx, const char *file)
+{
+  natusValue *config = natus_require_get_config(ctx);
+  natusValue *dir = natus_get_recursive_utf8(config, CFG_CACHE);
+  natus_decref(config);
+  if (!natus_is_string(dir)) {
+    natus_decref(dir);
+    return NULL;
+  }
+
+  char *dirname = natus_as_string_utf8(dir, NULL);
+  if (!dirname)
+    return NULL;
+
+  uint64_t hash = hash_string(file);
+
+  char *cfile = NULL;
+  if (asprintf(&cfile, "%s/%016llx.%s.jsc", dirname, (unsigned long long) hash,
+               natus_get_engine_name(ctx)) < 0)
+    cfile = NULL;
+  free(dirname);
+  return cfile;
+}
+
+static void
+cache_header(cacheHeader *hdr, natusValue *ctx, const char *file, const struct stat *st)
+{
+  memset(hdr, 0, sizeof(cacheHeader));
+  memcpy(hdr->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  strncpy(hdr->engine, natus_get_engine_name(ctx), sizeof(hdr->engine) - 1);
+  hdr->mtime = st->st_mtime;
+  hdr->size = st->st_size;
+  hdr->pathlen = strlen(file);
+}
+
+static void *
+cache_load(const char *cfile, const cacheHeader *want, const char *file, size_t *len)
+{
+  cacheHeader hdr;
+  char *path = NULL;
+  void *data = NULL;
+
+  FILE *f = fopen(cfile, "rb");
+  if (!f)
+    return NULL;
+
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.datalen == 0 || hdr.datalen > SIZE_MAX
+      || memcmp(&hdr, want, offsetof(cacheHeader, datalen)))
+    goto out;
+
+  // The hash is only a hint: the path must match too
+  if (!(path = malloc(hdr.pathlen + 1))
+      || fread(path, 1, hdr.pathlen, f) != hdr.pathlen
+      || memcmp(path, file, hdr.pathlen))
+    goto out;
+
+  if (!(data = malloc(hdr.datalen)) || fread(data, 1, hdr.datalen, f) != hdr.datalen) {
+    free(data);
+    data = NULL;
+    goto out;
+  }
+  *len = hdr.datalen;
+
+out:
+  free(path);
+  fclose(f);
+  return data;
+}
+
+static void
+cache_save(const char *cfile, const cacheHeader *want, const char *file, const void *data, size_t len)
+{
+  cacheHeader hdr = *want;
+  hdr.datalen = len;
+
+  // Written aside and renamed, so readers never see half an entry
+  char *tmp = NULL;
+  if (asprintf(&tmp, "%s.XXXXXX", cfile) < 0)
+    return;
+
+  int fd = mkstemp(tmp);
+  FILE *f = fd < 0 ? NULL : fdopen(fd, "wb");
+  if (!f) {
+    if (fd >= 0) {
+      close(fd);
+      unlink(tmp);
+    }
+    free(tmp);
+    return;
+  }
+
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1
+         && fwrite(file, 1, hdr.pathlen, f) == hdr.pathlen
+         && fwrite(data, 1, len, f) == len;
+  if (fclose(f) != 0 || !ok || rename(tmp, cfile) != 0)
+    unlink(tmp);
+  free(tmp);
+}
+
+/* Compiles through the cache, returning what evaluating javascript would */
+static natusValue *
+cache_evaluate(natusValue *ctx, natusValue *javascript, natusValue *uri, const char *file,
+               const char *cfile, const struct stat *st)
+{
+  cacheHeader hdr;
+  size_t len = 0;
+  bool hit = false;
+
+  cache_header(&hdr, ctx, file, st);
+  void *data = cache_load(cfile, &hdr, file, &len);
+  natusValue *script = natus_compile_cached(ctx, javascript, uri, 0, data, len, &hit);
+  free(data);
+  if (!script || natus_is_exception(script))
+    return script;
+
+  if (!hit && (data = natus_serialize(script, &len))) {
+    cache_save(cfile, &hdr, file, data, len);
+    free(data);
+  }
+
+  natusValue *rslt = natus_run(ctx, script);
+  natus_decref(script);
+  return rslt;
+}
+
 static natusValue *
 internal_require_javascript(natusValue *ctx, natusValue *name, natusValue *uri, const char *file)
 {
   struct stat st;
 
   // If we have a javascript text module
-  FILE *modfile = fopen(file, "r");
-  if (!modfile)
+  int fd = open(file, O_RDONLY);
+  if (fd < 0)
    return NULL;
 
-  if (fstat(fileno(modfile), &st) != 0) {
-    fclose(modfile);
-    return NULL;
-  }
-
-  // Allocate our buffer
-  char *jscript = mem_new_array_zero(NULL, char, st.st_size + 1);
-  if (!jscript) {
-    fclose(modfile);
+  if (fstat(fd, &st) != 0) {
+    close(fd);
     return NULL;
   }
 
-  // Read the file
-  size_t bytesread = 0;
-  while (bytesread < st.st_size) {
-    size_t br = fread(jscript + bytesread, 1,
-                      st.st_size - bytesread,
-                      modfile);
-    if (br == 0 && (ferror(modfile) || feof(modfile))) {
-      mem_free(jscript);
-      fclose(modfile);
+  // Map the file rather than reading it
+  void *map = NULL;
+  if (st.st_size > 0) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
       return natus_throw_exception(ctx, NULL, "RequireError", "Error reading file!");
     }
-
-    bytesread += br;
   }
-  fclose(modfile);
-
-  // Convert to a natus string and wrap in the function header/footer
-  natusValue *javascript = natus_new_string(ctx, "%s%s%s",
-                                            JS_REQUIRE_PREFIX,
-                                            jscript,
-                                            JS_REQUIRE_SUFFIX);
-  mem_free(jscript);
+  close(fd);
+
+  // Wrap it in the function header/footer, the only copy we make; the
+  // engine takes the buffer as is if it can
+  size_t plen = strlen(JS_REQUIRE_PREFIX), slen = strlen(JS_REQUIRE_SUFFIX);
+  size_t len = plen + st.st_size + slen;
+  char *jscript = malloc(len + 1);
+  if (jscript) {
+    memcpy(jscript, JS_REQUIRE_PREFIX, plen);
+    if (map)
+      memcpy(jscript + plen, map, st.st_size);
+    memcpy(jscript + plen + st.st_size, JS_REQUIRE_SUFFIX, slen + 1);
+  }
+  if (map)
+    munmap(map, st.st_size);
+  if (!jscript)
+    return NULL;
 
-  // Evaluate the file
-  natusValue *func = natus_evaluate(ctx, javascript, uri, 0);
+  natusValue *javascript = natus_new_string_external_utf8(ctx, jscript, len, free);
+  if (!javascript || natus_is_exception(javascript))
+    return javascript;
+
+  // Evaluate the file, through the cache if there is one
+  natusValue *func;
+  char *cfile = cache_file(ctx, file);
+  if (cfile)
+    func = cache_evaluate(ctx, javascript, uri, file, cfile, &st);
+  else
+    func = natus_evaluate(ctx, javascript, uri, 0);
+  free(cfile);
   natus_decref(javascript);
   if (natus_is_exception(func))
    return func;
@@ -393,67 +897,222 @@ require_js(natusValue *require, natusValue *ths, natusValue *arg)
   // Get the required name argument
   natusValue *name = natus_get_index(arg, 0);
 
-  // Build our path and whitelist
-  natusValue *cfg = natus_require_get_config(require);
-  natusValue *path = natus_get_recursive_utf8(cfg, CFG_PATH);
-  natusValue *whitelist = natus_get_recursive_utf8(cfg, CFG_WHITELIST);
-
   // Security check
-  if (natus_is_array(whitelist)) {
-    bool cleared = false;
-    long i, len = natus_as_long(natus_get_utf8(whitelist, "length"));
-    for (i = 0; !cleared && i < len; i++) {
-      natusValue *item = natus_get_index(whitelist, i);
-      cleared = natus_equals_strict(name, item);
-      natus_decref(item);
-    }
+  natusRequire *req = get_require(require);
+  if (!req || !req->policy) {
+    natus_decref(name);
+    return natus_throw_exception(ths, NULL, "SecurityError", "Permission denied!");
+  }
+  if (req->policy->sandboxed) {
+    char *modname = natus_to_string_utf8(name, NULL);
+    bool cleared = modname && set_find(&req->policy->modules, modname);
+    free(modname);
     if (!cleared) {
-      natus_decref(cfg);
-      natus_decref(path);
-      natus_decref(whitelist);
+      natus_decref(name);
       return natus_throw_exception(ths, NULL, "SecurityError", "Permission denied!");
     }
   }
 
-  natusValue *mod = natus_require(require, name);
+  natusValue *mod = require_module(req, require, name);
   natus_decref(name);
-  natus_decref(cfg);
-  natus_decref(path);
-  natus_decref(whitelist);
   return mod;
 }
 
+/* Drops a leading "#!" line, looking at the script a chunk at a time;
+ * only scripts which have one are ever copied */
+static void
+strip_shebang(natusValue *ths, natusValue **javascript, unsigned int *lineno)
+{
+  natusChar chunk[256];
+  size_t off, i, n = 0;
+
+  for (off = 0; ; off += n) {
+    n = natus_to_string_utf16_range(*javascript, off, chunk, sizeof(chunk) / sizeof(*chunk));
+    if (n == 0 || n == (size_t) -1)
+      return;
+
+    for (i = 0; i < n; i++)
+      if (chunk[i] == '\n')
+        break;
+    if (i < n)
+      break;
+  }
+
+  const natusChar *chars;
+  size_t len;
+  natusStringView view;
+  if (!natus_string_view_utf16(*javascript, &chars, &len, &view))
+    return;
+
+  natusValue *jscript = natus_new_string_utf16_length(ths, chars + off + i, len - off - i);
+  natus_string_view_release(&view);
+  if (natus_is_string(jscript)) {
+    natus_decref(*javascript);
+    *javascript = jscript;
+    *lineno += 1;
+  } else
+    natus_decref(jscript);
+}
+
 static void
 require_eval_hook(natusValue *ths, natusValue **javascript_or_return,
                   natusValue **filename, unsigned int *lineno, void *misc)
 {
-  natusValue *stack = (natusValue*) misc;
+  // The stack goes away with the global, possibly before the hook does
+  natusValue *stack = natus_get_private_name_value(natus_get_global(ths),
+                                                   NATUS_REQUIRE_STACK);
+  if (!stack)
+    return;
 
   if (lineno) {
     // Remove shebang line if present
-    size_t len;
-    natusChar *chars = natus_to_string_utf16(*javascript_or_return, &len);
-    if (len > 2 && chars[0] == '#' && chars[1] == '!') {
-      size_t i;
-      for (i = 2; i < len; i++) {
-        if (chars[i] == '\n') {
-          natusValue *jscript;
-
-          jscript = natus_new_string_utf16_length(ths, chars + i, len - i);
-          if (jscript) {
-            natus_decref(*javascript_or_return);
-            *javascript_or_return = jscript;
-            *lineno += 1;
-          }
-
-          break;
-        }
-      }
-    }
+    natusChar head[2];
+    if (natus_to_string_utf16_range(*javascript_or_return, 0, head, 2) == 2 &&
+        head[0] == '#' && head[1] == '!')
+      strip_shebang(ths, javascript_or_return, lineno);
 
-    natus_decref(natus_push(stack, *filename));
+    natus_push(stack, *filename);
   } else
     natus_decref(natus_pop(stack));
+
+  natus_decref(stack);
+}
+
+/* require.paths stands in for the configured search path: its indexes and
+ * length are those of the path, and every change to them clears the
+ * resolve memo, which can then be used without reading the path. */
+static natusValue *
+paths_array(natusValue *obj)
+{
+  natusValue *config = natus_require_get_config(obj);
+  natusValue *path = natus_get_recursive_utf8(config, CFG_PATH);
+  natus_decref(config);
+  if (natus_is_array(path))
+    return path;
+  natus_decref(path);
+  return NULL;
+}
+
+static bool
+paths_prop(const natusValue *prop)
+{
+  if (natus_is_number(prop))
+    return true;
+
+  char *name = natus_to_string_utf8(prop, NULL);
+  bool ours = name && (!strcmp(name, "length") || (name[0] >= '0' && name[0] <= '9'));
+  free(name);
+  return ours;
+}
+
+static void
+paths_changed(natusValue *obj)
+{
+  natusRequire *req = get_require(obj);
+  if (req)
+    resolved_clear(req);
+}
+
+/* Let the engine handle anything which isn't ours */
+static natusValue *
+paths_pass(natusValue *obj)
+{
+  return natus_to_exception(natus_new_undefined(obj));
+}
+
+static natusValue *
+paths_del(natusClass *cls, natusValue *obj, const natusValue *prop)
+{
+  natusValue *path = paths_prop(prop) ? paths_array(obj) : NULL;
+  if (!path)
+    return paths_pass(obj);
+
+  natusValue *rslt = natus_del(path, prop);
+  natus_decref(path);
+  paths_changed(obj);
+  return rslt;
+}
+
+static natusValue *
+paths_get(natusClass *cls, natusValue *obj, const natusValue *prop)
+{
+  natusValue *path = paths_prop(prop) ? paths_array(obj) : NULL;
+  if (!path)
+    return paths_pass(obj);
+
+  natusValue *rslt = natus_get(path, prop);
+  natus_decref(path);
+  return rslt;
+}
+
+static natusValue *
+paths_set(natusClass *cls, natusValue *obj, const natusValue *prop, const natusValue *value)
+{
+  natusValue *path = paths_prop(prop) ? paths_array(obj) : NULL;
+  if (!path)
+    return paths_pass(obj);
+
+  natusValue *rslt = natus_set(path, prop, value, natusPropAttrNone);
+  natus_decref(path);
+  paths_changed(obj);
+  return rslt;
+}
+
+static natusValue *
+paths_enumerate(natusClass *cls, natusValue *obj)
+{
+  natusValue *path = paths_array(obj);
+  if (!path)
+    return paths_pass(obj);
+
+  natusValue *rslt = natus_enumerate(path);
+  natus_decref(path);
+  return rslt;
+}
+
+static natusClass pathsClass = {
+  paths_del,
+  paths_get,
+  paths_set,
+  paths_enumerate,
+  NULL,
+  NULL
+};
+
+static natusValue *
+paths_push(natusValue *fnc, natusValue *ths, natusValue *arg)
+{
+  natusValue *path = paths_array(ths);
+  if (!path)
+    return natus_throw_exception(ths, NULL, "TypeError", "No search path!");
+
+  bool ok = true;
+  long i, len = natus_as_long(natus_get_utf8(arg, "length"));
+  for (i = 0; ok && i < len; i++) {
+    natusValue *item = natus_get_index(arg, i);
+    ok = natus_push(path, item) != NULL;
+    natus_decref(item);
+  }
+
+  paths_changed(ths);
+  natusValue *length = ok ? natus_get_utf8(path, "length") : NULL;
+  natus_decref(path);
+  if (!ok)
+    return natus_throw_exception(ths, NULL, "TypeError", "Unable to extend the search path!");
+  return length;
+}
+
+static bool
+paths_init(natusValue *require)
+{
+  natusValue *paths = natus_new_object(require, &pathsClass);
+  natusValue *push = natus_new_function(require, paths_push, "push");
+  bool ok = natus_is_function(push) &&
+            natus_as_bool(natus_set_utf8(paths, "push", push, natusPropAttrProtected)) &&
+            natus_as_bool(natus_set_utf8(require, "paths", paths, natusPropAttrConstant));
+  natus_decref(push);
+  natus_decref(paths);
+  return ok;
 }
 
 bool
@@ -488,7 +1147,7 @@ natus_require_init(natusValue *ctx, natusValue *config)
     // Add the paths variable if we are not in a sandbox
     natusValue *whitelist = natus_get_utf8(config, CFG_WHITELIST);
     if (!natus_is_array(whitelist))
-      natus_decref(natus_set_utf8(require, "paths", pth, natusPropAttrConstant));
+      paths_init(require);
     natus_decref(whitelist);
 
     natus_decref(require);
@@ -505,7 +1164,7 @@ natus_require_init(natusValue *ctx, natusValue *config)
   // Setup stack
   stack = natus_new_array_vector(glb, NULL);
   if (!stack ||
-      !natus_evaluate_hook_add(glb, NATUS_REQUIRE_HOOK, require_eval_hook, stack, NULL) ||
+      !natus_evaluate_hook_add(glb, NATUS_REQUIRE_HOOK, require_eval_hook, NULL, NULL) ||
       !natus_set_private_name_value(glb, NATUS_REQUIRE_STACK, stack)) {
     natus_decref(stack);
     goto error;
@@ -513,7 +1172,8 @@ natus_require_init(natusValue *ctx, natusValue *config)
   natus_decref(stack);
 
   // Finish initialization
-  if (!natus_set_private_name_value(glb, NATUS_REQUIRE_CONFIG, config))
+  if (!natus_set_private_name_value(glb, NATUS_REQUIRE_CONFIG, config) ||
+      !natus_require_reload_config(glb))
     goto error;
 
   natus_decref(pth);
@@ -571,6 +1231,22 @@ natus_require_get_config(natusValue *ctx)
                                       NATUS_REQUIRE_CONFIG);
 }
 
+bool
+natus_require_reload_config(natusValue *ctx)
+{
+  natusRequire *req = get_require(ctx);
+  if (!req)
+    return false;
+
+  natusValue *config = natus_require_get_config(ctx);
+  if (!config)
+    return false;
+
+  bool rslt = config_compile(req, config);
+  natus_decref(config);
+  return rslt;
+}
+
 bool
 natus_require_hook_add(natusValue *ctx, const char *name, natusRequireHook func, void *misc, natusFreeFunction free)
 {
@@ -633,6 +1309,8 @@ natus_require_origin_matcher_add(natusValue *ctx, const char *name, natusRequire
   tmp->func = func;
   tmp->next = req->matchers;
   req->matchers = tmp;
+  if (req->policy)
+    set_clear(&req->policy->verdicts);
   return true;
 }
 
@@ -650,6 +1328,8 @@ natus_require_origin_matcher_del(natusValue *ctx, const char *name)
     if (!strcmp(mem_name_get(tmp), name)) {
       *prv = tmp->next;
       mem_decref(req, tmp);
+      if (req->policy)
+        set_clear(&req->policy->verdicts);
       return true;
     }
   }
@@ -657,58 +1337,56 @@ natus_require_origin_matcher_del(natusValue *ctx, const char *name)
   return false;
 }
 
+static bool
+origin_matches(natusRequire *req, char **patterns, size_t count, const char *uri)
+{
+  reqOriginMatcher *tmp;
+  size_t i;
+
+  for (i = 0; i < count; i++)
+    for (tmp = req->matchers; tmp; tmp = tmp->next)
+      if (tmp->func(patterns[i], uri))
+        return true;
+  return false;
+}
+
 bool
 natus_require_origin_permitted(natusValue *ctx, const char *uri)
 {
-  // Get the global
-  natusValue *glb = natus_get_global(ctx);
-  if (!glb)
-    return true;
-
-  // Get the require structure
+  // Get the require structure, without one nothing is permitted
   natusRequire *req = get_require(ctx);
-  if (!req)
-    return true;
+  if (!req || !uri || !req->policy)
+    return false;
 
-  natusValue *config = natus_require_get_config(ctx);
-  if (!config)
-    return true;
+  reqPolicy *policy = req->policy;
+  reqSetItem *verdict = set_find(&policy->verdicts, uri);
+  if (verdict)
+    return verdict->flag;
 
-  // Get the whitelist and blacklist
-  natusValue *whitelist = natus_get_recursive_utf8(config, CFG_ORIGINS_WHITELIST);
-  natusValue *blacklist = natus_get_recursive_utf8(config, CFG_ORIGINS_BLACKLIST);
-  natus_decref(config);
+  // The URI must be on the whitelist, if there is one, and not on the blacklist
+  bool match = !policy->whitelisted ||
+               origin_matches(req, policy->whitelist, policy->nwhitelist, uri);
+  if (match)
+    match = !origin_matches(req, policy->blacklist, policy->nblacklist, uri);
 
-  // Check to see if the URI is on the approved whitelist
-  bool match = !natus_is_array(whitelist);
-  reqOriginMatcher *tmp;
-  int i;
-  long len = natus_as_long(natus_get_utf8(whitelist, "length"));
-  for (i=0; !match && i < len; i++) {
-    char *pattern = natus_as_string_utf8(natus_get_index(whitelist, i), NULL);
-    if (!pattern)
-      continue;
-    for (tmp = req->matchers; !match && tmp; tmp = tmp->next)
-      match = tmp->func(pattern, uri);
-    free(pattern);
-  }
-  natus_decref(whitelist);
+  if (policy->verdicts.count >= SET_MAX)
+    set_clear(&policy->verdicts);
+  set_add(policy, &policy->verdicts, uri, match);
+  return match;
+}
 
-  // If the URI matched the whitelist, check the blacklist
-  if (match && natus_is_array(blacklist)) {
-    len = natus_as_long(natus_get_utf8(blacklist, "length"));
-    for (i = 0; match && i < len; i++) {
-      char *pattern = natus_as_string_utf8(natus_get_index(blacklist, i), NULL);
-      if (!pattern)
-        continue;
-      for (tmp = req->matchers; match && tmp; tmp = tmp->next)
-        match = !tmp->func(pattern, uri);
-      free(pattern);
-    }
-  }
-  natus_decref(blacklist);
+bool
+natus_require_resolve_stats(natusValue *ctx, size_t *hits, size_t *misses)
+{
+  natusRequire *req = get_require(ctx);
+  if (!req)
+    return false;
 
-  return match;
+  if (hits)
+    *hits = req->hits;
+  if (misses)
+    *misses = req->misses;
+  return true;
 }
 
 typedef struct potential {
@@ -718,6 +1396,12 @@ typedef struct potential {
   struct potential *next;
 } potential;
 
+static void
+potential_dtor(potential *p)
+{
+  natus_decref(p->uris);
+}
+
 static potential *
 get_potentials(reqHook *hook, natusValue *global, natusValue *name, natusValue **exc)
 {
@@ -749,8 +1433,10 @@ get_potentials(reqHook *hook, natusValue *global, natusValue *name, natusValue *
 
     if (natus_as_long(natus_get_utf8(tmp, "length")) > 0 &&
         (p = mem_new(NULL, potential))) {
-      assert(!pset || mem_steal(p, pset));
-      assert(mem_steal(p, tmp));
+      /* The uris may live in a scope, so they are not a libmem child */
+      mem_destructor_set(p, potential_dtor);
+      if (pset)
+        mem_steal(p, pset);
 
       p->hook = hook->func;
       p->misc = hook->misc;
@@ -783,14 +1469,18 @@ check_cache(potential *pset, natusValue **uri)
                                              NATUS_REQUIRE_CACHE);
 
       module = natus_get(cache, *uri);
-      if (natus_is_object(module))
+      if (natus_is_object(module)) {
+        natus_decref(cache);
         return module;
+      }
 
       natus_decref(*uri);
+      *uri = NULL;
       natus_decref(module);
     }
   }
 
+  natus_decref(cache);
   return NULL;
 }
 
@@ -855,6 +1545,7 @@ havemod:
 
   // Store the module in the cache
   natus_decref(natus_set(cache, *uri, module, natusPropAttrNone));
+  natus_decref(cache);
 
 out:
   natus_decref(config);
@@ -862,8 +1553,8 @@ out:
   return module;
 }
 
-natusValue *
-natus_require(natusValue *ctx, natusValue *name)
+static natusValue *
+require_module(natusRequire *req, natusValue *ctx, natusValue *name)
 {
   natusValue *module = NULL, *uri = NULL;
   potential *pset = NULL;
@@ -873,9 +1564,14 @@ natus_require(natusValue *ctx, natusValue *name)
   if (!global)
     return NULL;
 
-  natusRequire *req = get_require(ctx);
-  if (!req)
-    return NULL;
+  // Name the trace after the module, its uri once we know it
+  char tname[PATH_MAX];
+  bool traced = natus_tracing(ctx);
+  if (traced) {
+    tname[0] = '\0';
+    natus_to_string_utf8_buffer(name, tname, sizeof(tname));
+    natus_trace(ctx, natusTraceRequire, true, tname);
+  }
 
   // Check to see if we've already loaded the module (resolve step)
   pset = get_potentials(req->hooks, global, name, &module);
@@ -908,7 +1604,6 @@ modfound:
                                  name, uri, tmp->misc);
     if (vtmp && natus_is_exception(vtmp)) {
       natus_decref(module);
-      natus_decref(uri);
       module = vtmp;
       goto out;
     }
@@ -917,10 +1612,26 @@ modfound:
   }
 
 out:
+  if (traced) {
+    if (natus_is_string(uri))
+      natus_to_string_utf8_buffer(uri, tname, sizeof(tname));
+    natus_trace(ctx, natusTraceRequire, false, tname);
+  }
+  natus_decref(uri);
   mem_free(pset);
   return module;
 }
 
+natusValue *
+natus_require(natusValue *ctx, natusValue *name)
+{
+  natusRequire *req = get_require(ctx);
+  if (!req)
+    return NULL;
+
+  return require_module(req, ctx, name);
+}
+
 natusValue *
 natus_require_utf8(natusValue *ctx, const char *name)
 {
@@ -96,6 +96,12 @@ namespace natus
       return natus_require_get_config(ctx.borrowCValue());
     }
 
+    bool
+    reloadConfig(Value ctx)
+    {
+      return natus_require_reload_config(ctx.borrowCValue());
+    }
+
     Value
     require(Value ctx, UTF8 name)
     {
@@ -119,6 +125,12 @@ namespace natus
     {
       return natus_require_origin_permitted(ctx.borrowCValue(), uri);
     }
+
+    bool
+    resolveStats(Value ctx, size_t* hits, size_t* misses)
+    {
+      return natus_require_resolve_stats(ctx.borrowCValue(), hits, misses);
+    }
   }
 }
 
@@ -0,0 +1,106 @@
+#include <natus-internal.h>
+
+#include <stddef.h>
+#include <string.h>
+
+/* natus.stats reads the counters of its context whenever a property is
+ * looked up; writes are ignored and nothing can be deleted. */
+
+static const struct {
+  const char *name;
+  size_t      offset;
+} statsFields[] = {
+  { "calls",       offsetof(natusContextStats, calls)       },
+  { "evaluations", offsetof(natusContextStats, evaluations) },
+  { "callbacks",   offsetof(natusContextStats, callbacks)   },
+  { "properties",  offsetof(natusContextStats, properties)  },
+  { "values",      offsetof(natusContextStats, values)      },
+  { "live",        offsetof(natusContextStats, live)        },
+};
+
+#define STATS_FIELDS (sizeof(statsFields) / sizeof(*statsFields))
+
+static natusValue *
+stats_del(natusClass *cls, natusValue *obj, const natusValue *prop)
+{
+  return natus_new_boolean(obj, false);
+}
+
+static natusValue *
+stats_get(natusClass *cls, natusValue *obj, const natusValue *prop)
+{
+  natusContextStats stats;
+  char name[16];
+
+  size_t len = natus_to_string_utf8_buffer(prop, name, sizeof(name));
+  if (len < sizeof(name) && natus_context_stats(obj, &stats)) {
+    for (size_t i=0; i < STATS_FIELDS; i++)
+      if (!strcmp(name, statsFields[i].name))
+        return natus_new_number(obj, *(size_t*) ((char*) &stats + statsFields[i].offset));
+  }
+
+  // Let the engine handle anything which isn't ours
+  return natus_to_exception(natus_new_undefined(obj));
+}
+
+static natusValue *
+stats_set(natusClass *cls, natusValue *obj, const natusValue *prop, const natusValue *value)
+{
+  return natus_new_boolean(obj, true);
+}
+
+static natusValue *
+stats_enumerate(natusClass *cls, natusValue *obj)
+{
+  const char *names[STATS_FIELDS];
+  for (size_t i=0; i < STATS_FIELDS; i++)
+    names[i] = statsFields[i].name;
+  return natus_new_array_utf8_strings(obj, names, STATS_FIELDS);
+}
+
+static natusClass statsClass = {
+  stats_del,
+  stats_get,
+  stats_set,
+  stats_enumerate,
+  NULL,
+  NULL
+};
+
+bool
+natus_context_stats(const natusValue *ctx, natusContextStats *stats)
+{
+  if (!ctx || !ctx->ctx || !stats)
+    return false;
+
+  *stats = ctx->ctx->stats;
+  return true;
+}
+
+bool
+natus_context_stats_expose(natusValue *global)
+{
+  if (!natus_is_object(global))
+    return false;
+
+  natusValue *ns = natus_get_utf8(global, "natus");
+  if (!natus_is_object(ns)) {
+    natus_decref(ns);
+    ns = natus_new_object(global, NULL);
+    natusValue *rslt = natus_set_utf8(global, "natus", ns, natusPropAttrConstant);
+    bool ok = natus_is_object(ns) && !natus_is_exception(rslt);
+    natus_decref(rslt);
+    if (!ok) {
+      natus_decref(ns);
+      return false;
+    }
+  }
+
+  natusValue *stats = natus_new_object(global, &statsClass);
+  natusValue *rslt = natus_set_utf8(ns, "stats", stats, natusPropAttrConstant);
+  bool ok = natus_is_object(stats) && !natus_is_exception(rslt);
+  natus_decref(rslt);
+  natus_decref(stats);
+  natus_decref(ns);
+  return ok;
+}
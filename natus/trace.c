@@ -0,0 +1,202 @@
+#include <natus-internal.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libmem.h>
+
+struct natusTracer {
+  natusTraceFunction func;
+  void              *misc;
+  natusFreeFunction  free;
+};
+
+static void
+tracer_dtor(natusTracer *tracer)
+{
+  if (tracer && tracer->misc && tracer->free)
+    tracer->free(tracer->misc);
+}
+
+static uint64_t
+trace_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bool
+natus_trace_set(const natusValue *ctx, natusTraceFunction func, void *misc,
+                natusFreeFunction free)
+{
+  natusTracer *tracer = NULL;
+
+  if (!ctx || !ctx->ctx)
+    goto error;
+
+  if (func) {
+    tracer = mem_new_zero(ctx->ctx, natusTracer);
+    if (!tracer)
+      goto error;
+    mem_destructor_set(tracer, tracer_dtor);
+    tracer->func = func;
+    tracer->misc = misc;
+    tracer->free = free;
+  }
+
+  mem_free(ctx->ctx->tracer);
+  ctx->ctx->tracer = tracer;
+  return true;
+
+error:
+  if (misc && free)
+    (*free)(misc);
+  return false;
+}
+
+bool
+natus_tracing(const natusValue *ctx)
+{
+  return ctx && ctx->ctx && ctx->ctx->tracer;
+}
+
+void
+natus_trace(const natusValue *ctx, natusTraceEvent event, bool enter, const char *name)
+{
+  if (!natus_tracing(ctx))
+    return;
+
+  natusTracer *tracer = ctx->ctx->tracer;
+  tracer->func(event, enter, name ? name : "", trace_now(), tracer->misc);
+}
+
+const char *
+trace_enter(const natusValue *ctx, natusTraceEvent event, const char *prefix,
+            const natusValue *val, const char *dflt, char *buf)
+{
+  if (!ctx->ctx->tracer)
+    return NULL;
+
+  size_t len = 0;
+  buf[0] = '\0';
+  if (prefix) {
+    len = strlen(prefix);
+    if (len > TRACE_NAME - 2)
+      len = TRACE_NAME - 2;
+    memcpy(buf, prefix, len);
+    buf[len++] = ' ';
+    buf[len] = '\0';
+  }
+
+  // Functions go by their name, strings and numbers by their value.
+  // Nothing here may call into script, that would be traced too.
+  if (natus_is_function(val)) {
+    natusValue *name = natus_get_utf8((natusValue*) val, "name");
+    if (natus_is_string(name))
+      natus_to_string_utf8_buffer(name, buf + len, TRACE_NAME - len);
+    natus_decref(name);
+  } else if (natus_is_string(val))
+    natus_to_string_utf8_buffer(val, buf + len, TRACE_NAME - len);
+  else if (natus_is_number(val))
+    snprintf(buf + len, TRACE_NAME - len, "%.17g", natus_to_double(val));
+
+  if (!buf[len] && dflt)
+    snprintf(buf + len, TRACE_NAME - len, "%s", dflt);
+  else if (!buf[len] && len > 0)
+    buf[len - 1] = '\0';
+
+  natus_trace(ctx, event, true, buf);
+  return buf;
+}
+
+void
+trace_leave(const natusValue *ctx, natusTraceEvent event, const char *name)
+{
+  if (name)
+    natus_trace(ctx, event, false, name);
+}
+
+/* The Chrome trace event format: one begin (B) and one end (E) event per
+ * crossing, timestamps in microseconds. Each traced context is a thread. */
+
+typedef struct {
+  FILE    *file;
+  unsigned tid;
+} chromeTrace;
+
+static const char *chromeCategories[] = {
+  "call",
+  "evaluate",
+  "callback",
+  "property",
+  "require"
+};
+
+static void
+chrome_string(FILE *file, const char *str)
+{
+  fputc('"', file);
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      fprintf(file, "\\%c", *str);
+    else if ((unsigned char) *str < 0x20)
+      fprintf(file, "\\u%04x", (unsigned char) *str);
+    else
+      fputc(*str, file);
+  }
+  fputc('"', file);
+}
+
+static void
+chrome_event(natusTraceEvent event, bool enter, const char *name,
+             uint64_t ns, void *misc)
+{
+  chromeTrace *trace = misc;
+
+  fputs(",\n{\"name\":", trace->file);
+  chrome_string(trace->file, name);
+  fprintf(trace->file, ",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%d,\"tid\":%u}",
+          chromeCategories[event], enter ? 'B' : 'E',
+          (unsigned long long) (ns / 1000), (unsigned) (ns % 1000),
+          (int) getpid(), trace->tid);
+}
+
+static void
+chrome_free(chromeTrace *trace)
+{
+  fputs("\n]}\n", trace->file);
+  fclose(trace->file);
+  free(trace);
+}
+
+bool
+natus_trace_chrome(const natusValue *ctx, const char *filename)
+{
+  static unsigned tids;
+
+  if (!ctx || !filename)
+    return false;
+
+  chromeTrace *trace = malloc(sizeof(chromeTrace));
+  if (!trace)
+    return false;
+
+  trace->file = fopen(filename, "w");
+  if (!trace->file) {
+    free(trace);
+    return false;
+  }
+  trace->tid = __sync_add_and_fetch(&tids, 1);
+
+  // Name the thread after the engine
+  fputs("{\"traceEvents\":[", trace->file);
+  fprintf(trace->file, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":",
+          (int) getpid(), trace->tid);
+  chrome_string(trace->file, natus_get_engine_name(ctx));
+  fputs("}}", trace->file);
+
+  return natus_trace_set(ctx, chrome_event, trace, (natusFreeFunction) chrome_free);
+}
@@ -0,0 +1,90 @@
+#include "test.hh"
+
+static Value kept;
+
+static Value
+count_function(Value& fnc, Value& ths, Value& arg)
+{
+  assert(arg.isArray());
+  return arg.get("length");
+}
+
+static Value
+sum_function(Value& fnc, Value& ths, Value& arg)
+{
+  int sum = 0;
+  int len = arg.get("length").to<int>();
+  for (int i=0; i < len; i++)
+    sum += arg[i].to<int>();
+  assert(arg[len].isUndefined());
+  assert(arg.get(fnc.newNumber(1e30)).isUndefined());
+  assert(arg.get(fnc.newNumber(0.0 / 0.0)).isUndefined());
+  return fnc.newNumber(sum);
+}
+
+static Value
+keep_function(Value& fnc, Value& ths, Value& arg)
+{
+  kept = arg;
+  return fnc.newUndefined();
+}
+
+static Value
+self_function(Value& fnc, Value& ths, Value& arg)
+{
+  assert(!arg.set(arg.get("length").to<long>(), "last").isException());
+  return arg;
+}
+
+int
+doTest(Value& global)
+{
+  Value rslt;
+  assert(!global.set("count", global.newFunction(count_function)).isException());
+  assert(!global.set("sum", global.newFunction(sum_function)).isException());
+  assert(!global.set("keep", global.newFunction(keep_function)).isException());
+  assert(!global.set("self", global.newFunction(self_function)).isException());
+
+  // Arguments from JS
+  assert(global.evaluate("count();").to<int>() == 0);
+  assert(global.evaluate("count(1, 'a', {});").to<int>() == 3);
+  assert(global.evaluate("sum(1, 2, 3, 4);").to<int>() == 10);
+
+  // Arguments kept past the call must still be readable
+  global.evaluate("keep(5, 'six');");
+  assert(kept.isArray());
+  assert(kept.get("length").to<int>() == 2);
+  assert(kept[0].to<int>() == 5);
+  assert(kept[1].to<UTF8>() == "six");
+  kept = Value();
+
+  // Arguments modified or handed back to JS
+  rslt = global.evaluate("self(1, 2);");
+  assert(rslt.isArray());
+  assert(rslt.get("length").to<int>() == 3);
+  assert(rslt[2].to<UTF8>() == "last");
+  assert(global.evaluate("self(7).join(',');").to<UTF8>() == "7,last");
+
+  // Arguments from C++, to native and to JS functions
+  Value one = global.newNumber(1);
+  Value two = global.newNumber(2);
+  assert(global.call("sum", &one, &two, NULL).to<int>() == 3);
+  assert(global.call("count").to<int>() == 0);
+  global.evaluate("function jsum(a, b) { return a + b + arguments.length; }");
+  assert(global.call("jsum", &one, &two, NULL).to<int>() == 5);
+  assert(global.get("jsum").call(global, &one, &two, NULL).to<int>() == 5);
+
+  // More arguments than fit on the stack
+  Value many[20];
+  for (int i=0; i < 20; i++)
+    many[i] = global.newNumber(i);
+  rslt = global.call("sum", &many[0], &many[1], &many[2], &many[3], &many[4],
+                     &many[5], &many[6], &many[7], &many[8], &many[9], &many[10],
+                     &many[11], &many[12], &many[13], &many[14], &many[15],
+                     &many[16], &many[17], &many[18], &many[19], NULL);
+  assert(rslt.to<int>() == 190);
+
+  // Natives reached through apply()
+  assert(global.evaluate("(function() { return sum.apply(this, [4, 5]); })();").to<int>() == 9);
+  return 0;
+}
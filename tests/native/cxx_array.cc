@@ -27,6 +27,26 @@ doTest(Value& global)
   assert(789 == array.get(0).to<int>());
   assert(456 == array.get(1).to<int>());
 
+  // Indexes are shared with script, holes read as undefined
+  assert(!array.set(4, 5).isException());
+  assert(5 == array.get("length").to<int>());
+  assert(array.get(3).isUndefined());
+  assert(global.evaluate("x[4] == 5 && x.length == 5").to<bool>());
+  assert(!global.evaluate("x[3] = 'bar'").isException());
+  assert(array.get(3).to<UTF8>() == "bar");
+
+  // 2^32 - 1 is not an array index, only a property name
+  assert(!array.set((size_t) 4294967295UL, 1).isException());
+  assert(5 == array.get("length").to<int>());
+  assert(1 == array.get("4294967295").to<int>());
+  assert(1 == array.get((size_t) 4294967295UL).to<int>());
+
+  // Plain objects take indexes too
+  Value obj = global.newObject();
+  assert(!obj.set(7, 7).isException());
+  assert(7 == obj.get("7").to<int>());
+  assert(7 == obj.get(7).to<int>());
+
   assert(!global.del("x").isException());
   assert(global.get("x").isUndefined());
   return 0;
@@ -0,0 +1,87 @@
+#include "test.hh"
+#include <cmath>
+
+static int freed = 0;
+
+static void
+count_free(void *mem)
+{
+  freed++;
+  free(mem);
+}
+
+int
+doTest(Value& global)
+{
+  unsigned char *bytes = (unsigned char *) malloc(16);
+  for (int i=0; i < 16; i++)
+    bytes[i] = i * 16;
+
+  {
+    Value buf = global.newBuffer(bytes, 16, count_free);
+    assert(buf.isBuffer());
+    assert(!buf.isObject());
+    assert(buf.isType(Value::TypeSupportsPrivate));
+    assert(!strcmp(buf.getTypeName(), "buffer"));
+
+    // No copy is made
+    void *data = NULL;
+    size_t len = 0;
+    assert(buf.borrowBuffer(&data, &len));
+    assert(data == bytes);
+    assert(len == 16);
+
+    // Native access sees the bytes
+    assert(buf.get("length").to<int>() == 16);
+    assert(buf.get(1).to<int>() == 16);
+    assert(buf.get(15).to<int>() == 240);
+    assert(buf.get(16).isUndefined());
+
+    // And so does script, both ways
+    assert(!global.set("b", buf).isException());
+    assert(global.evaluate("b.length").to<int>() == 16);
+    assert(global.evaluate("b[2]").to<int>() == 32);
+    assert(global.evaluate("b[16]").isUndefined());
+    assert(!global.evaluate("b[3] = 257; b[4] = -1; b[5] = 'x';").isException());
+    assert(bytes[3] == 1);
+    assert(bytes[4] == 255);
+    assert(bytes[5] == 0);
+    bytes[6] = 42;
+    assert(global.evaluate("b[6]").to<int>() == 42);
+
+    // Writes past the end and to length are dropped
+    assert(!global.evaluate("b[16] = 1; b.length = 1;").isException());
+    assert(global.evaluate("b.length").to<int>() == 16);
+    assert(global.evaluate("b[16]").isUndefined());
+
+    // Numbers which aren't indexes are names, however large
+    assert(buf.get(global.newNumber(NAN)).isUndefined());
+    assert(buf.get(global.newNumber(1e300)).isUndefined());
+    assert(buf.get(global.newNumber(-1)).isUndefined());
+    assert(buf.get("99999999999999999999").isUndefined());
+
+    // Other names are ordinary properties
+    assert(!global.evaluate("b.foo = 'bar';").isException());
+    assert(global.evaluate("b.foo").to<UTF8>() == "bar");
+
+    // The type survives the trip through the engine
+    assert(global.get("b").isBuffer());
+    assert(global.get("b").borrowBuffer(NULL, &len) && len == 16);
+
+    // Only buffers lend their memory
+    assert(!global.newObject().borrowBuffer(&data, &len));
+    assert(!global.newString("abc").borrowBuffer(&data, &len));
+    assert(!global.del("b").isException());
+  }
+
+  // Empty buffers work too
+  Value empty = global.newBuffer(NULL, 0, NULL);
+  assert(empty.isBuffer());
+  assert(empty.get("length").to<int>() == 0);
+
+  // Failing frees the memory as well
+  int before = freed;
+  assert(Value((natusValue*) NULL).newBuffer(malloc(1), 1, count_free).isException());
+  assert(freed == before + 1);
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include "test.hh"
+#include <natus.h>
+
+#include <cmath>
+
+#define COUNT 100000
+
+static Value
+sum(Value& fnc, Value& ths, Value& args)
+{
+  size_t len = 0;
+  double *nums = natus_array_to_doubles(args.borrowCValue(), &len);
+  assert(nums);
+
+  double total = 0;
+  for (size_t i=0; i < len; i++)
+    total += nums[i];
+  free(nums);
+  return fnc.newNumber(total);
+}
+
+int
+doTest(Value& global)
+{
+  // Numbers in, numbers out
+  double *nums = new double[COUNT];
+  for (size_t i=0; i < COUNT; i++)
+    nums[i] = i * 0.5;
+
+  Value array = global.newArray(nums, COUNT);
+  assert(array.isArray());
+  assert(array.get("length").to<long>() == COUNT);
+  assert(array.get(3).to<double>() == 1.5);
+  assert(!global.set("x", array).isException());
+  assert(global.evaluate("x[x.length - 1] == (x.length - 1) / 2").to<bool>());
+
+  size_t len = 0;
+  double *back = natus_array_to_doubles(array.borrowCValue(), &len);
+  assert(back);
+  assert(len == COUNT);
+  for (size_t i=0; i < COUNT; i++)
+    assert(back[i] == nums[i]);
+  free(back);
+  delete[] nums;
+
+  // Anything else is converted like Number() would, holes are NaN
+  array = global.evaluate("['4', true, null, , 2.5];");
+  back = natus_array_to_doubles(array.borrowCValue(), &len);
+  assert(back);
+  assert(len == 5);
+  assert(back[0] == 4 && back[1] == 1 && back[2] == 0);
+  assert(std::isnan(back[3]));
+  assert(back[4] == 2.5);
+  free(back);
+
+  // Only arrays convert
+  assert(!natus_array_to_doubles(global.newObject().borrowCValue(), NULL));
+  assert(!natus_array_to_doubles(global.newNumber(1).borrowCValue(), NULL));
+
+  // Empty arrays are fine
+  array = global.newArray((const double*) NULL, 0);
+  assert(array.isArray());
+  assert(array.get("length").to<int>() == 0);
+  back = natus_array_to_doubles(array.borrowCValue(), &len);
+  assert(back && len == 0);
+  free(back);
+
+  // Arguments are read without building an array first
+  assert(!global.set("sum", global.newFunction(sum)).isException());
+  assert(global.evaluate("sum(1, 2, 3.5)").to<double>() == 6.5);
+
+  // Strings, with NULL as null
+  const char *strs[] = { "foo", "bar", NULL, "baz" };
+  array = global.newArray(strs, 4);
+  assert(array.isArray());
+  assert(array.get("length").to<int>() == 4);
+  assert(array.get(0).to<UTF8>() == "foo");
+  assert(array.get(2).isNull());
+  assert(array.get(3).to<UTF8>() == "baz");
+
+  const char *many[COUNT / 100];
+  for (size_t i=0; i < COUNT / 100; i++)
+    many[i] = i % 2 ? "odd" : "even";
+  array = global.newArray(many, COUNT / 100);
+  assert(array.get("length").to<int>() == COUNT / 100);
+  assert(array.get(COUNT / 100 - 1).to<UTF8>() == "odd");
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include "test.hh"
+
+static int hooked = 0;
+
+static void
+count_hook(Value ths, Value *javascript_or_return, Value *filename, unsigned int *lineno, void *misc)
+{
+  hooked++;
+}
+
+int
+doTest(Value& global)
+{
+  assert(!global.set("n", 0).isException());
+
+  // Compiled once, run many times
+  Value script = global.compile("n = n + 1; n * 2;", "counter.js");
+  assert(!script.isException());
+  assert(script.isObject());
+  for (int i=1; i <= 10; i++) {
+    Value res = global.run(script);
+    assert(!res.isException());
+    assert(res.to<int>() == i * 2);
+  }
+  assert(global.get("n").to<int>() == 10);
+
+  // Runs see later changes to the global
+  assert(!global.set("n", 100).isException());
+  assert(global.run(script).to<int>() == 202);
+
+  // Syntax errors come from compiling, runtime errors from running
+  assert(global.compile("this is not javascript", "bad.js").isException());
+  Value thrower = global.compile("throw new Error('boom');", "throw.js");
+  assert(!thrower.isException());
+  Value exc = global.run(thrower);
+  assert(exc.isException());
+  assert(exc.get("message").to<UTF8>() == "boom");
+  assert(global.run(thrower).isException());
+
+  // Only compiled scripts run
+  assert(global.run(global.newObject()).isException());
+  assert(global.run(global.newString("n")).isException());
+
+  // Hooks see the compile, not the runs
+  assert(addEvaluateHook(global, "counter", count_hook, NULL, NULL));
+  Value hookedscript = global.compile("n", "hooked.js");
+  assert(hooked == 2);
+  global.run(hookedscript);
+  global.run(hookedscript);
+  assert(hooked == 2);
+  assert(delEvaluateHook(global, "counter"));
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "test.hh"
+
+static int freed = 0;
+
+static void
+count_free(void *mem)
+{
+  freed++;
+  free(mem);
+}
+
+int
+doTest(Value& global)
+{
+  // Static characters need no free function
+  static const char ascii[] = "Hello, world!";
+  Value str = global.newStringExternal(ascii, sizeof(ascii) - 1, NULL);
+  assert(str.isString());
+  assert(str.to<UTF8>() == ascii);
+  assert(str.get("length").to<int>() == 13);
+
+  // Only len characters are used
+  assert(global.newStringExternal(ascii, 5, NULL).to<UTF8>() == "Hello");
+
+  // Script sees ordinary strings
+  assert(!global.set("s", str).isException());
+  assert(global.evaluate("s.indexOf('world')").to<int>() == 7);
+  assert(global.evaluate("s + '!'").to<UTF8>() == "Hello, world!!");
+  assert(!global.del("s").isException());
+
+  // Non-ASCII UTF-8 is decoded
+  char *utf8 = strdup("caf\xc3\xa9");
+  Value cafe = global.newStringExternal(utf8, 5, count_free);
+  assert(cafe.isString());
+  assert(cafe.get("length").to<int>() == 4);
+  assert(cafe.to<UTF8>() == "caf\xc3\xa9");
+
+  // UTF-16 too
+  Char *utf16 = (Char *) malloc(sizeof(Char) * 4);
+  utf16[0] = 'a';
+  utf16[1] = 0x263A;
+  utf16[2] = 'b';
+  utf16[3] = 0;
+  UTF16 copy = utf16;
+  Value smile = global.newStringExternal(utf16, 3, count_free);
+  assert(smile.isString());
+  assert(smile.get("length").to<int>() == 3);
+  assert(smile.to<UTF16>() == copy);
+  assert(!global.set("u", smile).isException());
+  assert(global.evaluate("u.charCodeAt(1)").to<int>() == 0x263A);
+  assert(!global.del("u").isException());
+
+  // The engine frees each string at most once, maybe not yet
+  assert(freed <= 2);
+
+  // Failing frees the characters as well
+  int before = freed;
+  assert(Value((natusValue*) NULL).newStringExternal(strdup("x"), 1, count_free).isException());
+  assert(freed == before + 1);
+  return 0;
+}
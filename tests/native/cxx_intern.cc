@@ -0,0 +1,68 @@
+#include "test.hh"
+#include <natus.h>
+
+#define COUNT 5000
+
+int
+doTest(Value& global)
+{
+  // The same name always maps to the same key
+  const natusValue *length = natus_intern_utf8(global.borrowCValue(), "length");
+  assert(length);
+  assert(length == natus_intern_utf8(global.borrowCValue(), "length"));
+  assert(Value((natusValue*) length, false).to<UTF8>() == "length");
+
+  // Interned and fresh names must reach the same property
+  Value array = global.evaluate("[1, 2, 3];");
+  assert(array.get("length").to<int>() == 3);
+  assert(array.get(global.newString("length")).to<int>() == 3);
+
+  // Interned keys are owned by the table, not counted as live handles
+  natusContextStats before, after;
+  assert(natus_context_stats(global.borrowCValue(), &before));
+  assert(natus_intern_utf8(global.borrowCValue(), "unseen"));
+  assert(natus_context_stats(global.borrowCValue(), &after));
+  assert(after.live == before.live);
+
+  // More names than the table will hold: cold keys make room for new ones,
+  // while keys held or looked up all along stay interned
+  Value held((natusValue*) natus_intern_utf8(global.borrowCValue(), "held"), false);
+  const natusValue *hot = natus_intern_utf8(global.borrowCValue(), "hot");
+  Value obj = global.newObject();
+  char name[32];
+  for (int i=0; i < COUNT; i++) {
+    snprintf(name, sizeof(name), "name%d", i);
+    assert(!obj.set(name, i).isException());
+    assert(natus_intern_utf8(global.borrowCValue(), "hot") == hot);
+  }
+  assert(natus_intern_utf8(global.borrowCValue(), "held") == held.borrowCValue());
+  assert(natus_intern_utf8(global.borrowCValue(), "name0"));
+  assert(natus_context_stats(global.borrowCValue(), &after));
+  assert(after.live == before.live + 1);
+  for (int i=0; i < COUNT; i++) {
+    snprintf(name, sizeof(name), "name%d", i);
+    assert(obj.get(name).to<int>() == i);
+    assert(!obj.del(name).isException());
+    assert(obj.get(name).isUndefined());
+  }
+
+  // Names with embedded NULs are never interned
+  assert(!obj.set(UTF8("a\0b", 3), 1).isException());
+  assert(obj.get(UTF8("a\0b", 3)).to<int>() == 1);
+  assert(obj.get("a").isUndefined());
+
+  // A shared global has keys of its own
+  Value shared = Value::newGlobal(global);
+  assert(!shared.isException());
+  assert(shared.evaluate("[1, 2];").get("length").to<int>() == 2);
+
+  // A key kept past its global is only ever released
+  string engine = string(ENGINEDIR) + "/" + global.getEngineName() + MODSUFFIX;
+  natusValue *other = natus_new_global(engine.c_str());
+  assert(other);
+  natusValue *kept = natus_incref((natusValue*) natus_intern_utf8(other, "kept"));
+  assert(kept);
+  natus_decref(other);
+  natus_decref(kept);
+  return 0;
+}
@@ -0,0 +1,32 @@
+#include "test.hh"
+#include <vector>
+
+#define COUNT 1000000
+
+int
+doTest(Value& global)
+{
+  // Hold far more live values than a 16-bit link count could address
+  vector<Value> values;
+  values.reserve(COUNT);
+  for (int i=0; i < COUNT; i++) {
+    values.push_back(global.newNumber(i));
+    assert(values.back().isNumber());
+  }
+
+  assert(values[0].to<int>() == 0);
+  assert(values[COUNT / 2].to<int>() == COUNT / 2);
+  assert(values[COUNT - 1].to<int>() == COUNT - 1);
+
+  // The context must still be usable with all of them outstanding
+  global.set("x", values[COUNT - 1]);
+  assert(global.get("x").to<int>() == COUNT - 1);
+  assert(!global.del("x").isException());
+
+  // Release newest first, then the rest oldest first
+  for (int i=0; i < COUNT / 2; i++)
+    values.pop_back();
+  assert(values.back().to<int>() == COUNT / 2 - 1);
+  values.clear();
+  return 0;
+}
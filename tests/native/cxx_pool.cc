@@ -0,0 +1,147 @@
+#include "test.hh"
+#include <natus.h>
+
+#define JOBS 64
+
+static natusClone* results[JOBS];
+static bool setups[4];
+
+static bool
+setup(natusValue* global, size_t worker, void* misc)
+{
+  if (worker >= 4 || setups[worker])
+    return false;
+  setups[worker] = true;
+
+  natusValue* id = natus_new_number(global, worker);
+  natusValue* rslt = natus_set_utf8(global, "worker", id, natusPropAttrConstant);
+  bool ok = !natus_is_exception(rslt);
+  natus_decref(rslt);
+  natus_decref(id);
+  return ok;
+}
+
+static void
+collect(natusClone* result, void* misc)
+{
+  results[(size_t) misc] = result;
+}
+
+static Value
+value(Value& global, natusClone* clone)
+{
+  return natus_clone_value(global.borrowCValue(), clone);
+}
+
+int
+doTest(Value& global)
+{
+  string engine = string(ENGINEDIR) + "/" + global.getEngineName() + MODSUFFIX;
+
+  // Clones hold only data
+  Value obj = global.evaluate("({ a: [1, 'two', null, undefined, true], b: { c: '\\u00e9\\ud83d\\ude00' } })");
+  natusClone* clone = natus_clone(obj.borrowCValue());
+  assert(clone && !natus_clone_is_exception(clone));
+  Value copy = value(global, clone);
+  natus_clone_free(clone);
+  assert(!global.set("copy", copy).isException());
+  assert(global.evaluate("copy.a.length == 5 && copy.a[1] == 'two' && copy.a[2] === null").to<bool>());
+  assert(global.evaluate("copy.a[3] === undefined && copy.a[4] === true").to<bool>());
+  assert(global.evaluate("copy.b.c == '\\u00e9\\ud83d\\ude00'").to<bool>());
+
+  // Functions and cycles don't clone
+  assert(!natus_clone(global.evaluate("(function() {})").borrowCValue()));
+  assert(!natus_clone(global.evaluate("var o = {}; o.o = o; o").borrowCValue()));
+  assert(!natus_clone(global.evaluate("var p = {}; p.q = { r: [p] }; p").borrowCValue()));
+  assert(!natus_clone(global.evaluate("({ f: function() {} })").borrowCValue()));
+
+  // Shared values are cloned once, and stay shared
+  obj = global.evaluate("var x = [1]; for (var i=0; i < 40; i++) x = [x, { x: x }]; x");
+  clone = natus_clone(obj.borrowCValue());
+  assert(clone);
+  copy = value(global, clone);
+  natus_clone_free(clone);
+  assert(!global.set("copy", copy).isException());
+  assert(global.evaluate("copy[0] === copy[1].x && copy[1].x[0] === copy[0][0]").to<bool>());
+  assert(global.evaluate("for (var i=0; i < 40; i++) copy = copy[1].x; copy.length == 1 && copy[0] == 1").to<bool>());
+
+  // Holes in arrays are skipped
+  obj = global.evaluate("var s = []; s[100000] = 's'; s[7] = 7; s");
+  clone = natus_clone(obj.borrowCValue());
+  assert(clone);
+  copy = value(global, clone);
+  natus_clone_free(clone);
+  assert(!global.set("copy", copy).isException());
+  assert(global.evaluate("copy.length == 100001 && copy[100000] == 's' && copy[7] == 7").to<bool>());
+  assert(global.evaluate("Object.keys(copy).length == 2").to<bool>());
+
+  // However many arrays and objects, but only so deep
+  obj = global.evaluate("var m = []; for (var i=0; i < 20000; i++) m.push({ i: i, o: m[i - 1] }); m");
+  clone = natus_clone(obj.borrowCValue());
+  assert(clone);
+  copy = value(global, clone);
+  natus_clone_free(clone);
+  assert(!global.set("copy", copy).isException());
+  assert(global.evaluate("copy.length == 20000 && copy[19999].i == 19999 && copy[19999].o === copy[19998]").to<bool>());
+  obj = global.evaluate("var d = []; for (var i=0; i < 1023; i++) d = [d]; d");
+  clone = natus_clone(obj.borrowCValue());
+  assert(clone);
+  natus_clone_free(clone);
+  obj = global.evaluate("d = [d]");
+  assert(!natus_clone(obj.borrowCValue()));
+
+  // Every worker is set up once, with a global of its own
+  natusPool* pool = natus_pool_new(engine.c_str(), 4, setup, NULL);
+  assert(pool);
+  assert(natus_pool_size(pool) == 4);
+  for (size_t i=0; i < 4; i++)
+    assert(setups[i]);
+
+  // Functions are called with the arguments, results come back cloned
+  for (size_t i=0; i < JOBS - 4; i++) {
+    Value args = global.newArray().push((int) i).push("x");
+    assert(natus_pool_submit(pool, "(function(n, s) { return { n: n * 2, s: s + n, w: worker }; })",
+                             natus_clone(args.borrowCValue()), collect, (void*) i));
+  }
+
+  // Anything else is the result of the script
+  assert(natus_pool_submit(pool, "worker", NULL, collect, (void*) (JOBS - 4)));
+  assert(natus_pool_submit(pool, "throw new Error('boom')", NULL, collect, (void*) (JOBS - 3)));
+  assert(natus_pool_submit(pool, "(function() {})", NULL, collect, (void*) (JOBS - 2)));
+  assert(natus_pool_submit(pool, "(", NULL, collect, (void*) (JOBS - 1)));
+  natus_pool_wait(pool);
+
+  for (size_t i=0; i < JOBS - 4; i++) {
+    assert(results[i] && !natus_clone_is_exception(results[i]));
+    Value rslt = value(global, results[i]);
+    assert(rslt.get("n").to<int>() == (int) i * 2);
+    char s[32];
+    snprintf(s, sizeof(s), "x%zu", i);
+    assert(rslt.get("s").to<UTF8>() == s);
+    assert(rslt.get("w").to<int>() >= 0 && rslt.get("w").to<int>() < 4);
+  }
+  assert(value(global, results[JOBS - 4]).to<int>() < 4);
+  assert(natus_clone_is_exception(results[JOBS - 3]));
+  assert(value(global, results[JOBS - 3]).to<UTF8>().find("boom") != string::npos);
+  assert(natus_clone_is_exception(results[JOBS - 2]));
+  assert(value(global, results[JOBS - 2]).to<UTF8>().find("DataCloneError") != string::npos);
+  assert(natus_clone_is_exception(results[JOBS - 1]));
+  for (size_t i=0; i < JOBS; i++)
+    natus_clone_free(results[i]);
+
+  // Queued jobs still run when the pool is freed
+  for (size_t i=0; i < JOBS; i++) {
+    results[i] = NULL;
+    assert(natus_pool_submit(pool, "worker", NULL, collect, (void*) i));
+  }
+  natus_pool_free(pool);
+  for (size_t i=0; i < JOBS; i++) {
+    assert(results[i]);
+    natus_clone_free(results[i]);
+  }
+
+  // A worker which can't be set up fails the pool, as does no engine
+  assert(!natus_pool_new(engine.c_str(), 4, setup, NULL));
+  assert(!natus_pool_new("/nonexistent", 4, NULL, NULL));
+  return 0;
+}
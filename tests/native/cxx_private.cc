@@ -34,6 +34,38 @@ testExternal(Value& global, Value val, Value::Type type, bool works = false)
   assert(!global.del("x").isException());
 }
 
+static int freed = 0;
+
+static void
+countFree(void *priv)
+{
+  freed++;
+}
+
+static void
+testManyKeys(Value& global)
+{
+  Value obj = global.newObject();
+  char key[32];
+
+  // Enough keys to outgrow the initial table a few times
+  for (long i=0; i < 100; i++) {
+    snprintf(key, sizeof(key), "key%ld", i);
+    assert(obj.setPrivateName(key, (void *) (i + 1), countFree));
+  }
+  for (long i=0; i < 100; i++) {
+    snprintf(key, sizeof(key), "key%ld", i);
+    assert(i + 1 == obj.getPrivateName<long>(key));
+  }
+  assert(NULL == obj.getPrivateName<void*>("key100"));
+  assert(freed == 0);
+
+  // Replacing a key frees the old value
+  assert(obj.setPrivateName("key7", (void *) 0x1234, countFree));
+  assert(0x1234 == obj.getPrivateName<long>("key7"));
+  assert(freed == 1);
+}
+
 int
 doTest(Value& global)
 {
@@ -61,6 +93,9 @@ doTest(Value& global)
   testInternal(global, "x = 'hello';", Value::TypeString);
   testInternal(global, "", Value::TypeUndefined);
 
+  // Test lookups on an object with many keys
+  testManyKeys(global);
+
   // Cleanup
   assert(global.get("x").isUndefined());
   return 0;
@@ -0,0 +1,86 @@
+#include "test.hh"
+#include <natus.h>
+#include <natus-require.hh>
+
+#include <unistd.h>
+
+static int
+count_entries(const char *dir)
+{
+  int count = 0;
+  DIR *d = opendir(dir);
+  assert(d);
+  for (struct dirent *ent; (ent = readdir(d));)
+    if (strstr(ent->d_name, ".jsc"))
+      count++;
+  closedir(d);
+  return count;
+}
+
+static void
+load(const char *engine, const char *cachedir)
+{
+  string path = string(ENGINEDIR) + "/" + engine + MODSUFFIX;
+  Value global = Value::newGlobal(path.c_str());
+  assert(!global.isException());
+
+  Value config = global.newObject();
+  config.setRecursive("natus.require.path", global.newArray().push("./"), Value::PropAttrNone, true);
+  config.setRecursive("natus.require.cache", cachedir, Value::PropAttrNone, true);
+  assert(require::init(global, config));
+
+  Value mod = require::require(global, "scriptmod");
+  assert(!mod.isException());
+  assert(mod.get("number").to<int>() == 115);
+  assert(mod.get("string").to<UTF8>() == "hello world");
+}
+
+int
+doTest(Value& global)
+{
+  // Saved scripts round trip, where the engine can save them at all
+  natusValue *ctx = global.borrowCValue();
+  natusValue *src = natus_new_string_utf8(ctx, "6 * 7");
+  natusValue *script = natus_compile(ctx, src, NULL, 0);
+  assert(natus_is_object(script));
+
+  size_t len = 0;
+  bool hit = true;
+  void *data = natus_serialize(script, &len);
+  if (data) {
+    natusValue *again = natus_compile_cached(ctx, src, NULL, 0, data, len, &hit);
+    assert(hit);
+    assert(natus_as_long(natus_run(ctx, again)) == 42);
+    natus_decref(again);
+  }
+
+  // Anything else is compiled from source
+  natusValue *fresh = natus_compile_cached(ctx, src, NULL, 0, "garbage", 8, &hit);
+  assert(!hit);
+  assert(natus_as_long(natus_run(ctx, fresh)) == 42);
+  natus_decref(fresh);
+  free(data);
+  natus_decref(script);
+  natus_decref(src);
+
+  // Modules are saved on first load and reused by later globals
+  char cachedir[] = "/tmp/natus-cache-XXXXXX";
+  assert(mkdtemp(cachedir));
+  load(global.getEngineName(), cachedir);
+  assert(count_entries(cachedir) == (data ? 1 : 0));
+  load(global.getEngineName(), cachedir);
+  assert(count_entries(cachedir) == (data ? 1 : 0));
+
+  // Cleanup
+  DIR *d = opendir(cachedir);
+  for (struct dirent *ent; d && (ent = readdir(d));) {
+    if (ent->d_name[0] == '.')
+      continue;
+    string file = string(cachedir) + "/" + ent->d_name;
+    unlink(file.c_str());
+  }
+  if (d)
+    closedir(d);
+  assert(rmdir(cachedir) == 0);
+  return 0;
+}
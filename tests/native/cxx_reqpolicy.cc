@@ -0,0 +1,89 @@
+#include "test.hh"
+#include <natus-require.hh>
+
+#include <fnmatch.h>
+
+static int calls = 0;
+
+static bool
+glob_matcher(const char* pattern, const char* subject)
+{
+  calls++;
+  return fnmatch(pattern, subject, 0) == 0;
+}
+
+static bool
+never_matcher(const char* pattern, const char* subject)
+{
+  calls++;
+  return false;
+}
+
+int
+doTest(Value& global)
+{
+  string path = string(ENGINEDIR) + "/" + global.getEngineName() + MODSUFFIX;
+  Value glb = Value::newGlobal(path.c_str());
+  assert(!glb.isException());
+
+  Value config = glb.newObject();
+  config.setRecursive("natus.require.path", glb.newArray().push("./"), Value::PropAttrNone, true);
+  config.setRecursive("natus.require.whitelist", glb.newArray().push("scriptmod").push(7), Value::PropAttrNone, true);
+  config.setRecursive("natus.origins.whitelist", glb.newArray().push("http://*.example.com/*"), Value::PropAttrNone, true);
+  config.setRecursive("natus.origins.blacklist", glb.newArray().push("http://evil.example.com/*"), Value::PropAttrNone, true);
+  assert(require::init(glb, config));
+
+  // Only whitelisted modules can be required from script
+  assert(glb.evaluate("require('scriptmod').number").to<int>() == 115);
+  assert(glb.evaluate("require('7')").isException());
+  assert(glb.evaluate("require('other')").isException());
+
+  // Without a matcher, nothing matches the whitelist
+  assert(!require::originPermitted(glb, "http://www.example.com/"));
+  assert(require::addOriginMatcher(glb, "glob", glob_matcher));
+  assert(require::originPermitted(glb, "http://www.example.com/"));
+  assert(!require::originPermitted(glb, "http://evil.example.com/"));
+  assert(!require::originPermitted(glb, "http://www.example.org/"));
+
+  // Verdicts are remembered until the matchers change
+  calls = 0;
+  assert(require::originPermitted(glb, "http://www.example.com/"));
+  assert(!require::originPermitted(glb, "http://evil.example.com/"));
+  assert(calls == 0);
+  assert(require::addOriginMatcher(glb, "never", never_matcher));
+  assert(require::originPermitted(glb, "http://www.example.com/"));
+  assert(calls > 0);
+  assert(require::delOriginMatcher(glb, "never"));
+
+  // Changes to the config take effect once it is reloaded, remembered
+  // verdicts included
+  Value cfg = require::getConfig(glb);
+  cfg.setRecursive("natus.origins.blacklist", glb.newArray().push("http://www.*"), Value::PropAttrNone, true);
+  cfg.setRecursive("natus.require.whitelist", glb.newArray(), Value::PropAttrNone, true);
+  assert(require::originPermitted(glb, "http://www.example.com/"));
+  assert(!glb.evaluate("require('scriptmod')").isException());
+  assert(require::reloadConfig(glb));
+  assert(!require::originPermitted(glb, "http://www.example.com/"));
+  assert(require::originPermitted(glb, "http://evil.example.com/"));
+  assert(glb.evaluate("require('scriptmod')").isException());
+  cfg.getRecursive("natus.origins.whitelist").set((size_t) 0, "http://evil.*");
+  cfg.getRecursive("natus.origins.blacklist").push("http://evil.*");
+  assert(require::originPermitted(glb, "http://evil.example.com/"));
+  assert(require::reloadConfig(glb));
+  assert(!require::originPermitted(glb, "http://www.example.org/"));
+  assert(!require::originPermitted(glb, "http://evil.example.com/"));
+  cfg.getRecursive("natus.require.whitelist").push("scriptmod");
+  assert(require::reloadConfig(glb));
+  assert(glb.evaluate("require('scriptmod').number").to<int>() == 115);
+
+  // No whitelist at all lets everything through
+  Value open = Value::newGlobal(path.c_str());
+  Value none = open.newObject();
+  none.setRecursive("natus.require.path", open.newArray().push("./"), Value::PropAttrNone, true);
+  assert(require::init(open, none));
+  assert(require::originPermitted(open, "http://anything/"));
+
+  // Without require set up, nothing is permitted
+  assert(!require::originPermitted(global, "http://anything/"));
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include "test.hh"
+#include <natus-require.hh>
+
+#include <unistd.h>
+
+static void
+write_module(const char *file, const char *source)
+{
+  FILE *f = fopen(file, "w");
+  assert(f);
+  assert(fputs(source, f) >= 0);
+  fclose(f);
+}
+
+static Value
+setup(const char *engine, const char *dir, const char *mode)
+{
+  string path = string(ENGINEDIR) + "/" + engine + MODSUFFIX;
+  Value global = Value::newGlobal(path.c_str());
+  assert(!global.isException());
+
+  Value config = global.newObject();
+  config.setRecursive("natus.require.path", global.newArray().push(dir), Value::PropAttrNone, true);
+  if (mode)
+    config.setRecursive("natus.require.resolve", mode, Value::PropAttrNone, true);
+  assert(require::init(global, config));
+  return global;
+}
+
+static void
+check_stats(Value global, size_t hits, size_t misses)
+{
+  size_t h = 0, m = 0;
+  assert(require::resolveStats(global, &h, &m));
+  assert(h == hits);
+  assert(m == misses);
+}
+
+int
+doTest(Value& global)
+{
+  char dir[] = "/tmp/natus-resolve-XXXXXX";
+  assert(mkdtemp(dir));
+  string file = string(dir) + "/resolvemod.js";
+  write_module(file.c_str(), "exports.number = 1;");
+
+  // Repeated lookups of the same name are remembered
+  Value memo = setup(global.getEngineName(), dir, "memo");
+  check_stats(memo, 0, 0);
+  assert(require::require(memo, "resolvemod").get("number").to<int>() == 1);
+  check_stats(memo, 0, 1);
+  assert(require::require(memo, "resolvemod").get("number").to<int>() == 1);
+  assert(require::require(memo, "resolvemod").get("number").to<int>() == 1);
+  check_stats(memo, 2, 1);
+
+  // Names which aren't found are looked up every time
+  assert(require::require(memo, "missingmod").isException());
+  assert(require::require(memo, "missingmod").isException());
+  check_stats(memo, 2, 3);
+
+  // Changing the search path changes the lookup
+  assert(!memo.evaluate("require.paths.push('/nonexistent');").isException());
+  assert(require::require(memo, "resolvemod").get("number").to<int>() == 1);
+  check_stats(memo, 2, 4);
+  assert(memo.evaluate("require.paths.length == 2 && require.paths[1] == '/nonexistent'").to<bool>());
+  assert(!memo.evaluate("require.paths[1] = '/elsewhere';").isException());
+  assert(require::require(memo, "resolvemod").get("number").to<int>() == 1);
+  assert(require::require(memo, "resolvemod").get("number").to<int>() == 1);
+  check_stats(memo, 3, 5);
+  assert(memo.evaluate("require.paths[1] == '/elsewhere'").to<bool>());
+
+  // In mtime mode, the default, a changed file is looked up again
+  Value mtime = setup(global.getEngineName(), dir, NULL);
+  assert(require::require(mtime, "resolvemod").get("number").to<int>() == 1);
+  assert(require::require(mtime, "resolvemod").get("number").to<int>() == 1);
+  check_stats(mtime, 1, 1);
+  write_module(file.c_str(), "exports.number = 2; // changed");
+  assert(!require::require(mtime, "resolvemod").isException());
+  check_stats(mtime, 1, 2);
+  unlink(file.c_str());
+  assert(require::require(mtime, "resolvemod").isException());
+  check_stats(mtime, 1, 3);
+
+  // Only until the config asks for the plain memo
+  write_module(file.c_str(), "exports.number = 4;");
+  assert(!require::getConfig(mtime).setRecursive("natus.require.resolve", "memo").isException());
+  assert(require::reloadConfig(mtime));
+  assert(!require::require(mtime, "resolvemod").isException());
+  check_stats(mtime, 1, 4);
+  unlink(file.c_str());
+  assert(!require::require(mtime, "resolvemod").isException());
+  check_stats(mtime, 2, 4);
+
+  // Without the memo, every lookup searches the path
+  write_module(file.c_str(), "exports.number = 3;");
+  Value none = setup(global.getEngineName(), dir, "none");
+  assert(require::require(none, "resolvemod").get("number").to<int>() == 3);
+  assert(require::require(none, "resolvemod").get("number").to<int>() == 3);
+  check_stats(none, 0, 2);
+
+  unlink(file.c_str());
+  rmdir(dir);
+  return 0;
+}
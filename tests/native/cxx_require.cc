@@ -68,6 +68,12 @@ doTest(Value& global)
   assert(scriptmod.get("number").to<int>() == 115);
   assert(scriptmod.get("string").to<UTF8>() == "hello world");
 
+  // Shebang lines are skipped, however long they are
+  assert(global.evaluate("#!/usr/bin/natus\n40 + 2").to<int>() == 42);
+  string shebang = "#!" + string(1000, 'x') + "\n6 * 7";
+  assert(global.evaluate(shebang).to<int>() == 42);
+  assert(global.evaluate("#!\n1").to<int>() == 1);
+
   // Cleanup
   return 0;
 }
@@ -0,0 +1,67 @@
+#include "test.hh"
+
+static Value
+twice(Value& fnc, Value& ths, Value& args)
+{
+  NATUS_CHECK_ARGUMENTS(fnc, "n");
+
+  Scope scope(fnc);
+  Value tmp = fnc.newNumber(args[0].to<double>() * 2);
+  return scope.escape(tmp);
+}
+
+static Value
+makeArray(Value& global)
+{
+  Scope scope(global);
+  Value arr = global.newArray();
+  for (int i=0; i < 1000; i++)
+    arr.push(global.newNumber(i));
+  return scope.escape(arr);
+}
+
+int
+doTest(Value& global)
+{
+  // Temporaries are released with their scope, copies included
+  for (int i=0; i < 100; i++) {
+    Scope scope(global);
+    for (int j=0; j < 1000; j++) {
+      Value tmp = global.newNumber(j);
+      Value cpy = tmp;
+      assert(cpy.to<int>() == j);
+      assert(global.newString("x%d", j).isString());
+    }
+  }
+
+  // An escaped value survives its scope
+  Value arr = makeArray(global);
+  assert(arr.isArray());
+  assert(arr.get("length").to<int>() == 1000);
+  assert(arr.get((size_t) 999).to<int>() == 999);
+
+  // Scopes nest, and escape into the enclosing one
+  {
+    Scope outer(global);
+    Value kept;
+    {
+      Scope inner(global);
+      Value tmp = global.newNumber(42);
+      kept = inner.escape(tmp);
+    }
+    assert(kept.to<int>() == 42);
+    assert(!global.set("kept", kept).isException());
+  }
+  assert(global.get("kept").to<int>() == 42);
+  assert(!global.del("kept").isException());
+
+  // Native functions open their own scopes while javascript runs in ours
+  assert(!global.set("twice", twice).isException());
+  {
+    Scope scope(global);
+    for (int i=0; i < 100; i++)
+      assert(global.evaluate("twice(21)").to<int>() == 42);
+  }
+  assert(!global.del("twice").isException());
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include "test.hh"
+
+static Value
+nothing(Value& fnc, Value& ths, Value& arg)
+{
+  return fnc.newUndefined();
+}
+
+int
+doTest(Value& global)
+{
+  ContextStats before, after;
+
+  // Values count as created and live until released
+  assert(global.getContextStats(&before));
+  {
+    Value a = global.newNumber(1);
+    Value b = global.newString("x");
+    assert(global.getContextStats(&after));
+    assert(after.values == before.values + 2);
+    assert(after.live == before.live + 2);
+  }
+  assert(global.getContextStats(&after));
+  assert(after.live == before.live);
+
+  // Evaluations and calls into the engine
+  assert(global.getContextStats(&before));
+  Value fnc = global.evaluate("(function(x) { return x + 1; })");
+  assert(fnc.isFunction());
+  assert(fnc.call(global, global.newArray().push(1)).to<int>() == 2);
+  assert(global.getContextStats(&after));
+  assert(after.evaluations == before.evaluations + 1);
+  assert(after.calls == before.calls + 1);
+
+  // Calls back out of it
+  assert(!global.set("nothing", global.newFunction(nothing)).isException());
+  assert(global.getContextStats(&before));
+  assert(!global.evaluate("for (var i=0; i < 10; i++) nothing();").isException());
+  assert(global.getContextStats(&after));
+  assert(after.callbacks == before.callbacks + 10);
+
+  // natus.stats is only there once exposed, and can't be changed
+  assert(global.evaluate("typeof natus").to<UTF8>() == "undefined");
+  assert(global.exposeContextStats());
+  assert(global.evaluate("typeof natus.stats.calls == 'number'").to<bool>());
+  assert(!global.evaluate("var e = natus.stats.evaluations").isException());
+  assert(global.evaluate("natus.stats.evaluations == e + 1").to<bool>());
+  assert(global.evaluate("natus.stats.properties > 0").to<bool>());
+  assert(global.evaluate("natus.stats.live <= natus.stats.values").to<bool>());
+  assert(global.evaluate("natus.stats.foo").isUndefined());
+  assert(!global.evaluate("natus.stats.calls = -1; delete natus.stats.calls").isException());
+  assert(global.evaluate("natus.stats.calls >= 0").to<bool>());
+  assert(!global.evaluate("natus.stats = null").isException());
+  assert(global.evaluate("typeof natus.stats == 'object'").to<bool>());
+  assert(global.evaluate("Object.keys(natus.stats).length == 6").to<bool>());
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include "test.hh"
+#include <natus.h>
+
+int
+doTest(Value& global)
+{
+  // Fits, with room to spare
+  char buf[8];
+  memset(buf, 'x', sizeof(buf));
+  Value str = global.newString("abc");
+  assert(str.toUTF8(buf, sizeof(buf)) == 3);
+  assert(!strcmp(buf, "abc"));
+
+  // Truncated like snprintf()
+  Value longer = global.newString("abcdefghij");
+  assert(longer.toUTF8(buf, sizeof(buf)) == 10);
+  assert(!strcmp(buf, "abcdefg"));
+
+  // Never half a character: each of these takes three bytes
+  Value wide = global.newString("\xe2\x98\xba\xe2\x98\xba\xe2\x98\xba");
+  assert(wide.toUTF8(buf, sizeof(buf)) == 9);
+  assert(!strcmp(buf, "\xe2\x98\xba\xe2\x98\xba"));
+
+  // Measuring only, and non-strings
+  assert(longer.toUTF8(NULL, 0) == 10);
+  assert(global.newNumber(42).toUTF8(buf, sizeof(buf)) == 2);
+  assert(!strcmp(buf, "42"));
+  assert(global.newBoolean(true).toUTF8(buf, 1) == 4);
+  assert(!strcmp(buf, ""));
+
+  // Views see the same characters as a copy
+  natusValue *cstr = longer.borrowCValue();
+  natusStringView view;
+  const natusChar *chars = NULL;
+  size_t len = 0;
+  assert(natus_string_view_utf16(cstr, &chars, &len, &view));
+  assert(len == 10);
+  assert(chars[0] == 'a' && chars[9] == 'j');
+  natus_string_view_release(&view);
+  natus_string_view_release(&view);
+
+  // External strings are lent back as they were made
+  static const natusChar ext[] = { 'h', 'i', 0x263A, 0 };
+  Value extv = global.newStringExternal(ext, 3, NULL);
+  assert(natus_string_view_utf16(extv.borrowCValue(), &chars, &len, &view));
+  assert(len == 3 && chars[2] == 0x263A);
+  natus_string_view_release(&view);
+
+  // Non-strings are converted
+  Value num = global.newNumber(1.5);
+  assert(natus_string_view_utf16(num.borrowCValue(), &chars, &len, &view));
+  assert(len == 3 && chars[0] == '1' && chars[1] == '.' && chars[2] == '5');
+  natus_string_view_release(&view);
+
+  assert(!natus_string_view_utf16(NULL, &chars, &len, &view));
+
+  // Ranges copy only what was asked for
+  Char part[4];
+  assert(longer.toUTF16(part, 2, 4) == 4);
+  assert(part[0] == 'c' && part[3] == 'f');
+  assert(longer.toUTF16(part, 8, 4) == 2);
+  assert(part[0] == 'i' && part[1] == 'j');
+  assert(longer.toUTF16(part, 10, 4) == 0);
+  assert(longer.toUTF16(part, 100, 4) == 0);
+  assert(extv.toUTF16(part, 2, 1) == 1 && part[0] == 0x263A);
+  assert(num.toUTF16(part, 1, 4) == 2 && part[0] == '.' && part[1] == '5');
+  assert(natus_to_string_utf16_range(NULL, 0, (natusChar*) part, 4) == (size_t) -1);
+  return 0;
+}
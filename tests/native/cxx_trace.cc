@@ -0,0 +1,138 @@
+#include "test.hh"
+#include <natus-require.hh>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+struct Event {
+  TraceEvent event;
+  bool       enter;
+  string     name;
+  uint64_t   ns;
+};
+
+static void
+record(TraceEvent event, bool enter, const char* name, uint64_t ns, void* misc)
+{
+  Event e = { event, enter, name, ns };
+  ((vector<Event>*) misc)->push_back(e);
+}
+
+static bool
+has(const vector<Event>& events, TraceEvent event, bool enter, const char* name)
+{
+  for (size_t i=0; i < events.size(); i++)
+    if (events[i].event == event && events[i].enter == enter && events[i].name == name)
+      return true;
+  return false;
+}
+
+static Value
+nothing(Value& fnc, Value& ths, Value& arg)
+{
+  return fnc.newUndefined();
+}
+
+class Answer : public Class {
+  virtual Value
+  get(Value& obj, Value& name)
+  {
+    return obj.newNumber(42);
+  }
+
+  virtual Class::Hooks
+  getHooks()
+  {
+    return Class::HookGet;
+  }
+};
+
+int
+doTest(Value& global)
+{
+  vector<Event> events;
+
+  assert(!global.set("nothing", global.newFunction(nothing, "nothing")).isException());
+  assert(!global.set("answer", global.newObject(new Answer())).isException());
+  assert(!global.evaluate("function foo(x) { return x; }").isException());
+
+  // Nothing is reported before a tracer is set
+  assert(global.setTracer(record, &events));
+  assert(events.empty());
+
+  // Evaluations, and native functions called from them
+  assert(!global.evaluate("nothing()", "trace.js").isException());
+  assert(events.size() == 4);
+  assert(events[0].event == TraceEvaluate && events[0].enter && events[0].name == "trace.js");
+  assert(events[1].event == TraceCallback && events[1].enter && events[1].name == "nothing");
+  assert(events[2].event == TraceCallback && !events[2].enter && events[2].name == "nothing");
+  assert(events[3].event == TraceEvaluate && !events[3].enter && events[3].name == "trace.js");
+  for (size_t i=1; i < events.size(); i++)
+    assert(events[i].ns >= events[i-1].ns);
+
+  // Calls into script functions
+  events.clear();
+  assert(global.call("foo", global.newArray().push(1)).to<int>() == 1);
+  assert(events.size() == 2);
+  assert(has(events, TraceCall, true, "foo") && has(events, TraceCall, false, "foo"));
+
+  // Class property hooks
+  events.clear();
+  assert(global.evaluate("answer.x + answer[7]").to<int>() == 84);
+  assert(has(events, TraceProperty, true, "get x") && has(events, TraceProperty, false, "get x"));
+  assert(has(events, TraceProperty, true, "get 7"));
+
+  // Modules, by name and then by uri
+  char dir[] = "/tmp/natus-trace-XXXXXX";
+  assert(mkdtemp(dir));
+  string file = string(dir) + "/traced.js";
+  ofstream(file.c_str()) << "exports.x = 1;\n";
+
+  Value config = global.newObject();
+  config.setRecursive("natus.require.path", global.newArray().push(dir), Value::PropAttrNone, true);
+  assert(require::init(global, config));
+
+  events.clear();
+  assert(require::require(global, "traced").get("x").to<int>() == 1);
+  assert(has(events, TraceRequire, true, "traced"));
+  assert(has(events, TraceRequire, false, ("file://" + file).c_str()) ||
+         has(events, TraceRequire, false, file.c_str()));
+  assert(require::require(global, "missing").isException());
+  assert(has(events, TraceRequire, true, "missing") && has(events, TraceRequire, false, "missing"));
+  unlink(file.c_str());
+
+  // Unset, nothing more is reported
+  assert(global.setTracer(NULL));
+  events.clear();
+  assert(!global.evaluate("nothing()").isException());
+  assert(events.empty());
+
+  // The Chrome collector writes a complete trace once replaced
+  string trace = string(dir) + "/trace.json";
+  assert(global.traceChrome(trace.c_str()));
+  assert(!global.evaluate("foo(nothing())", "chrome.js").isException());
+  assert(global.setTracer(NULL));
+
+  stringstream json;
+  json << ifstream(trace.c_str()).rdbuf();
+  unlink(trace.c_str());
+  rmdir(dir);
+
+  Value parsed = global.get("JSON").call("parse", global.newArray().push(json.str()));
+  assert(!parsed.isException());
+  assert(!global.set("trace", parsed).isException());
+  // require()'s evaluate hook makes calls of its own, so only look for ours
+  assert(global.evaluate("trace.traceEvents[0].ph == 'M'").to<bool>());
+  assert(global.evaluate("function count(ph, cat, name) {"
+                         "  return trace.traceEvents.filter(function(e) {"
+                         "    return e.ph == ph && (!cat || (e.cat == cat && e.name == name));"
+                         "  }).length;"
+                         "}").isUndefined());
+  assert(global.evaluate("count('B') == count('E')").to<bool>());
+  assert(global.evaluate("count('B', 'evaluate', 'chrome.js') == 1").to<bool>());
+  assert(global.evaluate("count('E', 'callback', 'nothing') == 1").to<bool>());
+  return 0;
+}